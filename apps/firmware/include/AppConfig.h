@@ -1,15 +1,62 @@
 #pragma once
 #include <Arduino.h>
 #include <vector>
+#include "MeterProfiles.h"
+#include "ModbusRtuMaster.h"
+#include "SpscRing.h"
+
+// Report-by-exception: o canal só publica quando alguma grandeza sai da banda
+// morta ou quando vence o heartbeat. A banda de cada grandeza é a maior entre
+// o valor absoluto e `percent`% do último valor publicado (o absoluto segura o
+// ruído perto de zero, o percentual escala com a carga). Grandeza com banda
+// 0 não dispara. Tudo zero = publica toda leitura (comportamento antigo).
+struct Deadband {
+    float voltage = 0;   // V
+    float current = 0;   // A
+    float power = 0;     // W
+    float energy = 0;    // kWh
+    float percent = 0;   // % do último valor publicado (V, I e P)
+    uint16_t heartbeatSec = 0; // Silêncio máximo (0 = DEADBAND_DEFAULT_HEARTBEAT_S)
+
+    bool enabled() const { return voltage > 0 || current > 0 || power > 0 || energy > 0 || percent > 0; }
+};
+
+const uint16_t DEADBAND_DEFAULT_HEARTBEAT_S = 900;
 
 // Estrutura de um medidor individual
 struct MeterConfig {
     uint8_t id;         // ID interno (ex: 1, 2)
     uint8_t channelIndex;
     uint8_t modbusId;   // Endereço no barramento RS485 (ex: 10, 11)
+    MeterModel model;   // Perfil de registradores (ex: "dds238", "sdm120")
+    uint16_t periodSec; // Período de leitura próprio (0 = intervalo global)
+    uint8_t bus = 0;    // Índice em SystemConfig::buses
+    Deadband deadband;  // Report-by-exception (desligado por padrão)
     String name;        // Ex: "Kitnet 101"
 };
 
+// Barramento RS485: uma UART do ESP32 + transceptor (MAX485).
+// Os valores padrão são o barramento único das placas antigas.
+struct BusConfig {
+    uint8_t uart = 2;     // 1 = Serial1, 2 = Serial2 (a UART0 é o console)
+    int8_t rxPin = 16;
+    int8_t txPin = 17;
+    int8_t dePin = 4;     // RE & DE do MAX485 (acionado pela própria UART)
+    uint32_t baud = 9600;
+    SerialParity parity = PARITY_NONE; // 8N1 é o padrão da maioria dos medidores
+
+    SerialLine line() const { SerialLine l = { baud, parity }; return l; }
+};
+
+// UARTs livres para RS485 no ESP32 (UART1 e UART2)
+const uint8_t MAX_BUSES = 2;
+
+// Codificação do payload de telemetria
+enum PayloadFormat : uint8_t {
+    PAYLOAD_JSON = 0,    // energymeter/{id}/data    (texto, compatível com o backend atual)
+    PAYLOAD_MSGPACK = 1  // energymeter/{id}/data.v2 (MessagePack com chaves inteiras)
+};
+
 // Estrutura global de configuração
 struct SystemConfig {
     // WiFi
@@ -22,16 +69,45 @@ struct SystemConfig {
     int mqttPort;
     String deviceId;    // Ex: "central_condominio_01"
     int interval;       // Intervalo de envio em segundos
+    uint16_t samplePeriod = 0; // Amostragem rápida (s) agregada em resumos por intervalo; 0 = uma leitura por intervalo
+    PayloadFormat payloadFormat = PAYLOAD_JSON;
+    // Fila de leituras cheia (MQTT lento): por padrão o excedente vai para o outbox em flash
+    RingOverflow queueOverflow = RING_SPILL;
 
-    // Medidores
+    // Barramentos RS485 (sempre ao menos um) e medidores
+    std::vector<BusConfig> buses;
     std::vector<MeterConfig> meters;
 };
 
+// Flags de MeterReading
+const uint8_t READING_CYCLE_END = 0x01; // Última leitura do ciclo de polling
+const uint8_t READING_SUMMARY = 0x02;   // Resumo de uma janela (ver ChannelStats)
+const uint8_t READING_TIME_UTC = 0x04;  // timeMs em UTC; sem a flag, ms desde o boot bootId (ver WallClock)
+
+// Leituras por ciclo (medidores liberados de uma vez / agrupados na PubTask)
+const uint8_t MAX_CYCLE_READINGS = 64;
+
 // Estrutura de Leitura (O que vai para a fila MQTT)
+// Com READING_SUMMARY, voltage/current/power são as médias da janela e
+// totalKwh a última leitura; os campos de voltageMin a energyDelta só valem no resumo.
 struct MeterReading {
     uint8_t channelId;
+    uint8_t flags;      // READING_*
+    uint16_t samples;   // Amostras agregadas no resumo
     float voltage;
     float current;
     float power;
     float totalKwh;
+
+    float voltageMin;
+    float voltageMax;
+    float currentMin;
+    float currentMax;
+    float powerMin;
+    float powerMax;
+    float energyDelta;  // kWh consumidos na janela
+
+    // Instante da amostra (no resumo, o da última amostra da janela)
+    uint16_t bootId;    // Boot em que foi lida (só vale sem READING_TIME_UTC)
+    int64_t timeMs;     // UTC em ms (READING_TIME_UTC) ou ms desde o boot
 };
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include <ArduinoJson.h>
+#include <string.h>
+
+// Alocador "bump" sobre um buffer estático, para JsonDocument de vida curta
+// no caminho quente (publicação). Nenhuma chamada a malloc, nenhuma
+// fragmentação do heap: os blocos são liberados todos de uma vez quando o
+// último deles é devolvido (documento destruído ou limpo).
+//
+// Se o buffer acabar, allocate() devolve nullptr e o ArduinoJson marca o
+// documento como overflowed() — o chamador decide o que fazer.
+template <size_t N>
+class ArenaAllocator : public ArduinoJson::Allocator {
+public:
+    void *allocate(size_t size) override {
+        size_t total = HEADER + align(size);
+        if (_used + total > N) {
+            _failures++;
+            return nullptr;
+        }
+
+        uint8_t *block = _buf + _used;
+        *(size_t *)block = size;
+        _last = _used;
+        _used += total;
+        _live++;
+        if (_used > _peak) _peak = _used;
+        return block + HEADER;
+    }
+
+    void deallocate(void *ptr) override {
+        if (!ptr || _live == 0) return;
+        if (--_live == 0) _used = 0;
+    }
+
+    void *reallocate(void *ptr, size_t newSize) override {
+        if (!ptr) return allocate(newSize);
+
+        uint8_t *block = (uint8_t *)ptr - HEADER;
+        size_t offset = block - _buf;
+
+        // Último bloco: cresce/encolhe no lugar
+        if (offset == _last) {
+            size_t total = HEADER + align(newSize);
+            if (offset + total > N) {
+                _failures++;
+                return nullptr;
+            }
+            *(size_t *)block = newSize;
+            _used = offset + total;
+            if (_used > _peak) _peak = _used;
+            return ptr;
+        }
+
+        size_t oldSize = *(size_t *)block;
+        void *moved = allocate(newSize);
+        if (!moved) return nullptr;
+        memcpy(moved, ptr, oldSize < newSize ? oldSize : newSize);
+        deallocate(ptr);
+        return moved;
+    }
+
+    size_t used() const { return _used; }
+    size_t peak() const { return _peak; }
+    size_t failures() const { return _failures; }
+
+private:
+    static const size_t HEADER = 8; // guarda o tamanho e mantém alinhamento de 8 bytes
+
+    static size_t align(size_t n) { return (n + 7) & ~(size_t)7; }
+
+    alignas(8) uint8_t _buf[N];
+    size_t _used = 0;
+    size_t _last = 0;
+    size_t _live = 0;
+    size_t _peak = 0;
+    size_t _failures = 0;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+
+// Substituição atômica de arquivos no LittleFS (queda de energia no meio de
+// um save não deixa arquivo pela metade).
+//
+// Grava tudo em <path>.tmp, fecha (o close faz o sync dos blocos no LittleFS)
+// e só então promove: <path> -> <path>.bak e <path>.tmp -> <path>. Cada rename
+// do LittleFS é atômico, então em qualquer instante existe um <path> completo
+// ou, na janela entre os dois renames, o <path>.bak (última versão boa).
+// Quem lê tenta <path> e depois <path>.bak.
+class AtomicFile {
+public:
+    // Abre <path>.tmp para escrita (truncado)
+    static File begin(const char *path);
+
+    // Fecha o temporário e o promove a <path>; o anterior vira <path>.bak
+    static bool commit(File &tmp, const char *path);
+
+    // Desiste do temporário (o <path> atual fica intocado)
+    static void abort(File &tmp, const char *path);
+
+    // Remove <path>, <path>.bak e um <path>.tmp esquecido
+    static void removeAll(const char *path);
+
+    // CRC-32 do conteúdo (false se não existir)
+    static bool crc(const char *path, uint32_t &out);
+
+    // "<path><suffix>" (buf com PATH_MAX_LEN bytes)
+    static const char *withSuffix(char *buf, const char *path, const char *suffix);
+
+    static const size_t PATH_MAX_LEN = 32;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+// Backoff exponencial com teto: base, 2*base, 4*base ... até maxMs.
+// Com jitterPct > 0 cada atraso é sorteado em ±jitterPct% (o chamador passa
+// o número aleatório, ex: esp_random()), para que vários gateways que caíram
+// juntos não voltem todos no mesmo instante.
+class Backoff {
+public:
+    Backoff(uint32_t baseMs = 1000, uint32_t maxMs = 60000, uint8_t jitterPct = 0)
+        : _base(baseMs), _max(maxMs), _jitter(jitterPct), _current(0), _attempts(0) {}
+
+    void reset() {
+        _current = 0;
+        _attempts = 0;
+    }
+
+    // Próximo atraso (e avança a sequência)
+    uint32_t next(uint32_t random = 0) {
+        _current = (_current == 0) ? _base : (_current >= _max / 2 ? _max : _current * 2);
+        if (_attempts < 0xFFFF) _attempts++;
+
+        if (_jitter == 0) return _current;
+        uint32_t span = (uint32_t)((uint64_t)_current * _jitter / 100);
+        if (span == 0) return _current;
+        return _current - span + random % (2 * span + 1);
+    }
+
+    // Atraso atual sem avançar (0 antes da primeira falha)
+    uint32_t current() const { return _current; }
+    uint16_t attempts() const { return _attempts; }
+
+private:
+    uint32_t _base;
+    uint32_t _max;
+    uint8_t _jitter;
+    uint32_t _current;
+    uint16_t _attempts;
+};
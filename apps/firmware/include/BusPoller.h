@@ -0,0 +1,128 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <vector>
+#include "AppConfig.h"
+#include "ChannelStats.h"
+#include "ConfigStore.h"
+#include "ExceptionFilter.h"
+#include "MeterDiscovery.h"
+#include "ModbusWorker.h"
+#include "PollScheduler.h"
+#include "SpscRing.h"
+#include "UartRtuPort.h"
+
+// Um barramento RS485 completo: UART, mestre Modbus, escalonador e a task
+// que lê os medidores dele. Cada instância é independente (sem globais
+// compartilhados), então N barramentos fazem o polling em paralelo e o tempo
+// de ciclo do gateway cai com o número de barramentos.
+//
+// Medidores, intervalo e amostragem vêm do ConfigStore e são trocados sem
+// reboot no fim de um ciclo; UART, pinos e fila são fixos desde o start().
+
+// Leituras do barramento para a PubTask (um produtor: esta task; um consumidor: a PubTask)
+typedef SpscRing<MeterReading> ReadingRing;
+
+// Fila com folga para dois ciclos completos do barramento
+const size_t READING_RING_MIN = 16;
+
+// Descoberta de medidores (/api/discover) em um barramento
+enum DiscoveryState : uint8_t {
+    DISCOVERY_IDLE = 0,
+    DISCOVERY_PENDING,   // Pedida, a task ainda não pegou (termina o ciclo atual)
+    DISCOVERY_RUNNING,   // Varrendo: o polling deste barramento fica parado
+    DISCOVERY_DONE
+};
+
+class BusPoller {
+public:
+    // Separa os medidores deste barramento, cria a fila de leituras e a task
+    // de polling. No fim de cada ciclo a task acorda *consumer (notificação);
+    // com a fila cheia o excedente segue queueOverflow (spill -> `spill`).
+    bool start(uint8_t busIndex, ConfigStore &store, TaskHandle_t *consumer, ReadingRing::SpillFn spill);
+
+    // Acorda a task para aplicar uma config nova já (senão só na próxima liberação)
+    void notifyConfigChanged() { if (_task) xTaskNotifyGive(_task); }
+
+    uint8_t index() const { return _index; }
+    size_t meterCount() const { return _meterCount; }
+    const SchedulerStats &stats() const { return _scheduler.stats(); }
+
+    // Saúde do i-ésimo medidor deste barramento (lido pela PubTask e pelo
+    // servidor web; campos de 32 bits, uma leitura "rasgada" no máximo mistura
+    // dois ciclos). false se i saiu da lista (config trocada desde o meterCount()).
+    bool meterStatus(size_t i, MeterStatus &out) const;
+    uint32_t healthChanges() const { return _worker.health().changes(); }
+
+    // Leituras seguradas pelas bandas mortas
+    uint32_t suppressed() const { return _filter.suppressed(); }
+
+    // Fila de leituras deste barramento (a PubTask consome com popBatch)
+    ReadingRing &readings() { return _ring; }
+    const ReadingRing &readings() const { return _ring; }
+
+    // Descoberta (ver MeterDiscovery.h), pedida pela task do servidor web.
+    // A task do barramento varre entre dois ciclos e volta para a linha
+    // configurada. false = já há uma em andamento ou o barramento não subiu.
+    bool startDiscovery(bool allLines, uint32_t timeoutUs);
+    DiscoveryState discoveryState() const { return (DiscoveryState)_discovery.load(); }
+    uint16_t discoveryProbed() const { return _discoveryProbed.load(); }
+    uint16_t discoveryTotal() const { return _discoveryTotal; }
+    // Medidores achados; só valem com DISCOVERY_DONE
+    const std::vector<DiscoveredMeter> &discovered() const { return _discovered; }
+
+    // Menor folga de pilha já vista na task deste barramento (bytes)
+    uint32_t stackHighWater() const { return _task ? uxTaskGetStackHighWaterMark(_task) : 0; }
+
+private:
+    uint8_t _index = 0;
+    BusConfig _bus;
+    std::vector<MeterConfig> _meters;
+    uint32_t _defaultPeriodMs = 0;
+
+    // Config aplicada (só a task deste barramento troca; ver reload())
+    ConfigStore *_store = NULL;
+    uint32_t _appliedVersion = 0;
+    int _interval = 0;
+    uint16_t _samplePeriod = 0;
+    uint32_t _meterCount = 0;             // Cópia de _meters.size() para as outras tasks
+    SemaphoreHandle_t _viewLock = NULL;   // Protege _meters e a saúde enquanto são trocados
+    ReadingRing _ring;
+    TaskHandle_t *_consumer = NULL;
+    TaskHandle_t _task = NULL;
+
+    // Agregação (samplePeriod > 0): amostras rápidas viram um resumo por intervalo
+    bool _aggregate = false;
+    uint32_t _reportMs = 0;
+    uint32_t _nextReport = 0;
+    // Um por medidor. Remontado no fim de um ciclo quando um reload troca os
+    // medidores, depois de as janelas abertas saírem (flushSummaries); quem
+    // continua leva a base de energia (ver applyConfig)
+    std::vector<ChannelStats> _stats;
+
+    // Report-by-exception das leituras instantâneas (resumos sempre saem)
+    ExceptionFilter _filter;
+
+    UartRtuPort _port;
+    ModbusWorker _worker;
+    PollScheduler _scheduler;
+
+    // Descoberta: parâmetros e resultados escritos com o estado em IDLE/DONE
+    // (servidor web) ou RUNNING (esta task), nunca pelas duas ao mesmo tempo
+    std::atomic<uint8_t> _discovery{DISCOVERY_IDLE};
+    std::atomic<uint16_t> _discoveryProbed{0};
+    uint16_t _discoveryTotal = 0;
+    bool _discoverAllLines = false;
+    uint32_t _discoverTimeoutUs = DISCOVERY_TIMEOUT_US;
+    std::vector<DiscoveredMeter> _discovered;
+
+    static void taskEntry(void *self);
+    void run();
+    void flushSummaries(uint32_t now);
+    void applyConfig(const SystemConfig &config);
+    void reload();
+    void runDiscovery();
+
+    static HardwareSerial *serialFor(uint8_t uart);
+    static void onMeterRead(const MeterConfig &meter, bool ok, const MeterReading &reading, void *ctx);
+};
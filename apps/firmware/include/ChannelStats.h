@@ -0,0 +1,51 @@
+#pragma once
+#include <Arduino.h>
+#include "AppConfig.h"
+
+// Mínimo/máximo/média de uma grandeza na janela atual.
+// A soma é em double: com amostras de 1 s, uma janela de um dia (86400
+// amostras de ~220 V) já perderia casas decimais numa soma em float.
+struct RunningStat {
+    float min = 0;
+    float max = 0;
+    double sum = 0;
+
+    void add(float x, bool first) {
+        if (first || x < min) min = x;
+        if (first || x > max) max = x;
+        sum += x;
+    }
+};
+
+// Agregador de um canal entre dois relatórios: as leituras rápidas (ex: a
+// cada 2 s) entram com add() e saem como UMA leitura-resumo por intervalo.
+// Memória fixa, sem alocação.
+//
+// Energia: soma os incrementos de totalKwh entre amostras consecutivas. Se o
+// contador voltar (medidor trocado/zerado), o trecho é ignorado e a base
+// recomeça. A última amostra fica como base da próxima janela, para não perder
+// o consumo entre a última leitura de uma janela e a primeira da seguinte.
+// O resumo leva o carimbo de tempo da última amostra da janela.
+class ChannelStats {
+public:
+    void add(const MeterReading &reading);
+
+    uint32_t count() const { return _count; }
+
+    // Preenche `out` com o resumo (READING_SUMMARY: médias em voltage/current/
+    // power, último totalKwh, min/max, energyDelta e o tempo da última
+    // amostra) e abre uma nova janela
+    void summarize(MeterReading &out);
+
+private:
+    uint32_t _count = 0;
+    RunningStat _voltage;
+    RunningStat _current;
+    RunningStat _power;
+    double _energy = 0;
+    float _lastKwh = 0;
+    bool _hasKwh = false;
+    int64_t _lastTimeMs = 0;
+    uint16_t _lastBootId = 0;
+    uint8_t _lastTimeFlag = 0;  // READING_TIME_UTC da última amostra
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (IEEE 802.3, polinômio refletido 0xEDB88320).
+// Versão bit-a-bit: sem tabela de 1 KB na RAM, suficiente para registros pequenos.
+inline uint32_t crc32(const void *data, size_t len, uint32_t crc = 0) {
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+// CRC-16/MODBUS (polinômio refletido 0xA001, valor inicial 0xFFFF).
+// No quadro RTU vai o byte baixo primeiro.
+inline uint16_t crc16Modbus(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+        crc ^= *data++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
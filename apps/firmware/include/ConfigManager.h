@@ -3,27 +3,82 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include "AppConfig.h"
+#include "JsonInput.h"
 
+// De onde veio a configuração do último load()
+enum ConfigSource : uint8_t {
+    CONFIG_FROM_SNAPSHOT = 0, // /config.bin (caminho rápido)
+    CONFIG_FROM_JSON,         // /config.json (snapshot ausente ou desatualizado)
+    CONFIG_FROM_BACKUP,       // .bak de um dos dois (o atual estava corrompido)
+    CONFIG_FROM_DEFAULTS
+};
+
+// Persistência do SystemConfig.
+//
+// O config.json é a fonte; ao lado dele fica o snapshot binário
+// (ConfigSnapshot), lido primeiro no boot. Toda gravação é atômica
+// (AtomicFile) e mantém a versão anterior em .bak como última versão boa.
+//
+// O JSON é escrito em partes (cabeçalho, um medidor por parte, fechamento) e
+// lido em duas passadas (cabeçalho filtrado, depois um medidor por vez): o
+// pico de heap de load/save e do /api/config não cresce com os medidores.
 class ConfigManager {
 public:
     // Inicializa o sistema de arquivos (LittleFS)
     bool begin();
 
-    // Carrega o arquivo JSON para a struct SystemConfig
+    // Carrega a configuração: snapshot -> config.json -> .bak -> padrão
     SystemConfig load();
 
-    // Salva a struct SystemConfig de volta para o JSON
+    // Salva a struct SystemConfig no JSON e no snapshot
     bool save(const SystemConfig &config);
 
-    // Restaura as configurações de fábrica (apaga o json atual)
+    // Restaura as configurações de fábrica (apaga json, snapshot e backups)
     void reset();
 
+    ConfigSource lastSource() const { return _source; }
+    static const char *sourceName(ConfigSource source);
+
+    // Lê um medidor / a lista de barramentos do JSON (também usado pelo /api/save)
+    static MeterConfig parseMeter(JsonObjectConst m);
+    static void parseBuses(JsonArrayConst buses, SystemConfig &config);
+
+    // Primeira passada: só "wifi", "mqtt" e "buses" (os medidores são pulados)
+    static DeserializationError readHeader(JsonInput &in, JsonDocument &doc);
+
+    // Segunda passada: a lista "meters", um medidor por vez.
+    // 1 = lida, 0 = sem a chave "meters", -1 = JSON inválido
+    static int readMeters(JsonInput &in, std::vector<MeterConfig> &meters);
+
+    // Partes do JSON: 0 = cabeçalho, 1..N = um medidor cada, N+1 = fechamento.
+    // Concatenadas formam o documento inteiro. `forApi` omite a senha do WiFi
+    // e inclui "system" (para o painel). Retorna os bytes escritos.
+    static size_t partCount(const SystemConfig &config) { return config.meters.size() + 2; }
+    static size_t writePart(const SystemConfig &config, size_t part, Print &out, bool forApi = false);
+
+    // Garante ao menos um barramento e medidores apontando para barramentos existentes
+    static void normalizeBuses(SystemConfig &config);
+
+    // "drop_oldest" / "drop_newest" / "spill" (desconhecido = spill)
+    static RingOverflow overflowFromName(const char *name);
+    static const char *overflowName(RingOverflow policy);
+
+    // "none" / "even" / "odd" (desconhecido = none)
+    static SerialParity parityFromName(const char *name);
+    static const char *parityName(SerialParity parity);
+
 private:
     const char* CONFIG_FILE = "/config.json";
-    
+    const char* SNAPSHOT_FILE = "/config.bin";
+    ConfigSource _source = CONFIG_FROM_DEFAULTS;
+
+    bool parseFile(const char *path, SystemConfig &config);
+
     // Converte JSON -> Struct
     SystemConfig deserialize(const JsonDocument &doc);
     
     // Converte Struct -> JSON
     void serialize(const SystemConfig &config, JsonDocument &doc);
+    static void serializeHeader(const SystemConfig &config, JsonDocument &doc, bool forApi);
+    static void serializeMeter(const MeterConfig &m, JsonObject mObj);
 };
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "AppConfig.h"
+
+// --- Snapshot binário do SystemConfig (/config.bin) ---
+//
+// O config.json continua sendo a fonte (é o que a API e o usuário editam);
+// o snapshot é a mesma configuração já "parseada", para o boot não precisar
+// montar um JsonDocument no heap. Formato: cabeçalho fixo + payload com os
+// campos gravados um a um (strings com prefixo de tamanho). O CRC cobre
+// cabeçalho e payload; `sourceCrc` é o CRC do config.json que gerou o
+// snapshot, então um JSON trocado por fora (uploadfs, edição manual) invalida
+// o snapshot em vez de ser ignorado.
+//
+// Mudou algum campo do SystemConfig? Incremente CONFIG_SNAPSHOT_VERSION: o
+// snapshot antigo é descartado e refeito a partir do JSON no próximo boot.
+
+const uint32_t CONFIG_SNAPSHOT_MAGIC = 0x4746434D; // "MCFG"
+const uint16_t CONFIG_SNAPSHOT_VERSION = 2; // 2: paridade dos barramentos
+
+class ConfigSnapshot {
+public:
+    // Cabeçalho + payload em `out`
+    static void encode(const SystemConfig &config, uint32_t sourceCrc, std::vector<uint8_t> &out);
+
+    // false se magic, versão, CRC ou algum limite não bater (config fica intocada)
+    static bool decode(const uint8_t *data, size_t len, SystemConfig &config, uint32_t &sourceCrc);
+
+    // Lê/grava o arquivo inteiro (gravação atômica, ver AtomicFile)
+    static bool read(const char *path, SystemConfig &config, uint32_t &sourceCrc);
+    static bool write(const char *path, const SystemConfig &config, uint32_t sourceCrc);
+};
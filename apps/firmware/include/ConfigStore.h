@@ -0,0 +1,66 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <memory>
+#include "AppConfig.h"
+
+// --- Configuração viva, trocada sem reboot (estilo RCU) ---
+//
+// Cada versão do SystemConfig é um snapshot imutável. Quem lê pega o atual
+// com get() e segura o ponteiro durante um ciclo/request inteiro: enquanto
+// segura, os campos não mudam, mesmo que o /api/save publique outra versão
+// no meio. publish() monta a versão nova fora do lugar e troca o ponteiro
+// de uma vez; a antiga é liberada quando o último leitor a solta.
+//
+// Cada consumidor guarda a versão que aplicou e, no próprio ponto seguro
+// (fim de ciclo do barramento, volta da NetTask), compara com version() e
+// refaz só o que mudou (ver diff()).
+//
+// Escritores serializados pelo NetworkManager (o /api/save na task do
+// servidor web, o fim de uma descoberta na NetTask); leitores em qualquer task.
+
+typedef std::shared_ptr<const SystemConfig> ConfigRef;
+
+// O que mudou entre duas versões (bits de ConfigStore::diff)
+const uint8_t CONFIG_CHANGED_WIFI = 0x01;     // SSID, senha, AP forçado: refaz só o WiFi
+const uint8_t CONFIG_CHANGED_MQTT = 0x02;     // Broker, porta, device id: reconecta só o MQTT
+const uint8_t CONFIG_CHANGED_POLLING = 0x04;  // Medidores, intervalo, amostragem: barramentos no fim do ciclo
+const uint8_t CONFIG_CHANGED_PAYLOAD = 0x08;  // Formato do payload: vale no próximo publish
+const uint8_t CONFIG_CHANGED_HARDWARE = 0x10; // UART/pinos/baud/paridade dos barramentos, política da fila: exige reinício
+
+// Avisado depois de cada publish() (na task de quem publicou)
+typedef void (*ConfigListener)(uint8_t changes, void *ctx);
+
+class ConfigStore {
+public:
+    // Versão atual (nunca nula depois do primeiro publish)
+    ConfigRef get() const { return std::atomic_load(&_current); }
+
+    // Incrementa a cada publish (comparar é mais barato que pegar o snapshot)
+    uint32_t version() const { return _version.load(std::memory_order_acquire); }
+
+    // Publica uma cópia de `next`. Retorna o que mudou em relação à anterior.
+    uint8_t publish(const SystemConfig &next);
+
+    void setListener(ConfigListener listener, void *ctx = NULL) {
+        _listener = listener;
+        _listenerCtx = ctx;
+    }
+
+    static uint8_t diff(const SystemConfig &a, const SystemConfig &b);
+
+    // Mesmos medidores, na mesma ordem, com os mesmos parâmetros
+    static bool sameMeters(const std::vector<MeterConfig> &a, const std::vector<MeterConfig> &b);
+
+    // Para cada medidor de `after`, a posição dele em `before` (mesmo
+    // modbusId e modelo) ou -1 se é novo ou trocado. É o que mantém a saúde,
+    // a banda morta e a agregação de quem continua no barramento num reload.
+    static void matchMeters(const std::vector<MeterConfig> &before, const std::vector<MeterConfig> &after,
+                            std::vector<int> &from);
+
+private:
+    ConfigRef _current;
+    std::atomic<uint32_t> _version{0};
+    ConfigListener _listener = NULL;
+    void *_listenerCtx = NULL;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "AppConfig.h"
+
+// Filtro de report-by-exception (ver Deadband em AppConfig.h).
+// Guarda, por canal, a última leitura PUBLICADA e o instante dela; a
+// comparação é sempre contra ela, então uma deriva lenta acaba saindo.
+class ExceptionFilter {
+public:
+    // Um slot por medidor (alocado uma vez)
+    void reset(size_t channels);
+
+    // Lista de medidores trocada: o i-ésimo compara com a referência do
+    // antigo from[i] (-1 = a próxima leitura sai; ver ConfigStore::matchMeters)
+    void remap(const std::vector<int> &from);
+
+    // true se a leitura deve ser publicada (e passa a ser a nova referência)
+    bool shouldReport(size_t i, const Deadband &deadband, const MeterReading &reading, uint32_t nowMs);
+
+    // Alguma grandeza de `reading` saiu da banda em relação a `last`?
+    static bool exceeds(const Deadband &deadband, const MeterReading &last, const MeterReading &reading);
+
+    // Leituras seguradas pelo filtro desde o boot
+    uint32_t suppressed() const { return _suppressed; }
+
+private:
+    struct LastReport {
+        float voltage;
+        float current;
+        float power;
+        float totalKwh;
+        uint32_t atMs;
+        bool valid;
+    };
+
+    std::vector<LastReport> _last;
+    uint32_t _suppressed = 0;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+
+// Entrada de JSON lida aos poucos (corpo do /api/save, config.json).
+//
+// Tem read()/readBytes(), então o deserializeJson do ArduinoJson aceita
+// direto e para logo depois do valor que leu. Com JsonScan dá para pular até
+// a chave "meters" e desserializar um medidor por vez num JsonDocument
+// pequeno: a memória do parse não cresce com o número de medidores.
+class JsonInput {
+public:
+    virtual ~JsonInput() {}
+
+    virtual int read() = 0;  // -1 no fim
+    virtual int peek() = 0;
+    virtual size_t readBytes(char *buf, size_t len);
+
+    // Volta ao início (uma segunda passada no mesmo texto)
+    virtual bool rewind() = 0;
+};
+
+class BufferJsonInput : public JsonInput {
+public:
+    BufferJsonInput(const char *data, size_t len) : _data(data), _len(len) {}
+
+    int read() override { return _pos < _len ? (uint8_t)_data[_pos++] : -1; }
+    int peek() override { return _pos < _len ? (uint8_t)_data[_pos] : -1; }
+    size_t readBytes(char *buf, size_t len) override;
+    bool rewind() override { _pos = 0; return true; }
+
+private:
+    const char *_data;
+    size_t _len;
+    size_t _pos = 0;
+};
+
+class FileJsonInput : public JsonInput {
+public:
+    explicit FileJsonInput(File &file) : _file(file) {}
+
+    int read() override { return _file.read(); }
+    int peek() override { return _file.peek(); }
+    size_t readBytes(char *buf, size_t len) override { return _file.read((uint8_t *)buf, len); }
+    bool rewind() override { return _file.seek(0); }
+
+private:
+    File &_file;
+};
+
+// Navegação mínima sobre um JsonInput (sem montar documento)
+class JsonScan {
+public:
+    // Avança até a chave `key` do objeto de fora e para logo depois do ':'.
+    // Ignora chaves iguais em objetos internos e dentro de strings.
+    static bool seekKey(JsonInput &in, const char *key);
+
+    // Consome o '[' de um array. 1 = vem um elemento, 0 = vazio, -1 = não é array.
+    // Com 1, a entrada fica no primeiro caractere do elemento.
+    static int enterArray(JsonInput &in);
+
+    // Depois de ler um elemento: consome ',' (1, parando no próximo) ou ']' (0); -1 = inválido
+    static int nextElement(JsonInput &in);
+
+    // Pula espaços e devolve o próximo caractere sem consumir
+    static int skipSpace(JsonInput &in);
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "AppConfig.h"
+
+// --- Descoberta de medidores no barramento (comissionamento) ---
+//
+// Em vez de digitar cada modbus_id no painel, a task do barramento varre os
+// endereços 1..247 (ModbusWorker::discover):
+//   1. Presença: FC 03 de 1 registrador com timeout curto, com as
+//      requisições em fila no mestre (o fio não fica parado entre elas).
+//      Qualquer resposta prova que há alguém no endereço, inclusive uma
+//      exceção (registrador que o modelo não tem); só o timeout conta como
+//      vazio. Erro de CRC/quadro é testado de novo uma vez no fim.
+//   2. Identificação: quem respondeu é lido com o plano de cada perfil, na
+//      ordem de DISCOVERY_ORDER; vale o primeiro com todas as leituras ok e
+//      valores plausíveis.
+// No modo automático a varredura se repete em cada linha de DISCOVERY_LINES
+// (quem já foi achado não é testado de novo).
+//
+// Custo a 9600 baud: ~9 ms de requisição + o timeout por endereço vazio,
+// ~13 s por linha com o timeout padrão.
+
+const uint8_t DISCOVERY_FIRST_ID = 1;
+const uint8_t DISCOVERY_LAST_ID = 247;
+const uint16_t DISCOVERY_ADDRESSES = DISCOVERY_LAST_ID - DISCOVERY_FIRST_ID + 1;
+const uint32_t DISCOVERY_TIMEOUT_US = 40000;          // Presença: até o primeiro byte da resposta
+const uint32_t DISCOVERY_TIMEOUT_MIN_US = 10000;
+const uint32_t DISCOVERY_TIMEOUT_MAX_US = 500000;
+const uint32_t DISCOVERY_IDENTIFY_TIMEOUT_US = 300000; // Identificação: já se sabe que há alguém
+
+// Combinações mais comuns de fábrica, tentadas no modo automático depois da
+// linha configurada no barramento
+const SerialLine DISCOVERY_LINES[] = {
+    { 9600, PARITY_NONE },
+    { 9600, PARITY_EVEN },
+    { 2400, PARITY_NONE },
+    { 4800, PARITY_NONE },
+    { 19200, PARITY_NONE },
+    { 19200, PARITY_EVEN },
+};
+const uint8_t DISCOVERY_MAX_LINES = sizeof(DISCOVERY_LINES) / sizeof(DISCOVERY_LINES[0]) + 1;
+
+// Mapas mais específicos primeiro: o SDM120 recusa a faixa do SDM630 com
+// exceção, o contrário não; o DDS238 (inteiros) passa como plausível quase
+// sempre, por isso fica por último
+const MeterModel DISCOVERY_ORDER[METER_MODEL_COUNT] = { METER_DDSU666, METER_SDM630, METER_SDM120, METER_DDS238 };
+
+struct DiscoveredMeter {
+    uint8_t modbusId;
+    MeterModel model;   // METER_MODEL_COUNT = respondeu, mas nenhum perfil bateu
+    SerialLine line;
+};
+
+// O que a descoberta mudou na config (ver MeterDiscovery::merge)
+struct DiscoveryMerge {
+    uint8_t added = 0;        // Medidores novos
+    uint8_t updated = 0;      // Já configurados, com o modelo corrigido
+    uint8_t skipped = 0;      // Modelo desconhecido, outra linha ou sem ID livre
+    bool lineChanged = false; // Baud/paridade do barramento trocados (exige reinício)
+};
+
+class MeterDiscovery {
+public:
+    // Linhas a varrer: a do barramento e, com allLines, as de DISCOVERY_LINES
+    // (sem repetir). Retorna quantas foram escritas em out[DISCOVERY_MAX_LINES].
+    static size_t lines(const SerialLine &bus, bool allLines, SerialLine *out);
+
+    // Leitura que um medidor de energia ligado daria (descarta perfis errados)
+    static bool plausible(const float values[Q_COUNT]);
+
+    // Junta o que foi achado no barramento `bus` em config.meters. A linha
+    // com mais medidores identificados vira a do barramento (empate: fica a
+    // atual) e só os medidores dela entram. Endereço já configurado mantém
+    // canal, nome e período, e só tem o modelo corrigido.
+    static DiscoveryMerge merge(SystemConfig &config, uint8_t bus, const std::vector<DiscoveredMeter> &found);
+};
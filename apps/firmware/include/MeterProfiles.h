@@ -0,0 +1,176 @@
+#pragma once
+#include <Arduino.h>
+#include <string.h>
+
+// --- Perfis de registradores por modelo de medidor ---
+//
+// Cada modelo descreve ONDE estão as grandezas (função Modbus, endereço),
+// COMO decodificá-las (tipo, ordem das words) e a escala para a unidade final
+// (V, A, W, kWh). O planejador junta os registradores de um perfil no menor
+// número de leituras contíguas, então um DDS238 sai com 1 transação por
+// ciclo em vez de 2.
+//
+// Para adicionar um modelo: acrescente em MeterModel e em METER_PROFILES
+// (mesma ordem) e use o nome dele no campo "model" do medidor no config.json.
+
+enum MeterModel : uint8_t {
+    METER_DDS238 = 0,   // Monofásico, inteiros (padrão para configs antigas)
+    METER_SDM120,       // Eastron monofásico, float32
+    METER_SDM630,       // Eastron trifásico, float32 (V/I da fase L1, P total)
+    METER_DDSU666,      // CHINT monofásico, float32 em holding registers
+    METER_MODEL_COUNT
+};
+
+// Grandezas lidas de todo medidor (índice em MeterProfile::fields)
+enum MeterQuantity : uint8_t {
+    Q_VOLTAGE = 0,
+    Q_CURRENT,
+    Q_POWER,
+    Q_ENERGY,
+    Q_COUNT
+};
+
+// Código de função Modbus usado para ler o registrador
+enum RegFunction : uint8_t {
+    FC_HOLDING = 0x03,
+    FC_INPUT = 0x04
+};
+
+enum RegType : uint8_t {
+    REG_U16,
+    REG_S16,
+    REG_U32,
+    REG_S32,
+    REG_F32   // IEEE-754
+};
+
+// Ordem das words nos tipos de 32 bits (os bytes de cada word são sempre big-endian)
+enum WordOrder : uint8_t {
+    WORDS_ABCD,  // word alta primeiro (padrão Modbus)
+    WORDS_CDAB   // word baixa primeiro ("word swap")
+};
+
+struct RegisterField {
+    RegFunction function;
+    uint16_t address;
+    RegType type;
+    WordOrder order;
+    float scale;   // Multiplicador aplicado ao valor bruto
+};
+
+struct MeterProfile {
+    const char *name;               // Nome usado no config.json
+    RegisterField fields[Q_COUNT];  // Indexado por MeterQuantity
+};
+
+// Tabela de perfis (mesma ordem de MeterModel)
+constexpr MeterProfile METER_PROFILES[METER_MODEL_COUNT] = {
+    { "dds238", {
+        { FC_HOLDING, 0x000C, REG_U16, WORDS_ABCD, 0.1f },    // 2205 -> 220.5 V
+        { FC_HOLDING, 0x000D, REG_U16, WORDS_ABCD, 0.01f },   // 523 -> 5.23 A
+        { FC_HOLDING, 0x000F, REG_U16, WORDS_ABCD, 1.0f },    // W
+        { FC_HOLDING, 0x0000, REG_U32, WORDS_ABCD, 0.01f },   // 123456 -> 1234.56 kWh
+    } },
+    { "sdm120", {
+        { FC_INPUT, 0x0000, REG_F32, WORDS_ABCD, 1.0f },
+        { FC_INPUT, 0x0006, REG_F32, WORDS_ABCD, 1.0f },
+        { FC_INPUT, 0x000C, REG_F32, WORDS_ABCD, 1.0f },
+        { FC_INPUT, 0x0156, REG_F32, WORDS_ABCD, 1.0f },
+    } },
+    { "sdm630", {
+        { FC_INPUT, 0x0000, REG_F32, WORDS_ABCD, 1.0f },
+        { FC_INPUT, 0x0006, REG_F32, WORDS_ABCD, 1.0f },
+        { FC_INPUT, 0x0034, REG_F32, WORDS_ABCD, 1.0f },
+        { FC_INPUT, 0x0156, REG_F32, WORDS_ABCD, 1.0f },
+    } },
+    { "ddsu666", {
+        { FC_HOLDING, 0x2000, REG_F32, WORDS_ABCD, 1.0f },
+        { FC_HOLDING, 0x2002, REG_F32, WORDS_ABCD, 1.0f },
+        { FC_HOLDING, 0x2004, REG_F32, WORDS_ABCD, 1000.0f }, // kW -> W
+        { FC_HOLDING, 0x4000, REG_F32, WORDS_ABCD, 1.0f },
+    } },
+};
+
+// Limite de registradores por requisição (FC 03/04). O mestre RTU guarda a
+// resposta inteira, então os planos usam o máximo do protocolo.
+const uint8_t MODBUS_MAX_READ_REGS = 125;
+const uint8_t PLAN_MAX_READ_REGS = MODBUS_MAX_READ_REGS;
+
+// Uma leitura contígua: função + faixa de registradores
+struct ReadBlock {
+    RegFunction function;
+    uint16_t start;
+    uint8_t count;
+};
+
+// Plano de leitura de um perfil: os blocos e em qual bloco está cada grandeza
+struct ReadPlan {
+    uint8_t blockCount;
+    ReadBlock blocks[Q_COUNT];
+    uint8_t fieldBlock[Q_COUNT];
+};
+
+// --- Decodificadores (especializados por tipo e ordem das words) ---
+
+template <RegType T, WordOrder O>
+struct RegDecoder;
+
+template <WordOrder O>
+struct RegDecoder<REG_U16, O> {
+    static float decode(const uint16_t *r) { return (float)r[0]; }
+};
+
+template <WordOrder O>
+struct RegDecoder<REG_S16, O> {
+    static float decode(const uint16_t *r) { return (float)(int16_t)r[0]; }
+};
+
+template <WordOrder O>
+struct RegWords {
+    static uint32_t join(const uint16_t *r) { return ((uint32_t)r[0] << 16) | r[1]; }
+};
+
+template <>
+struct RegWords<WORDS_CDAB> {
+    static uint32_t join(const uint16_t *r) { return ((uint32_t)r[1] << 16) | r[0]; }
+};
+
+template <WordOrder O>
+struct RegDecoder<REG_U32, O> {
+    static float decode(const uint16_t *r) { return (float)RegWords<O>::join(r); }
+};
+
+template <WordOrder O>
+struct RegDecoder<REG_S32, O> {
+    static float decode(const uint16_t *r) { return (float)(int32_t)RegWords<O>::join(r); }
+};
+
+template <WordOrder O>
+struct RegDecoder<REG_F32, O> {
+    static float decode(const uint16_t *r) {
+        uint32_t bits = RegWords<O>::join(r);
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+};
+
+class MeterProfiles {
+public:
+    // Nome -> modelo (desconhecido ou vazio cai no DDS238, o padrão histórico)
+    static MeterModel fromName(const char *name);
+    static const char *name(MeterModel model);
+
+    // Plano de leitura do modelo (tabela com PLAN_MAX_READ_REGS, montada antes
+    // do setup(); só leitura, pode ser chamado de qualquer task)
+    static const ReadPlan &plan(MeterModel model);
+
+    // Junta os registradores no menor número de blocos contíguos de até maxRegs
+    static ReadPlan buildPlan(const MeterProfile &profile, uint8_t maxRegs = MODBUS_MAX_READ_REGS);
+
+    // Quantos registradores o tipo ocupa
+    static uint8_t width(RegType type) { return (type == REG_U16 || type == REG_S16) ? 1 : 2; }
+
+    // Decodifica o campo a partir dos registradores (já aplicando a escala)
+    static float decode(const RegisterField &field, const uint16_t *regs);
+};
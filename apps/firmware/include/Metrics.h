@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+
+// --- Métricas de runtime (exportadas em /api/metrics e no MQTT) ---
+//
+// Sem lock: cada contador/histograma tem UM escritor (a task dona do
+// recurso: a task do barramento para os escravos, a PubTask para os
+// publishes, a NetTask para a conexão) e é só lido pelas outras. Palavras
+// de 32 bits alinhadas são lidas/gravadas de uma vez no ESP32; no pior caso
+// quem lê vê um histograma com uma amostra a mais nos buckets do que no _count.
+// Gravar custa alguns ciclos, então fica ligado em produção.
+
+const uint8_t HIST_BUCKETS = 9; // 8 limites + "+Inf"
+const uint16_t HIST_BOUNDS_MS[HIST_BUCKETS - 1] = {10, 25, 50, 100, 250, 500, 1000, 2500};
+
+// Histograma de latência com faixas fixas (mesmas para Modbus, MQTT e TLS)
+struct LatencyHistogram {
+    uint32_t buckets[HIST_BUCKETS] = {}; // Não cumulativos (a exportação acumula)
+    uint32_t count = 0;
+    uint32_t sumMs = 0;                  // Arredondado por amostra: não estoura em anos de uptime
+
+    void record(uint32_t us);
+};
+
+// Print sobre um buffer fixo (renderizar sem heap). Trunca se não couber.
+class BufferPrint : public Print {
+public:
+    BufferPrint(char *buf, size_t capacity) : _buf(buf), _capacity(capacity) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t size) override;
+
+    size_t length() const { return _len; }
+    bool overflow() const { return _overflow; }
+
+private:
+    char *_buf;
+    size_t _capacity;
+    size_t _len = 0;
+    bool _overflow = false;
+};
+
+// Escreve no formato texto do Prometheus (0.0.4).
+// `labels` sem chaves, ex.: "bus=\"0\",modbus_id=\"12\"" (ou NULL)
+class PromWriter {
+public:
+    explicit PromWriter(Print &out) : _out(out) {}
+
+    // # HELP / # TYPE (uma vez por família, antes das amostras)
+    void family(const char *name, const char *type, const char *help);
+    void sample(const char *name, const char *labels, uint32_t value);
+    // _bucket{le=...} cumulativos em segundos, _sum e _count
+    void histogram(const char *name, const char *labels, const LatencyHistogram &h);
+
+private:
+    Print &_out;
+    void line(const char *fmt, ...);
+};
@@ -0,0 +1,171 @@
+#pragma once
+#include <Arduino.h>
+#include "Checksum.h"
+#include "MeterProfiles.h"
+
+// --- Mestre Modbus RTU assíncrono ---
+//
+// Máquina de estados que nunca bloqueia: a task envia requisições com
+// submit(), chama poll() quando a UART avisa que chegou dado (ou quando o
+// próximo prazo vence, ver nextEventUs()) e retira as respostas prontas com
+// nextResult(). Enquanto um quadro está no barramento, a task decodifica a
+// resposta anterior.
+//
+// Temporização (Modbus over Serial Line, 2.5.1.1):
+//   - t1.5: silêncio máximo entre bytes do mesmo quadro
+//   - t3.5: silêncio que delimita quadros (fim da resposta e antes de transmitir)
+//   - acima de 19200 baud os valores são fixos em 750 us / 1750 us
+//
+// O t1.5 só é cobrado quando o RtuPort sabe quando cada byte chegou
+// (exactByteTimes: o simulador e os roteiros dos testes). Na UART do ESP32
+// o poll() roda quando a task acorda (tick, outra task de barramento no
+// mesmo core), e o atraso do despertar viraria um "silêncio" falso: um
+// intervalo legal de ~1.2 caractere mais 1 ms de jitter a 9600 baud
+// descartaria a resposta. Lá o quadro termina pelo tamanho esperado ou pelo
+// t3.5, e o CRC pega o que vier corrompido.
+//
+// Todo o enquadramento, CRC e tempo ficam aqui, sem acesso a hardware:
+// o tempo entra como parâmetro (us) e os bytes via RtuPort, o que permite
+// testar no ambiente nativo com um fluxo de bytes roteirizado.
+
+// Formato do caractere no fio (sempre 8 bits de dados; sem paridade = 1 stop)
+enum SerialParity : uint8_t {
+    PARITY_NONE = 0,
+    PARITY_EVEN,
+    PARITY_ODD
+};
+
+// Baud + paridade de um barramento
+struct SerialLine {
+    uint32_t baud;
+    SerialParity parity;
+};
+
+// Transporte físico do barramento (UART no ESP32, roteiro nos testes)
+class RtuPort {
+public:
+    virtual ~RtuPort() {}
+
+    // Coloca o quadro na FIFO de transmissão e retorna (o DE é controlado pelo transporte)
+    virtual void send(const uint8_t *frame, size_t len) = 0;
+
+    // Copia os bytes já recebidos, sem esperar. Retorna quantos foram lidos.
+    virtual size_t receive(uint8_t *buf, size_t max) = 0;
+
+    // Relógio em microssegundos
+    virtual uint32_t nowUs() = 0;
+
+    // Bloqueia até chegar dado na porta ou passar timeoutUs
+    virtual void waitEvent(uint32_t timeoutUs) = 0;
+
+    // Troca baud/paridade com o barramento parado (descoberta). false = fixo
+    virtual bool setLine(const SerialLine &) { return false; }
+
+    // true se receive() entrega cada byte logo que ele chega, com nowUs()
+    // exato: só assim o silêncio entre bytes medido no poll() é real (t1.5)
+    virtual bool exactByteTimes() const { return false; }
+};
+
+// Silêncios do protocolo para um baud rate (11 bits por caractere: start + 8 + paridade/stop + stop)
+struct RtuTiming {
+    uint32_t charUs;   // Tempo de um caractere no fio
+    uint32_t t15Us;
+    uint32_t t35Us;
+
+    static RtuTiming forBaud(uint32_t baud);
+};
+
+enum RtuStatus : uint8_t {
+    RTU_OK = 0,
+    RTU_TIMEOUT,       // Escravo não respondeu
+    RTU_CRC_ERROR,
+    RTU_FRAME_ERROR,   // Quadro truncado, endereço/função trocados ou intervalo > t1.5 (exactByteTimes)
+    RTU_EXCEPTION      // Escravo respondeu com exceção (ver exceptionCode)
+};
+
+const uint8_t RTU_MAX_QUEUE = 4;                 // Requisições aguardando a vez
+const uint8_t RTU_MAX_RESULTS = 2;               // Respostas prontas não retiradas
+const uint32_t RTU_DEFAULT_TIMEOUT_US = 2000000; // Mesmo padrão do ModbusMaster (2 s)
+const uint16_t RTU_MAX_FRAME = 5 + 2 * MODBUS_MAX_READ_REGS; // addr + fc + n + dados + crc
+
+struct RtuRequest {
+    uint8_t slave;
+    RegFunction function;
+    uint16_t start;
+    uint16_t count;
+    uint32_t timeoutUs;  // 0 = RTU_DEFAULT_TIMEOUT_US
+    uint32_t tag;        // Livre para o chamador identificar a resposta
+};
+
+struct RtuResult {
+    RtuRequest request;
+    RtuStatus status;
+    uint8_t exceptionCode;
+    uint32_t latencyUs;  // Do fim da transmissão até o fim da resposta
+    uint32_t responseUs; // Do fim da transmissão até o primeiro byte (tempo de reação do escravo)
+    uint16_t regs[MODBUS_MAX_READ_REGS];
+};
+
+class ModbusRtuMaster {
+public:
+    void begin(RtuPort *port, uint32_t baud);
+
+    // Enfileira uma leitura (FC 03/04). false se a fila estiver cheia ou a requisição for inválida.
+    bool submit(const RtuRequest &request);
+
+    // Remove da fila as requisições ainda não transmitidas com este tag. Retorna quantas.
+    size_t cancel(uint32_t tag, uint32_t mask = 0xFFFFFFFF);
+
+    // Lê o que chegou na porta e avança a máquina de estados
+    void poll(uint32_t nowUs);
+
+    // Retira a resposta mais antiga. false se não houver.
+    bool nextResult(RtuResult &out);
+
+    // Nada na fila, nada no barramento e nenhuma resposta pendente
+    bool idle() const { return _state == IDLE && _queued == 0 && _results == 0; }
+
+    // Quanto esperar até o próximo prazo (t3.5, timeout), para dormir na porta
+    uint32_t nextEventUs(uint32_t nowUs) const;
+
+    const RtuTiming &timing() const { return _timing; }
+
+    // Monta o quadro de leitura; retorna o tamanho (8)
+    static size_t buildRequest(const RtuRequest &request, uint8_t *frame);
+
+private:
+    enum State : uint8_t {
+        IDLE,          // Barramento livre (respeitando t3.5 desde a última atividade)
+        WAIT_REPLY,    // Quadro enviado, esperando o primeiro byte
+        RECEIVING      // Recebendo, fim por tamanho esperado ou silêncio de t3.5
+    };
+
+    RtuPort *_port = NULL;
+    RtuTiming _timing;
+    State _state = IDLE;
+
+    RtuRequest _queue[RTU_MAX_QUEUE];
+    uint8_t _queued = 0;
+
+    RtuResult _resultRing[RTU_MAX_RESULTS];
+    uint8_t _resultHead = 0;
+    uint8_t _results = 0;
+
+    RtuRequest _current;
+    uint32_t _txEndUs = 0;       // Instante em que o último bit da requisição sai
+    uint32_t _deadlineUs = 0;    // Timeout de resposta
+    uint32_t _lastActivityUs = 0;
+    uint32_t _firstByteUs = 0;   // Início estimado do primeiro byte da resposta
+    bool _brokenFrame = false;   // Intervalo entre bytes > t1.5
+    bool _checkT15 = false;      // Porta com exactByteTimes()
+
+    uint8_t _rx[RTU_MAX_FRAME];
+    uint16_t _rxLen = 0;
+
+    void transmit(uint32_t nowUs);
+    void finish(uint32_t nowUs);
+    void complete(RtuStatus status, uint8_t exceptionCode, uint32_t nowUs);
+    uint16_t expectedLength() const;
+
+    static bool reached(uint32_t deadline, uint32_t now) { return (int32_t)(now - deadline) >= 0; }
+};
@@ -1,23 +1,73 @@
 #pragma once
 #include <Arduino.h>
-#include <ModbusMaster.h>
+#include <atomic>
+#include <vector>
 #include "AppConfig.h"
+#include "MeterDiscovery.h"
+#include "ModbusRtuMaster.h"
+#include "SlaveHealth.h"
+
+// Chamado uma vez por medidor, quando todas as transações dele terminam
+// (ok = false se algum bloco falhou)
+typedef void (*MeterReadCallback)(const MeterConfig &meter, bool ok, const MeterReading &reading, void *ctx);
+
+// Medidores em andamento ao mesmo tempo: os blocos do próximo já estão na
+// fila do mestre enquanto a resposta do atual é decodificada
+const uint8_t MODBUS_PIPELINE_DEPTH = 2;
 
 class ModbusWorker {
 public:
-    void begin();
-    
-    // Retorna true se a leitura foi bem sucedida
-    bool readMeter(uint8_t modbusId, MeterReading &outReading);
+    // O transporte (UART, simulador) vem de fora; o worker só fala Modbus.
+    // meterCount = tamanho da lista de medidores passada a readMeters.
+    void begin(RtuPort *port, uint32_t baud, size_t meterCount);
+
+    // Lista de medidores trocada (config aplicada sem reboot): o i-ésimo fica
+    // com a saúde do antigo from[i], -1 recomeça. Só entre dois readMeters.
+    void remap(const std::vector<int> &from) { _health.remap(from); }
+
+    // Lê os medidores meters[indices[i]] conforme o perfil de cada modelo,
+    // com as transações em pipeline no mestre assíncrono. Retorna quando
+    // todos terminaram (ok ou falha); `onRead` recebe cada um na ordem.
+    // Medidores offline só entram quando vence a sonda (ver SlaveHealth).
+    void readMeters(const MeterConfig *meters, const uint8_t *indices, size_t count, MeterReadCallback onRead, void *ctx);
+
+    const SlaveHealthTracker &health() const { return _health; }
+
+    // Troca baud/paridade da porta e refaz os tempos do mestre. Só entre dois readMeters.
+    bool setLine(const SerialLine &line);
+
+    // Descoberta (ver MeterDiscovery.h): varre os endereços em cada linha de
+    // `lines` e acrescenta em `found` quem respondeu, na ordem dos endereços.
+    // `probed` conta os endereços já testados (andamento). A porta fica na
+    // última linha: quem chama volta para a do barramento com setLine().
+    void discover(const SerialLine *lines, size_t lineCount, uint32_t timeoutUs,
+                  std::vector<DiscoveredMeter> &found, std::atomic<uint16_t> *probed = NULL);
 
 private:
-    ModbusMaster node;
-    
-    // Pinos do RS485 (ESP32)
-    const int MAX485_DE = 4;  // Connect to RE & DE
-    const int RX_PIN = 16;    // Serial2 RX
-    const int TX_PIN = 17;    // Serial2 TX
-
-    static void preTransmission();
-    static void postTransmission();
-};
\ No newline at end of file
+    struct MeterSlot {
+        const MeterConfig *meter;
+        uint8_t index;        // Posição na lista de medidores (índice da saúde)
+        uint8_t submitted;    // Blocos já enfileirados no mestre
+        uint8_t completed;    // Respostas recebidas (ok ou erro)
+        bool active;
+        bool failed;
+        float values[Q_COUNT];
+        int64_t sampledMs;    // Chegada da primeira resposta boa (WallClock::monoMs)
+    };
+
+    RtuPort *_port = NULL;
+    ModbusRtuMaster _master;
+    RtuResult _result;   // Fora da pilha da task (~270 bytes)
+    MeterSlot _slots[MODBUS_PIPELINE_DEPTH];
+    SlaveHealthTracker _health;
+
+    void submitPending();
+    void handleResult();
+
+    // Bitmap de endereços 0..255
+    typedef uint8_t AddressSet[32];
+    void probe(const AddressSet todo, uint32_t timeoutUs, AddressSet present, AddressSet noisy, std::atomic<uint16_t> *probed);
+    MeterModel identify(uint8_t slave);
+    bool transact(const RtuRequest &request); // Uma requisição, esperando a resposta em _result
+    static const char *statusName(RtuStatus status);
+};
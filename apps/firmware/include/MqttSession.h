@@ -0,0 +1,151 @@
+#pragma once
+#include <Arduino.h>
+#include "Metrics.h"
+
+// --- Sessão MQTT 3.1.1 (codec + janela de QoS 1), sem socket ---
+//
+// O MqttWorker faz o I/O na NetTask; esta classe só monta e interpreta
+// pacotes, então dá para testar contra um broker falso (test_mqtt).
+//
+// - publish() copia o pacote inteiro para um slot e volta na hora: quem
+//   publica (PubTask) nunca espera o socket.
+// - QoS 1 em pipeline: até MQTT_INFLIGHT_WINDOW PUBLISH sem PUBACK no ar ao
+//   mesmo tempo, casados pelo packet id (um round trip por janela, não por
+//   mensagem). Janela cheia = publish() recusa e a leitura vai para o outbox.
+// - Queda: os QoS 1 sem PUBACK ficam nos slots e são reenviados (DUP, na
+//   ordem original) depois do próximo CONNACK. Por isso o CONNECT vai com
+//   clean session = 0: o broker mantém a sessão e aceita o reenvio.
+// - Leituras reenviadas do outbox levam a faixa de sequências delas no
+//   slot; o PUBACK avança outboxAcked() em ordem (nunca passa de um PUBLISH
+//   mais antigo ainda sem PUBACK) e só então a PubTask apaga do flash.
+// - Não assina tópicos: PUBLISH vindo do broker é descartado.
+//
+// Não é thread-safe: o MqttWorker serializa as chamadas com um mutex.
+
+#ifndef MQTT_INFLIGHT_WINDOW
+#define MQTT_INFLIGHT_WINDOW 4       // PUBLISH QoS 1 sem PUBACK ao mesmo tempo
+#endif
+const uint8_t MQTT_QOS0_SLOTS = 2;  // Status retido etc. (não ocupam a janela)
+const uint8_t MQTT_SLOTS = MQTT_INFLIGHT_WINDOW + MQTT_QOS0_SLOTS;
+const size_t MQTT_PACKET_MAX = 1024; // Pacote inteiro: header fixo + tópico + id + payload
+const uint16_t MQTT_KEEPALIVE_S = 15;
+
+// Header fixo (até 5) + tamanho do tópico (2) + packet id (2)
+inline size_t mqttPayloadMax(size_t topicLen) { return MQTT_PACKET_MAX - 9 - topicLen; }
+
+enum MqttPacketType : uint8_t {
+    MQTT_CONNECT = 1,
+    MQTT_CONNACK = 2,
+    MQTT_PUBLISH = 3,
+    MQTT_PUBACK = 4,
+    MQTT_PINGREQ = 12,
+    MQTT_PINGRESP = 13,
+    MQTT_DISCONNECT = 14
+};
+
+const uint32_t MQTT_PING_TIMEOUT_MS = 7500; // PINGREQ sem resposta: conexão morta
+
+enum MqttKeepAlive : uint8_t {
+    MQTT_IDLE = 0,
+    MQTT_SEND_PING,   // Nada escrito ou lido há MQTT_KEEPALIVE_S: mandar PINGREQ
+    MQTT_TIMED_OUT    // PINGREQ sem resposta em MQTT_PING_TIMEOUT_MS: derrubar a conexão
+};
+
+// Escritas só pela NetTask (ver Metrics.h)
+struct MqttSessionStats {
+    uint32_t acked = 0;        // PUBACK recebidos
+    uint32_t retransmits = 0;  // PUBLISH reenviados com DUP depois de uma queda
+    LatencyHistogram ack;      // Escrita do PUBLISH -> PUBACK
+};
+
+// Sequências do ReadingOutbox [first, end) carregadas por um PUBLISH
+struct OutboxRange {
+    uint32_t first;
+    uint32_t end;
+};
+
+class MqttSession {
+public:
+    // CONNECT (clean session = 0, Last Will QoS 1). Retorna o tamanho ou 0 se não couber
+    static size_t encodeConnect(uint8_t *out, size_t cap, const char *clientId,
+                                const char *willTopic, const char *willMessage, bool willRetain);
+    // Header fixo + tópico de um PUBLISH QoS 0; o payload vai logo depois, à parte
+    static size_t encodePublishHeader(uint8_t *out, size_t cap, const char *topic, size_t payloadLen, bool retain);
+    static size_t encodePingReq(uint8_t *out) { out[0] = MQTT_PINGREQ << 4; out[1] = 0; return 2; }
+    static size_t encodeDisconnect(uint8_t *out) { out[0] = MQTT_DISCONNECT << 4; out[1] = 0; return 2; }
+
+    // Conexão nova (CONNECT já escrito): espera o CONNACK e prepara o reenvio
+    void begin(uint32_t nowMs);
+    // Conexão caiu: QoS 1 sem PUBACK ficam para o reenvio
+    void end();
+
+    // Copia o PUBLISH para um slot livre. false = janela/slots cheios ou grande demais.
+    // outbox: registros do outbox que este PUBLISH leva (só QoS 1)
+    bool publish(const char *topic, const uint8_t *payload, size_t len, uint8_t qos, bool retain,
+                 const OutboxRange *outbox = NULL);
+
+    // Próximo pacote a escrever (ordem de publish), ou NULL. O slot fica
+    // reservado até written(); pode ser escrito fora do lock
+    const uint8_t *nextOutput(size_t &len);
+    void written(uint32_t nowMs);
+    void pingSent(uint32_t nowMs);
+
+    // Bytes do broker, em qualquer fragmentação. false = CONNACK recusado ou protocolo quebrado
+    bool receive(const uint8_t *data, size_t len, uint32_t nowMs);
+
+    MqttKeepAlive keepAlive(uint32_t nowMs) const;
+
+    bool connected() const { return _connected; }
+    uint8_t connackCode() const { return _connackCode; }
+    size_t inflight() const;   // QoS 1 sem PUBACK (na fila, no ar ou esperando reenvio)
+    size_t queued() const;     // Slots ocupados (QoS 0 + QoS 1)
+    const MqttSessionStats &stats() const { return _stats; }
+
+    // Sequência do outbox até a qual (exclusive) tudo que foi entregue à
+    // sessão já teve PUBACK. false = nenhum PUBACK de outbox ainda
+    bool outboxAcked(uint32_t &through) const;
+
+private:
+    enum SlotState : uint8_t { SLOT_FREE = 0, SLOT_QUEUED, SLOT_SENDING, SLOT_AWAIT_ACK };
+
+    struct Slot {
+        SlotState state = SLOT_FREE;
+        uint8_t qos = 0;
+        uint16_t packetId = 0;
+        uint16_t len = 0;
+        uint32_t seq = 0;        // Ordem de publish (reenvio na ordem original)
+        bool fromOutbox = false;
+        OutboxRange outbox = { 0, 0 };
+        uint32_t sentMs = 0;
+        uint8_t packet[MQTT_PACKET_MAX];
+    };
+
+    Slot _slots[MQTT_SLOTS];
+    int8_t _sending = -1;
+    uint32_t _seq = 0;
+    uint16_t _nextId = 1;
+    bool _connected = false;
+    uint8_t _connackCode = 0;
+    uint32_t _lastWriteMs = 0;
+    uint32_t _lastReadMs = 0;
+    bool _pingOutstanding = false;
+    uint32_t _pingSentMs = 0;
+    MqttSessionStats _stats;
+    bool _outboxAny = false;
+    uint32_t _outboxDone = 0;   // Fim da faixa mais nova com PUBACK
+    uint32_t _outboxAcked = 0;  // Confirmado em ordem (ver outboxAcked())
+
+    // Parser incremental do que chega
+    enum RxStage : uint8_t { RX_HEADER = 0, RX_LENGTH, RX_BODY };
+    RxStage _rxStage = RX_HEADER;
+    uint8_t _rxHeader = 0;
+    uint8_t _rxLenBytes = 0;
+    uint32_t _rxLength = 0;    // "Remaining length" do pacote
+    uint32_t _rxRemaining = 0;
+    uint8_t _rxBody[4];        // CONNACK e PUBACK têm 2 bytes; o resto é pulado
+    uint8_t _rxBodyLen = 0;
+
+    uint16_t allocateId();
+    bool handlePacket(uint32_t nowMs);
+    void outboxDelivered(const OutboxRange &range);
+};
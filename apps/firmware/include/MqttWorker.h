@@ -1,25 +1,125 @@
 #pragma once
 #include <Arduino.h>
 #include <WiFiClientSecure.h>
-#include <PubSubClient.h>
 #include <ArduinoJson.h>
+#include <atomic>
 #include "AppConfig.h"
+#include "ConfigStore.h"
+#include "TelemetryEncoder.h"
+#include "Metrics.h"
+#include "Backoff.h"
+#include "TlsCredentials.h"
+#include "MqttSession.h"
 
+// Payload de um PUBLISH (o pacote inteiro vai para um slot da MqttSession)
+const uint16_t MQTT_BUFFER_SIZE = MQTT_PACKET_MAX;
+const uint8_t MQTT_TOPIC_SIZE = 64;
+const uint32_t MQTT_CONNACK_TIMEOUT_MS = 5000;
+const uint32_t MQTT_QOS0_WAIT_MS = 500; // Status esperando slot livre antes de desistir
+
+// Religamento: primeira tentativa logo depois da queda, depois dobrando até o
+// teto, com jitter (gateways que perderam o mesmo broker não voltam juntos)
+const uint32_t MQTT_RETRY_BASE_MS = 500;
+const uint32_t MQTT_RETRY_MAX_MS = 60000;
+const uint8_t MQTT_RETRY_JITTER_PCT = 25;
+const uint32_t MQTT_HANDSHAKE_TIMEOUT_S = 10; // Padrão do WiFiClientSecure é 120 s (trava a NetTask)
+
+// Contadores da conexão (ver Metrics.h: publishFailures escrito pela PubTask,
+// o resto pela NetTask, que é quem mexe no socket)
+struct MqttMetrics {
+    LatencyHistogram publish;      // Escrita de cada PUBLISH no socket
+    uint32_t publishFailures = 0;  // Recusados na fila (janela QoS 1 ou slots QoS 0 cheios)
+    uint32_t connects = 0;         // Conexões MQTT bem-sucedidas
+    uint32_t connectFailures = 0;  // TCP/TLS ou CONNECT recusado
+    uint32_t disconnects = 0;      // Quedas de uma conexão estabelecida
+    LatencyHistogram tlsHandshake; // TCP + handshake TLS (sem o CONNECT do MQTT)
+    uint32_t lastReconnectMs = 0;  // Queda -> conectado de novo, da última queda
+    LatencyHistogram reconnect;    // Queda -> conectado de novo
+};
+
+// --- Cliente MQTT 3.1.1 sobre o WiFiClientSecure ---
+//
+// Só a NetTask (loop()) mexe no socket: conecta, escreve a fila da
+// MqttSession e lê os PUBACK. Os publish*() da PubTask só copiam o pacote
+// para a sessão (sob _lock) e voltam; um write lento não trava mais a
+// publicação. Leituras vão em QoS 1 (confirmadas por PUBACK, reenviadas
+// depois de uma queda); status retido e métricas em QoS 0.
 class MqttWorker {
 public:
     MqttWorker();
     
     void loop();
     bool isConnected();
-    bool publishReading(String deviceId, const MeterReading &reading);
+    bool publishReading(const MeterReading &reading);
+    // Enfileira várias leituras agrupadas (várias por mensagem, dividindo só
+    // quando não cabem no pacote), em QoS 1. Retorna quantas entraram na
+    // janela; o resto fica com o chamador (outbox).
+    // outboxSeqs: sequência no outbox de cada leitura (replay); cada PUBLISH
+    // leva a faixa dele e o PUBACK aparece em outboxAcked().
+    // Não aloca heap: tópico e payload usam buffers fixos desta classe.
+    size_t publishBatch(const MeterReading *readings, size_t count, const uint32_t *outboxSeqs = NULL);
+
+    // Até onde o outbox pode ser apagado (PUBACK em ordem; ver MqttSession)
+    bool outboxAcked(uint32_t &through);
+
+    // Publica (retido) o status do gateway e de cada medidor em
+    // energymeter/{id}/status e energymeter/{id}/status/{canal}. O tópico
+    // status também é o Last Will ({"online":false}): o backend distingue
+    // gateway caído (LWT) de medidor caído (state = "offline").
+    bool publishMeterStatus(const MeterStatus &status);
+    bool publishGatewayStatus(size_t metersOnline, size_t metersOffline);
+
+    // Métricas do gateway (texto Prometheus) em energymeter/{id}/metrics.
+    // Passa do tamanho de um slot: a NetTask escreve direto do buffer do
+    // chamador, que não pode ser mexido enquanto metricsPending().
+    bool publishMetrics(const char *text, size_t len);
+    bool metricsPending() const { return _bulkPending.load(); }
+
+    const MqttMetrics &metrics() const { return _metrics; }
+    const MqttSessionStats &sessionStats() const { return _session.stats(); }
+    size_t inflight();
+    DeviceKeyType keyType() const { return _credentials.keyType(); }
     bool loadCredentials();
 private:
     WiFiClientSecure espClient;
-    PubSubClient client;
-    SystemConfig* _config = nullptr; 
-    bool _credentialsLoaded = false;
-    void reconnect();
+    MqttSession _session;
+    SemaphoreHandle_t _lock;        // Protege _session (PubTask enfileira, NetTask escreve)
+    ConfigRef _config;              // Versão aplicada pela NetTask (host/porta/device id)
+    uint32_t _configVersion = 0;
+    char _host[64] = "";
+    TlsCredentials _credentials;    // Vivas enquanto o espClient apontar para elas
+    Backoff _retry = Backoff(MQTT_RETRY_BASE_MS, MQTT_RETRY_MAX_MS, MQTT_RETRY_JITTER_PCT);
+    uint32_t _nextAttemptMs = 0;
+    uint32_t _lostMs = 0;
+    std::atomic<bool> _up{false};   // CONNACK aceito e socket de pé (lido pela PubTask)
+    bool _everConnected = false;
+    TelemetryEncoder _encoder;
+    char _payload[MQTT_BUFFER_SIZE];
+    uint16_t _port = 8883;
+    MqttMetrics _metrics;
+    bool reconnect();
+    bool handshake();
+    bool service();
+    void closeConnection();
+    void applyConfig();
+    bool writeAll(const uint8_t *data, size_t len);
+    bool writeBulk();
+    bool publish(const char *topic, const uint8_t *payload, size_t len, uint8_t qos, bool retained,
+                 const OutboxRange *outbox = NULL);
+
+    // Métricas em andamento (buffer do chamador)
+    char _bulkTopic[MQTT_TOPIC_SIZE + 8];
+    const char *_bulkText = NULL;
+    size_t _bulkLen = 0;
+    std::atomic<bool> _bulkPending{false};
     
-    // Tópico padrão: energymeter/{DEVICE_ID}/data
-    // String getTopic(String deviceId);
+    // Tópico de dados: energymeter/{DEVICE_ID}/data (ou data.v2)
+    // Montado na conexão, e de novo só se o formato mudar
+    char _topic[MQTT_TOPIC_SIZE];
+    size_t _topicLen = 0;
+    PayloadFormat _topicFormat = PAYLOAD_JSON;
+    void buildTopic(const SystemConfig &config, PayloadFormat format);
+
+    // energymeter/{DEVICE_ID}/status (Last Will + status retido)
+    char _statusTopic[MQTT_TOPIC_SIZE];
 };
\ No newline at end of file
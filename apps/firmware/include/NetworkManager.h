@@ -4,21 +4,60 @@
 #include <ESPAsyncWebServer.h>
 #include <AsyncTCP.h>
 #include "AppConfig.h"
+#include "BusPoller.h"
 #include "ConfigManager.h"
+#include "ConfigStore.h"
+#include "Metrics.h"
+#include "WifiScanCache.h"
+#include "WifiLink.h"
+#include <atomic>
+#include <functional>
+
+// Respostas grandes saem em chunks, uma parte por vez (ver sendParts).
+// Cada parte deve caber em RESPONSE_PART_SIZE.
+const size_t RESPONSE_PART_SIZE = 1536;
+typedef std::function<bool(size_t part, Print &out)> PartRenderer;
+
+// Escreve a parte `part` das métricas (0 = gateway, depois os medidores).
+// false quando não há mais partes.
+typedef bool (*MetricsRenderer)(size_t part, Print &out);
+
+// Maior corpo aceito no /api/save (juntado num buffer só, alocado pelo tamanho anunciado)
+const size_t SAVE_BODY_MAX = 48 * 1024;
+
+// Descoberta pedida no /api/discover, do lado do NetworkManager
+enum DiscoverPhase : uint8_t {
+    DISCOVER_IDLE = 0,
+    DISCOVER_SCANNING,   // Barramentos varrendo; a NetTask grava quando todos terminam
+    DISCOVER_APPLIED,    // Resultado gravado (_discoverResult vale)
+    DISCOVER_FAILED      // Varredura terminou, mas a config não foi gravada
+};
 
 class NetworkManager {
 public:
     NetworkManager();
     
-    // Inicia a conexão (tenta WiFi ou sobe AP)
-    void begin(SystemConfig &config);
+    // Inicia a conexão (dispara o WiFi ou sobe AP, sem esperar). Configs
+    // publicadas depois no store são aplicadas pelo loop() (WiFi só
+    // reconecta se as credenciais mudaram).
+    void begin(ConfigStore &store);
     
-    // Configura as rotas do servidor web
+    // Configura as rotas do servidor web (o ConfigManager também grava o
+    // resultado da descoberta, na NetTask)
     void setupWebServer(ConfigManager &configManager);
-    
 
-    // Chamado no loop principal (para reconexão se cair)
+    // Fonte do /api/metrics (quem conhece as tasks e os barramentos é o main)
+    void setMetricsRenderer(MetricsRenderer renderer) { _metricsRenderer = renderer; }
+
+    // Barramentos que o /api/discover varre (os BusPoller do main)
+    void setBuses(BusPoller *buses, uint8_t count) { _buses = buses; _busCount = count; }
+
+    // Chamado na NetTask a cada poucos ms: eventos do WiFi, religamento, AP de
+    // emergência e o fim de uma descoberta
     void loop();
+
+    // Tempo de religar, quedas etc. (/api/metrics)
+    const WifiMetrics &wifiMetrics() const { return _link.metrics(); }
     
     // Retorna true se estiver conectado à internet
     bool isWifiConnected();
@@ -28,11 +67,38 @@ public:
 
 private:
     AsyncWebServer server;
-    SystemConfig* _config; // Ponteiro para a config atual
-    unsigned long _lastWifiCheck = 0;
+    ConfigStore *_store = NULL;
+    ConfigRef _config;           // Versão aplicada ao WiFi (só a NetTask troca)
+    uint32_t _configVersion = 0;
+    WifiLink _link;               // Só a NetTask mexe
+    std::atomic<uint8_t> _wifiEvents{0}; // Eventos vindos da task de eventos do WiFi
+    std::atomic<uint8_t> _disconnectReason{0};
     bool _apMode = false;
     bool _shouldReboot = false;
+    ConfigManager *_configManager = NULL;
+    SemaphoreHandle_t _saveLock = NULL; // Gravar + publicar config (/api/save e descoberta na NetTask)
+    MetricsRenderer _metricsRenderer = NULL;
+    WifiScanCache _scan;          // Só a task do servidor web mexe
+    BusPoller *_buses = NULL;
+    uint8_t _busCount = 0;
+    // Descoberta de medidores. Com a fase em DISCOVER_SCANNING só a NetTask
+    // escreve (resultado); nas outras, só a task do servidor web (novo pedido)
+    std::atomic<uint8_t> _discoverPhase{DISCOVER_IDLE};
+    uint8_t _discoverMask = 0;    // Barramentos da última varredura pedida
+    bool _discoverRestart = false;
+    DiscoveryMerge _discoverResult;
     void startAP();
-    void connectWiFi();
+    void stopAP();
+    void startLink();
+    void onWifiEvent(WiFiEvent_t event, WiFiEventInfo_t info);
+    void handleWifiEvents();
+    void applyConfig();
+    void refreshScan();
+    void handleSave(AsyncWebServerRequest *request, ConfigManager &configManager);
+    void startDiscovery(AsyncWebServerRequest *request);
+    void reportDiscovery(AsyncWebServerRequest *request);
+    void collectDiscovery();
+    bool applyDiscovery();
+    static void sendParts(AsyncWebServerRequest *request, const char *contentType, PartRenderer render);
     String macToHex(); // Helper para gerar o ID
 };
\ No newline at end of file
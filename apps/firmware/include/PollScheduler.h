@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "AppConfig.h"
+
+// Estatísticas de temporização do polling (para diagnóstico/métricas)
+struct SchedulerStats {
+    uint32_t cycles = 0;        // Liberações executadas
+    uint32_t overruns = 0;      // Ciclos que terminaram depois da próxima liberação
+    uint32_t skipped = 0;       // Liberações puladas por atraso maior que um período
+    uint32_t lastJitterMs = 0;  // Atraso do início do ciclo em relação ao instante ideal
+    uint32_t maxJitterMs = 0;
+    uint32_t lastCycleMs = 0;   // Duração do último ciclo
+};
+
+// Escalonador periódico com deadline absoluto (estilo vTaskDelayUntil).
+//
+// Cada medidor tem um período (MeterConfig::periodSec ou o intervalo global).
+// A próxima liberação é sempre "liberação anterior + período", nunca
+// "agora + período": o tempo gasto lendo o barramento não acumula deriva.
+//
+// Medidores com o mesmo período são liberados juntos (um ciclo = uma
+// mensagem MQTT). Grupos de períodos diferentes são defasados igualmente
+// dentro do menor período, para que o lote de 60 s dos sub-medidores não
+// caia em cima da leitura de 5 s dos alimentadores.
+//
+// Todo tempo é em ms de millis(); comparações são seguras no wrap-around.
+class PollScheduler {
+public:
+    // Reconstrói os jobs a partir da lista de medidores
+    void configure(const std::vector<MeterConfig> &meters, uint32_t defaultPeriodMs, uint32_t now);
+
+    bool empty() const { return _jobs.empty(); }
+
+    // Instante absoluto da próxima liberação
+    uint32_t nextRelease() const;
+
+    // Coleta os medidores vencidos em `now` (índices em `meters`) e agenda a
+    // próxima liberação de cada um. Retorna quantos foram escritos em `out`.
+    size_t collectDue(uint32_t now, uint8_t *out, size_t max);
+
+    // Fecha o ciclo liberado em `release`, que começou em `startedAt` e acabou em `finishedAt`
+    void endCycle(uint32_t release, uint32_t startedAt, uint32_t finishedAt);
+
+    const SchedulerStats &stats() const { return _stats; }
+
+private:
+    struct PollJob {
+        uint8_t meterIndex;
+        uint32_t periodMs;
+        uint32_t next;
+    };
+
+    std::vector<PollJob> _jobs;
+    SchedulerStats _stats;
+
+    static bool reached(uint32_t deadline, uint32_t now) { return (int32_t)(now - deadline) >= 0; }
+};
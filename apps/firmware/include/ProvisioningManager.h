@@ -4,12 +4,12 @@
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include "AppConfig.h"
+#include "DeviceKey.h"
+#include "TlsCredentials.h"
 
-#include "mbedtls/pk.h"
-#include "mbedtls/x509_csr.h"
-#include "mbedtls/entropy.h"
-#include "mbedtls/ctr_drbg.h"
-#include "mbedtls/error.h"
+// A geração da chave roda numa task própria: a aritmética de bignum do
+// mbedTLS não cabe nos 4 KB da NetTask (RSA principalmente)
+const uint32_t KEYGEN_STACK_SIZE = 8192;
 
 class ProvisioningManager {
 public:
@@ -20,13 +20,13 @@ public:
 
 private:
    
-    const char* PATH_CA   = "/ca.crt";
-    const char* PATH_CERT = "/device.crt";
-    const char* PATH_KEY  = "/device.key";
+    const char* PATH_CA   = TLS_CA_PATH;
+    const char* PATH_CERT = TLS_CERT_PATH;
+    const char* PATH_KEY  = TLS_KEY_PATH;
 
-    bool generateCsr(String deviceId, String &outCsr, String &outPrivateKey);
+    bool generateCsr(const String &deviceId, String &outCsr, String &outPrivateKey);
     
     bool requestSigning(const String &apiUrl, const String &deviceId, const String &csr, String &outCert, String &outCa);
     
     bool saveFile(const char* path, const String &content);
-};
\ No newline at end of file
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "AppConfig.h"
+
+// Capacidade padrão (~2048 leituras ≈ 34 min de 64 medidores a cada 60s)
+const uint16_t OUTBOX_DEFAULT_CAPACITY = 2048;
+// Máximo de leituras devolvidas por peek() (tamanho do lote de replay)
+const uint8_t OUTBOX_MAX_BATCH = 32;
+
+// Outbox persistente (store-and-forward) das leituras que não puderam ser publicadas.
+//
+// Formato em flash: um único arquivo circular (/outbox.bin) com cabeçalho e
+// slots de tamanho fixo. Cada registro carrega um número de sequência e CRC,
+// então head/tail são reconstruídos varrendo os slots no boot. Nenhum índice
+// é regravado a cada append: as escritas percorrem todos os slots em círculo
+// (wear-levelling sobre o próprio LittleFS).
+//
+// Política de descarte: com o outbox cheio, o registro MAIS ANTIGO é
+// sobrescrito (oldest-first). Para faturamento, perder o início de uma
+// queda muito longa é preferível a perder as leituras mais recentes.
+//
+// Replay em duas etapas: markSent() passa o cursor de leitura pelos
+// registros entregues ao MQTT (o próximo peek() começa depois deles) e
+// ackThrough() só os apaga quando chega o PUBACK (MqttSession::outboxAcked).
+// Reboot com PUBLISH ainda sem PUBACK: o cursor volta ao tail e eles saem
+// de novo (at-least-once), nada se perde.
+//
+// O ack é persistido em /outbox.ack a cada avanço do tail.
+//
+// Não é thread-safe: use a partir de uma única task.
+class ReadingOutbox {
+public:
+    // Abre (ou cria) o log. Se o formato/capacidade mudou, o log é recriado.
+    bool begin(uint16_t capacity = OUTBOX_DEFAULT_CAPACITY);
+
+    // Acrescenta uma leitura. Se cheio, descarta a mais antiga.
+    bool push(const MeterReading &reading);
+
+    // Copia até `max` leituras mais antigas ainda não entregues (sem
+    // removê-las). seqs (opcional) recebe a sequência de cada uma.
+    size_t peek(MeterReading *out, size_t max, uint32_t *seqs = NULL);
+
+    // As `count` primeiras do último peek() foram entregues (esperam PUBACK)
+    void markSent(size_t count);
+
+    // Remove as `count` primeiras leituras do último peek()
+    void ack(size_t count);
+
+    // Remove tudo antes da sequência `seq` (PUBACK recebido)
+    void ackThrough(uint32_t seq);
+
+    uint32_t size() const { return _head - _tail; }       // Inclui as entregues sem PUBACK
+    uint32_t unsent() const { return _head - _cursor; }
+    uint16_t capacity() const { return _capacity; }
+    uint32_t dropped() const { return _dropped; }
+
+private:
+    const char* LOG_FILE = "/outbox.bin";
+    const char* ACK_FILE = "/outbox.ack";
+
+    File _file;
+    uint16_t _capacity = 0;
+    uint32_t _head = 0;     // Próxima sequência a ser escrita
+    uint32_t _tail = 0;     // Sequência mais antiga ainda não confirmada
+    uint32_t _cursor = 0;   // Próxima a entregar ao MQTT (>= _tail; volta ao tail no boot)
+    uint32_t _dropped = 0;  // Leituras perdidas por overflow ou corrupção
+
+    uint32_t _peekSeqs[OUTBOX_MAX_BATCH];
+    size_t _peekCount = 0;
+
+    bool openLog();
+    void recover();
+    uint32_t slotOffset(uint32_t seq) const;
+    bool readSlot(uint32_t seq, MeterReading &out);
+    void persistAck();
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "Backoff.h"
+#include "Metrics.h"
+
+// --- Saúde de cada escravo Modbus ---
+//
+// Timeout adaptativo no estilo do RTO do TCP: média móvel (EWMA) do tempo
+// de resposta do escravo e do seu desvio; o timeout é média + 4 desvios,
+// limitado a [HEALTH_MIN_TIMEOUT_US, HEALTH_MAX_TIMEOUT_US]. Um medidor que
+// responde em 30 ms deixa de custar 2 s quando some do barramento.
+//
+// Depois de HEALTH_OFFLINE_AFTER falhas seguidas o escravo fica offline e só
+// é sondado com backoff exponencial (10 s, 20 s, ... até 10 min); os
+// medidores saudáveis mantêm o período normal.
+
+enum SlaveState : uint8_t {
+    SLAVE_UNKNOWN = 0,  // Ainda não respondeu nenhuma vez
+    SLAVE_ONLINE,
+    SLAVE_DEGRADED,     // Falhou, mas ainda não o bastante para ficar offline
+    SLAVE_OFFLINE       // Só sondado de tempos em tempos
+};
+
+const uint8_t HEALTH_OFFLINE_AFTER = 3;
+const uint32_t HEALTH_INITIAL_TIMEOUT_US = 1000000; // Antes da primeira resposta
+const uint32_t HEALTH_MIN_TIMEOUT_US = 50000;
+const uint32_t HEALTH_MAX_TIMEOUT_US = 2000000;
+const uint32_t HEALTH_PROBE_BASE_MS = 10000;
+const uint32_t HEALTH_PROBE_MAX_MS = 600000;
+
+struct SlaveHealth {
+    SlaveState state = SLAVE_UNKNOWN;
+    uint16_t consecutiveFailures = 0;
+    uint32_t okCount = 0;
+    uint32_t failCount = 0;
+    uint32_t srttUs = 0;      // EWMA do tempo de resposta (fim da requisição -> primeiro byte)
+    uint32_t rttVarUs = 0;    // EWMA do desvio absoluto
+    uint32_t lastOkMs = 0;
+    uint32_t nextProbeMs = 0; // Offline: quando tentar de novo
+    Backoff probe = Backoff(HEALTH_PROBE_BASE_MS, HEALTH_PROBE_MAX_MS);
+    LatencyHistogram response; // Tempo de resposta de cada transação ok (/api/metrics)
+};
+
+// Estado de um medidor para o tópico status/{canal}
+struct MeterStatus {
+    uint8_t channelId;
+    uint8_t bus;
+    uint8_t modbusId;
+    SlaveHealth health;
+    uint32_t timeoutUs;
+};
+
+// Saúde dos medidores de um barramento (índice = posição do medidor na lista do barramento)
+class SlaveHealthTracker {
+public:
+    void reset(size_t count);
+    // Lista de medidores trocada: o i-ésimo fica com a saúde do antigo
+    // from[i] (-1 = começa do zero; ver ConfigStore::matchMeters)
+    void remap(const std::vector<int> &from);
+    size_t size() const { return _slaves.size(); }
+
+    // Offline só é lido quando a próxima sonda vence; os demais, sempre
+    bool shouldPoll(size_t i, uint32_t nowMs) const;
+
+    // Timeout de resposta para a próxima requisição a este escravo
+    uint32_t timeoutUs(size_t i) const;
+
+    // Atualizam as médias/contadores. Retornam true se o estado mudou.
+    bool onSuccess(size_t i, uint32_t responseUs, uint32_t nowMs);
+    bool onFailure(size_t i, uint32_t nowMs);
+
+    const SlaveHealth &get(size_t i) const { return _slaves[i]; }
+
+    // Incrementa a cada mudança de estado (para publicar só quando muda)
+    uint32_t changes() const { return _changes; }
+
+    static const char *stateName(SlaveState state);
+
+private:
+    std::vector<SlaveHealth> _slaves;
+    uint32_t _changes = 0;
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// --- Fila circular lock-free de um produtor e um consumidor ---
+//
+// Substitui a FreeRTOS queue entre a task do barramento (produtor) e a
+// PubTask (consumidor): push/pop não bloqueiam nem entram em seção crítica,
+// e o produtor nunca espera o consumidor (tempo de barramento não se perde
+// por causa de um publish lento).
+//
+// head é escrito só pelo produtor; tail pelo consumidor e, na política
+// RING_DROP_OLDEST, também pelo produtor (descartando o mais antigo). Por
+// isso tail avança com compare-exchange: o consumidor copia os itens e só
+// então confirma; se o produtor descartou no meio, a cópia é refeita.
+// head e tail ficam em linhas de cache separadas e cada lado guarda uma
+// cópia local do índice do outro, relida só quando a fila parece cheia/vazia.
+
+enum RingOverflow : uint8_t {
+    RING_DROP_OLDEST = 0, // Sobrescreve o mais antigo (mantém os dados recentes)
+    RING_DROP_NEWEST,     // Descarta o que está chegando
+    RING_SPILL            // Entrega o que está chegando para o callback de spill (ex.: outbox em flash)
+};
+
+const size_t RING_CACHE_LINE = 64;
+
+template <typename T>
+class SpscRing {
+public:
+    typedef void (*SpillFn)(const T &item, void *ctx);
+
+    // Aloca a fila (capacidade arredondada para potência de 2). Chamar antes
+    // de produtor e consumidor começarem.
+    void begin(size_t capacity, RingOverflow policy, SpillFn spill = NULL, void *ctx = NULL) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        _slots.assign(cap, T());
+        _mask = cap - 1;
+        _policy = policy;
+        _spill = spill;
+        _spillCtx = ctx;
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _tailCache = 0;
+        _headCache = 0;
+        _highWater = 0;
+        _dropped = 0;
+        _spilled = 0;
+    }
+
+    // --- Produtor ---
+
+    // false se o item não ficou na fila (cheia: descartado ou enviado ao spill)
+    bool push(const T &item) {
+        if (_slots.empty()) return false;
+        uint32_t head = _head.load(std::memory_order_relaxed);
+
+        if (head - _tailCache > _mask) {
+            _tailCache = _tail.load(std::memory_order_acquire);
+            while (head - _tailCache > _mask) {
+                if (_policy == RING_DROP_NEWEST || (_policy == RING_SPILL && !_spill)) {
+                    _dropped++;
+                    return false;
+                }
+                if (_policy == RING_SPILL) {
+                    _spill(item, _spillCtx);
+                    _spilled++;
+                    return false;
+                }
+                // Descarta o mais antigo; se o consumidor levou antes, já há espaço
+                if (_tail.compare_exchange_weak(_tailCache, _tailCache + 1, std::memory_order_acq_rel)) {
+                    _tailCache++;
+                    _dropped++;
+                }
+            }
+        }
+
+        _slots[head & _mask] = item;
+        _head.store(head + 1, std::memory_order_release);
+
+        uint32_t used = head + 1 - _tailCache;
+        if (used > _highWater) _highWater = used;
+        return true;
+    }
+
+    // --- Consumidor ---
+
+    bool pop(T &out) { return popBatch(&out, 1) == 1; }
+
+    // Retira até `max` itens de uma vez
+    size_t popBatch(T *out, size_t max) { return popThrough(out, max, NULL); }
+
+    // Como popBatch, mas só até o último item com isEnd(item) (fim de um
+    // ciclo, por exemplo): o que vem depois fica na fila até o fim dele
+    // chegar. Sem nenhum fim, só retira se `max` ou a fila inteira encheram
+    // (senão o produtor nunca conseguiria fechar o grupo).
+    size_t popThrough(T *out, size_t max, bool (*isEnd)(const T &item)) {
+        if (_slots.empty() || max == 0) return 0;
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t available = _headCache - tail;
+            if (available == 0 || available > _mask + 1) {
+                _headCache = _head.load(std::memory_order_acquire);
+                available = _headCache - tail;
+                if (available == 0) return 0;
+            }
+            size_t n = available < max ? available : max;
+            for (size_t i = 0; i < n; i++) out[i] = _slots[(tail + i) & _mask];
+
+            size_t take = n;
+            if (isEnd) {
+                while (take > 0 && !isEnd(out[take - 1])) take--;
+                if (take == 0 && (n == max || n > _mask)) take = n;
+                if (take == 0) {
+                    // A cópia local do head pode estar velha: confere antes de desistir
+                    uint32_t head = _head.load(std::memory_order_acquire);
+                    if (head == _headCache) return 0;
+                    _headCache = head;
+                    continue;
+                }
+            }
+
+            // Se o produtor descartou (RING_DROP_OLDEST) durante a cópia, refaz do novo tail
+            if (_tail.compare_exchange_strong(tail, tail + take, std::memory_order_acq_rel)) return take;
+        }
+    }
+
+    // --- Qualquer task (aproximados enquanto os dois lados rodam) ---
+
+    size_t size() const {
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        uint32_t used = _head.load(std::memory_order_acquire) - tail;
+        return used > _slots.size() ? _slots.size() : used;
+    }
+    size_t capacity() const { return _slots.size(); }
+    uint32_t highWater() const { return _highWater; }
+    uint32_t dropped() const { return _dropped; }
+    uint32_t spilled() const { return _spilled; }
+
+private:
+    std::vector<T> _slots;
+    uint32_t _mask = 0;
+    RingOverflow _policy = RING_DROP_OLDEST;
+    SpillFn _spill = NULL;
+    void *_spillCtx = NULL;
+
+    // Lado do produtor
+    alignas(RING_CACHE_LINE) std::atomic<uint32_t> _head{0};
+    uint32_t _tailCache = 0;
+    uint32_t _highWater = 0;
+    uint32_t _dropped = 0;
+    uint32_t _spilled = 0;
+
+    // Lado do consumidor
+    alignas(RING_CACHE_LINE) std::atomic<uint32_t> _tail{0};
+    uint32_t _headCache = 0;
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "AppConfig.h"
+#include "ArenaAllocator.h"
+#include "SlaveHealth.h"
+#include "WallClock.h"
+
+// Memória fixa do JsonDocument de telemetria (cobre um payload de 1 KB com folga)
+const size_t TELEMETRY_ARENA_SIZE = 6144;
+
+// Versão do schema binário (primeiro campo de toda mensagem data.v2)
+const uint8_t TELEMETRY_SCHEMA_VERSION = 3;
+
+// Chaves inteiras do schema binário (MessagePack)
+// Mensagem: { 0: versão, 1: device_id, 2: [ canal, canal, ... ] }
+// Canal:    { 0: channel_id, 1: voltage, 2: current, 3: power, 4: total_kwh }
+// Resumo:   canal + { 5: samples, 6/7: voltage min/max, 8/9: current min/max,
+//                     10/11: power min/max, 12: energy_delta_kwh }
+// Tempo:    todo canal leva { 13: ts } (UTC em ms) ou, antes do primeiro sync
+//           SNTP, { 14: ts_boot_ms, 15: boot_id }
+enum TelemetryKey : uint8_t {
+    TK_VERSION = 0,
+    TK_DEVICE_ID = 1,
+    TK_CHANNELS = 2,
+
+    TK_CH_ID = 0,
+    TK_CH_VOLTAGE = 1,
+    TK_CH_CURRENT = 2,
+    TK_CH_POWER = 3,
+    TK_CH_TOTAL_KWH = 4,
+    TK_CH_SAMPLES = 5,
+    TK_CH_VOLTAGE_MIN = 6,
+    TK_CH_VOLTAGE_MAX = 7,
+    TK_CH_CURRENT_MIN = 8,
+    TK_CH_CURRENT_MAX = 9,
+    TK_CH_POWER_MIN = 10,
+    TK_CH_POWER_MAX = 11,
+    TK_CH_ENERGY_DELTA = 12,
+    TK_CH_TS = 13,
+    TK_CH_TS_BOOT = 14,
+    TK_CH_BOOT_ID = 15
+};
+
+// Monta o payload de telemetria com vários canais numa única mensagem.
+//   JSON:    { "device_id": "...", "channels": { "1": {...}, "2": {...} } }
+//            (formato EnergyMeterPayload do backend; resumos acrescentam
+//            "samples", "voltage_min", ..., "energy_delta_kwh" ao canal)
+//            Cada canal leva "ts" (UTC em ms, instante da amostra) ou
+//            "ts_boot_ms" + "boot_id"; "timestamp" da mensagem é o "ts" do
+//            primeiro canal, quando houver.
+//   MsgPack: schema acima, floats em 32 bits
+//
+// Nenhum dos dois caminhos usa o heap: o JSON é montado sobre uma arena
+// estática e ambos escrevem direto no buffer do chamador.
+class TelemetryEncoder {
+public:
+    // Codifica o maior prefixo de `readings` que cabe em `capacity` bytes
+    // (incluindo o '\0' no JSON). Retorna quantas leituras entraram na
+    // mensagem (0 se nem a primeira coube) e o tamanho do payload em outLen.
+    //
+    // A mensagem também é fechada quando um canal se repete (replay do
+    // outbox com leituras de ciclos diferentes): o backend trata cada
+    // mensagem como uma amostra por canal.
+    //
+    // Com `clock`, leituras relativas a este boot saem em UTC se o relógio
+    // já sincronizou (ver WallClock::resolve).
+    size_t encode(PayloadFormat format, const String &deviceId, const MeterReading *readings, size_t count,
+                  char *out, size_t capacity, size_t &outLen, const WallClock *clock = NULL);
+
+    size_t encodeJson(const String &deviceId, const MeterReading *readings, size_t count,
+                      char *out, size_t capacity, size_t &outLen, const WallClock *clock = NULL);
+
+    size_t encodeMsgPack(const String &deviceId, const MeterReading *readings, size_t count,
+                         char *out, size_t capacity, size_t &outLen, const WallClock *clock = NULL);
+
+    // Sufixo do tópico para cada formato ("data" ou "data.v2")
+    static const char *topicSuffix(PayloadFormat format);
+
+    // Status retido (JSON curto, sempre texto). Retornam o tamanho ou 0 se não couber.
+    //   status:         { "online": true, "uptime_s": 3600, "meters_online": 7, "meters_offline": 1 }
+    //   status/{canal}: { "bus": 0, "modbus_id": 10, "state": "offline", "response_ms": 23,
+    //                     "timeout_ms": 120, "failures": 5, "last_ok_s": 42 }
+    static size_t encodeGatewayStatus(uint32_t uptimeSec, size_t online, size_t offline, char *out, size_t capacity);
+    static size_t encodeMeterStatus(const MeterStatus &status, uint32_t nowMs, char *out, size_t capacity);
+
+private:
+    ArenaAllocator<TELEMETRY_ARENA_SIZE> _arena;
+};
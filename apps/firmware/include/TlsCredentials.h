@@ -0,0 +1,42 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <memory>
+#include "DeviceKey.h"
+
+// --- Credenciais mTLS do MQTT (CA, certificado e chave do dispositivo) ---
+//
+// Lidas do LittleFS uma vez e mantidas durante toda a execução: o
+// WiFiClientSecure guarda só os ponteiros e relê o texto a cada handshake,
+// então os buffers não podem ser temporários. Cada arquivo ocupa um bloco do
+// tamanho exato (PEM + '\0'), alocado no boot, antes de fragmentar o heap.
+//
+// Ficam em PEM: o WiFiClientSecure mede as credenciais com strlen(), então
+// DER (binário, com zeros no meio) não passa pela API dele.
+
+const char *const TLS_CA_PATH = "/ca.crt";
+const char *const TLS_CERT_PATH = "/device.crt";
+const char *const TLS_KEY_PATH = "/device.key";
+const size_t TLS_PEM_MAX_BYTES = 8192; // Maior que isso não é certificado nosso
+
+class TlsCredentials {
+public:
+    // Lê os três arquivos (false se faltar algum ou não for PEM; nada muda)
+    bool load();
+
+    bool loaded() const { return (bool)_key; }
+    const char *ca() const { return _ca.get(); }
+    const char *cert() const { return _cert.get(); }
+    const char *key() const { return _key.get(); }
+    size_t bytes() const { return _bytes; }
+    DeviceKeyType keyType() const { return _keyType; } // Pelo rótulo do PEM da chave
+
+private:
+    std::unique_ptr<char[]> _ca;
+    std::unique_ptr<char[]> _cert;
+    std::unique_ptr<char[]> _key;
+    size_t _bytes = 0;
+    DeviceKeyType _keyType = KEY_UNKNOWN;
+
+    static std::unique_ptr<char[]> readPem(const char *path, size_t &len);
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include "ModbusRtuMaster.h"
+
+// Transporte RTU sobre uma UART do ESP32 em modo RS485 half-duplex.
+// O próprio periférico aciona o DE (pino RTS) durante a transmissão: não há
+// callbacks pre/post nem espera pela FIFO esvaziar. Cada evento de RX da UART
+// acorda a task que está em waitEvent(). Sem carimbo de tempo por byte
+// (exactByteTimes = false): o mestre não cobra o t1.5 nesta porta.
+class UartRtuPort : public RtuPort {
+public:
+    void begin(HardwareSerial &serial, uint8_t uart, const SerialLine &line, int rxPin, int txPin, int dePin);
+
+    void send(const uint8_t *frame, size_t len) override;
+    size_t receive(uint8_t *buf, size_t max) override;
+    uint32_t nowUs() override { return micros(); }
+    void waitEvent(uint32_t timeoutUs) override;
+    bool setLine(const SerialLine &line) override;
+
+private:
+    HardwareSerial *_serial = NULL;
+    uint8_t _uart = 0;
+    volatile TaskHandle_t _waiter = NULL;
+};
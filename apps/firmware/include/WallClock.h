@@ -0,0 +1,54 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "AppConfig.h"
+
+// --- Relógio de parede (UTC) sobre o relógio monotônico ---
+//
+// As leituras são carimbadas com o relógio monotônico (esp_timer, 64 bits:
+// não volta nem pula) no instante em que a resposta Modbus chega. O SNTP só
+// ajusta o mapeamento monotônico -> UTC guardado aqui, então lote, fila,
+// outbox e replay não distorcem a série: o instante é o da amostra, não o
+// da chegada no backend.
+//
+// Antes do primeiro sync a leitura fica com o tempo relativo ao boot
+// (timeMs desde o boot + bootId). resolve() a converte para UTC assim que o
+// relógio sincroniza, enquanto ela estiver na fila ou no outbox do mesmo
+// boot. De um boot anterior não há como corrigir: sai relativa ao boot.
+
+const uint32_t SNTP_SYNC_INTERVAL_MS = 3600000; // Ressincroniza a cada hora
+#define SNTP_SERVER_1 "pool.ntp.org"
+#define SNTP_SERVER_2 "time.google.com"
+
+class WallClock {
+public:
+    // ms desde o boot (64 bits)
+    static int64_t monoMs();
+
+    // Identificador deste boot (aleatório, != 0)
+    void begin(uint16_t bootId) { _bootId = bootId ? bootId : 1; }
+    uint16_t bootId() const { return _bootId; }
+
+    // Callback do SNTP (task do lwIP): UTC recebido no instante monoMs
+    void sync(int64_t monoMs, int64_t utcMs);
+
+    bool synced() const { return _syncs.load() > 0; }
+    // UTC de um instante monotônico deste boot. false antes do primeiro sync
+    bool toUtc(int64_t monoMs, int64_t &utcMs) const;
+
+    // Carimbo de uma leitura recém-lida (timeMs monotônico): UTC se já
+    // sincronizou, senão relativo a este boot
+    void stamp(MeterReading &reading) const;
+    // Leitura relativa a este boot vira UTC se o relógio já sincronizou
+    void resolve(MeterReading &reading) const;
+
+    uint32_t syncs() const { return _syncs.load(); }
+    // Diferença entre o UTC previsto e o do SNTP no último sync (deriva do cristal)
+    int32_t lastStepMs() const { return _lastStepMs.load(); }
+
+private:
+    std::atomic<int64_t> _offsetMs{0}; // UTC - monotônico
+    std::atomic<uint32_t> _syncs{0};
+    std::atomic<int32_t> _lastStepMs{0};
+    uint16_t _bootId = 1;
+};
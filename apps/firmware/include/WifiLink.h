@@ -0,0 +1,98 @@
+#pragma once
+#include <Arduino.h>
+#include "Backoff.h"
+#include "Metrics.h"
+
+// --- Máquina de estados da conexão WiFi (STA) ---
+//
+// Movida pelos eventos do WiFi (conectou com IP / caiu) e por poll()
+// periódico na NetTask, que devolve a próxima ação para o NetworkManager
+// executar. Não mexe no rádio: dá para testar sem hardware.
+//
+// - Queda: nova tentativa em WIFI_RETRY_BASE_MS, dobrando até
+//   WIFI_RETRY_MAX_MS (com jitter). Um AP que piscou 2 s volta em ~1 s.
+// - A primeira tentativa depois de uma queda vai direto no último BSSID/canal
+//   (sem varrer os canais); se falhar, as próximas fazem a busca completa.
+// - AP de emergência por política de tempo, não por número de tentativas:
+//   credenciais que nunca conectaram abrem o AP em WIFI_AP_FALLBACK_MS; uma
+//   rede que já funcionou tem WIFI_AP_AFTER_LOSS_MS para voltar. O STA
+//   continua tentando com o AP no ar, e o AP sai quando conecta.
+
+const uint32_t WIFI_RETRY_BASE_MS = 250;
+const uint32_t WIFI_RETRY_MAX_MS = 30000;
+const uint8_t WIFI_RETRY_JITTER_PCT = 20;
+const uint32_t WIFI_CONNECT_TIMEOUT_MS = 15000;   // Associação + DHCP
+const uint32_t WIFI_AP_FALLBACK_MS = 30000;
+const uint32_t WIFI_AP_AFTER_LOSS_MS = 300000;
+
+// Motivo de desconexão de quando nós mesmos saímos (WIFI_REASON_ASSOC_LEAVE):
+// é eco de um begin()/disconnect() nosso, não falha da tentativa
+const uint8_t WIFI_REASON_LEFT = 8;
+
+enum WifiLinkState : uint8_t {
+    LINK_OFF = 0,    // AP forçado ou sem SSID: não tenta STA
+    LINK_WAITING,    // Esperando o backoff para tentar de novo
+    LINK_CONNECTING,
+    LINK_CONNECTED
+};
+
+enum WifiLinkAction : uint8_t {
+    LINK_NONE = 0,
+    LINK_CONNECT,       // WiFi.begin com busca completa
+    LINK_CONNECT_FAST,  // WiFi.begin no BSSID/canal guardados
+    LINK_ABORT,         // Tentativa passou do tempo: desistir dela
+    LINK_START_AP,
+    LINK_STOP_AP
+};
+
+// Escritas só pela NetTask (ver Metrics.h)
+struct WifiMetrics {
+    uint32_t connects = 0;       // Conexões com IP
+    uint32_t disconnects = 0;    // Quedas de uma conexão estabelecida
+    uint32_t failures = 0;       // Tentativas que não conectaram
+    uint32_t apFallbacks = 0;
+    uint32_t lastReconnectMs = 0; // Queda -> IP de novo, da última queda
+    uint32_t maxReconnectMs = 0;
+    LatencyHistogram reconnect;   // Queda -> IP de novo
+};
+
+class WifiLink {
+public:
+    // Recomeça (boot ou credenciais novas). `enabled` = há SSID e o AP não é forçado.
+    void begin(bool enabled, uint32_t nowMs);
+
+    void connected(uint32_t nowMs, const uint8_t *bssid, uint8_t channel);
+    void disconnected(uint32_t nowMs, uint8_t reason, uint32_t random = 0);
+
+    // Próxima ação (no máximo uma por chamada)
+    WifiLinkAction poll(uint32_t nowMs, uint32_t random = 0);
+
+    // O AP está no ar (quem sobe/derruba é o NetworkManager)
+    void setApActive(bool active) { _apActive = active; }
+
+    // BSSID/canal para o religamento rápido (também vindos de antes do reboot)
+    void setHint(const uint8_t *bssid, uint8_t channel);
+    bool hasHint() const { return _hintChannel != 0; }
+    const uint8_t *hintBssid() const { return _hintBssid; }
+    uint8_t hintChannel() const { return _hintChannel; }
+
+    WifiLinkState state() const { return _state; }
+    const WifiMetrics &metrics() const { return _metrics; }
+
+private:
+    WifiLinkState _state = LINK_OFF;
+    Backoff _retry = Backoff(WIFI_RETRY_BASE_MS, WIFI_RETRY_MAX_MS, WIFI_RETRY_JITTER_PCT);
+    uint32_t _beginMs = 0;
+    uint32_t _attemptMs = 0;
+    uint32_t _retryAtMs = 0;
+    uint32_t _lostMs = 0;
+    bool _lost = false;          // Caiu depois de ter conectado (conta o tempo de religar)
+    bool _everConnected = false; // Desde o begin(): as credenciais funcionam
+    bool _fastAttempt = false;
+    bool _apActive = false;
+    uint8_t _hintBssid[6] = {};
+    uint8_t _hintChannel = 0;
+    WifiMetrics _metrics;
+
+    void fail(uint32_t nowMs, uint32_t random);
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+
+// --- Cache do scan de redes WiFi (/api/scan) ---
+//
+// O scan roda em segundo plano (WiFi.scanNetworks(true)) e leva alguns
+// segundos; o /api/scan responde na hora com a última lista e a flag
+// "scanning", e o painel consulta de novo até terminar. Um scan novo só
+// começa quando a lista passou de SCAN_MAX_AGE_MS, e nunca mais de um a cada
+// SCAN_MIN_INTERVAL_MS (atualizar a página não refaz o scan do rádio).
+//
+// Só guarda estado; quem conversa com o WiFi é o NetworkManager.
+
+const uint8_t SCAN_MAX_NETWORKS = 20;
+const uint32_t SCAN_MAX_AGE_MS = 30000;
+const uint32_t SCAN_MIN_INTERVAL_MS = 5000;  // Também o intervalo de nova tentativa após falha
+const uint32_t SCAN_TIMEOUT_MS = 15000;      // Scan que não termina conta como falha
+
+struct ScanEntry {
+    char ssid[33];
+    int8_t rssi;
+    bool secure;
+};
+
+class WifiScanCache {
+public:
+    // Hora de disparar um scan novo?
+    bool shouldStart(uint32_t nowMs) const;
+
+    void started(uint32_t nowMs);
+
+    // Resultado do scan: clear(), add() de cada rede e finished()
+    void clear() { _count = 0; }
+    void add(const char *ssid, int32_t rssi, bool secure);
+    void finished(uint32_t nowMs);
+    void failed();
+
+    // Scan em andamento há mais de SCAN_TIMEOUT_MS
+    bool timedOut(uint32_t nowMs) const { return _scanning && nowMs - _startedMs >= SCAN_TIMEOUT_MS; }
+
+    bool scanning() const { return _scanning; }
+    bool hasResult() const { return _hasResult; }
+    uint32_t ageMs(uint32_t nowMs) const { return nowMs - _updatedMs; }
+
+    uint8_t count() const { return _count; }
+    const ScanEntry &entry(uint8_t i) const { return _entries[i]; }
+
+private:
+    ScanEntry _entries[SCAN_MAX_NETWORKS];
+    uint8_t _count = 0;
+    bool _scanning = false;
+    bool _started = false;   // Já houve alguma tentativa
+    bool _hasResult = false;
+    uint32_t _startedMs = 0;
+    uint32_t _updatedMs = 0;
+};
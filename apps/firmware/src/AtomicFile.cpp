@@ -0,0 +1,62 @@
+#include "AtomicFile.h"
+#include "Checksum.h"
+
+const char *AtomicFile::withSuffix(char *buf, const char *path, const char *suffix) {
+    snprintf(buf, PATH_MAX_LEN, "%s%s", path, suffix);
+    return buf;
+}
+
+File AtomicFile::begin(const char *path) {
+    char tmp[PATH_MAX_LEN];
+    return LittleFS.open(withSuffix(tmp, path, ".tmp"), "w");
+}
+
+bool AtomicFile::commit(File &tmp, const char *path) {
+    char tmpPath[PATH_MAX_LEN];
+    char bakPath[PATH_MAX_LEN];
+    withSuffix(tmpPath, path, ".tmp");
+    withSuffix(bakPath, path, ".bak");
+
+    if (!tmp) return false;
+    tmp.flush();
+    tmp.close();
+
+    // O atual vira a última versão boa (o rename sobrescreve o .bak antigo)
+    if (LittleFS.exists(path) && !LittleFS.rename(path, bakPath)) {
+        Serial.printf("❌ Falha ao guardar %s\n", bakPath);
+        LittleFS.remove(tmpPath);
+        return false;
+    }
+    if (!LittleFS.rename(tmpPath, path)) {
+        Serial.printf("❌ Falha ao promover %s\n", tmpPath);
+        return false;
+    }
+    return true;
+}
+
+void AtomicFile::abort(File &tmp, const char *path) {
+    char tmpPath[PATH_MAX_LEN];
+    tmp.close();
+    LittleFS.remove(withSuffix(tmpPath, path, ".tmp"));
+}
+
+void AtomicFile::removeAll(const char *path) {
+    char buf[PATH_MAX_LEN];
+    LittleFS.remove(path);
+    LittleFS.remove(withSuffix(buf, path, ".bak"));
+    LittleFS.remove(withSuffix(buf, path, ".tmp"));
+}
+
+bool AtomicFile::crc(const char *path, uint32_t &out) {
+    if (!LittleFS.exists(path)) return false; // open() de arquivo ausente polui o log no ESP32
+    File f = LittleFS.open(path, "r");
+    if (!f) return false;
+
+    uint8_t buf[128];
+    uint32_t c = 0;
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) > 0) c = crc32(buf, n, c);
+    f.close();
+    out = c;
+    return true;
+}
@@ -0,0 +1,291 @@
+#include "BusPoller.h"
+#include "WallClock.h"
+
+extern WallClock wallClock; // main.cpp
+
+// Leituras de um ciclo: cada uma só vai para a fila quando a próxima chega,
+// para que a última do ciclo saia marcada com READING_CYCLE_END (a PubTask
+// agrupa até ela)
+struct CycleSink {
+    ReadingRing *ring;
+    TaskHandle_t *consumer;     // Acordada no fim do ciclo
+    MeterReading pending;
+    bool hasPending;
+    ChannelStats *stats;        // Agregando: leituras vão para cá, não para a fila
+    ExceptionFilter *filter;    // Bandas mortas (NULL = publica tudo)
+    const MeterConfig *meters;  // Base para achar o índice do medidor
+};
+
+static void sinkPush(CycleSink &sink, const MeterReading &reading) {
+    // Nunca bloqueia: com a fila cheia vale a política de overflow (contada no anel)
+    if (sink.hasPending) sink.ring->push(sink.pending);
+    sink.pending = reading;
+    sink.hasPending = true;
+}
+
+// Envia a última leitura retida, marcando o fim do ciclo
+static void sinkClose(CycleSink &sink) {
+    if (!sink.hasPending) return;
+    sink.pending.flags |= READING_CYCLE_END;
+    sink.ring->push(sink.pending);
+    sink.hasPending = false;
+    if (sink.consumer && *sink.consumer) xTaskNotifyGive(*sink.consumer);
+}
+
+HardwareSerial *BusPoller::serialFor(uint8_t uart) {
+    switch (uart) {
+        case 1: return &Serial1;
+        case 2: return &Serial2;
+        default: return NULL; // UART0 fica com o console
+    }
+}
+
+bool BusPoller::start(uint8_t busIndex, ConfigStore &store, TaskHandle_t *consumer, ReadingRing::SpillFn spill) {
+    ConfigRef config = store.get();
+    _index = busIndex;
+    _bus = config->buses[busIndex];
+    _consumer = consumer;
+    _store = &store;
+    _appliedVersion = store.version();
+    if (!_viewLock) _viewLock = xSemaphoreCreateMutex();
+
+    applyConfig(*config);
+    _ring.begin(_meters.size() * 2 > READING_RING_MIN ? _meters.size() * 2 : READING_RING_MIN,
+                config->queueOverflow, spill);
+
+    if (!serialFor(_bus.uart)) {
+        Serial.printf("❌ Barramento %u: UART%u inválida (use 1 ou 2)\n", _index, _bus.uart);
+        _meters.clear();
+        _meterCount = 0;
+        return false;
+    }
+
+    // Inicializa antes de criar a task: a PubTask lê a saúde dos medidores
+    _port.begin(*serialFor(_bus.uart), _bus.uart, _bus.line(), _bus.rxPin, _bus.txPin, _bus.dePin);
+    _worker.begin(&_port, _bus.baud, _meters.size());
+    Serial.printf("🔌 Barramento %u: UART%u, %u medidores\n", _index, _bus.uart, (unsigned)_meters.size());
+
+    char name[12];
+    snprintf(name, sizeof(name), "Modbus%u", _index);
+    // Prioridade 2 (acima da PubTask) para garantir precisão no tempo
+    return xTaskCreatePinnedToCore(taskEntry, name, 4096, this, 2, &_task, 1) == pdPASS;
+}
+
+// Medidores, períodos e estado por medidor (agregação, banda morta, saúde).
+// Depois do start() só roda na task do barramento, entre dois ciclos.
+void BusPoller::applyConfig(const SystemConfig &config) {
+    _interval = config.interval;
+    _samplePeriod = config.samplePeriod;
+    _defaultPeriodMs = config.interval * 1000UL;
+
+    // Agregando, o período padrão dos medidores passa a ser o de amostragem
+    // e o intervalo vira o período dos relatórios
+    _aggregate = config.samplePeriod > 0 && config.samplePeriod < config.interval;
+    _reportMs = 0;
+    if (_aggregate) {
+        _reportMs = _defaultPeriodMs;
+        _defaultPeriodMs = config.samplePeriod * 1000UL;
+    }
+
+    std::vector<MeterConfig> meters;
+    for (const auto &m : config.meters) {
+        if (m.bus == _index) meters.push_back(m);
+    }
+
+    // Quem continua no barramento leva o estado junto (backoff, timeout,
+    // contadores, referência da banda morta, base de energia); só os
+    // medidores novos ou trocados recomeçam
+    std::vector<int> from;
+    ConfigStore::matchMeters(_meters, meters, from);
+    std::vector<ChannelStats> stats(_aggregate ? meters.size() : 0);
+    for (size_t i = 0; i < stats.size(); i++) {
+        if (from[i] >= 0 && (size_t)from[i] < _stats.size()) stats[i] = _stats[from[i]];
+    }
+
+    // A PubTask e o servidor web leem _meters e a saúde em meterStatus()
+    xSemaphoreTake(_viewLock, portMAX_DELAY);
+    _meters.swap(meters);
+    _meterCount = _meters.size();
+    _stats.swap(stats);
+    _filter.remap(from);
+    _worker.remap(from);
+    xSemaphoreGive(_viewLock);
+}
+
+// Chamado no topo de cada volta da task: aplica a config publicada desde a última
+void BusPoller::reload() {
+    if (_store->version() == _appliedVersion) return;
+    _appliedVersion = _store->version();
+    ConfigRef config = _store->get();
+
+    std::vector<MeterConfig> meters;
+    for (const auto &m : config->meters) {
+        if (m.bus == _index) meters.push_back(m);
+    }
+    if (config->interval == _interval && config->samplePeriod == _samplePeriod &&
+        ConfigStore::sameMeters(meters, _meters)) {
+        return; // Mudou algo de outro barramento ou fora do polling
+    }
+
+    // A janela em andamento fecha com os medidores antigos (nada se perde)
+    if (_aggregate) flushSummaries(millis());
+
+    applyConfig(*config);
+    _scheduler.configure(_meters, _defaultPeriodMs, millis());
+    _nextReport = millis() + _reportMs;
+
+    if (_meters.size() * 2 > _ring.capacity()) {
+        Serial.printf("⚠️ Barramento %u: fila de %u leituras fica pequena até reiniciar\n", _index, (unsigned)_ring.capacity());
+    }
+    Serial.printf("🔁 Barramento %u: config aplicada sem reiniciar (%u medidores)\n", _index, (unsigned)_meters.size());
+}
+
+bool BusPoller::startDiscovery(bool allLines, uint32_t timeoutUs) {
+    uint8_t state = _discovery.load();
+    if (!_task || state == DISCOVERY_PENDING || state == DISCOVERY_RUNNING) return false;
+
+    SerialLine lines[DISCOVERY_MAX_LINES];
+    _discoverAllLines = allLines;
+    _discoverTimeoutUs = timeoutUs;
+    _discoveryTotal = MeterDiscovery::lines(_bus.line(), allLines, lines) * DISCOVERY_ADDRESSES;
+    _discoveryProbed = 0;
+    _discovered.clear();
+    _discovery.store(DISCOVERY_PENDING);
+    xTaskNotifyGive(_task); // Sai da espera pela próxima liberação
+    return true;
+}
+
+// Na task do barramento, entre dois ciclos
+void BusPoller::runDiscovery() {
+    _discovery.store(DISCOVERY_RUNNING);
+    SerialLine lines[DISCOVERY_MAX_LINES];
+    size_t n = MeterDiscovery::lines(_bus.line(), _discoverAllLines, lines);
+    Serial.printf("🔎 Barramento %u: descoberta em %u linha(s), polling parado\n", _index, (unsigned)n);
+
+    uint32_t start = millis();
+    _worker.discover(lines, n, _discoverTimeoutUs, _discovered, &_discoveryProbed);
+    if (!_worker.setLine(_bus.line())) Serial.printf("❌ Barramento %u: não voltou para %u baud\n", _index, (unsigned)_bus.baud);
+    Serial.printf("🔎 Barramento %u: %u medidores em %u s\n", _index, (unsigned)_discovered.size(), (unsigned)((millis() - start) / 1000));
+
+    // As liberações perdidas durante a varredura não contam como overrun
+    _scheduler.configure(_meters, _defaultPeriodMs, millis());
+    _discovery.store(DISCOVERY_DONE);
+}
+
+bool BusPoller::meterStatus(size_t i, MeterStatus &out) const {
+    if (!_viewLock) return false;
+    xSemaphoreTake(_viewLock, portMAX_DELAY);
+    bool ok = i < _meters.size();
+    if (ok) {
+        out.channelId = _meters[i].channelIndex;
+        out.bus = _index;
+        out.modbusId = _meters[i].modbusId;
+        out.health = _worker.health().get(i);
+        out.timeoutUs = _worker.health().timeoutUs(i);
+    }
+    xSemaphoreGive(_viewLock);
+    return ok;
+}
+
+void BusPoller::taskEntry(void *self) {
+    ((BusPoller *)self)->run();
+}
+
+void BusPoller::onMeterRead(const MeterConfig &meter, bool ok, const MeterReading &reading, void *ctx) {
+    if (!ok) return;
+    CycleSink *sink = (CycleSink *)ctx;
+
+    MeterReading r = reading;
+    r.channelId = meter.channelIndex; // Usa o channelIndex configurado manualmente
+    r.flags = 0;
+    wallClock.stamp(r);               // timeMs monotônico -> UTC (ou relativo ao boot)
+
+    size_t index = &meter - sink->meters;
+    if (sink->stats) {
+        sink->stats[index].add(r);
+        return;
+    }
+
+    // Dentro da banda morta e antes do heartbeat: não publica
+    if (sink->filter && !sink->filter->shouldReport(index, meter.deadband, r, millis())) return;
+
+    sinkPush(*sink, r);
+}
+
+void BusPoller::flushSummaries(uint32_t now) {
+    // Um resumo por canal que teve amostra; o lote inteiro é um ciclo para a PubTask
+    CycleSink sink;
+    sink.ring = &_ring;
+    sink.consumer = _consumer;
+    sink.hasPending = false;
+    sink.stats = NULL;
+    sink.filter = NULL;
+    sink.meters = _meters.data();
+
+    for (size_t i = 0; i < _stats.size(); i++) {
+        if (_stats[i].count() == 0) continue;
+        MeterReading summary;
+        _stats[i].summarize(summary);
+        summary.channelId = _meters[i].channelIndex;
+        sinkPush(sink, summary);
+    }
+    sinkClose(sink);
+
+    // Deadline absoluto, como no escalonador (pula relatórios perdidos)
+    do {
+        _nextReport += _reportMs;
+    } while ((int32_t)(now - _nextReport) >= 0);
+}
+
+void BusPoller::run() {
+    // Cada medidor tem seu período; as liberações seguem deadlines absolutos
+    _scheduler.configure(_meters, _defaultPeriodMs, millis());
+    _nextReport = millis() + _reportMs;
+
+    while (true) {
+        // Fim de ciclo: ponto seguro para trocar a lista de medidores
+        reload();
+
+        if (_discovery.load() == DISCOVERY_PENDING) {
+            runDiscovery();
+            continue;
+        }
+
+        if (_scheduler.empty()) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+            continue;
+        }
+
+        // Dorme até o instante absoluto da próxima liberação (sem deriva).
+        // Uma config nova acorda antes (notifyConfigChanged) e volta ao topo.
+        uint32_t release = _scheduler.nextRelease();
+        int32_t wait = (int32_t)(release - millis());
+        if (wait > 0 && ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait)) > 0) continue;
+
+        uint32_t start = millis();
+        uint8_t due[MAX_CYCLE_READINGS];
+        size_t dueCount = _scheduler.collectDue(start, due, MAX_CYCLE_READINGS);
+
+        // Lê os medidores liberados com as transações em pipeline
+        CycleSink sink;
+        sink.ring = &_ring;
+        sink.consumer = _consumer;
+        sink.hasPending = false;
+        sink.stats = _aggregate ? _stats.data() : NULL;
+        sink.filter = &_filter;
+        sink.meters = _meters.data();
+        _worker.readMeters(_meters.data(), due, dueCount, onMeterRead, &sink);
+
+        // Envia para a Fila, marcando o fim do ciclo deste barramento
+        sinkClose(sink);
+
+        // Agregando: só o resumo sai, uma vez por intervalo
+        if (_aggregate && (int32_t)(millis() - _nextReport) >= 0) flushSummaries(millis());
+
+        _scheduler.endCycle(release, start, millis());
+        const SchedulerStats &st = _scheduler.stats();
+        if (st.lastJitterMs > 100 || (int32_t)(millis() - _scheduler.nextRelease()) > 0) {
+            Serial.printf("⏱️ Barramento %u: ciclo %u ms (atraso %u ms, overruns %u)\n", _index, st.lastCycleMs, st.lastJitterMs, st.overruns);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#include "ChannelStats.h"
+
+void ChannelStats::add(const MeterReading &r) {
+    bool first = _count == 0;
+    _voltage.add(r.voltage, first);
+    _current.add(r.current, first);
+    _power.add(r.power, first);
+    _count++;
+
+    _lastTimeMs = r.timeMs;
+    _lastBootId = r.bootId;
+    _lastTimeFlag = r.flags & READING_TIME_UTC;
+
+    if (_hasKwh && r.totalKwh >= _lastKwh) {
+        _energy += (double)r.totalKwh - (double)_lastKwh;
+    }
+    _lastKwh = r.totalKwh;
+    _hasKwh = true;
+}
+
+void ChannelStats::summarize(MeterReading &out) {
+    memset(&out, 0, sizeof(out));
+    out.flags = READING_SUMMARY | _lastTimeFlag;
+    out.samples = _count > 0xFFFF ? 0xFFFF : _count;
+
+    if (_count > 0) {
+        out.voltage = _voltage.sum / _count;
+        out.current = _current.sum / _count;
+        out.power = _power.sum / _count;
+        out.voltageMin = _voltage.min;
+        out.voltageMax = _voltage.max;
+        out.currentMin = _current.min;
+        out.currentMax = _current.max;
+        out.powerMin = _power.min;
+        out.powerMax = _power.max;
+    }
+    out.totalKwh = _lastKwh;
+    out.energyDelta = _energy;
+    out.timeMs = _lastTimeMs;
+    out.bootId = _lastBootId;
+
+    // Nova janela (a base de energia continua)
+    _count = 0;
+    _voltage = RunningStat();
+    _current = RunningStat();
+    _power = RunningStat();
+    _energy = 0;
+}
@@ -1,4 +1,6 @@
 #include "ConfigManager.h"
+#include "AtomicFile.h"
+#include "ConfigSnapshot.h"
 
 bool ConfigManager::begin()
 {
@@ -16,8 +18,40 @@ SystemConfig ConfigManager::load()
 {
     SystemConfig config; // Começa vazia (ou com defaults do construtor se tiver)
 
-    File file = LittleFS.open(CONFIG_FILE, "r");
-    if (!file)
+    // 1. Snapshot binário, se ainda corresponde ao config.json (sem JsonDocument no boot)
+    uint32_t jsonCrc = 0, sourceCrc = 0;
+    bool hasJson = AtomicFile::crc(CONFIG_FILE, jsonCrc);
+    if (ConfigSnapshot::read(SNAPSHOT_FILE, config, sourceCrc) && (!hasJson || sourceCrc == jsonCrc))
+    {
+        _source = CONFIG_FROM_SNAPSHOT;
+        if (!hasJson)
+            save(config); // Recria o JSON (a API e o usuário editam ele)
+        return config;
+    }
+
+    // 2. config.json (e refaz o snapshot para o próximo boot)
+    if (hasJson && parseFile(CONFIG_FILE, config))
+    {
+        _source = CONFIG_FROM_JSON;
+        if (!ConfigSnapshot::write(SNAPSHOT_FILE, config, jsonCrc))
+            Serial.println("⚠️ Falha ao gravar config.bin (o boot continua lendo o JSON)");
+        return config;
+    }
+
+    // 3. Última versão boa (save interrompido ou arquivo corrompido)
+    char bak[AtomicFile::PATH_MAX_LEN];
+    if (parseFile(AtomicFile::withSuffix(bak, CONFIG_FILE, ".bak"), config) ||
+        ConfigSnapshot::read(AtomicFile::withSuffix(bak, SNAPSHOT_FILE, ".bak"), config, sourceCrc))
+    {
+        Serial.println("♻️ Config restaurada da última versão boa");
+        _source = CONFIG_FROM_BACKUP;
+        save(config);
+        return config;
+    }
+
+    _source = CONFIG_FROM_DEFAULTS;
+    config = SystemConfig();
+    if (!hasJson)
     {
         Serial.println("⚠️ Config não encontrada, criando padrão...");
         // Se não existir, salva uma padrão e retorna ela
@@ -25,54 +59,131 @@ SystemConfig ConfigManager::load()
         config.wifiSsid = "EnergyMeter_AP";
         config.apModeForce = true;
         config.interval = 60;
+        normalizeBuses(config);
         save(config);
         return config;
     }
 
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, file);
-    file.close();
+    // JSON corrompido e sem cópia boa: fica o arquivo (para diagnóstico) e valem os padrões
+    normalizeBuses(config);
+    return config; // Retorna vazia/default
+}
+
+bool ConfigManager::parseFile(const char *path, SystemConfig &config)
+{
+    if (!LittleFS.exists(path))
+        return false;
+    File file = LittleFS.open(path, "r");
+    if (!file)
+        return false;
 
+    FileJsonInput in(file);
+    JsonDocument doc;
+    DeserializationError error = readHeader(in, doc);
     if (error)
     {
+        file.close();
         Serial.print("❌ Erro ao ler JSON: ");
         Serial.println(error.c_str());
-        return config; // Retorna vazia/default
+        return false;
     }
 
-    return deserialize(doc);
+    SystemConfig c = deserialize(doc);
+    bool ok = in.rewind() && readMeters(in, c.meters) >= 0;
+    file.close();
+    if (!ok)
+    {
+        Serial.println("❌ Erro ao ler JSON: lista de medidores inválida");
+        return false;
+    }
+
+    normalizeBuses(c);
+    config = c;
+    return true;
 }
 
-bool ConfigManager::save(const SystemConfig &config)
+DeserializationError ConfigManager::readHeader(JsonInput &in, JsonDocument &doc)
 {
-    JsonDocument doc;
-    serialize(config, doc);
+    JsonDocument filter;
+    filter["wifi"] = true;
+    filter["mqtt"] = true;
+    filter["buses"] = true;
+    return deserializeJson(doc, in, DeserializationOption::Filter(filter));
+}
+
+int ConfigManager::readMeters(JsonInput &in, std::vector<MeterConfig> &meters)
+{
+    if (!JsonScan::seekKey(in, "meters"))
+        return 0;
 
-    File file = LittleFS.open(CONFIG_FILE, "w");
+    meters.clear();
+    JsonDocument doc; // Reaproveitado: cada deserializeJson limpa o anterior
+    int more = JsonScan::enterArray(in);
+    while (more == 1)
+    {
+        if (deserializeJson(doc, in) || !doc.is<JsonObjectConst>())
+            return -1;
+        meters.push_back(parseMeter(doc.as<JsonObjectConst>()));
+        more = JsonScan::nextElement(in);
+    }
+    return more < 0 ? -1 : 1;
+}
+
+bool ConfigManager::save(const SystemConfig &config)
+{
+    // Grava num temporário e troca de uma vez: queda de energia aqui não corrompe o atual
+    File file = AtomicFile::begin(CONFIG_FILE);
     if (!file)
     {
         Serial.println("❌ Falha ao abrir arquivo para escrita");
         return false;
     }
 
-    if (serializeJson(doc, file) == 0)
+    // Uma parte por vez direto no arquivo (sem o documento inteiro na RAM)
+    for (size_t part = 0; part < partCount(config); part++)
     {
-        Serial.println("❌ Falha ao gravar JSON");
-        file.close();
-        return false;
+        if (writePart(config, part, file) == 0)
+        {
+            Serial.println("❌ Falha ao gravar JSON");
+            AtomicFile::abort(file, CONFIG_FILE);
+            return false;
+        }
     }
 
-    file.close();
+    if (!AtomicFile::commit(file, CONFIG_FILE))
+        return false;
+
+    // Depois do JSON: se cair entre os dois, o snapshot antigo não bate com o
+    // CRC do JSON novo e o próximo boot lê o JSON
+    uint32_t jsonCrc = 0;
+    AtomicFile::crc(CONFIG_FILE, jsonCrc);
+    if (!ConfigSnapshot::write(SNAPSHOT_FILE, config, jsonCrc))
+        Serial.println("⚠️ Falha ao gravar config.bin (o boot continua lendo o JSON)");
+
     Serial.println("✅ Configuração salva!");
     return true;
 }
 
 void ConfigManager::reset()
 {
-    if (LittleFS.exists(CONFIG_FILE))
+    // Inclui as cópias .bak: senão o próximo boot "restauraria" a config apagada
+    AtomicFile::removeAll(CONFIG_FILE);
+    AtomicFile::removeAll(SNAPSHOT_FILE);
+    Serial.println("♻️ Configurações resetadas (arquivo deletado)");
+}
+
+const char *ConfigManager::sourceName(ConfigSource source)
+{
+    switch (source)
     {
-        LittleFS.remove(CONFIG_FILE);
-        Serial.println("♻️ Configurações resetadas (arquivo deletado)");
+    case CONFIG_FROM_SNAPSHOT:
+        return "config.bin";
+    case CONFIG_FROM_JSON:
+        return "config.json";
+    case CONFIG_FROM_BACKUP:
+        return "backup";
+    default:
+        return "padrão";
     }
 }
 
@@ -92,27 +203,96 @@ SystemConfig ConfigManager::deserialize(const JsonDocument &doc)
     c.mqttPort = doc["mqtt"]["port"] | 1883;
     c.deviceId = doc["mqtt"]["device_id"] | "esp32_meter";
     c.interval = doc["mqtt"]["interval"] | 300;
+    c.samplePeriod = doc["mqtt"]["sample_period"] | 0;
+    c.payloadFormat = strcmp(doc["mqtt"]["format"] | "json", "msgpack") == 0 ? PAYLOAD_MSGPACK : PAYLOAD_JSON;
+    c.queueOverflow = overflowFromName(doc["mqtt"]["overflow"] | "spill");
+
+    parseBuses(doc["buses"].as<JsonArrayConst>(), c);
 
     JsonArrayConst meters = doc["meters"].as<JsonArrayConst>();
 
     for (JsonObjectConst m : meters)
     {
-        MeterConfig mc;
-        mc.id = m["id"];
-        mc.channelIndex = m["channel_index"] | m["id"];
-        mc.modbusId = m["modbus_id"];
-        mc.name = m["name"].as<String>();
-        c.meters.push_back(mc);
+        c.meters.push_back(parseMeter(m));
     }
 
+    normalizeBuses(c);
     return c;
 }
 
+MeterConfig ConfigManager::parseMeter(JsonObjectConst m)
+{
+    MeterConfig mc;
+    mc.id = m["id"];
+    mc.channelIndex = m["channel_index"] | m["id"];
+    mc.modbusId = m["modbus_id"];
+    mc.model = MeterProfiles::fromName(m["model"] | "dds238");
+    mc.periodSec = m["period"] | 0;
+    mc.bus = m["bus"] | 0;
+
+    JsonObjectConst db = m["deadband"];
+    mc.deadband.voltage = db["voltage"] | 0.0f;
+    mc.deadband.current = db["current"] | 0.0f;
+    mc.deadband.power = db["power"] | 0.0f;
+    mc.deadband.energy = db["energy"] | 0.0f;
+    mc.deadband.percent = db["percent"] | 0.0f;
+    mc.deadband.heartbeatSec = db["heartbeat"] | 0;
+    mc.name = m["name"].as<String>();
+    return mc;
+}
+
+void ConfigManager::parseBuses(JsonArrayConst buses, SystemConfig &config)
+{
+    config.buses.clear();
+    for (JsonObjectConst b : buses)
+    {
+        if (config.buses.size() >= MAX_BUSES)
+            break;
+
+        BusConfig bc; // Campos ausentes ficam com o padrão (Serial2, 16/17/4, 9600)
+        bc.uart = b["uart"] | bc.uart;
+        bc.rxPin = b["rx"] | bc.rxPin;
+        bc.txPin = b["tx"] | bc.txPin;
+        bc.dePin = b["de"] | bc.dePin;
+        bc.baud = b["baud"] | bc.baud;
+        bc.parity = parityFromName(b["parity"] | "none");
+        config.buses.push_back(bc);
+    }
+}
+
+void ConfigManager::normalizeBuses(SystemConfig &config)
+{
+    // Configs antigas não têm "buses": um barramento com os pinos de sempre
+    if (config.buses.empty())
+        config.buses.push_back(BusConfig());
+
+    for (auto &m : config.meters)
+    {
+        if (m.bus >= config.buses.size())
+        {
+            Serial.printf("⚠️ Medidor %d aponta para barramento %d inexistente, usando 0\n", m.id, m.bus);
+            m.bus = 0;
+        }
+    }
+}
+
 void ConfigManager::serialize(const SystemConfig &config, JsonDocument &doc)
 {
-    // WiFi
+    serializeHeader(config, doc, false);
+
+    // Meters Array
+    JsonArray meters = doc["meters"].to<JsonArray>();
+    for (const auto &m : config.meters)
+    {
+        serializeMeter(m, meters.add<JsonObject>());
+    }
+}
+
+void ConfigManager::serializeHeader(const SystemConfig &config, JsonDocument &doc, bool forApi)
+{
+    // WiFi (a senha não volta para o navegador)
     doc["wifi"]["ssid"] = config.wifiSsid;
-    doc["wifi"]["pass"] = config.wifiPass;
+    if (!forApi) doc["wifi"]["pass"] = config.wifiPass;
     doc["wifi"]["ap_mode"] = config.apModeForce;
 
     // MQTT
@@ -120,15 +300,108 @@ void ConfigManager::serialize(const SystemConfig &config, JsonDocument &doc)
     doc["mqtt"]["port"] = config.mqttPort;
     doc["mqtt"]["device_id"] = config.deviceId;
     doc["mqtt"]["interval"] = config.interval;
+    if (config.samplePeriod || forApi) doc["mqtt"]["sample_period"] = config.samplePeriod;
+    doc["mqtt"]["format"] = config.payloadFormat == PAYLOAD_MSGPACK ? "msgpack" : "json";
+    if (config.queueOverflow != RING_SPILL || forApi) doc["mqtt"]["overflow"] = overflowName(config.queueOverflow);
 
-    // Meters Array
-    JsonArray meters = doc["meters"].to<JsonArray>();
-    for (const auto &m : config.meters)
+    // Barramentos RS485
+    JsonArray buses = doc["buses"].to<JsonArray>();
+    for (const auto &b : config.buses)
+    {
+        JsonObject bObj = buses.add<JsonObject>();
+        bObj["uart"] = b.uart;
+        bObj["rx"] = b.rxPin;
+        bObj["tx"] = b.txPin;
+        bObj["de"] = b.dePin;
+        bObj["baud"] = b.baud;
+        if (b.parity != PARITY_NONE || forApi) bObj["parity"] = parityName(b.parity);
+    }
+
+    // O device id é o serial do hardware (o main preenche no boot)
+    if (forApi) doc["system"]["serial_id"] = config.deviceId;
+}
+
+void ConfigManager::serializeMeter(const MeterConfig &m, JsonObject mObj)
+{
+    mObj["id"] = m.id;
+    mObj["channel_index"] = m.channelIndex;
+    mObj["modbus_id"] = m.modbusId;
+    mObj["model"] = MeterProfiles::name(m.model);
+    if (m.periodSec) mObj["period"] = m.periodSec;
+    if (m.bus) mObj["bus"] = m.bus;
+    if (m.deadband.enabled())
+    {
+        JsonObject db = mObj["deadband"].to<JsonObject>();
+        db["voltage"] = m.deadband.voltage;
+        db["current"] = m.deadband.current;
+        db["power"] = m.deadband.power;
+        db["energy"] = m.deadband.energy;
+        db["percent"] = m.deadband.percent;
+        db["heartbeat"] = m.deadband.heartbeatSec;
+    }
+    mObj["name"] = m.name;
+}
+
+size_t ConfigManager::writePart(const SystemConfig &config, size_t part, Print &out, bool forApi)
+{
+    JsonDocument doc;
+    size_t n = 0;
+
+    if (part == 0)
     {
-        JsonObject mObj = meters.add<JsonObject>();
-        mObj["id"] = m.id;
-        mObj["channel_index"] = m.channelIndex;
-        mObj["modbus_id"] = m.modbusId;
-        mObj["name"] = m.name;
+        // Membros do cabeçalho um a um, deixando o objeto aberto para o "meters"
+        serializeHeader(config, doc, forApi);
+        char sep = '{';
+        for (JsonPairConst kv : doc.as<JsonObjectConst>())
+        {
+            n += out.write((uint8_t)sep);
+            n += out.write((uint8_t)'"');
+            n += out.write((const uint8_t *)kv.key().c_str(), kv.key().size());
+            n += out.write((const uint8_t *)"\":", 2);
+            n += serializeJson(kv.value(), out);
+            sep = ',';
+        }
+        n += out.write((const uint8_t *)",\"meters\":[", 11);
+        return n;
     }
-}
\ No newline at end of file
+
+    if (part <= config.meters.size())
+    {
+        if (part > 1)
+            n += out.write((uint8_t)',');
+        serializeMeter(config.meters[part - 1], doc.to<JsonObject>());
+        return n + serializeJson(doc, out);
+    }
+
+    if (part == config.meters.size() + 1)
+        return out.write((const uint8_t *)"]}", 2);
+    return 0;
+}
+
+RingOverflow ConfigManager::overflowFromName(const char *name) {
+    if (name && strcmp(name, "drop_oldest") == 0) return RING_DROP_OLDEST;
+    if (name && strcmp(name, "drop_newest") == 0) return RING_DROP_NEWEST;
+    return RING_SPILL;
+}
+
+const char *ConfigManager::overflowName(RingOverflow policy) {
+    switch (policy) {
+        case RING_DROP_OLDEST: return "drop_oldest";
+        case RING_DROP_NEWEST: return "drop_newest";
+        default: return "spill";
+    }
+}
+
+SerialParity ConfigManager::parityFromName(const char *name) {
+    if (name && strcmp(name, "even") == 0) return PARITY_EVEN;
+    if (name && strcmp(name, "odd") == 0) return PARITY_ODD;
+    return PARITY_NONE;
+}
+
+const char *ConfigManager::parityName(SerialParity parity) {
+    switch (parity) {
+        case PARITY_EVEN: return "even";
+        case PARITY_ODD: return "odd";
+        default: return "none";
+    }
+}
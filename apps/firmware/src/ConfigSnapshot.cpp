@@ -0,0 +1,215 @@
+#include "ConfigSnapshot.h"
+#include "AtomicFile.h"
+#include "Checksum.h"
+
+namespace {
+
+// Um config com 247 medidores por barramento fica bem abaixo disso; acima é lixo
+const uint32_t SNAPSHOT_MAX_BYTES = 64 * 1024;
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t payloadLen;
+    uint32_t sourceCrc;
+    uint32_t crc;       // Cabeçalho até aqui + payload
+};
+
+uint32_t snapshotCrc(const SnapshotHeader &h, const uint8_t *payload) {
+    uint32_t c = crc32(&h, offsetof(SnapshotHeader, crc));
+    return crc32(payload, h.payloadLen, c);
+}
+
+// Campos na ordem de gravação, em bytes nativos (o arquivo só é lido pelo
+// mesmo firmware que o gravou)
+class Writer {
+public:
+    explicit Writer(std::vector<uint8_t> &out) : _out(out) {}
+
+    template <typename T>
+    void put(const T &v) {
+        const uint8_t *p = (const uint8_t *)&v;
+        _out.insert(_out.end(), p, p + sizeof(T));
+    }
+
+    void putString(const String &s) {
+        uint16_t len = s.length();
+        put(len);
+        _out.insert(_out.end(), (const uint8_t *)s.c_str(), (const uint8_t *)s.c_str() + len);
+    }
+
+private:
+    std::vector<uint8_t> &_out;
+};
+
+class Reader {
+public:
+    Reader(const uint8_t *data, size_t len) : _p(data), _end(data + len) {}
+
+    template <typename T>
+    bool get(T &v) {
+        if ((size_t)(_end - _p) < sizeof(T)) return false;
+        memcpy(&v, _p, sizeof(T));
+        _p += sizeof(T);
+        return true;
+    }
+
+    bool getString(String &s) {
+        uint16_t len;
+        if (!get(len) || (size_t)(_end - _p) < len) return false;
+        s = String();
+        s.reserve(len);
+        for (uint16_t i = 0; i < len; i++) s += (char)_p[i];
+        _p += len;
+        return true;
+    }
+
+    bool done() const { return _p == _end; }
+
+private:
+    const uint8_t *_p;
+    const uint8_t *_end;
+};
+
+} // namespace
+
+void ConfigSnapshot::encode(const SystemConfig &config, uint32_t sourceCrc, std::vector<uint8_t> &out) {
+    out.clear();
+    out.resize(sizeof(SnapshotHeader));
+    Writer w(out);
+
+    w.putString(config.wifiSsid);
+    w.putString(config.wifiPass);
+    w.put((uint8_t)config.apModeForce);
+
+    w.putString(config.mqttServer);
+    w.put((int32_t)config.mqttPort);
+    w.putString(config.deviceId);
+    w.put((int32_t)config.interval);
+    w.put(config.samplePeriod);
+    w.put((uint8_t)config.payloadFormat);
+    w.put((uint8_t)config.queueOverflow);
+
+    w.put((uint8_t)config.buses.size());
+    for (const auto &b : config.buses) {
+        w.put(b.uart);
+        w.put(b.rxPin);
+        w.put(b.txPin);
+        w.put(b.dePin);
+        w.put(b.baud);
+        w.put((uint8_t)b.parity);
+    }
+
+    w.put((uint16_t)config.meters.size());
+    for (const auto &m : config.meters) {
+        w.put(m.id);
+        w.put(m.channelIndex);
+        w.put(m.modbusId);
+        w.put((uint8_t)m.model);
+        w.put(m.periodSec);
+        w.put(m.bus);
+        w.put(m.deadband.voltage);
+        w.put(m.deadband.current);
+        w.put(m.deadband.power);
+        w.put(m.deadband.energy);
+        w.put(m.deadband.percent);
+        w.put(m.deadband.heartbeatSec);
+        w.putString(m.name);
+    }
+
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = CONFIG_SNAPSHOT_MAGIC;
+    h.version = CONFIG_SNAPSHOT_VERSION;
+    h.payloadLen = out.size() - sizeof(SnapshotHeader);
+    h.sourceCrc = sourceCrc;
+    h.crc = snapshotCrc(h, out.data() + sizeof(SnapshotHeader));
+    memcpy(out.data(), &h, sizeof(h));
+}
+
+bool ConfigSnapshot::decode(const uint8_t *data, size_t len, SystemConfig &config, uint32_t &sourceCrc) {
+    SnapshotHeader h;
+    if (len < sizeof(h)) return false;
+    memcpy(&h, data, sizeof(h));
+    if (h.magic != CONFIG_SNAPSHOT_MAGIC || h.version != CONFIG_SNAPSHOT_VERSION) return false;
+    if (h.payloadLen != len - sizeof(h)) return false;
+    if (h.crc != snapshotCrc(h, data + sizeof(h))) return false;
+
+    // Monta numa cópia: payload inconsistente não deixa config pela metade
+    SystemConfig c;
+    Reader r(data + sizeof(h), h.payloadLen);
+    uint8_t apMode, format, overflow, busCount;
+    int32_t port, interval;
+    uint16_t meterCount;
+
+    bool ok = r.getString(c.wifiSsid) && r.getString(c.wifiPass) && r.get(apMode) &&
+              r.getString(c.mqttServer) && r.get(port) && r.getString(c.deviceId) &&
+              r.get(interval) && r.get(c.samplePeriod) && r.get(format) && r.get(overflow) &&
+              r.get(busCount);
+    if (!ok || busCount == 0 || busCount > MAX_BUSES || format > PAYLOAD_MSGPACK || overflow > RING_SPILL) return false;
+
+    c.apModeForce = apMode != 0;
+    c.mqttPort = port;
+    c.interval = interval;
+    c.payloadFormat = (PayloadFormat)format;
+    c.queueOverflow = (RingOverflow)overflow;
+
+    c.buses.resize(busCount);
+    for (auto &b : c.buses) {
+        uint8_t parity;
+        if (!(r.get(b.uart) && r.get(b.rxPin) && r.get(b.txPin) && r.get(b.dePin) && r.get(b.baud) &&
+              r.get(parity)) || parity > PARITY_ODD) return false;
+        b.parity = (SerialParity)parity;
+    }
+
+    if (!r.get(meterCount)) return false;
+    c.meters.reserve(meterCount);
+    for (uint16_t i = 0; i < meterCount; i++) {
+        MeterConfig m;
+        uint8_t model;
+        ok = r.get(m.id) && r.get(m.channelIndex) && r.get(m.modbusId) && r.get(model) &&
+             r.get(m.periodSec) && r.get(m.bus) &&
+             r.get(m.deadband.voltage) && r.get(m.deadband.current) && r.get(m.deadband.power) &&
+             r.get(m.deadband.energy) && r.get(m.deadband.percent) && r.get(m.deadband.heartbeatSec) &&
+             r.getString(m.name);
+        if (!ok || model >= METER_MODEL_COUNT || m.bus >= busCount) return false;
+        m.model = (MeterModel)model;
+        c.meters.push_back(m);
+    }
+    if (!r.done()) return false;
+
+    sourceCrc = h.sourceCrc;
+    config = c;
+    return true;
+}
+
+bool ConfigSnapshot::read(const char *path, SystemConfig &config, uint32_t &sourceCrc) {
+    if (!LittleFS.exists(path)) return false;
+    File f = LittleFS.open(path, "r");
+    if (!f) return false;
+
+    size_t size = f.size();
+    if (size < sizeof(SnapshotHeader) || size > SNAPSHOT_MAX_BYTES) {
+        f.close();
+        return false;
+    }
+
+    std::vector<uint8_t> buf(size);
+    bool complete = f.read(buf.data(), size) == size;
+    f.close();
+    return complete && decode(buf.data(), size, config, sourceCrc);
+}
+
+bool ConfigSnapshot::write(const char *path, const SystemConfig &config, uint32_t sourceCrc) {
+    std::vector<uint8_t> buf;
+    encode(config, sourceCrc, buf);
+
+    File f = AtomicFile::begin(path);
+    if (!f) return false;
+    if (f.write(buf.data(), buf.size()) != buf.size()) {
+        AtomicFile::abort(f, path);
+        return false;
+    }
+    return AtomicFile::commit(f, path);
+}
@@ -0,0 +1,80 @@
+#include "ConfigStore.h"
+
+namespace {
+
+bool sameDeadband(const Deadband &a, const Deadband &b) {
+    return a.voltage == b.voltage && a.current == b.current && a.power == b.power &&
+           a.energy == b.energy && a.percent == b.percent && a.heartbeatSec == b.heartbeatSec;
+}
+
+bool sameMeter(const MeterConfig &a, const MeterConfig &b) {
+    return a.id == b.id && a.channelIndex == b.channelIndex && a.modbusId == b.modbusId &&
+           a.model == b.model && a.periodSec == b.periodSec && a.bus == b.bus &&
+           sameDeadband(a.deadband, b.deadband) && a.name == b.name;
+}
+
+bool sameBus(const BusConfig &a, const BusConfig &b) {
+    return a.uart == b.uart && a.rxPin == b.rxPin && a.txPin == b.txPin &&
+           a.dePin == b.dePin && a.baud == b.baud && a.parity == b.parity;
+}
+
+} // namespace
+
+bool ConfigStore::sameMeters(const std::vector<MeterConfig> &a, const std::vector<MeterConfig> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!sameMeter(a[i], b[i])) return false;
+    }
+    return true;
+}
+
+void ConfigStore::matchMeters(const std::vector<MeterConfig> &before, const std::vector<MeterConfig> &after,
+                              std::vector<int> &from) {
+    from.assign(after.size(), -1);
+    std::vector<bool> taken(before.size(), false);
+    for (size_t i = 0; i < after.size(); i++) {
+        for (size_t j = 0; j < before.size(); j++) {
+            // Outro modelo no mesmo endereço lê outros registradores: recomeça
+            if (taken[j] || before[j].modbusId != after[i].modbusId || before[j].model != after[i].model) continue;
+            from[i] = j;
+            taken[j] = true;
+            break;
+        }
+    }
+}
+
+uint8_t ConfigStore::diff(const SystemConfig &a, const SystemConfig &b) {
+    uint8_t changes = 0;
+
+    if (a.wifiSsid != b.wifiSsid || a.wifiPass != b.wifiPass || a.apModeForce != b.apModeForce)
+        changes |= CONFIG_CHANGED_WIFI;
+
+    if (a.mqttServer != b.mqttServer || a.mqttPort != b.mqttPort || a.deviceId != b.deviceId)
+        changes |= CONFIG_CHANGED_MQTT;
+
+    if (a.interval != b.interval || a.samplePeriod != b.samplePeriod || !sameMeters(a.meters, b.meters))
+        changes |= CONFIG_CHANGED_POLLING;
+
+    if (a.payloadFormat != b.payloadFormat)
+        changes |= CONFIG_CHANGED_PAYLOAD;
+
+    // A task, a UART e a fila de cada barramento são criadas uma vez no boot
+    bool sameBuses = a.buses.size() == b.buses.size() && a.queueOverflow == b.queueOverflow;
+    for (size_t i = 0; sameBuses && i < a.buses.size(); i++) sameBuses = sameBus(a.buses[i], b.buses[i]);
+    if (!sameBuses)
+        changes |= CONFIG_CHANGED_HARDWARE;
+
+    return changes;
+}
+
+uint8_t ConfigStore::publish(const SystemConfig &next) {
+    ConfigRef fresh = std::make_shared<const SystemConfig>(next);
+    ConfigRef previous = get();
+    uint8_t changes = previous ? diff(*previous, *fresh) : 0xFF;
+
+    std::atomic_store(&_current, fresh);
+    _version.fetch_add(1, std::memory_order_release);
+
+    if (_listener) _listener(changes, _listenerCtx);
+    return changes;
+}
@@ -0,0 +1,59 @@
+#include "DeviceKey.h"
+#include <stdio.h>
+
+#include "mbedtls/pk.h"
+#include "mbedtls/ecp.h"
+#include "mbedtls/rsa.h"
+#include "mbedtls/x509_csr.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/error.h"
+
+int DeviceKey::generate(DeviceKeyType type, const char *deviceId, DeviceKeyPem &out) {
+    char subject[DEVICE_SUBJECT_MAX];
+    int n = snprintf(subject, sizeof(subject), "CN=%s,O=EnergyMe IoT", deviceId);
+    if (n < 0 || (size_t)n >= sizeof(subject)) return MBEDTLS_ERR_X509_BAD_INPUT_DATA;
+
+    mbedtls_pk_context key;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    mbedtls_entropy_context entropy;
+    mbedtls_x509write_csr req;
+
+    mbedtls_pk_init(&key);
+    mbedtls_ctr_drbg_init(&ctr_drbg);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_x509write_csr_init(&req);
+
+    const char *pers = "energymeter_gen";
+    int ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy, (const unsigned char *)pers, strlen(pers));
+
+    if (ret == 0) {
+        if (type == KEY_RSA_2048) {
+            ret = mbedtls_pk_setup(&key, mbedtls_pk_info_from_type(MBEDTLS_PK_RSA));
+            if (ret == 0) ret = mbedtls_rsa_gen_key(mbedtls_pk_rsa(key), mbedtls_ctr_drbg_random, &ctr_drbg, 2048, 65537);
+        } else if (type == KEY_ECDSA_P256) {
+            ret = mbedtls_pk_setup(&key, mbedtls_pk_info_from_type(MBEDTLS_PK_ECKEY));
+            if (ret == 0) ret = mbedtls_ecp_gen_key(MBEDTLS_ECP_DP_SECP256R1, mbedtls_pk_ec(key), mbedtls_ctr_drbg_random, &ctr_drbg);
+        } else {
+            ret = MBEDTLS_ERR_PK_FEATURE_UNAVAILABLE;
+        }
+    }
+
+    // Os dois PEM saem terminados em '\0'
+    if (ret == 0) ret = mbedtls_pk_write_key_pem(&key, (unsigned char *)out.key, sizeof(out.key));
+
+    if (ret == 0) {
+        ret = mbedtls_x509write_csr_set_subject_name(&req, subject);
+    }
+    if (ret == 0) {
+        mbedtls_x509write_csr_set_key(&req, &key);
+        mbedtls_x509write_csr_set_md_alg(&req, MBEDTLS_MD_SHA256);
+        ret = mbedtls_x509write_csr_pem(&req, (unsigned char *)out.csr, sizeof(out.csr), mbedtls_ctr_drbg_random, &ctr_drbg);
+    }
+
+    mbedtls_x509write_csr_free(&req);
+    mbedtls_pk_free(&key);
+    mbedtls_ctr_drbg_free(&ctr_drbg);
+    mbedtls_entropy_free(&entropy);
+    return ret;
+}
@@ -0,0 +1,63 @@
+#include "ExceptionFilter.h"
+#include <math.h>
+
+void ExceptionFilter::reset(size_t channels) {
+    LastReport empty;
+    memset(&empty, 0, sizeof(empty));
+    _last.assign(channels, empty);
+}
+
+void ExceptionFilter::remap(const std::vector<int> &from) {
+    LastReport empty;
+    memset(&empty, 0, sizeof(empty));
+    std::vector<LastReport> last(from.size(), empty);
+    for (size_t i = 0; i < from.size(); i++) {
+        if (from[i] >= 0 && (size_t)from[i] < _last.size()) last[i] = _last[from[i]];
+    }
+    _last.swap(last);
+}
+
+// |atual - referência| passou da banda (maior entre absoluto e percentual)?
+static bool outside(float value, float reference, float absolute, float percent) {
+    float band = fabsf(reference) * percent / 100.0f;
+    if (absolute > band) band = absolute;
+    return band > 0 && fabsf(value - reference) > band;
+}
+
+bool ExceptionFilter::exceeds(const Deadband &db, const MeterReading &last, const MeterReading &r) {
+    return outside(r.voltage, last.voltage, db.voltage, db.percent) ||
+           outside(r.current, last.current, db.current, db.percent) ||
+           outside(r.power, last.power, db.power, db.percent) ||
+           outside(r.totalKwh, last.totalKwh, db.energy, 0);
+}
+
+bool ExceptionFilter::shouldReport(size_t i, const Deadband &db, const MeterReading &r, uint32_t nowMs) {
+    if (!db.enabled() || i >= _last.size()) return true;
+
+    LastReport &last = _last[i];
+    uint32_t heartbeatMs = (db.heartbeatSec ? db.heartbeatSec : DEADBAND_DEFAULT_HEARTBEAT_S) * 1000UL;
+
+    bool report = !last.valid || nowMs - last.atMs >= heartbeatMs;
+    if (!report) {
+        MeterReading ref;
+        memset(&ref, 0, sizeof(ref));
+        ref.voltage = last.voltage;
+        ref.current = last.current;
+        ref.power = last.power;
+        ref.totalKwh = last.totalKwh;
+        report = exceeds(db, ref, r);
+    }
+
+    if (!report) {
+        _suppressed++;
+        return false;
+    }
+
+    last.voltage = r.voltage;
+    last.current = r.current;
+    last.power = r.power;
+    last.totalKwh = r.totalKwh;
+    last.atMs = nowMs;
+    last.valid = true;
+    return true;
+}
@@ -0,0 +1,91 @@
+#include "JsonInput.h"
+
+size_t JsonInput::readBytes(char *buf, size_t len) {
+    size_t n = 0;
+    int c;
+    while (n < len && (c = read()) >= 0) buf[n++] = (char)c;
+    return n;
+}
+
+size_t BufferJsonInput::readBytes(char *buf, size_t len) {
+    size_t n = _len - _pos;
+    if (n > len) n = len;
+    memcpy(buf, _data + _pos, n);
+    _pos += n;
+    return n;
+}
+
+int JsonScan::skipSpace(JsonInput &in) {
+    int c;
+    while ((c = in.peek()) == ' ' || c == '\n' || c == '\r' || c == '\t') in.read();
+    return c;
+}
+
+bool JsonScan::seekKey(JsonInput &in, const char *key) {
+    size_t keyLen = strlen(key);
+    int depth = 0;
+    int c;
+
+    while ((c = in.read()) >= 0) {
+        switch (c) {
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (--depth <= 0) return false; // Fim do objeto de fora
+            break;
+        case '"': {
+            // Compara enquanto lê; escape nunca casa (nossas chaves não têm)
+            size_t matched = 0;
+            bool same = true;
+            bool escaped = false;
+            while ((c = in.read()) >= 0) {
+                if (escaped) {
+                    escaped = false;
+                } else if (c == '\\') {
+                    escaped = true;
+                    same = false;
+                } else if (c == '"') {
+                    break;
+                } else if (matched < keyLen && key[matched] == c) {
+                    matched++;
+                } else {
+                    same = false;
+                }
+            }
+            if (c < 0) return false;
+
+            // String no nível 1 seguida de ':' é chave (senão era valor)
+            if (depth == 1 && same && matched == keyLen && skipSpace(in) == ':') {
+                in.read();
+                return true;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+int JsonScan::enterArray(JsonInput &in) {
+    if (skipSpace(in) != '[') return -1;
+    in.read();
+    int c = skipSpace(in);
+    if (c == ']') {
+        in.read();
+        return 0;
+    }
+    return c < 0 ? -1 : 1;
+}
+
+int JsonScan::nextElement(JsonInput &in) {
+    int c = skipSpace(in);
+    in.read();
+    if (c == ']') return 0;
+    if (c != ',') return -1;
+    return skipSpace(in) < 0 ? -1 : 1;
+}
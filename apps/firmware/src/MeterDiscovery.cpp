@@ -0,0 +1,99 @@
+#include "MeterDiscovery.h"
+#include <math.h>
+
+static bool sameLine(const SerialLine &a, const SerialLine &b) {
+    return a.baud == b.baud && a.parity == b.parity;
+}
+
+size_t MeterDiscovery::lines(const SerialLine &bus, bool allLines, SerialLine *out) {
+    size_t n = 0;
+    out[n++] = bus;
+    if (!allLines) return n;
+
+    for (const SerialLine &line : DISCOVERY_LINES) {
+        if (!sameLine(line, bus)) out[n++] = line;
+    }
+    return n;
+}
+
+bool MeterDiscovery::plausible(const float v[Q_COUNT]) {
+    for (uint8_t q = 0; q < Q_COUNT; q++) {
+        if (!isfinite(v[q])) return false;
+    }
+    // O medidor se alimenta da rede que mede: a tensão nunca é zero
+    return v[Q_VOLTAGE] >= 50.0f && v[Q_VOLTAGE] <= 500.0f &&
+           fabsf(v[Q_CURRENT]) < 10000.0f && fabsf(v[Q_POWER]) < 1.0e7f &&
+           v[Q_ENERGY] >= 0.0f && v[Q_ENERGY] < 1.0e9f;
+}
+
+DiscoveryMerge MeterDiscovery::merge(SystemConfig &config, uint8_t bus, const std::vector<DiscoveredMeter> &found) {
+    DiscoveryMerge result;
+    if (bus >= config.buses.size()) return result;
+    BusConfig &busConfig = config.buses[bus];
+
+    // Linha com mais medidores identificados
+    SerialLine best = busConfig.line();
+    size_t bestCount = 0;
+    for (const DiscoveredMeter &d : found) {
+        if (d.model >= METER_MODEL_COUNT) continue;
+        size_t count = 0;
+        for (const DiscoveredMeter &o : found) {
+            if (o.model < METER_MODEL_COUNT && sameLine(o.line, d.line)) count++;
+        }
+        bool current = sameLine(d.line, busConfig.line());
+        if (count > bestCount || (count == bestCount && current)) {
+            best = d.line;
+            bestCount = count;
+        }
+    }
+
+    if (bestCount > 0 && !sameLine(best, busConfig.line())) {
+        busConfig.baud = best.baud;
+        busConfig.parity = best.parity;
+        result.lineChanged = true;
+    }
+
+    // IDs internos e canais novos depois dos maiores em uso
+    uint16_t nextId = 1, nextChannel = 1;
+    for (const MeterConfig &m : config.meters) {
+        if (m.id >= nextId) nextId = m.id + 1;
+        if (m.channelIndex >= nextChannel) nextChannel = m.channelIndex + 1;
+    }
+
+    for (const DiscoveredMeter &d : found) {
+        if (d.model >= METER_MODEL_COUNT || !sameLine(d.line, best)) {
+            result.skipped++;
+            continue;
+        }
+
+        MeterConfig *existing = NULL;
+        for (MeterConfig &m : config.meters) {
+            if (m.bus == bus && m.modbusId == d.modbusId) existing = &m;
+        }
+        if (existing) {
+            if (existing->model != d.model) {
+                existing->model = d.model;
+                result.updated++;
+            }
+            continue;
+        }
+
+        if (nextId > 0xFF || nextChannel > 0xFF) {
+            result.skipped++;
+            continue;
+        }
+        MeterConfig m;
+        m.id = nextId++;
+        m.channelIndex = nextChannel++;
+        m.modbusId = d.modbusId;
+        m.model = d.model;
+        m.periodSec = 0;
+        m.bus = bus;
+        char name[24];
+        snprintf(name, sizeof(name), "Medidor %u/%u", bus, d.modbusId);
+        m.name = name;
+        config.meters.push_back(m);
+        result.added++;
+    }
+    return result;
+}
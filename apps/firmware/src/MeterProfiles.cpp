@@ -0,0 +1,87 @@
+#include "MeterProfiles.h"
+
+MeterModel MeterProfiles::fromName(const char *name) {
+    if (name) {
+        for (uint8_t m = 0; m < METER_MODEL_COUNT; m++) {
+            if (strcmp(name, METER_PROFILES[m].name) == 0) return (MeterModel)m;
+        }
+    }
+    return METER_DDS238;
+}
+
+const char *MeterProfiles::name(MeterModel model) {
+    return METER_PROFILES[model < METER_MODEL_COUNT ? model : METER_DDS238].name;
+}
+
+// Planos de todos os modelos, montados na inicialização estática (antes do
+// setup() e de qualquer task): depois disso a tabela só é lida, então as
+// tasks dos barramentos (polling e descoberta) a consultam sem trava
+struct PlanTable {
+    ReadPlan plans[METER_MODEL_COUNT];
+};
+
+static PlanTable buildPlans() {
+    PlanTable table;
+    for (uint8_t m = 0; m < METER_MODEL_COUNT; m++) {
+        table.plans[m] = MeterProfiles::buildPlan(METER_PROFILES[m], PLAN_MAX_READ_REGS);
+    }
+    return table;
+}
+
+static const PlanTable PLANS = buildPlans();
+
+const ReadPlan &MeterProfiles::plan(MeterModel model) {
+    return PLANS.plans[model < METER_MODEL_COUNT ? model : METER_DDS238];
+}
+
+ReadPlan MeterProfiles::buildPlan(const MeterProfile &profile, uint8_t maxRegs) {
+    ReadPlan plan;
+    memset(&plan, 0, sizeof(plan));
+
+    // Ordena as grandezas por (função, endereço) — são só 4, insertion sort basta
+    uint8_t order[Q_COUNT];
+    for (uint8_t i = 0; i < Q_COUNT; i++) order[i] = i;
+    for (uint8_t i = 1; i < Q_COUNT; i++) {
+        for (uint8_t j = i; j > 0; j--) {
+            const RegisterField &a = profile.fields[order[j - 1]];
+            const RegisterField &b = profile.fields[order[j]];
+            if (a.function < b.function || (a.function == b.function && a.address <= b.address)) break;
+            uint8_t t = order[j]; order[j] = order[j - 1]; order[j - 1] = t;
+        }
+    }
+
+    // Guloso: estende o bloco atual enquanto a faixa inteira couber em maxRegs.
+    // Ler alguns registradores a mais no meio custa ~2 ms cada a 9600 baud;
+    // uma transação extra custa o turnaround do escravo (dezenas de ms).
+    for (uint8_t i = 0; i < Q_COUNT; i++) {
+        const RegisterField &f = profile.fields[order[i]];
+        uint16_t end = f.address + width(f.type);
+
+        ReadBlock *cur = plan.blockCount ? &plan.blocks[plan.blockCount - 1] : NULL;
+        if (cur && cur->function == f.function && f.address >= cur->start && end - cur->start <= maxRegs) {
+            if (end - cur->start > cur->count) cur->count = end - cur->start;
+        } else {
+            cur = &plan.blocks[plan.blockCount++];
+            cur->function = f.function;
+            cur->start = f.address;
+            cur->count = width(f.type);
+        }
+        plan.fieldBlock[order[i]] = plan.blockCount - 1;
+    }
+
+    return plan;
+}
+
+float MeterProfiles::decode(const RegisterField &field, const uint16_t *regs) {
+    float raw = 0;
+    bool swapped = field.order == WORDS_CDAB;
+
+    switch (field.type) {
+        case REG_U16: raw = RegDecoder<REG_U16, WORDS_ABCD>::decode(regs); break;
+        case REG_S16: raw = RegDecoder<REG_S16, WORDS_ABCD>::decode(regs); break;
+        case REG_U32: raw = swapped ? RegDecoder<REG_U32, WORDS_CDAB>::decode(regs) : RegDecoder<REG_U32, WORDS_ABCD>::decode(regs); break;
+        case REG_S32: raw = swapped ? RegDecoder<REG_S32, WORDS_CDAB>::decode(regs) : RegDecoder<REG_S32, WORDS_ABCD>::decode(regs); break;
+        case REG_F32: raw = swapped ? RegDecoder<REG_F32, WORDS_CDAB>::decode(regs) : RegDecoder<REG_F32, WORDS_ABCD>::decode(regs); break;
+    }
+    return raw * field.scale;
+}
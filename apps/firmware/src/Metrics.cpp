@@ -0,0 +1,69 @@
+#include "Metrics.h"
+#include <stdarg.h>
+
+void LatencyHistogram::record(uint32_t us) {
+    uint32_t ms = (us + 500) / 1000;
+    uint8_t b = 0;
+    while (b < HIST_BUCKETS - 1 && us > HIST_BOUNDS_MS[b] * 1000UL) b++;
+    buckets[b]++;
+    sumMs += ms;
+    count++;
+}
+
+size_t BufferPrint::write(const uint8_t *data, size_t size) {
+    if (_len + size >= _capacity) {
+        _overflow = true;
+        size = _len + 1 < _capacity ? _capacity - 1 - _len : 0;
+    }
+    memcpy(_buf + _len, data, size);
+    _len += size;
+    if (_capacity) _buf[_len] = '\0';
+    return size;
+}
+
+void PromWriter::line(const char *fmt, ...) {
+    char buf[192];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n <= 0) return;
+    if (n >= (int)sizeof(buf)) n = sizeof(buf) - 1;
+    _out.write((const uint8_t *)buf, n);
+}
+
+void PromWriter::family(const char *name, const char *type, const char *help) {
+    line("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void PromWriter::sample(const char *name, const char *labels, uint32_t value) {
+    if (labels && *labels) line("%s{%s} %u\n", name, labels, (unsigned)value);
+    else line("%s %u\n", name, (unsigned)value);
+}
+
+void PromWriter::histogram(const char *name, const char *labels, const LatencyHistogram &h) {
+    const char *sep = labels && *labels ? "," : "";
+    if (!labels) labels = "";
+
+    // Snapshot do count antes dos buckets: com o escritor rodando, o +Inf
+    // nunca fica menor que a soma vista
+    uint32_t count = h.count;
+    uint32_t cumulative = 0;
+    for (uint8_t b = 0; b < HIST_BUCKETS - 1; b++) {
+        cumulative += h.buckets[b];
+        line("%s_bucket{%s%sle=\"%u.%03u\"} %u\n", name, labels, sep,
+             HIST_BOUNDS_MS[b] / 1000, HIST_BOUNDS_MS[b] % 1000, (unsigned)cumulative);
+    }
+    cumulative += h.buckets[HIST_BUCKETS - 1];
+    if (cumulative > count) count = cumulative;
+    line("%s_bucket{%s%sle=\"+Inf\"} %u\n", name, labels, sep, (unsigned)count);
+
+    uint32_t sumMs = h.sumMs;
+    if (*labels) {
+        line("%s_sum{%s} %u.%03u\n", name, labels, (unsigned)(sumMs / 1000), (unsigned)(sumMs % 1000));
+        line("%s_count{%s} %u\n", name, labels, (unsigned)count);
+    } else {
+        line("%s_sum %u.%03u\n", name, (unsigned)(sumMs / 1000), (unsigned)(sumMs % 1000));
+        line("%s_count %u\n", name, (unsigned)count);
+    }
+}
@@ -0,0 +1,216 @@
+#include "ModbusRtuMaster.h"
+
+RtuTiming RtuTiming::forBaud(uint32_t baud) {
+    RtuTiming t;
+    if (baud == 0) baud = 9600;
+    t.charUs = (11UL * 1000000UL + baud - 1) / baud;
+
+    // Acima de 19200 baud a norma fixa os silêncios (senão o mestre
+    // gastaria a CPU medindo intervalos de poucas dezenas de us)
+    if (baud > 19200) {
+        t.t15Us = 750;
+        t.t35Us = 1750;
+    } else {
+        t.t15Us = t.charUs * 3 / 2;
+        t.t35Us = t.charUs * 7 / 2;
+    }
+    return t;
+}
+
+void ModbusRtuMaster::begin(RtuPort *port, uint32_t baud) {
+    _port = port;
+    _timing = RtuTiming::forBaud(baud);
+    _state = IDLE;
+    _queued = 0;
+    _results = 0;
+    _resultHead = 0;
+    _checkT15 = port && port->exactByteTimes();
+    // Considera o barramento em silêncio desde já: a primeira requisição sai sem espera
+    _lastActivityUs = port ? port->nowUs() - _timing.t35Us : 0;
+}
+
+size_t ModbusRtuMaster::buildRequest(const RtuRequest &request, uint8_t *frame) {
+    frame[0] = request.slave;
+    frame[1] = request.function;
+    frame[2] = request.start >> 8;
+    frame[3] = request.start & 0xFF;
+    frame[4] = request.count >> 8;
+    frame[5] = request.count & 0xFF;
+    uint16_t crc = crc16Modbus(frame, 6);
+    frame[6] = crc & 0xFF;
+    frame[7] = crc >> 8;
+    return 8;
+}
+
+bool ModbusRtuMaster::submit(const RtuRequest &request) {
+    if (_queued >= RTU_MAX_QUEUE) return false;
+    if (request.slave == 0 || request.slave > 247) return false;
+    if (request.function != FC_HOLDING && request.function != FC_INPUT) return false;
+    if (request.count == 0 || request.count > MODBUS_MAX_READ_REGS) return false;
+
+    _queue[_queued++] = request;
+    return true;
+}
+
+size_t ModbusRtuMaster::cancel(uint32_t tag, uint32_t mask) {
+    size_t removed = 0;
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < _queued; i++) {
+        if ((_queue[i].tag & mask) == (tag & mask)) {
+            removed++;
+            continue;
+        }
+        _queue[kept++] = _queue[i];
+    }
+    _queued = kept;
+    return removed;
+}
+
+bool ModbusRtuMaster::nextResult(RtuResult &out) {
+    if (_results == 0) return false;
+    out = _resultRing[_resultHead];
+    _resultHead = (_resultHead + 1) % RTU_MAX_RESULTS;
+    _results--;
+    return true;
+}
+
+uint32_t ModbusRtuMaster::nextEventUs(uint32_t nowUs) const {
+    uint32_t deadline;
+    switch (_state) {
+        case WAIT_REPLY:
+            deadline = _deadlineUs;
+            break;
+        case RECEIVING:
+            deadline = _lastActivityUs + _timing.t35Us;
+            break;
+        default:
+            // Parado: só há prazo se tiver requisição esperando o silêncio de t3.5
+            if (_queued == 0 || _results >= RTU_MAX_RESULTS) return 0xFFFFFFFF;
+            deadline = _lastActivityUs + _timing.t35Us;
+            break;
+    }
+    return reached(deadline, nowUs) ? 0 : deadline - nowUs;
+}
+
+void ModbusRtuMaster::poll(uint32_t nowUs) {
+    if (!_port) return;
+
+    if (_state == IDLE) {
+        // Bytes fora de uma transação (ruído, outro mestre): descarta, mas
+        // conta como atividade para o t3.5 antes da próxima transmissão
+        uint8_t junk[16];
+        while (_port->receive(junk, sizeof(junk)) > 0) _lastActivityUs = nowUs;
+    } else {
+        size_t n = 0, got;
+        while (_rxLen + n < RTU_MAX_FRAME &&
+               (got = _port->receive(_rx + _rxLen + n, RTU_MAX_FRAME - _rxLen - n)) > 0) {
+            n += got;
+        }
+        if (n > 0) {
+            // O primeiro byte do lote começou a chegar n caracteres antes de agora;
+            // o silêncio antes dele é o que se compara com t1.5
+            uint32_t batchStart = nowUs - n * _timing.charUs;
+            if (_state == WAIT_REPLY) {
+                _state = RECEIVING;
+                _firstByteUs = batchStart;
+            } else if (_checkT15 && (int32_t)(batchStart - _lastActivityUs) > (int32_t)_timing.t15Us) {
+                _brokenFrame = true;
+            }
+            _rxLen += n;
+            _lastActivityUs = nowUs;
+        }
+    }
+
+    switch (_state) {
+        case WAIT_REPLY:
+            if (reached(_deadlineUs, nowUs)) complete(RTU_TIMEOUT, 0, nowUs);
+            break;
+        case RECEIVING:
+            // Fim pelo tamanho esperado (não precisa esperar o t3.5 para entregar)
+            // ou pelo silêncio de t3.5 (quadro menor que o esperado)
+            if (_rxLen >= expectedLength() || reached(_lastActivityUs + _timing.t35Us, nowUs)) finish(nowUs);
+            break;
+        default:
+            break;
+    }
+
+    // Próxima requisição: só com o barramento em silêncio há t3.5 e espaço para a resposta
+    if (_state == IDLE && _queued > 0 && _results < RTU_MAX_RESULTS &&
+        reached(_lastActivityUs + _timing.t35Us, nowUs)) {
+        transmit(nowUs);
+    }
+}
+
+void ModbusRtuMaster::transmit(uint32_t nowUs) {
+    _current = _queue[0];
+    for (uint8_t i = 1; i < _queued; i++) _queue[i - 1] = _queue[i];
+    _queued--;
+
+    uint8_t frame[8];
+    size_t len = buildRequest(_current, frame);
+    _port->send(frame, len);
+
+    // O timeout conta a partir do último bit transmitido
+    _txEndUs = nowUs + len * _timing.charUs;
+    _deadlineUs = _txEndUs + (_current.timeoutUs ? _current.timeoutUs : RTU_DEFAULT_TIMEOUT_US);
+    _lastActivityUs = _txEndUs;
+    _rxLen = 0;
+    _brokenFrame = false;
+    _state = WAIT_REPLY;
+}
+
+uint16_t ModbusRtuMaster::expectedLength() const {
+    // Exceção: endereço + (função | 0x80) + código + CRC
+    if (_rxLen >= 2 && (_rx[1] & 0x80)) return 5;
+    return 5 + 2 * _current.count;
+}
+
+void ModbusRtuMaster::finish(uint32_t nowUs) {
+    // Intervalo > t1.5 ou quadro que acabou (t3.5) antes do tamanho esperado
+    if (_brokenFrame || _rxLen < 5 || _rxLen < expectedLength()) {
+        complete(RTU_FRAME_ERROR, 0, nowUs);
+        return;
+    }
+
+    uint16_t crc = crc16Modbus(_rx, _rxLen - 2);
+    if (_rx[_rxLen - 2] != (crc & 0xFF) || _rx[_rxLen - 1] != (crc >> 8)) {
+        complete(RTU_CRC_ERROR, 0, nowUs);
+        return;
+    }
+
+    if (_rx[0] != _current.slave) {
+        complete(RTU_FRAME_ERROR, 0, nowUs);
+        return;
+    }
+    if (_rx[1] == (_current.function | 0x80)) {
+        complete(RTU_EXCEPTION, _rx[2], nowUs);
+        return;
+    }
+    if (_rx[1] != _current.function || _rx[2] != 2 * _current.count || _rxLen != 5 + 2 * _current.count) {
+        complete(RTU_FRAME_ERROR, 0, nowUs);
+        return;
+    }
+
+    // Registradores direto no slot da resposta (big-endian no fio)
+    RtuResult &slot = _resultRing[(_resultHead + _results) % RTU_MAX_RESULTS];
+    for (uint16_t i = 0; i < _current.count; i++) {
+        slot.regs[i] = ((uint16_t)_rx[3 + 2 * i] << 8) | _rx[4 + 2 * i];
+    }
+    complete(RTU_OK, 0, nowUs);
+}
+
+void ModbusRtuMaster::complete(RtuStatus status, uint8_t exceptionCode, uint32_t nowUs) {
+    // Só se transmite com espaço no anel, então o slot está sempre livre aqui
+    RtuResult &slot = _resultRing[(_resultHead + _results) % RTU_MAX_RESULTS];
+    slot.request = _current;
+    slot.status = status;
+    slot.exceptionCode = exceptionCode;
+    slot.latencyUs = nowUs - _txEndUs;
+    // Sem resposta, o tempo de reação é o timeout inteiro
+    slot.responseUs = status == RTU_TIMEOUT ? slot.latencyUs
+                    : ((int32_t)(_firstByteUs - _txEndUs) > 0 ? _firstByteUs - _txEndUs : 0);
+    _results++;
+
+    _rxLen = 0;
+    _state = IDLE;
+}
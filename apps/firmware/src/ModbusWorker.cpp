@@ -1,77 +1,285 @@
 #include "ModbusWorker.h"
+#include "WallClock.h"
 
-// Controle de fluxo do RS485 (Half-Duplex)
-// Precisamos de ponteiros globais/estáticos porque a lib ModbusMaster usa callbacks C
-int globalDePin = 4; 
+// Tag das requisições: slot do pipeline no byte 1, bloco do plano no byte 0
+#define SLOT_TAG(slot) ((uint32_t)(slot) << 8)
+#define SLOT_MASK 0xFF00
 
-void ModbusWorker::preTransmission() {
-    digitalWrite(globalDePin, HIGH); // Habilita TX
+void ModbusWorker::begin(RtuPort *port, uint32_t baud, size_t meterCount) {
+    _port = port;
+    _master.begin(port, baud);
+    memset(_slots, 0, sizeof(_slots));
+    _health.reset(meterCount);
+
+    const RtuTiming &t = _master.timing();
+    Serial.printf("🔌 Modbus RS485 Iniciado (%u baud, t3.5 = %u us)\n", (unsigned)baud, (unsigned)t.t35Us);
+}
+
+const char *ModbusWorker::statusName(RtuStatus status) {
+    switch (status) {
+        case RTU_TIMEOUT: return "timeout";
+        case RTU_CRC_ERROR: return "CRC";
+        case RTU_FRAME_ERROR: return "quadro";
+        case RTU_EXCEPTION: return "exceção";
+        default: return "ok";
+    }
 }
 
-void ModbusWorker::postTransmission() {
-    digitalWrite(globalDePin, LOW);  // Habilita RX
+void ModbusWorker::readMeters(const MeterConfig *meters, const uint8_t *indices, size_t count, MeterReadCallback onRead, void *ctx) {
+    if (!_port) return;
+
+    // Offline fora da hora da sonda não gasta tempo de barramento
+    uint8_t polled[MAX_CYCLE_READINGS];
+    size_t polledCount = 0;
+    for (size_t i = 0; i < count && polledCount < MAX_CYCLE_READINGS; i++) {
+        if (_health.shouldPoll(indices[i], millis())) polled[polledCount++] = indices[i];
+    }
+    indices = polled;
+    count = polledCount;
+
+    size_t next = 0;     // Próximo medidor a entrar no pipeline
+    size_t done = 0;     // Próximo medidor a ser entregue (mantém a ordem)
+
+    while (done < count) {
+        // Ocupa os slots livres com os próximos medidores
+        for (uint8_t s = 0; s < MODBUS_PIPELINE_DEPTH && next < count; s++) {
+            MeterSlot &slot = _slots[s];
+            if (slot.active) continue;
+            memset(&slot, 0, sizeof(slot));
+            slot.index = indices[next++];
+            slot.meter = &meters[slot.index];
+            slot.active = true;
+        }
+
+        submitPending();
+        _master.poll(_port->nowUs());
+        while (_master.nextResult(_result)) handleResult();
+
+        // Entrega na ordem de chegada ao pipeline: procura o medidor `done`
+        bool progressed = true;
+        while (progressed && done < count) {
+            progressed = false;
+            for (uint8_t s = 0; s < MODBUS_PIPELINE_DEPTH; s++) {
+                MeterSlot &slot = _slots[s];
+                if (!slot.active || slot.meter != &meters[indices[done]]) continue;
+
+                const ReadPlan &plan = MeterProfiles::plan(slot.meter->model);
+                bool finished = slot.failed ? slot.completed == slot.submitted : slot.completed == plan.blockCount;
+                if (!finished) break;
+
+                MeterReading reading;
+                memset(&reading, 0, sizeof(reading));
+                if (!slot.failed) {
+                    reading.voltage  = slot.values[Q_VOLTAGE];
+                    reading.current  = slot.values[Q_CURRENT];
+                    reading.power    = slot.values[Q_POWER];
+                    reading.totalKwh = slot.values[Q_ENERGY];
+                    reading.timeMs   = slot.sampledMs; // Monotônico: a BusPoller carimba o UTC
+                }
+                const MeterConfig &meter = *slot.meter;
+                slot.active = false;
+                done++;
+                progressed = true;
+                if (onRead) onRead(meter, !slot.failed, reading, ctx);
+                break;
+            }
+        }
+
+        // Dorme até chegar dado na UART ou vencer o próximo prazo do mestre
+        if (done < count) _port->waitEvent(_master.nextEventUs(_port->nowUs()));
+    }
 }
 
-void ModbusWorker::begin() {
-    pinMode(MAX485_DE, OUTPUT);
-    digitalWrite(MAX485_DE, LOW);
-    globalDePin = MAX485_DE;
-
-    // Inicia Serial2 (Hardware Serial) para RS485
-    // 9600 8N1 é o padrão da maioria dos medidores
-    Serial2.begin(9600, SERIAL_8N1, RX_PIN, TX_PIN);
-    
-    node.begin(1, Serial2); // ID inicial temporário
-    node.preTransmission(preTransmission);
-    node.postTransmission(postTransmission);
-    
-    Serial.println("🔌 Modbus RS485 Iniciado");
+void ModbusWorker::submitPending() {
+    // Enfileira na ordem dos slots (mais antigo primeiro) enquanto houver espaço
+    for (uint8_t s = 0; s < MODBUS_PIPELINE_DEPTH; s++) {
+        MeterSlot &slot = _slots[s];
+        if (!slot.active || slot.failed) continue;
+
+        const ReadPlan &plan = MeterProfiles::plan(slot.meter->model);
+        while (slot.submitted < plan.blockCount) {
+            const ReadBlock &block = plan.blocks[slot.submitted];
+            RtuRequest req;
+            req.slave = slot.meter->modbusId;
+            req.function = block.function;
+            req.start = block.start;
+            req.count = block.count;
+            req.timeoutUs = _health.timeoutUs(slot.index);
+            req.tag = SLOT_TAG(s) | slot.submitted;
+            if (!_master.submit(req)) return; // Fila cheia: o resto entra depois
+            slot.submitted++;
+        }
+    }
 }
 
-bool ModbusWorker::readMeter(uint8_t modbusId, MeterReading &outReading) {
-    node.setSlaveId(modbusId);
-
-    // Exemplo para medidores comuns (DDS238 / Eastron)
-    // Atenção: Consulte o manual do seu medidor para os endereços exatos (Hex)
-    // Muitas vezes: 
-    // 0x000C (12) = Voltagem
-    // 0x000D (13) = Corrente
-    // 0x000E (14) = Potência
-    // 0x0100 ou 0x0000 = Energia Total (kWh) - geralmente são 2 registradores (float/double)
-
-    uint8_t result;
-    
-    // Leitura 1: Dados instantâneos (Tensão, Corrente, Potência)
-    // Lendo 10 registradores a partir do endereço 0x000C
-    result = node.readHoldingRegisters(0x000C, 10); 
-    
-    if (result == node.ku8MBSuccess) {
-        // Conversão depende do medidor (ex: valor bruto / 10 ou / 100)
-        // DDS238 costuma enviar com 1 casa decimal (int 2205 = 220.5V)
-        
-        outReading.voltage = node.getResponseBuffer(0) / 10.0f; 
-        outReading.current = node.getResponseBuffer(1) / 100.0f;
-        outReading.power   = node.getResponseBuffer(3); // Às vezes é direto em Watts
-        
-    } else {
-        Serial.printf("❌ Erro Modbus ID %d: %02X\n", modbusId, result);
-        return false;
+void ModbusWorker::handleResult() {
+    uint8_t s = (_result.request.tag & SLOT_MASK) >> 8;
+    uint8_t b = _result.request.tag & 0xFF;
+    MeterSlot &slot = _slots[s];
+    slot.completed++;
+
+    if (_result.status != RTU_OK) {
+        // Os outros blocos deste medidor não valem mais nada: tira da fila.
+        // Conta uma falha por ciclo, e só loga quando o estado muda.
+        if (!slot.failed) {
+            slot.failed = true;
+            slot.submitted -= _master.cancel(SLOT_TAG(s), SLOT_MASK);
+
+            if (_health.onFailure(slot.index, millis())) {
+                const SlaveHealth &h = _health.get(slot.index);
+                if (h.state == SLAVE_OFFLINE) {
+                    Serial.printf("📴 Medidor ID %d offline (%s), próxima sonda em %u s\n", slot.meter->modbusId,
+                                  statusName(_result.status), (unsigned)(h.probe.current() / 1000));
+                } else {
+                    Serial.printf("❌ Erro Modbus ID %d (bloco 0x%04X): %s %02X\n", slot.meter->modbusId, _result.request.start,
+                                  statusName(_result.status), _result.exceptionCode);
+                }
+            }
+        }
+        return;
     }
+    if (slot.failed) return;
 
-    // Leitura 2: Energia Acumulada (Total kWh)
-    // Geralmente em outro endereço, ex: 0x0000 ou 0x0100
-    // Energia costuma ser um valor de 32 bits (2 words)
-    result = node.readHoldingRegisters(0x0000, 2);
-    
-    if (result == node.ku8MBSuccess) {
-        // Combina 2 registradores de 16 bits em um uint32
-        uint32_t highWord = node.getResponseBuffer(0);
-        uint32_t lowWord  = node.getResponseBuffer(1);
-        uint32_t combined = (highWord << 16) | lowWord;
-        
-        outReading.totalKwh = combined / 100.0f; // Ex: 123456 -> 1234.56 kWh
-        return true;
+    SlaveState before = _health.get(slot.index).state;
+    if (_health.onSuccess(slot.index, _result.responseUs, millis()) && before == SLAVE_OFFLINE) {
+        Serial.printf("✅ Medidor ID %d voltou a responder\n", slot.meter->modbusId);
     }
 
-    return false;
-}
\ No newline at end of file
+    // Instante da amostra: a chegada da resposta, não a entrega ao callback
+    if (!slot.sampledMs) slot.sampledMs = WallClock::monoMs();
+
+    // Decodifica as grandezas que estão neste bloco
+    const MeterProfile &profile = METER_PROFILES[slot.meter->model < METER_MODEL_COUNT ? slot.meter->model : METER_DDS238];
+    const ReadPlan &plan = MeterProfiles::plan(slot.meter->model);
+    for (uint8_t q = 0; q < Q_COUNT; q++) {
+        if (plan.fieldBlock[q] != b) continue;
+        const RegisterField &field = profile.fields[q];
+        slot.values[q] = MeterProfiles::decode(field, &_result.regs[field.address - _result.request.start]);
+    }
+}
+
+// --- Descoberta ---
+
+static bool hasAddress(const uint8_t *set, uint8_t id) { return set[id >> 3] & (1 << (id & 7)); }
+static void addAddress(uint8_t *set, uint8_t id) { set[id >> 3] |= 1 << (id & 7); }
+
+bool ModbusWorker::setLine(const SerialLine &line) {
+    if (!_port || !_port->setLine(line)) return false;
+    _master.begin(_port, line.baud);
+    return true;
+}
+
+void ModbusWorker::discover(const SerialLine *lines, size_t lineCount, uint32_t timeoutUs,
+                            std::vector<DiscoveredMeter> &found, std::atomic<uint16_t> *probed) {
+    if (!_port) return;
+
+    AddressSet seen; // Achados numa linha anterior
+    memset(seen, 0, sizeof(seen));
+
+    for (size_t l = 0; l < lineCount; l++) {
+        if (!setLine(lines[l])) {
+            Serial.printf("⚠️ Descoberta: porta não aceita %u baud\n", (unsigned)lines[l].baud);
+            if (probed) probed->fetch_add(DISCOVERY_ADDRESSES);
+            continue;
+        }
+
+        AddressSet todo, present, noisy, none;
+        memset(todo, 0, sizeof(todo));
+        memset(present, 0, sizeof(present));
+        memset(noisy, 0, sizeof(noisy));
+        memset(none, 0, sizeof(none));
+        for (uint16_t id = DISCOVERY_FIRST_ID; id <= DISCOVERY_LAST_ID; id++) {
+            if (!hasAddress(seen, id)) addAddress(todo, id);
+        }
+
+        probe(todo, timeoutUs, present, noisy, probed);
+        // CRC/quadro ruim: alguém falou, mas pode ter sido ruído. Uma segunda chance
+        probe(noisy, timeoutUs, present, none, NULL);
+
+        for (uint16_t id = DISCOVERY_FIRST_ID; id <= DISCOVERY_LAST_ID; id++) {
+            if (!hasAddress(present, id)) continue;
+            addAddress(seen, id);
+
+            DiscoveredMeter d;
+            d.modbusId = id;
+            d.model = identify(id);
+            d.line = lines[l];
+            found.push_back(d);
+            Serial.printf("🔎 ID %u responde a %u baud: %s\n", (unsigned)id, (unsigned)lines[l].baud,
+                          d.model < METER_MODEL_COUNT ? MeterProfiles::name(d.model) : "modelo desconhecido");
+        }
+    }
+}
+
+void ModbusWorker::probe(const AddressSet todo, uint32_t timeoutUs, AddressSet present, AddressSet noisy,
+                         std::atomic<uint16_t> *probed) {
+    RtuRequest req;
+    req.function = FC_HOLDING;
+    req.start = 0;
+    req.count = 1;
+    req.timeoutUs = timeoutUs;
+    req.tag = 0;
+
+    // A fila do mestre fica sempre cheia: a próxima requisição sai logo
+    // depois do t3.5 do timeout anterior
+    uint16_t next = DISCOVERY_FIRST_ID;
+    while (true) {
+        while (next <= DISCOVERY_LAST_ID) {
+            if (hasAddress(todo, next)) {
+                req.slave = next;
+                if (!_master.submit(req)) break;
+            } else if (probed) {
+                probed->fetch_add(1);
+            }
+            next++;
+        }
+
+        _master.poll(_port->nowUs());
+        while (_master.nextResult(_result)) {
+            uint8_t id = _result.request.slave;
+            if (_result.status == RTU_OK || _result.status == RTU_EXCEPTION) addAddress(present, id);
+            else if (_result.status != RTU_TIMEOUT) addAddress(noisy, id);
+            if (probed) probed->fetch_add(1);
+        }
+
+        if (next > DISCOVERY_LAST_ID && _master.idle()) break;
+        _port->waitEvent(_master.nextEventUs(_port->nowUs()));
+    }
+}
+
+MeterModel ModbusWorker::identify(uint8_t slave) {
+    for (uint8_t i = 0; i < METER_MODEL_COUNT; i++) {
+        MeterModel model = DISCOVERY_ORDER[i];
+        const MeterProfile &profile = METER_PROFILES[model];
+        const ReadPlan &plan = MeterProfiles::plan(model);
+
+        float values[Q_COUNT];
+        bool ok = true;
+        for (uint8_t b = 0; b < plan.blockCount && ok; b++) {
+            RtuRequest req;
+            req.slave = slave;
+            req.function = plan.blocks[b].function;
+            req.start = plan.blocks[b].start;
+            req.count = plan.blocks[b].count;
+            req.timeoutUs = DISCOVERY_IDENTIFY_TIMEOUT_US;
+            req.tag = 0;
+            ok = transact(req) && _result.status == RTU_OK;
+            for (uint8_t q = 0; ok && q < Q_COUNT; q++) {
+                if (plan.fieldBlock[q] != b) continue;
+                const RegisterField &field = profile.fields[q];
+                values[q] = MeterProfiles::decode(field, &_result.regs[field.address - req.start]);
+            }
+        }
+        if (ok && MeterDiscovery::plausible(values)) return model;
+    }
+    return METER_MODEL_COUNT;
+}
+
+bool ModbusWorker::transact(const RtuRequest &request) {
+    if (!_master.submit(request)) return false;
+    while (true) {
+        _master.poll(_port->nowUs());
+        if (_master.nextResult(_result)) return true;
+        _port->waitEvent(_master.nextEventUs(_port->nowUs()));
+    }
+}
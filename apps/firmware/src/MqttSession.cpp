@@ -0,0 +1,305 @@
+#include "MqttSession.h"
+
+// "Remaining length": 7 bits por byte, bit alto = continua (até 4 bytes)
+static size_t writeLength(uint8_t *out, uint32_t value) {
+    size_t n = 0;
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        out[n++] = value ? (b | 0x80) : b;
+    } while (value);
+    return n;
+}
+
+static size_t lengthBytes(uint32_t value) {
+    return value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4;
+}
+
+static size_t writeString(uint8_t *out, const char *s, size_t len) {
+    out[0] = len >> 8;
+    out[1] = len & 0xFF;
+    memcpy(out + 2, s, len);
+    return 2 + len;
+}
+
+size_t MqttSession::encodeConnect(uint8_t *out, size_t cap, const char *clientId,
+                                  const char *willTopic, const char *willMessage, bool willRetain) {
+    size_t idLen = strlen(clientId);
+    size_t topicLen = willTopic ? strlen(willTopic) : 0;
+    size_t messageLen = willTopic ? strlen(willMessage) : 0;
+
+    uint32_t remaining = 10 + 2 + idLen;
+    if (willTopic) remaining += 2 + topicLen + 2 + messageLen;
+    if (1 + lengthBytes(remaining) + remaining > cap) return 0;
+
+    size_t n = 0;
+    out[n++] = MQTT_CONNECT << 4;
+    n += writeLength(out + n, remaining);
+    n += writeString(out + n, "MQTT", 4);
+    out[n++] = 4; // 3.1.1
+
+    // Clean session = 0 (bit 1 zerado): os QoS 1 pendentes sobrevivem à queda
+    uint8_t flags = 0;
+    if (willTopic) flags |= 0x04 | (1 << 3) | (willRetain ? 0x20 : 0);
+    out[n++] = flags;
+    out[n++] = MQTT_KEEPALIVE_S >> 8;
+    out[n++] = MQTT_KEEPALIVE_S & 0xFF;
+
+    n += writeString(out + n, clientId, idLen);
+    if (willTopic) {
+        n += writeString(out + n, willTopic, topicLen);
+        n += writeString(out + n, willMessage, messageLen);
+    }
+    return n;
+}
+
+size_t MqttSession::encodePublishHeader(uint8_t *out, size_t cap, const char *topic, size_t payloadLen, bool retain) {
+    size_t topicLen = strlen(topic);
+    uint32_t remaining = 2 + topicLen + payloadLen;
+    if (1 + lengthBytes(remaining) + 2 + topicLen > cap) return 0;
+
+    size_t n = 0;
+    out[n++] = (MQTT_PUBLISH << 4) | (retain ? 1 : 0);
+    n += writeLength(out + n, remaining);
+    n += writeString(out + n, topic, topicLen);
+    return n;
+}
+
+void MqttSession::begin(uint32_t nowMs) {
+    end();
+    _connackCode = 0;
+    _lastWriteMs = nowMs;
+    _lastReadMs = nowMs;
+    _rxStage = RX_HEADER;
+}
+
+void MqttSession::end() {
+    _connected = false;
+    _pingOutstanding = false;
+    _sending = -1;
+
+    // Tudo que pode ter saído (inteiro ou pela metade) volta para a fila.
+    // QoS 1 vai marcado DUP; a ordem original fica pelo seq.
+    for (uint8_t i = 0; i < MQTT_SLOTS; i++) {
+        Slot &s = _slots[i];
+        if (s.state != SLOT_SENDING && s.state != SLOT_AWAIT_ACK) continue;
+        if (s.qos > 0) s.packet[0] |= 0x08;
+        s.state = SLOT_QUEUED;
+    }
+}
+
+uint16_t MqttSession::allocateId() {
+    while (true) {
+        uint16_t id = _nextId++;
+        if (_nextId == 0) _nextId = 1;
+        bool used = false;
+        for (uint8_t i = 0; i < MQTT_SLOTS; i++) {
+            if (_slots[i].state != SLOT_FREE && _slots[i].qos > 0 && _slots[i].packetId == id) used = true;
+        }
+        if (!used) return id;
+    }
+}
+
+bool MqttSession::publish(const char *topic, const uint8_t *payload, size_t len, uint8_t qos, bool retain,
+                          const OutboxRange *outbox) {
+    if (qos > 1 || (outbox && qos == 0)) return false;
+
+    size_t qos0 = 0;
+    int8_t slot = -1;
+    for (uint8_t i = 0; i < MQTT_SLOTS; i++) {
+        if (_slots[i].state == SLOT_FREE) {
+            if (slot < 0) slot = i;
+        } else if (_slots[i].qos == 0) {
+            qos0++;
+        }
+    }
+    // Cada QoS tem sua cota: status não tira lugar da janela e vice-versa
+    if (slot < 0) return false;
+    if (qos == 0 && qos0 >= MQTT_QOS0_SLOTS) return false;
+    if (qos == 1 && inflight() >= MQTT_INFLIGHT_WINDOW) return false;
+
+    size_t topicLen = strlen(topic);
+    uint32_t remaining = 2 + topicLen + (qos ? 2 : 0) + len;
+    if (1 + lengthBytes(remaining) + remaining > MQTT_PACKET_MAX) return false;
+
+    Slot &s = _slots[slot];
+    size_t n = 0;
+    s.packet[n++] = (MQTT_PUBLISH << 4) | (qos << 1) | (retain ? 1 : 0);
+    n += writeLength(s.packet + n, remaining);
+    n += writeString(s.packet + n, topic, topicLen);
+    s.packetId = 0;
+    if (qos) {
+        s.packetId = allocateId();
+        s.packet[n++] = s.packetId >> 8;
+        s.packet[n++] = s.packetId & 0xFF;
+    }
+    memcpy(s.packet + n, payload, len);
+    s.len = n + len;
+    s.qos = qos;
+    s.fromOutbox = outbox != NULL;
+    if (outbox) s.outbox = *outbox;
+    s.seq = _seq++;
+    s.state = SLOT_QUEUED;
+    return true;
+}
+
+const uint8_t *MqttSession::nextOutput(size_t &len) {
+    if (!_connected || _sending >= 0) return NULL;
+
+    int8_t next = -1;
+    for (uint8_t i = 0; i < MQTT_SLOTS; i++) {
+        if (_slots[i].state != SLOT_QUEUED) continue;
+        if (next < 0 || (int32_t)(_slots[i].seq - _slots[next].seq) < 0) next = i;
+    }
+    if (next < 0) return NULL;
+
+    _sending = next;
+    _slots[next].state = SLOT_SENDING;
+    len = _slots[next].len;
+    return _slots[next].packet;
+}
+
+void MqttSession::written(uint32_t nowMs) {
+    if (_sending < 0) return;
+    Slot &s = _slots[_sending];
+    _sending = -1;
+    _lastWriteMs = nowMs;
+
+    if (s.packet[0] & 0x08) _stats.retransmits++;
+    if (s.qos == 0) {
+        s.state = SLOT_FREE;
+        return;
+    }
+    s.state = SLOT_AWAIT_ACK;
+    s.sentMs = nowMs;
+}
+
+void MqttSession::pingSent(uint32_t nowMs) {
+    _lastWriteMs = nowMs;
+    _pingOutstanding = true;
+    _pingSentMs = nowMs;
+}
+
+bool MqttSession::receive(const uint8_t *data, size_t len, uint32_t nowMs) {
+    size_t i = 0;
+    while (i < len) {
+        switch (_rxStage) {
+            case RX_HEADER:
+                _rxHeader = data[i++];
+                _rxLenBytes = 0;
+                _rxLength = 0;
+                _rxStage = RX_LENGTH;
+                break;
+
+            case RX_LENGTH: {
+                uint8_t b = data[i++];
+                _rxLength |= (uint32_t)(b & 0x7F) << (7 * _rxLenBytes);
+                _rxLenBytes++;
+                if (b & 0x80) {
+                    if (_rxLenBytes == 4) return false; // Tamanho malformado
+                    break;
+                }
+                _rxRemaining = _rxLength;
+                _rxBodyLen = 0;
+                _rxStage = RX_BODY;
+                if (_rxRemaining == 0 && !handlePacket(nowMs)) return false;
+                break;
+            }
+
+            case RX_BODY: {
+                // Guarda só o começo; o resto (PUBLISH do broker etc.) é pulado de uma vez
+                size_t take = len - i < _rxRemaining ? len - i : _rxRemaining;
+                for (size_t k = 0; k < take && _rxBodyLen < sizeof(_rxBody); k++) {
+                    _rxBody[_rxBodyLen++] = data[i + k];
+                }
+                i += take;
+                _rxRemaining -= take;
+                if (_rxRemaining == 0 && !handlePacket(nowMs)) return false;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool MqttSession::handlePacket(uint32_t nowMs) {
+    _rxStage = RX_HEADER;
+    _lastReadMs = nowMs;
+    _pingOutstanding = false; // Qualquer pacote prova que o broker está vivo
+
+    switch (_rxHeader >> 4) {
+        case MQTT_CONNACK:
+            if (_rxLength != 2) return false;
+            _connackCode = _rxBody[1];
+            _connected = _connackCode == 0;
+            return _connected;
+
+        case MQTT_PUBACK: {
+            if (_rxLength != 2) return false;
+            uint16_t id = (_rxBody[0] << 8) | _rxBody[1];
+            for (uint8_t i = 0; i < MQTT_SLOTS; i++) {
+                Slot &s = _slots[i];
+                if (s.state != SLOT_AWAIT_ACK || s.packetId != id) continue;
+                uint32_t ms = nowMs - s.sentMs;
+                _stats.ack.record(ms >= 4000000 ? 0xFFFFFFFF : ms * 1000);
+                _stats.acked++;
+                s.state = SLOT_FREE;
+                if (s.fromOutbox) outboxDelivered(s.outbox);
+                break;
+            }
+            return true; // Id desconhecido (ack atrasado de outra conexão): ignora
+        }
+
+        default:
+            return true; // PINGRESP, PUBLISH (não assinamos nada) etc.
+    }
+}
+
+// PUBACK de registros do outbox: o confirmado só avança até o começo do
+// PUBLISH de outbox mais antigo ainda sem PUBACK (o broker pode responder
+// fora de ordem; o flash é apagado do início, então a ordem vale aqui)
+void MqttSession::outboxDelivered(const OutboxRange &range) {
+    if (!_outboxAny || (int32_t)(range.end - _outboxDone) > 0) _outboxDone = range.end;
+
+    uint32_t through = _outboxDone;
+    for (uint8_t i = 0; i < MQTT_SLOTS; i++) {
+        const Slot &s = _slots[i];
+        if (s.state == SLOT_FREE || !s.fromOutbox) continue;
+        if ((int32_t)(s.outbox.first - through) < 0) through = s.outbox.first;
+    }
+    if (!_outboxAny || (int32_t)(through - _outboxAcked) > 0) _outboxAcked = through;
+    _outboxAny = true;
+}
+
+bool MqttSession::outboxAcked(uint32_t &through) const {
+    if (!_outboxAny) return false;
+    through = _outboxAcked;
+    return true;
+}
+
+MqttKeepAlive MqttSession::keepAlive(uint32_t nowMs) const {
+    if (!_connected) return MQTT_IDLE;
+    if (_pingOutstanding) {
+        return nowMs - _pingSentMs >= MQTT_PING_TIMEOUT_MS ? MQTT_TIMED_OUT : MQTT_IDLE;
+    }
+    // Só QoS 0 saindo não prova nada: silêncio do broker também pede PINGREQ
+    uint32_t keepAliveMs = MQTT_KEEPALIVE_S * 1000UL;
+    if (nowMs - _lastWriteMs >= keepAliveMs || nowMs - _lastReadMs >= keepAliveMs) return MQTT_SEND_PING;
+    return MQTT_IDLE;
+}
+
+size_t MqttSession::inflight() const {
+    size_t n = 0;
+    for (uint8_t i = 0; i < MQTT_SLOTS; i++) {
+        if (_slots[i].state != SLOT_FREE && _slots[i].qos > 0) n++;
+    }
+    return n;
+}
+
+size_t MqttSession::queued() const {
+    size_t n = 0;
+    for (uint8_t i = 0; i < MQTT_SLOTS; i++) {
+        if (_slots[i].state != SLOT_FREE) n++;
+    }
+    return n;
+}
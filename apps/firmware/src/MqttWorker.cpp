@@ -1,101 +1,334 @@
 #include "MqttWorker.h"
 
-extern SystemConfig sysConfig; 
+extern ConfigStore configStore;
+extern WallClock wallClock;
 
-MqttWorker::MqttWorker() : client(espClient) {
-    client.setBufferSize(1024); 
+MqttWorker::MqttWorker() {
+    _lock = xSemaphoreCreateMutex();
 }
 
 bool MqttWorker::loadCredentials() {
-    if (!LittleFS.exists("/ca.crt") || !LittleFS.exists("/device.crt") || !LittleFS.exists("/device.key")) {
+    if (_credentials.loaded()) return true;
+    if (!_credentials.load()) {
         Serial.println("⚠️ MqttWorker: Certificados não encontrados no disco.");
         return false;
     }
 
-    String ca = LittleFS.open("/ca.crt").readString();
-    String cert = LittleFS.open("/device.crt").readString();
-    String key = LittleFS.open("/device.key").readString();
+    espClient.setCACert(_credentials.ca());
+    espClient.setCertificate(_credentials.cert());
+    espClient.setPrivateKey(_credentials.key());
+    espClient.setHandshakeTimeout(MQTT_HANDSHAKE_TIMEOUT_S);
 
-    espClient.setCACert(ca.c_str());
-    espClient.setCertificate(cert.c_str());
-    espClient.setPrivateKey(key.c_str());
-
-    _credentialsLoaded = true;
-    Serial.println("🔐 MqttWorker: Credenciais mTLS carregadas!");
+    Serial.printf("🔐 MqttWorker: Credenciais mTLS carregadas (%u bytes, chave %s)\n",
+                  (unsigned)_credentials.bytes(), DeviceKey::name(_credentials.keyType()));
     return true;
 }
 
 void MqttWorker::loop() {
-    if (sysConfig.mqttServer.isEmpty()) return;
+    applyConfig();
+    if (!_config || _config->mqttServer.isEmpty()) return;
+
+    if (_up) {
+        if (service()) return;
 
-    if (!_credentialsLoaded) {
-        if (!loadCredentials()) return; 
+        // Caiu: a primeira tentativa sai em MQTT_RETRY_BASE_MS
+        closeConnection();
+        uint32_t now = millis();
+        _lostMs = now;
+        _metrics.disconnects++;
+        _retry.reset();
+        _nextAttemptMs = now + _retry.next(esp_random());
+        Serial.println("❌ MQTT caiu, religando...");
     }
 
-    if (client.getServer().toString() != sysConfig.mqttServer) {
-        int port = (sysConfig.mqttPort == 1883) ? 8883 : sysConfig.mqttPort;
-        client.setServer(sysConfig.mqttServer.c_str(), port);
+    uint32_t now = millis();
+    if ((int32_t)(now - _nextAttemptMs) < 0) return;
+    if (WiFi.status() != WL_CONNECTED) return; // Sem WiFi não gasta tentativa
+
+    if (loadCredentials() && reconnect()) return;
+    _nextAttemptMs = millis() + _retry.next(esp_random());
+}
+
+// Uma volta da conexão estabelecida: lê o broker, keepalive e escreve a fila.
+// false = conexão perdida
+bool MqttWorker::service() {
+    if (!espClient.connected()) return false;
+    uint32_t now = millis();
+
+    // Entrada: PUBACK e PINGRESP
+    uint8_t rx[64];
+    int avail;
+    while ((avail = espClient.available()) > 0) {
+        int n = espClient.read(rx, avail < (int)sizeof(rx) ? avail : sizeof(rx));
+        if (n <= 0) break;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        bool ok = _session.receive(rx, n, now);
+        xSemaphoreGive(_lock);
+        if (!ok) {
+            Serial.println("⚠️ MQTT: pacote inválido do broker");
+            return false;
+        }
     }
 
-    if (!client.connected()) {
-        reconnect();
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    MqttKeepAlive keepAlive = _session.keepAlive(now);
+    xSemaphoreGive(_lock);
+    if (keepAlive == MQTT_TIMED_OUT) {
+        Serial.println("⚠️ MQTT: broker não respondeu ao PINGREQ");
+        return false;
     }
-    client.loop();
+    if (keepAlive == MQTT_SEND_PING) {
+        uint8_t ping[2];
+        if (!writeAll(ping, MqttSession::encodePingReq(ping))) return false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        _session.pingSent(now);
+        xSemaphoreGive(_lock);
+    }
+
+    // Saída: o que a PubTask enfileirou, em ordem. O slot fica reservado
+    // durante o write, então o lock não segura a PubTask no socket
+    for (uint8_t i = 0; i < MQTT_SLOTS; i++) {
+        size_t len = 0;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        const uint8_t *packet = _session.nextOutput(len);
+        xSemaphoreGive(_lock);
+        if (!packet) break;
+
+        uint32_t t0 = micros();
+        if (!writeAll(packet, len)) return false; // O closeConnection() devolve o slot à fila
+        _metrics.publish.record(micros() - t0);
+
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        _session.written(millis());
+        xSemaphoreGive(_lock);
+    }
+
+    if (_bulkPending.load() && !writeBulk()) return false;
+    return true;
+}
+
+bool MqttWorker::writeAll(const uint8_t *data, size_t len) {
+    return espClient.write(data, len) == len;
 }
 
-void MqttWorker::reconnect() {
-    if (WiFi.status() != WL_CONNECTED) return;
-    if (!_credentialsLoaded) return;
+// Métricas: header montado aqui, texto direto do buffer do chamador (QoS 0)
+bool MqttWorker::writeBulk() {
+    uint8_t header[5 + 2 + sizeof(_bulkTopic)];
+    size_t n = MqttSession::encodePublishHeader(header, sizeof(header), _bulkTopic, _bulkLen, false);
 
+    uint32_t t0 = micros();
+    bool ok = n > 0 && writeAll(header, n) && writeAll((const uint8_t *)_bulkText, _bulkLen);
+    if (!ok) return false; // Continua pendente: sai na próxima conexão
+    _metrics.publish.record(micros() - t0);
+    _bulkPending.store(false);
+    return true;
+}
+
+void MqttWorker::closeConnection() {
+    _up = false;
+    espClient.stop();
+    // QoS 1 sem PUBACK (e o que estava no meio de um write) voltam para a fila
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _session.end();
+    xSemaphoreGive(_lock);
+}
+
+// Config nova no ConfigStore: só reconecta se broker, porta ou device id mudaram
+void MqttWorker::applyConfig() {
+    if (_config && configStore.version() == _configVersion) return;
+    _configVersion = configStore.version();
+    ConfigRef next = configStore.get();
+    if (!next) return;
+
+    bool changed = !_config || (ConfigStore::diff(*_config, *next) & CONFIG_CHANGED_MQTT);
+    _config = next;
+    if (!changed) return;
+
+    if (_up) {
+        Serial.println("🔁 MQTT: broker alterado, reconectando...");
+        uint8_t packet[2];
+        writeAll(packet, MqttSession::encodeDisconnect(packet)); // Saída limpa: sem Last Will
+        closeConnection();
+    }
+    // Broker novo: tenta já, sem contar como queda
+    _up = false;
+    _everConnected = false;
+    _retry.reset();
+    _nextAttemptMs = millis();
+
+    _port = (_config->mqttPort == 1883) ? 8883 : _config->mqttPort;
+    // Cópia própria do host, que não some com o snapshot
+    snprintf(_host, sizeof(_host), "%s", _config->mqttServer.c_str());
+}
+
+bool MqttWorker::reconnect() {
     Serial.print("📡 Conectando MQTT Seguro... ");
-    
-    if (client.connect(sysConfig.deviceId.c_str())) {
-        Serial.println("Conectado!");
-    } else {
-        Serial.print("Falha, rc=");
-        Serial.print(client.state());
-        
-        char buf[256];
-        espClient.lastError(buf, 256);
-        Serial.printf(" (SSL Error: %s)\n", buf);
+
+    // Se a conexão cair sem DISCONNECT, o broker publica o Last Will no status
+    snprintf(_statusTopic, sizeof(_statusTopic), "energymeter/%s/status", _config->deviceId.c_str());
+
+    // TCP + TLS primeiro, para medir o handshake separado do CONNECT
+    uint32_t t0 = micros();
+    bool secured = espClient.connect(_host, _port);
+    if (secured) _metrics.tlsHandshake.record(micros() - t0);
+
+    if (secured && handshake()) {
+        _metrics.connects++;
+        if (_everConnected) {
+            uint32_t ms = millis() - _lostMs;
+            _metrics.lastReconnectMs = ms;
+            _metrics.reconnect.record(ms >= 4000000 ? 0xFFFFFFFF : ms * 1000);
+            Serial.printf("Conectado! (religou em %u ms, %u pendentes)\n", (unsigned)ms, (unsigned)inflight());
+        } else {
+            Serial.println("Conectado!");
+        }
+        _everConnected = true;
+        _retry.reset();
+        buildTopic(*_config, _config->payloadFormat);
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        _session.publish(_statusTopic, (const uint8_t *)"{\"online\":true}", 15, 0, true);
+        xSemaphoreGive(_lock);
+        _up = true;
+        return true;
     }
+
+    _metrics.connectFailures++;
+    char buf[256];
+    espClient.lastError(buf, 256);
+    Serial.printf("Falha, CONNACK=%u (SSL Error: %s)\n", _session.connackCode(), buf);
+    closeConnection();
+    return false;
 }
+
+// CONNECT + espera do CONNACK (a NetTask fica aqui até MQTT_CONNACK_TIMEOUT_MS)
+bool MqttWorker::handshake() {
+    uint8_t packet[2 * MQTT_TOPIC_SIZE + 64];
+    size_t len = MqttSession::encodeConnect(packet, sizeof(packet), _config->deviceId.c_str(),
+                                            _statusTopic, "{\"online\":false}", true);
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _session.begin(millis());
+    xSemaphoreGive(_lock);
+    if (len == 0 || !writeAll(packet, len)) return false;
+
+    uint32_t start = millis();
+    while (millis() - start < MQTT_CONNACK_TIMEOUT_MS) {
+        int avail = espClient.available();
+        if (avail > 0) {
+            uint8_t rx[8];
+            int n = espClient.read(rx, avail < (int)sizeof(rx) ? avail : sizeof(rx));
+            xSemaphoreTake(_lock, portMAX_DELAY);
+            bool ok = n > 0 && _session.receive(rx, n, millis());
+            bool accepted = _session.connected();
+            xSemaphoreGive(_lock);
+            if (!ok) return false;
+            if (accepted) return true;
+        } else if (!espClient.connected()) {
+            return false;
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    return false;
+}
+
 bool MqttWorker::isConnected() {
-    return client.connected();
-}
-bool MqttWorker::publishReading(String deviceId, const MeterReading &reading) {
-    if (!client.connected()) return false;
-
-    // 1. Criar o JSON
-    // Tamanho calculado para garantir (Payload simples ~200 bytes)
-    JsonDocument doc; 
-    
-    doc["device_id"] = deviceId;
-    
-    // Timestamp é opcional no backend (ele usa o server time se omitido)
-    // doc["timestamp"] = millis(); 
-
-    // Cria o objeto aninhado "channels": { "ID": { ... } }
-    JsonObject channels = doc["channels"].to<JsonObject>();
-    
-    // A chave é o ID do canal (ex: "1", "2") convertido para string
-    String channelKey = String(reading.channelId);
-    JsonObject chData = channels[channelKey].to<JsonObject>();
-    
-    chData["voltage"] = reading.voltage;
-    chData["current"] = reading.current;
-    chData["power"] = reading.power;
-    chData["total_kwh"] = reading.totalKwh;
-
-    // 2. Serializar para String
-    String jsonString;
-    serializeJson(doc, jsonString);
-
-    // 3. Publicar
-    String topic = "energymeter/" + deviceId + "/data";
-    
-    // Aumenta o buffer se necessário (padrão é 256 bytes)
-    client.setBufferSize(512); 
-    
-    return client.publish(topic.c_str(), jsonString.c_str());
-}
\ No newline at end of file
+    return _up;
+}
+
+size_t MqttWorker::inflight() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    size_t n = _session.inflight();
+    xSemaphoreGive(_lock);
+    return n;
+}
+
+bool MqttWorker::outboxAcked(uint32_t &through) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    bool any = _session.outboxAcked(through);
+    xSemaphoreGive(_lock);
+    return any;
+}
+
+bool MqttWorker::publishReading(const MeterReading &reading) {
+    return publishBatch(&reading, 1) == 1;
+}
+
+void MqttWorker::buildTopic(const SystemConfig &config, PayloadFormat format) {
+    // JSON em energymeter/{id}/data, binário em energymeter/{id}/data.v2
+    int n = snprintf(_topic, sizeof(_topic), "energymeter/%s/%s",
+                     config.deviceId.c_str(), TelemetryEncoder::topicSuffix(format));
+    _topicLen = (n > 0 && n < (int)sizeof(_topic)) ? n : 0;
+    _topicFormat = format;
+}
+
+size_t MqttWorker::publishBatch(const MeterReading *readings, size_t count, const uint32_t *outboxSeqs) {
+    if (!_up) return 0;
+
+    // Snapshot do lote inteiro: um /api/save no meio não mistura formatos
+    ConfigRef config = configStore.get();
+    PayloadFormat format = config->payloadFormat;
+    if (_topicLen == 0 || format != _topicFormat) buildTopic(*config, format);
+    if (_topicLen == 0) return 0;
+
+    size_t maxPayload = mqttPayloadMax(_topicLen);
+
+    size_t sent = 0;
+    while (sent < count) {
+        size_t len;
+        size_t n = _encoder.encode(format, config->deviceId, readings + sent, count - sent, _payload, maxPayload, len, &wallClock);
+        if (n == 0) break; // Nem um canal coube (não deve acontecer com 1024 bytes)
+
+        // Do outbox: a mensagem leva a faixa de registros (apagados só no PUBACK)
+        OutboxRange range;
+        if (outboxSeqs) {
+            range.first = outboxSeqs[sent];
+            range.end = outboxSeqs[sent + n - 1] + 1;
+        }
+        if (!publish(_topic, (const uint8_t *)_payload, len, 1, false, outboxSeqs ? &range : NULL)) break; // Janela cheia
+        sent += n;
+    }
+    return sent;
+}
+
+bool MqttWorker::publishMeterStatus(const MeterStatus &status) {
+    if (!_up) return false;
+
+    char topic[MQTT_TOPIC_SIZE + 4];
+    snprintf(topic, sizeof(topic), "%s/%u", _statusTopic, status.channelId);
+    size_t len = TelemetryEncoder::encodeMeterStatus(status, millis(), _payload, sizeof(_payload));
+    return len > 0 && publish(topic, (const uint8_t *)_payload, len, 0, true);
+}
+
+bool MqttWorker::publishGatewayStatus(size_t metersOnline, size_t metersOffline) {
+    if (!_up) return false;
+
+    size_t len = TelemetryEncoder::encodeGatewayStatus(millis() / 1000, metersOnline, metersOffline, _payload, sizeof(_payload));
+    return len > 0 && publish(_statusTopic, (const uint8_t *)_payload, len, 0, true);
+}
+
+bool MqttWorker::publishMetrics(const char *text, size_t len) {
+    if (!_up || _bulkPending.load()) return false;
+
+    snprintf(_bulkTopic, sizeof(_bulkTopic), "energymeter/%s/metrics", configStore.get()->deviceId.c_str());
+    _bulkText = text;
+    _bulkLen = len;
+    _bulkPending.store(true); // A NetTask escreve na próxima volta
+    return true;
+}
+
+// Leituras (QoS 1) não esperam: janela cheia vai para o outbox. Status (QoS 0)
+// vêm um por medidor em sequência, então esperam a NetTask liberar um slot
+bool MqttWorker::publish(const char *topic, const uint8_t *payload, size_t len, uint8_t qos, bool retained,
+                         const OutboxRange *outbox) {
+    uint32_t start = millis();
+    while (true) {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        bool ok = _session.publish(topic, payload, len, qos, retained, outbox);
+        xSemaphoreGive(_lock);
+        if (ok) return true;
+        if (qos > 0 || !_up || millis() - start >= MQTT_QOS0_WAIT_MS) break;
+        vTaskDelay(pdMS_TO_TICKS(10)); // A NetTask esvazia a fila a cada volta (10 ms)
+    }
+    _metrics.publishFailures++;
+    return false;
+}
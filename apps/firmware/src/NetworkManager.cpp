@@ -1,7 +1,35 @@
 #include "NetworkManager.h"
+#include "Checksum.h"
 
 NetworkManager::NetworkManager() : server(80) {}
 
+// Eventos anotados pela task de eventos do WiFi para a NetTask
+const uint8_t WIFI_EVT_GOT_IP = 0x01;
+const uint8_t WIFI_EVT_DISCONNECTED = 0x02;
+
+// Último BSSID/canal na RTC: sobrevive ao ESP.restart() (não a queda de energia)
+const uint32_t WIFI_HINT_MAGIC = 0x57494649;
+struct WifiHint {
+    uint32_t magic;
+    uint32_t ssidCrc;
+    uint8_t bssid[6];
+    uint8_t channel;
+};
+RTC_NOINIT_ATTR static WifiHint rtcWifiHint;
+
+static uint32_t ssidCrc(const String &ssid) {
+    return crc32(ssid.c_str(), ssid.length());
+}
+
+// Estado de uma resposta em partes: a parte atual e quanto dela já saiu
+struct PartCursor {
+    PartRenderer render;
+    size_t part = 0;
+    size_t len = 0;
+    size_t offset = 0;
+    char text[RESPONSE_PART_SIZE];
+};
+
 String NetworkManager::macToHex() {
     uint64_t mac = ESP.getEfuseMac(); 
     uint32_t high = (uint32_t)((mac >> 32) & 0xFFFF);
@@ -15,24 +43,38 @@ String NetworkManager::getDeviceId() {
     return macToHex();
 }
 
-void NetworkManager::begin(SystemConfig &config) {
-    _config = &config;
-
-    _config->deviceId = getDeviceId();
-    Serial.println("🔒 Device ID (MAC): " + _config->deviceId);
+void NetworkManager::begin(ConfigStore &store) {
+    _store = &store;
+    _configVersion = store.version();
+    _config = store.get();
+    if (!_saveLock) _saveLock = xSemaphoreCreateMutex();
 
     WiFi.mode(WIFI_AP_STA); 
+    WiFi.setAutoReconnect(false); // Quem religa é o WifiLink (backoff bem mais curto)
+    WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t info) { onWifiEvent(event, info); });
+
+    // BSSID/canal de antes do reboot (mesma rede): o primeiro begin já vai direto
+    if (rtcWifiHint.magic == WIFI_HINT_MAGIC && rtcWifiHint.ssidCrc == ssidCrc(_config->wifiSsid)) {
+        _link.setHint(rtcWifiHint.bssid, rtcWifiHint.channel);
+    }
+    startLink();
+}
 
-    if (_config->apModeForce || _config->wifiSsid == "") {
+void NetworkManager::startLink() {
+    bool sta = !(_config->apModeForce || _config->wifiSsid == "");
+    if (!sta) {
         Serial.println("⚠️ Modo AP Forçado ou sem WiFi configurado.");
-        startAP();
+        if (!_apMode) startAP();
     } else {
-        connectWiFi();
+        Serial.print("ww Conectando ao WiFi: ");
+        Serial.println(_config->wifiSsid);
     }
+    _link.begin(sta, millis());
 }
 
 void NetworkManager::startAP() {
     _apMode = true;
+    _link.setApActive(true);
     
     String ssid = "Energy_" + getDeviceId();
     String pass = "12345678"; 
@@ -47,31 +89,77 @@ void NetworkManager::startAP() {
     Serial.println(IP);
 }
 
-void NetworkManager::connectWiFi() {
-    Serial.print("ww Conectando ao WiFi: ");
-    Serial.println(_config->wifiSsid);
-
-    WiFi.begin(_config->wifiSsid.c_str(), _config->wifiPass.c_str());
+void NetworkManager::stopAP() {
+    Serial.println("📡 WiFi de volta, desligando o Hotspot de emergência");
+    WiFi.softAPdisconnect(true);
+    _apMode = false;
+    _link.setApActive(false);
+}
 
-    // Tentamos por 10 segundos. Se falhar, não travamos o loop (o loop() vai tratar retry)
-    // Mas para UX inicial, esperamos um pouco.
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
+// Roda na task de eventos do WiFi: só anota, quem trata é a NetTask
+void NetworkManager::onWifiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            _wifiEvents.fetch_or(WIFI_EVT_GOT_IP);
+            break;
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+            _disconnectReason = info.wifi_sta_disconnected.reason;
+            _wifiEvents.fetch_or(WIFI_EVT_DISCONNECTED);
+            break;
+        case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+            _disconnectReason = 0;
+            _wifiEvents.fetch_or(WIFI_EVT_DISCONNECTED);
+            break;
+        default:
+            break;
     }
+}
+
+void NetworkManager::handleWifiEvents() {
+    uint8_t events = _wifiEvents.exchange(0);
+    uint32_t now = millis();
 
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\n✅ WiFi Conectado!");
-        Serial.print("📍 IP: ");
+    // Queda antes: se os dois chegaram juntos, o status atual decide se voltou
+    if (events & WIFI_EVT_DISCONNECTED) {
+        bool wasConnected = _link.state() == LINK_CONNECTED;
+        _link.disconnected(now, _disconnectReason, esp_random());
+        if (wasConnected) Serial.printf("❌ WiFi caiu (motivo %u), religando...\n", (unsigned)_disconnectReason);
+    }
+    if ((events & WIFI_EVT_GOT_IP) && WiFi.status() == WL_CONNECTED) {
+        _link.connected(now, WiFi.BSSID(), WiFi.channel());
+        Serial.print("✅ WiFi Conectado! 📍 IP: ");
         Serial.println(WiFi.localIP());
-        _apMode = false;
-        // Se quisermos desligar o AP quando conecta:
-        // WiFi.softAPdisconnect(true); 
-    } else {
-        Serial.println("\n❌ Falha ao conectar. Subindo AP de emergência...");
-        startAP();
+        if (_link.metrics().disconnects > 0) {
+            Serial.printf("⏱️ Religou em %u ms\n", (unsigned)_link.metrics().lastReconnectMs);
+        }
+
+        // Guarda para o religamento rápido depois de um reboot
+        rtcWifiHint.magic = WIFI_HINT_MAGIC;
+        rtcWifiHint.ssidCrc = ssidCrc(_config->wifiSsid);
+        memcpy(rtcWifiHint.bssid, _link.hintBssid(), sizeof(rtcWifiHint.bssid));
+        rtcWifiHint.channel = _link.hintChannel();
+    }
+
+    switch (_link.poll(now, esp_random())) {
+        case LINK_CONNECT:
+            WiFi.begin(_config->wifiSsid.c_str(), _config->wifiPass.c_str());
+            break;
+        case LINK_CONNECT_FAST:
+            WiFi.begin(_config->wifiSsid.c_str(), _config->wifiPass.c_str(), _link.hintChannel(), _link.hintBssid());
+            break;
+        case LINK_ABORT:
+            Serial.println("⌛ WiFi: tentativa sem resposta, desistindo dela");
+            WiFi.disconnect();
+            break;
+        case LINK_START_AP:
+            Serial.println("❌ WiFi fora há tempo demais. Subindo AP de emergência...");
+            startAP();
+            break;
+        case LINK_STOP_AP:
+            stopAP();
+            break;
+        default:
+            break;
     }
 }
 
@@ -82,18 +170,51 @@ void NetworkManager::loop() {
         ESP.restart();
     }
 
-    // Reconnection Manager
-    // Se não estiver em modo AP forçado e o WiFi caiu
-    if (!_config->apModeForce && !_apMode) {
-        if (WiFi.status() != WL_CONNECTED) {
-            unsigned long now = millis();
-            if (now - _lastWifiCheck > 60000) { // Tenta reconectar a cada 60s
-                _lastWifiCheck = now;
-                Serial.println("🔄 Tentando reconectar WiFi...");
-                WiFi.reconnect();
+    applyConfig();
+    handleWifiEvents();
+    collectDiscovery();
+}
+
+// Config nova no ConfigStore: só refaz a conexão se SSID, senha ou modo AP mudaram
+void NetworkManager::applyConfig() {
+    if (_store->version() == _configVersion) return;
+    _configVersion = _store->version();
+    ConfigRef next = _store->get();
+    bool changed = (ConfigStore::diff(*_config, *next) & CONFIG_CHANGED_WIFI) != 0;
+    _config = next;
+    if (!changed) return;
+
+    Serial.println("🔁 WiFi: credenciais alteradas, reconectando...");
+    WiFi.disconnect();
+    startLink();
+}
+
+// Recolhe um scan que terminou e, se a lista estiver velha, dispara outro.
+// Nunca bloqueia: roda dentro do callback do servidor web (no modo AP a
+// NetTask fica esperando o WiFi, então é o próprio /api/scan que acompanha)
+void NetworkManager::refreshScan() {
+    uint32_t now = millis();
+
+    if (_scan.scanning()) {
+        int16_t n = WiFi.scanComplete();
+        if (n >= 0) {
+            _scan.clear();
+            for (int16_t i = 0; i < n; i++) {
+                _scan.add(WiFi.SSID(i).c_str(), WiFi.RSSI(i), WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
             }
+            _scan.finished(now);
+            WiFi.scanDelete(); // Libera a lista do driver
+        } else if (n == WIFI_SCAN_FAILED || _scan.timedOut(now)) {
+            Serial.println("⚠️ Scan WiFi falhou, mantendo a lista anterior");
+            _scan.failed();
+            WiFi.scanDelete();
         }
     }
+
+    if (_scan.shouldStart(now)) {
+        _scan.started(now);
+        if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED) _scan.failed();
+    }
 }
 
 bool NetworkManager::isWifiConnected() {
@@ -105,72 +226,36 @@ bool NetworkManager::isApMode() {
 // --- CONFIGURAÇÃO DO SERVIDOR WEB (API) ---
 
 void NetworkManager::setupWebServer(ConfigManager &configManager) {
+    _configManager = &configManager;
+
     // Rota Principal (Serve o HTML do LittleFS)
    server.serveStatic("/", LittleFS, "/").setDefaultFile("index.html");
 
-    // API: Obter Configurações Atuais
+    // API: Obter Configurações Atuais (com a lista de medidores, um por chunk)
     server.on("/api/config", HTTP_GET, [this](AsyncWebServerRequest *request){
-        JsonDocument doc;
-        // Preenche o JSON com os dados atuais da memória
-        doc["wifi"]["ssid"] = _config->wifiSsid;
-        doc["wifi"]["ap_mode"] = _config->apModeForce;
-        doc["mqtt"]["server"] = _config->mqttServer;
-        doc["mqtt"]["port"] = _config->mqttPort;
-        doc["mqtt"]["device_id"] = _config->deviceId;
-        doc["system"]["serial_id"] = getDeviceId(); // Envia o Serial ID para o frontend mostrar
-
-        String response;
-        serializeJson(doc, response);
-        request->send(200, "application/json", response);
+        ConfigRef config = _store->get(); // Segura a versão até o último chunk
+        sendParts(request, "application/json", [config](size_t part, Print &out) {
+            if (part >= ConfigManager::partCount(*config)) return false;
+            ConfigManager::writePart(*config, part, out, true);
+            return true;
+        });
     });
 
     // API: Salvar Novas Configurações
-    // Recebe um JSON, atualiza a struct e manda o ConfigManager salvar no disco
+    // O corpo chega em pedaços (um por segmento TCP); o body handler junta tudo
+    // num buffer do tamanho anunciado e o handleSave roda com o corpo completo.
     server.on("/api/save", HTTP_POST, 
-        [](AsyncWebServerRequest *request){},
+        [this, &configManager](AsyncWebServerRequest *request){
+            handleSave(request, configManager);
+        },
         NULL,
-        [this, &configManager](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {  
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, data);
-
-            if (error) {
-                request->send(400, "application/json", "{\"status\":\"error\",\"msg\":\"Invalid JSON\"}");
-                return;
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {  
+            if (index == 0) {
+                if (total == 0 || total > SAVE_BODY_MAX) return; // handleSave responde 413
+                request->_tempObject = malloc(total); // Liberado pelo próprio request
             }
-
-            // Atualiza WiFi e MQTT
-            _config->wifiSsid = doc["wifi"]["ssid"] | _config->wifiSsid;
-            _config->wifiPass = doc["wifi"]["pass"] | _config->wifiPass;
-            _config->mqttServer = doc["mqtt"]["server"] | _config->mqttServer;
-            _config->mqttPort = doc["mqtt"]["port"] | _config->mqttPort;
-            _config->interval = doc["mqtt"]["interval"] | _config->interval;
-            
-          if (doc.containsKey("meters")) {
-                _config->meters.clear(); // Limpa a lista antiga da memória
-                JsonArray meters = doc["meters"];
-                for (JsonObject m : meters) {
-                    MeterConfig mc;
-                    mc.id = m["id"];
-                    mc.channelIndex = m["channel_index"] | m["id"]; 
-                    mc.modbusId = m["modbus_id"];
-                    mc.name = m["name"].as<String>();
-                    _config->meters.push_back(mc);
-                }
-            }
-            
-            //  Configurações de sistema
-            _config->apModeForce = false; 
-
-            //  Salva no LittleFS
-            if (configManager.save(*_config)) {
-                request->send(200, "application/json", "{\"status\":\"success\",\"msg\":\"Configurações salvas. Reiniciando...\"}");
-                
-                // Evita chamar delay() longo aqui dentro do callback assíncrono
-                // O ideal é setar uma flag, mas para o MVP, um delay curto antes do restart funciona
-                delay(100); 
-                _shouldReboot = true; 
-            } else {
-                request->send(500, "application/json", "{\"status\":\"error\",\"msg\":\"Falha ao gravar no disco\"}");
+            if (request->_tempObject && index + len <= total) {
+                memcpy((uint8_t *)request->_tempObject + index, data, len);
             }
         }
     );
@@ -196,16 +281,21 @@ void NetworkManager::setupWebServer(ConfigManager &configManager) {
     });
 
     // API: Scan de Redes WiFi (Para o usuário escolher no dropdown)
-    server.on("/api/scan", HTTP_GET, [](AsyncWebServerRequest *request){
-        int n = WiFi.scanNetworks();
+    // Responde na hora com a última lista; "scanning" = há um scan rodando,
+    // o painel consulta de novo até terminar
+    server.on("/api/scan", HTTP_GET, [this](AsyncWebServerRequest *request){
+        refreshScan();
+
         JsonDocument doc;
-        JsonArray array = doc.to<JsonArray>();
-        
-        for (int i = 0; i < n; ++i) {
+        doc["scanning"] = _scan.scanning();
+        if (_scan.hasResult()) doc["age_ms"] = _scan.ageMs(millis());
+        JsonArray array = doc["networks"].to<JsonArray>();
+        for (uint8_t i = 0; i < _scan.count(); ++i) {
+            const ScanEntry &e = _scan.entry(i);
             JsonObject net = array.add<JsonObject>();
-            net["ssid"] = WiFi.SSID(i);
-            net["rssi"] = WiFi.RSSI(i);
-            net["secure"] = (WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
+            net["ssid"] = e.ssid;
+            net["rssi"] = e.rssi;
+            net["secure"] = e.secure;
         }
         
         String response;
@@ -213,7 +303,289 @@ void NetworkManager::setupWebServer(ConfigManager &configManager) {
         request->send(200, "application/json", response);
     });
 
+    // API: Descoberta de medidores nos barramentos RS485 (comissionamento).
+    // POST inicia (?bus=N, sem ele todos; ?lines=auto tenta outros baud/paridade;
+    // ?timeout_ms=); a NetTask junta o achado na config quando a varredura
+    // termina e o GET só acompanha
+    server.on("/api/discover", HTTP_POST, [this](AsyncWebServerRequest *request){
+        startDiscovery(request);
+    });
+    server.on("/api/discover", HTTP_GET, [this](AsyncWebServerRequest *request){
+        reportDiscovery(request);
+    });
+
+    // API: Métricas de runtime (texto Prometheus, para scrape ou diagnóstico em campo).
+    // Resposta em chunks, uma parte por vez: com 64+ medidores o texto passa
+    // de dezenas de KB e não pode ser montado inteiro na RAM.
+    server.on("/api/metrics", HTTP_GET, [this](AsyncWebServerRequest *request){
+        if (!_metricsRenderer) {
+            request->send(503, "text/plain", "metrics unavailable\n");
+            return;
+        }
+        sendParts(request, "text/plain; version=0.0.4", _metricsRenderer);
+    });
+
     // Inicia o servidor
     server.begin();
     Serial.println("🌍 WebServer Iniciado");
-}
\ No newline at end of file
+}
+
+// Uma parte por vez num buffer fixo: o pico de RAM da resposta é uma parte,
+// não a resposta inteira (o renderer é chamado na task do servidor web)
+void NetworkManager::sendParts(AsyncWebServerRequest *request, const char *contentType, PartRenderer render) {
+    std::shared_ptr<PartCursor> cursor(new PartCursor());
+    cursor->render = render;
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse(contentType,
+        [cursor](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            size_t written = 0;
+            while (written < maxLen) {
+                if (cursor->offset == cursor->len) {
+                    BufferPrint out(cursor->text, sizeof(cursor->text));
+                    if (!cursor->render(cursor->part++, out)) break;
+                    if (out.overflow()) Serial.printf("⚠️ Parte %u da resposta truncada\n", (unsigned)cursor->part - 1);
+                    cursor->len = out.length();
+                    cursor->offset = 0;
+                    continue;
+                }
+                size_t n = cursor->len - cursor->offset;
+                if (n > maxLen - written) n = maxLen - written;
+                memcpy(buffer + written, cursor->text + cursor->offset, n);
+                cursor->offset += n;
+                written += n;
+            }
+            return written;
+        });
+    request->send(response);
+}
+
+// Corpo completo do /api/save (juntado pelo body handler): monta a config nova
+// a partir da atual, salva no disco e publica no ConfigStore (ver ConfigStore.h)
+void NetworkManager::handleSave(AsyncWebServerRequest *request, ConfigManager &configManager) {
+    if (request->contentLength() > SAVE_BODY_MAX) {
+        request->send(413, "application/json", "{\"status\":\"error\",\"msg\":\"Config grande demais\"}");
+        return;
+    }
+    if (!request->_tempObject) {
+        request->send(400, "application/json", "{\"status\":\"error\",\"msg\":\"Invalid JSON\"}");
+        return;
+    }
+
+    // Cabeçalho numa passada, medidores na outra (um JsonDocument pequeno por vez)
+    BufferJsonInput in((const char *)request->_tempObject, request->contentLength());
+    JsonDocument doc;
+    std::vector<MeterConfig> meters;
+    int hasMeters = -1;
+    if (!ConfigManager::readHeader(in, doc) && in.rewind()) {
+        hasMeters = ConfigManager::readMeters(in, meters);
+    }
+    if (hasMeters < 0) {
+        request->send(400, "application/json", "{\"status\":\"error\",\"msg\":\"Invalid JSON\"}");
+        return;
+    }
+
+    // Cópia da versão atual: quem está lendo a atual não vê nada pela metade.
+    // O lock segura até o publish (a descoberta também grava, na NetTask)
+    xSemaphoreTake(_saveLock, portMAX_DELAY);
+    ConfigRef current = _store->get();
+    SystemConfig next = *current;
+
+    // Atualiza WiFi e MQTT
+    next.wifiSsid = doc["wifi"]["ssid"] | next.wifiSsid;
+    next.wifiPass = doc["wifi"]["pass"] | next.wifiPass;
+    next.mqttServer = doc["mqtt"]["server"] | next.mqttServer;
+    next.mqttPort = doc["mqtt"]["port"] | next.mqttPort;
+    next.interval = doc["mqtt"]["interval"] | next.interval;
+    next.samplePeriod = doc["mqtt"]["sample_period"] | next.samplePeriod;
+    if (doc["mqtt"]["format"].is<const char*>()) {
+        next.payloadFormat = strcmp(doc["mqtt"]["format"].as<const char*>(), "msgpack") == 0 ? PAYLOAD_MSGPACK : PAYLOAD_JSON;
+    }
+    if (doc["mqtt"]["overflow"].is<const char*>()) {
+        next.queueOverflow = ConfigManager::overflowFromName(doc["mqtt"]["overflow"].as<const char*>());
+    }
+
+    if (doc.containsKey("buses")) {
+        ConfigManager::parseBuses(doc["buses"].as<JsonArrayConst>(), next);
+    }
+
+    if (hasMeters) {
+        next.meters.swap(meters); // Lista nova montada fora do lugar
+    }
+    ConfigManager::normalizeBuses(next);
+
+    //  Configurações de sistema
+    next.apModeForce = false; 
+
+    //  Salva no LittleFS
+    if (!configManager.save(next)) {
+        xSemaphoreGive(_saveLock);
+        request->send(500, "application/json", "{\"status\":\"error\",\"msg\":\"Falha ao gravar no disco\"}");
+        return;
+    }
+
+    // Barramentos (UART/pinos) e fila são criados no boot: só aí reinicia
+    if (ConfigStore::diff(*current, next) & CONFIG_CHANGED_HARDWARE) {
+        xSemaphoreGive(_saveLock);
+        request->send(200, "application/json", "{\"status\":\"success\",\"restart\":true,\"msg\":\"Configurações salvas. Reiniciando...\"}");
+        _shouldReboot = true; 
+        return;
+    }
+
+    // O resto vale já: WiFi e MQTT só reconectam se os deles mudaram,
+    // os barramentos trocam os medidores no fim do ciclo
+    _store->publish(next);
+    xSemaphoreGive(_saveLock);
+    request->send(200, "application/json", "{\"status\":\"success\",\"restart\":false,\"msg\":\"Configurações aplicadas.\"}");
+}
+
+void NetworkManager::startDiscovery(AsyncWebServerRequest *request) {
+    if (!_buses) {
+        request->send(503, "application/json", "{\"status\":\"error\",\"msg\":\"Barramentos indisponíveis\"}");
+        return;
+    }
+    // Inclui a que já terminou mas a NetTask ainda não gravou: nada se perde
+    if (_discoverPhase.load(std::memory_order_acquire) == DISCOVER_SCANNING) {
+        request->send(409, "application/json", "{\"status\":\"error\",\"msg\":\"Descoberta em andamento\"}");
+        return;
+    }
+
+    uint8_t mask = 0;
+    if (request->hasParam("bus")) {
+        long bus = request->getParam("bus")->value().toInt();
+        if (bus < 0 || bus >= _busCount) {
+            request->send(400, "application/json", "{\"status\":\"error\",\"msg\":\"Barramento inválido\"}");
+            return;
+        }
+        mask = 1 << bus;
+    } else {
+        mask = (1 << _busCount) - 1;
+    }
+
+    bool allLines = request->hasParam("lines") && request->getParam("lines")->value() == "auto";
+    uint32_t timeoutUs = DISCOVERY_TIMEOUT_US;
+    if (request->hasParam("timeout_ms")) {
+        timeoutUs = (uint32_t)request->getParam("timeout_ms")->value().toInt() * 1000;
+        if (timeoutUs < DISCOVERY_TIMEOUT_MIN_US) timeoutUs = DISCOVERY_TIMEOUT_MIN_US;
+        if (timeoutUs > DISCOVERY_TIMEOUT_MAX_US) timeoutUs = DISCOVERY_TIMEOUT_MAX_US;
+    }
+
+    // Barramento sem task (não subiu no boot) fica de fora
+    uint8_t started = 0;
+    for (uint8_t b = 0; b < _busCount; b++) {
+        if ((mask & (1 << b)) && _buses[b].startDiscovery(allLines, timeoutUs)) started |= 1 << b;
+    }
+    if (!started) {
+        request->send(503, "application/json", "{\"status\":\"error\",\"msg\":\"Nenhum barramento ativo\"}");
+        return;
+    }
+    _discoverMask = started;
+    _discoverRestart = false;
+    _discoverResult = DiscoveryMerge();
+    _discoverPhase.store(DISCOVER_SCANNING, std::memory_order_release); // A partir daqui a NetTask acompanha
+    request->send(202, "application/json", "{\"status\":\"started\"}");
+}
+
+// NetTask: quando todos os barramentos pedidos terminam, grava o resultado
+// (uma vez por varredura) e, se a linha serial mudou, reinicia em seguida
+void NetworkManager::collectDiscovery() {
+    if (_discoverPhase.load(std::memory_order_acquire) != DISCOVER_SCANNING) return;
+    for (uint8_t b = 0; b < _busCount; b++) {
+        if ((_discoverMask & (1 << b)) && _buses[b].discoveryState() != DISCOVERY_DONE) return;
+    }
+
+    bool ok = applyDiscovery();
+    if (!ok) Serial.println("❌ Descoberta: falha ao gravar a config");
+    _discoverPhase.store(ok ? DISCOVER_APPLIED : DISCOVER_FAILED, std::memory_order_release);
+    // O loop() espera 5 s antes do restart: o painel ainda lê o resultado
+    if (ok && _discoverRestart) _shouldReboot = true;
+}
+
+// Junta o que todos os barramentos acharam numa config nova, como o /api/save
+bool NetworkManager::applyDiscovery() {
+    if (!_configManager) return false;
+    xSemaphoreTake(_saveLock, portMAX_DELAY);
+    ConfigRef current = _store->get();
+    SystemConfig next = *current;
+    DiscoveryMerge total;
+    for (uint8_t b = 0; b < _busCount; b++) {
+        if (!(_discoverMask & (1 << b))) continue;
+        DiscoveryMerge r = MeterDiscovery::merge(next, b, _buses[b].discovered());
+        total.added += r.added;
+        total.updated += r.updated;
+        total.skipped += r.skipped;
+        total.lineChanged |= r.lineChanged;
+    }
+    _discoverResult = total;
+
+    bool ok = true;
+    if (!total.added && !total.updated && !total.lineChanged) {
+        // Nada a gravar
+    } else if (!_configManager->save(next)) {
+        ok = false;
+    } else if (ConfigStore::diff(*current, next) & CONFIG_CHANGED_HARDWARE) {
+        // Baud/paridade nova só vale depois do reboot (UART criada no start())
+        _discoverRestart = true;
+    } else {
+        _store->publish(next);
+    }
+    xSemaphoreGive(_saveLock);
+
+    if (ok) Serial.printf("🔎 Descoberta: %u novos, %u corrigidos, %u ignorados\n", total.added, total.updated, total.skipped);
+    return ok;
+}
+
+// Só leitura: andamento, o que cada barramento achou e, depois que a NetTask
+// gravou, o resultado do merge
+void NetworkManager::reportDiscovery(AsyncWebServerRequest *request) {
+    if (!_buses) {
+        request->send(503, "application/json", "{\"status\":\"error\",\"msg\":\"Barramentos indisponíveis\"}");
+        return;
+    }
+
+    uint8_t phase = _discoverPhase.load(std::memory_order_acquire);
+    uint32_t probed = 0, total = 0;
+    for (uint8_t b = 0; b < _busCount; b++) {
+        if (!(_discoverMask & (1 << b))) continue;
+        probed += _buses[b].discoveryProbed();
+        total += _buses[b].discoveryTotal();
+    }
+
+    JsonDocument doc;
+    switch (phase) {
+        case DISCOVER_SCANNING: doc["state"] = "running"; break; // Inclui o intervalo até a NetTask gravar
+        case DISCOVER_APPLIED: doc["state"] = "done"; break;
+        case DISCOVER_FAILED:
+            doc["state"] = "error";
+            doc["msg"] = "Falha ao gravar no disco";
+            break;
+        default: doc["state"] = "idle"; break;
+    }
+    doc["progress"] = total ? probed * 100 / total : 0;
+    JsonArray buses = doc["buses"].to<JsonArray>();
+    for (uint8_t b = 0; b < _busCount; b++) {
+        if (!(_discoverMask & (1 << b))) continue;
+        JsonObject bus = buses.add<JsonObject>();
+        bus["bus"] = b;
+        bus["probed"] = _buses[b].discoveryProbed();
+        bus["total"] = _buses[b].discoveryTotal();
+        if (_buses[b].discoveryState() != DISCOVERY_DONE) continue;
+        JsonArray meters = bus["meters"].to<JsonArray>();
+        for (const DiscoveredMeter &d : _buses[b].discovered()) {
+            JsonObject m = meters.add<JsonObject>();
+            m["modbus_id"] = d.modbusId;
+            m["model"] = d.model < METER_MODEL_COUNT ? MeterProfiles::name(d.model) : "unknown";
+            m["baud"] = d.line.baud;
+            m["parity"] = ConfigManager::parityName(d.line.parity);
+        }
+    }
+    if (phase == DISCOVER_APPLIED) {
+        doc["added"] = _discoverResult.added;
+        doc["updated"] = _discoverResult.updated;
+        doc["skipped"] = _discoverResult.skipped;
+        doc["restart"] = _discoverRestart;
+    }
+
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+}
@@ -0,0 +1,67 @@
+#include "PollScheduler.h"
+#include <algorithm>
+
+void PollScheduler::configure(const std::vector<MeterConfig> &meters, uint32_t defaultPeriodMs, uint32_t now) {
+    _jobs.clear();
+    _stats = SchedulerStats();
+
+    // Períodos distintos, em ordem crescente
+    std::vector<uint32_t> periods;
+    for (size_t i = 0; i < meters.size(); i++) {
+        uint32_t p = meters[i].periodSec ? meters[i].periodSec * 1000UL : defaultPeriodMs;
+        if (p == 0) p = 1000;
+        if (std::find(periods.begin(), periods.end(), p) == periods.end()) periods.push_back(p);
+
+        PollJob job;
+        job.meterIndex = i;
+        job.periodMs = p;
+        job.next = now;
+        _jobs.push_back(job);
+    }
+    std::sort(periods.begin(), periods.end());
+
+    // Defasagem de cada grupo: g-ésimo grupo começa em (menor período * g / grupos)
+    for (size_t j = 0; j < _jobs.size(); j++) {
+        size_t g = std::find(periods.begin(), periods.end(), _jobs[j].periodMs) - periods.begin();
+        _jobs[j].next = now + (uint32_t)((uint64_t)periods[0] * g / periods.size());
+    }
+}
+
+uint32_t PollScheduler::nextRelease() const {
+    uint32_t best = _jobs.empty() ? 0 : _jobs[0].next;
+    for (size_t j = 1; j < _jobs.size(); j++) {
+        if ((int32_t)(_jobs[j].next - best) < 0) best = _jobs[j].next;
+    }
+    return best;
+}
+
+size_t PollScheduler::collectDue(uint32_t now, uint8_t *out, size_t max) {
+    size_t n = 0;
+    for (size_t j = 0; j < _jobs.size() && n < max; j++) {
+        PollJob &job = _jobs[j];
+        if (!reached(job.next, now)) continue;
+
+        out[n++] = job.meterIndex;
+
+        // Deadline absoluto: soma o período à liberação anterior. Se atrasou
+        // mais de um período, pula as liberações perdidas (não faz rajada).
+        job.next += job.periodMs;
+        while (reached(job.next, now)) {
+            job.next += job.periodMs;
+            _stats.skipped++;
+        }
+    }
+    return n;
+}
+
+void PollScheduler::endCycle(uint32_t release, uint32_t startedAt, uint32_t finishedAt) {
+    _stats.cycles++;
+    _stats.lastJitterMs = startedAt - release;
+    if (_stats.lastJitterMs > _stats.maxJitterMs) _stats.maxJitterMs = _stats.lastJitterMs;
+    _stats.lastCycleMs = finishedAt - startedAt;
+
+    // Terminou depois da próxima liberação: o próximo ciclo já começa atrasado
+    if (!_jobs.empty() && (int32_t)(finishedAt - nextRelease()) > 0) {
+        _stats.overruns++;
+    }
+}
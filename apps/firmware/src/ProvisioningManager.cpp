@@ -1,4 +1,7 @@
 #include "ProvisioningManager.h"
+#include <memory>
+#include <new>
+#include "mbedtls/platform_util.h"
 
 bool ProvisioningManager::isProvisioned() {
     return LittleFS.exists(PATH_CA) && 
@@ -40,59 +43,49 @@ bool ProvisioningManager::performProvisioning(const String &apiUrl, const String
     return false;
 }
 
-bool ProvisioningManager::generateCsr(String deviceId, String &outCsr, String &outPrivateKey) {
-    Serial.println("... Gerando chaves RSA 2048 (isso pode demorar ~10s) ...");
+// --- Task de geração da chave ---
+// Prioridade baixa no core 0: os barramentos (core 1) seguem lendo e o
+// servidor web continua respondendo. A NetTask fica bloqueada esperando.
+struct KeygenJob {
+    DeviceKeyType type;
+    const char *deviceId;
+    DeviceKeyPem *out;
+    TaskHandle_t caller;
+    int result;
+};
+
+static void keygenTask(void *parameter) {
+    KeygenJob *job = (KeygenJob *)parameter;
+    job->result = DeviceKey::generate(job->type, job->deviceId, *job->out);
+    xTaskNotifyGive(job->caller);
+    vTaskDelete(NULL);
+}
 
-    mbedtls_pk_context key;
-    mbedtls_ctr_drbg_context ctr_drbg;
-    mbedtls_entropy_context entropy;
-    mbedtls_x509write_csr req;
-    
-    mbedtls_pk_init(&key);
-    mbedtls_ctr_drbg_init(&ctr_drbg);
-    mbedtls_entropy_init(&entropy);
-    mbedtls_x509write_csr_init(&req);
+bool ProvisioningManager::generateCsr(const String &deviceId, String &outCsr, String &outPrivateKey) {
+    DeviceKeyType type = (DeviceKeyType)DEVICE_KEY_TYPE;
+    Serial.printf("... Gerando chave %s ...\n", DeviceKey::name(type));
 
-    int ret;
-    const char *pers = "energymeter_gen";
+    std::unique_ptr<DeviceKeyPem> pem(new (std::nothrow) DeviceKeyPem());
+    if (!pem) return false;
 
-    if ((ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy, (const unsigned char *)pers, strlen(pers))) != 0) {
-        Serial.printf("mbedtls_ctr_drbg_seed falhou: -0x%04x\n", -ret);
+    KeygenJob job = { type, deviceId.c_str(), pem.get(), xTaskGetCurrentTaskHandle(), -1 };
+    uint32_t started = millis();
+    if (xTaskCreatePinnedToCore(keygenTask, "Keygen", KEYGEN_STACK_SIZE, &job, 1, NULL, 0) != pdPASS) {
+        Serial.println("Sem memória para a task de geração de chave");
         return false;
     }
+    // Sem timeout: o job mora nesta pilha e a geração sempre termina
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-    if ((ret = mbedtls_pk_setup(&key, mbedtls_pk_info_from_type(MBEDTLS_PK_RSA))) != 0 ||
-        (ret = mbedtls_rsa_gen_key(mbedtls_pk_rsa(key), mbedtls_ctr_drbg_random, &ctr_drbg, 2048, 65537)) != 0) {
-        Serial.printf("Geração de chave falhou: -0x%04x\n", -ret);
+    if (job.result != 0) {
+        Serial.printf("Geração de chave falhou: -0x%04x\n", -job.result);
         return false;
     }
+    Serial.printf("🔑 Chave gerada em %lu ms (%u bytes)\n", (unsigned long)(millis() - started), (unsigned)strlen(pem->key));
 
-    unsigned char output_buf[1600];
-    memset(output_buf, 0, sizeof(output_buf));
-    if (mbedtls_pk_write_key_pem(&key, output_buf, sizeof(output_buf)) != 0) {
-        return false;
-    }
-    outPrivateKey = String((char *)output_buf);
-
-    String subject = "CN=" + deviceId + ",O=EnergyMe IoT";
-    if ((ret = mbedtls_x509write_csr_set_subject_name(&req, subject.c_str())) != 0) {
-        return false;
-    }
-    
-    mbedtls_x509write_csr_set_key(&req, &key);
-    mbedtls_x509write_csr_set_md_alg(&req, MBEDTLS_MD_SHA256);
-
-    memset(output_buf, 0, sizeof(output_buf));
-    if ((ret = mbedtls_x509write_csr_pem(&req, output_buf, sizeof(output_buf), mbedtls_ctr_drbg_random, &ctr_drbg)) != 0) {
-        return false;
-    }
-    outCsr = String((char *)output_buf);
-
-    mbedtls_x509write_csr_free(&req);
-    mbedtls_pk_free(&key);
-    mbedtls_ctr_drbg_free(&ctr_drbg);
-    mbedtls_entropy_free(&entropy);
-
+    outPrivateKey = String(pem->key);
+    outCsr = String(pem->csr);
+    mbedtls_platform_zeroize(pem->key, sizeof(pem->key));
     return true;
 }
 
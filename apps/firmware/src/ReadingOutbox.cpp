@@ -0,0 +1,201 @@
+#include "ReadingOutbox.h"
+#include "Checksum.h"
+
+namespace {
+
+const uint32_t OUTBOX_MAGIC = 0x584F424D; // "MBOX"
+const uint16_t OUTBOX_VERSION = 3; // 2: MeterReading com campos de resumo; 3: tempo da amostra
+
+struct OutboxHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint16_t capacity;
+    uint16_t reserved;
+};
+
+struct OutboxRecord {
+    uint32_t seq;
+    MeterReading reading;
+    uint32_t crc;
+};
+
+uint32_t recordCrc(const OutboxRecord &rec) {
+    return crc32(&rec, offsetof(OutboxRecord, crc));
+}
+
+} // namespace
+
+bool ReadingOutbox::begin(uint16_t capacity) {
+    _capacity = capacity;
+    _head = _tail = _cursor = 0;
+    _dropped = 0;
+    _peekCount = 0;
+
+    if (!openLog()) {
+        Serial.println("❌ Outbox: falha ao abrir log");
+        return false;
+    }
+
+    recover();
+    Serial.printf("📦 Outbox: %u leituras pendentes (capacidade %u)\n", size(), _capacity);
+    return true;
+}
+
+bool ReadingOutbox::openLog() {
+    if (LittleFS.exists(LOG_FILE)) {
+        _file = LittleFS.open(LOG_FILE, "r+");
+        OutboxHeader h;
+        if (_file && _file.read((uint8_t *)&h, sizeof(h)) == sizeof(h) &&
+            h.magic == OUTBOX_MAGIC && h.version == OUTBOX_VERSION &&
+            h.recordSize == sizeof(OutboxRecord) && h.capacity == _capacity) {
+            return true;
+        }
+
+        // Formato antigo ou capacidade diferente: recomeça do zero
+        Serial.println("⚠️ Outbox: formato incompatível, recriando log");
+        _file.close();
+        LittleFS.remove(LOG_FILE);
+        LittleFS.remove(ACK_FILE);
+    }
+
+    File f = LittleFS.open(LOG_FILE, "w");
+    if (!f) return false;
+
+    OutboxHeader h = { OUTBOX_MAGIC, OUTBOX_VERSION, (uint16_t)sizeof(OutboxRecord), _capacity, 0 };
+    f.write((const uint8_t *)&h, sizeof(h));
+    f.close();
+
+    // O arquivo cresce conforme os slots são escritos pela primeira vez
+    _file = LittleFS.open(LOG_FILE, "r+");
+    return (bool)_file;
+}
+
+void ReadingOutbox::recover() {
+    size_t slots = (_file.size() - sizeof(OutboxHeader)) / sizeof(OutboxRecord);
+    if (slots > _capacity) slots = _capacity;
+
+    bool any = false;
+    uint32_t minSeq = 0, maxSeq = 0;
+
+    _file.seek(sizeof(OutboxHeader));
+    for (size_t i = 0; i < slots; i++) {
+        OutboxRecord rec;
+        if (_file.read((uint8_t *)&rec, sizeof(rec)) != sizeof(rec)) break;
+        if (rec.crc != recordCrc(rec) || rec.seq % _capacity != i) continue;
+
+        if (!any || rec.seq < minSeq) minSeq = rec.seq;
+        if (!any || rec.seq > maxSeq) maxSeq = rec.seq;
+        any = true;
+    }
+
+    uint32_t acked = 0;
+    File a = LittleFS.open(ACK_FILE, "r");
+    if (a) {
+        if (a.read((uint8_t *)&acked, sizeof(acked)) != sizeof(acked)) acked = 0;
+        a.close();
+    }
+
+    _head = any ? maxSeq + 1 : 0;
+    if (_head < acked) _head = acked;
+    _tail = any ? minSeq : _head;
+    if (_tail < acked) _tail = acked;
+    _cursor = _tail; // O que estava no ar sem PUBACK sai de novo
+}
+
+uint32_t ReadingOutbox::slotOffset(uint32_t seq) const {
+    return sizeof(OutboxHeader) + (seq % _capacity) * sizeof(OutboxRecord);
+}
+
+bool ReadingOutbox::push(const MeterReading &reading) {
+    if (!_file) return false;
+
+    // Cheio: descarta o mais antigo (o slot dele é o próximo a ser sobrescrito)
+    if (size() >= _capacity) {
+        _tail++;
+        _dropped++;
+        if (_cursor < _tail) _cursor = _tail;
+    }
+
+    OutboxRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.seq = _head;
+    rec.reading = reading;
+    rec.crc = recordCrc(rec);
+
+    if (!_file.seek(slotOffset(_head)) ||
+        _file.write((const uint8_t *)&rec, sizeof(rec)) != sizeof(rec)) {
+        return false;
+    }
+    _file.flush();
+
+    _head++;
+    return true;
+}
+
+bool ReadingOutbox::readSlot(uint32_t seq, MeterReading &out) {
+    OutboxRecord rec;
+    if (!_file.seek(slotOffset(seq)) ||
+        _file.read((uint8_t *)&rec, sizeof(rec)) != sizeof(rec)) {
+        return false;
+    }
+    if (rec.seq != seq || rec.crc != recordCrc(rec)) return false;
+
+    out = rec.reading;
+    return true;
+}
+
+size_t ReadingOutbox::peek(MeterReading *out, size_t max, uint32_t *seqs) {
+    if (max > OUTBOX_MAX_BATCH) max = OUTBOX_MAX_BATCH;
+    _peekCount = 0;
+
+    for (uint32_t seq = _cursor; seq != _head && _peekCount < max; seq++) {
+        if (readSlot(seq, out[_peekCount])) {
+            if (seqs) seqs[_peekCount] = seq;
+            _peekSeqs[_peekCount++] = seq;
+        } else if (_peekCount == 0) {
+            // Registro corrompido no início: não há o que reenviar
+            // (se nada está no ar, sai do tail também)
+            if (_tail == seq) _tail = seq + 1;
+            _cursor = seq + 1;
+            _dropped++;
+        }
+    }
+    return _peekCount;
+}
+
+void ReadingOutbox::markSent(size_t count) {
+    if (count == 0 || _peekCount == 0) return;
+    if (count > _peekCount) count = _peekCount;
+
+    uint32_t next = _peekSeqs[count - 1] + 1;
+    if (next > _cursor) _cursor = next;
+    _peekCount = 0;
+}
+
+void ReadingOutbox::ack(size_t count) {
+    if (count == 0 || _peekCount == 0) return;
+    if (count > _peekCount) count = _peekCount;
+
+    // Se houve descarte por overflow depois do peek, o tail já passou daqui
+    uint32_t next = _peekSeqs[count - 1] + 1;
+    if (next > _tail) _tail = next;
+    if (_cursor < _tail) _cursor = _tail;
+    _peekCount = 0;
+    persistAck();
+}
+
+void ReadingOutbox::ackThrough(uint32_t seq) {
+    if (seq > _head) seq = _head;
+    if (seq <= _tail) return; // Nada novo (ou já descartado por overflow)
+    _tail = seq;
+    if (_cursor < _tail) _cursor = _tail;
+    persistAck();
+}
+
+void ReadingOutbox::persistAck() {
+    File a = LittleFS.open(ACK_FILE, "w");
+    if (!a) return;
+    a.write((const uint8_t *)&_tail, sizeof(_tail));
+    a.close();
+}
@@ -0,0 +1,85 @@
+#include "SlaveHealth.h"
+
+void SlaveHealthTracker::reset(size_t count) {
+    _slaves.assign(count, SlaveHealth());
+    _changes++;
+}
+
+void SlaveHealthTracker::remap(const std::vector<int> &from) {
+    std::vector<SlaveHealth> slaves(from.size());
+    for (size_t i = 0; i < from.size(); i++) {
+        if (from[i] >= 0 && (size_t)from[i] < _slaves.size()) slaves[i] = _slaves[from[i]];
+    }
+    _slaves.swap(slaves);
+    _changes++;
+}
+
+const char *SlaveHealthTracker::stateName(SlaveState state) {
+    switch (state) {
+        case SLAVE_ONLINE: return "online";
+        case SLAVE_DEGRADED: return "degraded";
+        case SLAVE_OFFLINE: return "offline";
+        default: return "unknown";
+    }
+}
+
+bool SlaveHealthTracker::shouldPoll(size_t i, uint32_t nowMs) const {
+    if (i >= _slaves.size()) return true;
+    const SlaveHealth &h = _slaves[i];
+    return h.state != SLAVE_OFFLINE || (int32_t)(nowMs - h.nextProbeMs) >= 0;
+}
+
+uint32_t SlaveHealthTracker::timeoutUs(size_t i) const {
+    if (i >= _slaves.size() || _slaves[i].okCount == 0) return HEALTH_INITIAL_TIMEOUT_US;
+
+    const SlaveHealth &h = _slaves[i];
+    uint32_t t = h.srttUs + 4 * h.rttVarUs;
+    if (t < HEALTH_MIN_TIMEOUT_US) t = HEALTH_MIN_TIMEOUT_US;
+    if (t > HEALTH_MAX_TIMEOUT_US) t = HEALTH_MAX_TIMEOUT_US;
+    return t;
+}
+
+bool SlaveHealthTracker::onSuccess(size_t i, uint32_t responseUs, uint32_t nowMs) {
+    if (i >= _slaves.size()) return false;
+    SlaveHealth &h = _slaves[i];
+
+    // RFC 6298: primeira amostra inicializa; depois alfa = 1/8, beta = 1/4
+    if (h.okCount == 0) {
+        h.srttUs = responseUs;
+        h.rttVarUs = responseUs / 2;
+    } else {
+        uint32_t err = responseUs > h.srttUs ? responseUs - h.srttUs : h.srttUs - responseUs;
+        h.rttVarUs = h.rttVarUs - h.rttVarUs / 4 + err / 4;
+        h.srttUs = h.srttUs - h.srttUs / 8 + responseUs / 8;
+    }
+
+    h.response.record(responseUs);
+    h.okCount++;
+    h.lastOkMs = nowMs;
+    h.consecutiveFailures = 0;
+    h.probe.reset();
+
+    bool changed = h.state != SLAVE_ONLINE;
+    h.state = SLAVE_ONLINE;
+    if (changed) _changes++;
+    return changed;
+}
+
+bool SlaveHealthTracker::onFailure(size_t i, uint32_t nowMs) {
+    if (i >= _slaves.size()) return false;
+    SlaveHealth &h = _slaves[i];
+
+    h.failCount++;
+    if (h.consecutiveFailures < 0xFFFF) h.consecutiveFailures++;
+
+    SlaveState next = h.consecutiveFailures >= HEALTH_OFFLINE_AFTER ? SLAVE_OFFLINE : SLAVE_DEGRADED;
+    if (next == SLAVE_OFFLINE) {
+        // Cada sonda que falha dobra o intervalo até a próxima
+        h.nextProbeMs = nowMs + h.probe.next();
+    }
+
+    bool changed = h.state != next;
+    h.state = next;
+    if (changed) _changes++;
+    return changed;
+}
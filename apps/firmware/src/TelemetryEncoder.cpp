@@ -0,0 +1,245 @@
+#include "TelemetryEncoder.h"
+
+namespace {
+
+// Escritor MessagePack mínimo (só os tipos que o schema usa).
+// O ArduinoJson também serializa MessagePack, mas só com chaves string;
+// aqui as chaves são inteiros de 1 byte.
+class MsgPackWriter {
+public:
+    MsgPackWriter(uint8_t *buf, size_t capacity) : _buf(buf), _cap(capacity), _len(0), _overflow(false) {}
+
+    void mapHeader(uint8_t n) { byte(0x80 | n); }           // fixmap (n < 16)
+    void array16Header(uint16_t n) { byte(0xdc); be16(n); } // array16 (tamanho corrigido no final)
+
+    void integer(uint32_t v) {
+        if (v < 0x80) { byte(v); }
+        else if (v <= 0xFF) { byte(0xcc); byte(v); }
+        else if (v <= 0xFFFF) { byte(0xcd); be16(v); }
+        else { byte(0xce); be32(v); }
+    }
+
+    void integer64(uint64_t v) {
+        if (v <= 0xFFFFFFFFULL) { integer((uint32_t)v); return; }
+        byte(0xcf);
+        be32(v >> 32);
+        be32(v & 0xFFFFFFFF);
+    }
+
+    void float32(float f) {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        byte(0xca);
+        be32(bits);
+    }
+
+    void str(const char *s, size_t n) {
+        if (n < 32) { byte(0xa0 | n); }
+        else { byte(0xd9); byte(n); }
+        raw(s, n);
+    }
+
+    void patch16(size_t pos, uint16_t v) {
+        if (pos + 2 > _len) return;
+        _buf[pos] = v >> 8;
+        _buf[pos + 1] = v & 0xFF;
+    }
+
+    size_t length() const { return _len; }
+    bool overflow() const { return _overflow; }
+    void rewind(size_t len) { _len = len; _overflow = false; }
+
+private:
+    uint8_t *_buf;
+    size_t _cap;
+    size_t _len;
+    bool _overflow;
+
+    void byte(uint8_t b) { raw(&b, 1); }
+    void be16(uint16_t v) { byte(v >> 8); byte(v & 0xFF); }
+    void be32(uint32_t v) { be16(v >> 16); be16(v & 0xFFFF); }
+
+    void raw(const void *p, size_t n) {
+        if (_overflow || _len + n > _cap) { _overflow = true; return; }
+        memcpy(_buf + _len, p, n);
+        _len += n;
+    }
+};
+
+// Cópia da leitura com o tempo já convertido para UTC, se possível
+MeterReading resolved(const MeterReading &reading, const WallClock *clock) {
+    MeterReading r = reading;
+    if (clock) clock->resolve(r);
+    return r;
+}
+
+} // namespace
+
+const char *TelemetryEncoder::topicSuffix(PayloadFormat format) {
+    return format == PAYLOAD_MSGPACK ? "data.v2" : "data";
+}
+
+size_t TelemetryEncoder::encodeGatewayStatus(uint32_t uptimeSec, size_t online, size_t offline, char *out, size_t capacity) {
+    int n = snprintf(out, capacity, "{\"online\":true,\"uptime_s\":%u,\"meters_online\":%u,\"meters_offline\":%u}",
+                     (unsigned)uptimeSec, (unsigned)online, (unsigned)offline);
+    return (n > 0 && (size_t)n < capacity) ? n : 0;
+}
+
+size_t TelemetryEncoder::encodeMeterStatus(const MeterStatus &st, uint32_t nowMs, char *out, size_t capacity) {
+    const SlaveHealth &h = st.health;
+
+    // Nunca respondeu: last_ok_s = null
+    char lastOk[12];
+    if (h.okCount) snprintf(lastOk, sizeof(lastOk), "%u", (unsigned)((nowMs - h.lastOkMs) / 1000));
+    else strcpy(lastOk, "null");
+
+    int n = snprintf(out, capacity,
+                     "{\"bus\":%u,\"modbus_id\":%u,\"state\":\"%s\",\"response_ms\":%u,\"timeout_ms\":%u,\"failures\":%u,\"last_ok_s\":%s}",
+                     st.bus, st.modbusId, SlaveHealthTracker::stateName(h.state), (unsigned)(h.srttUs / 1000),
+                     (unsigned)(st.timeoutUs / 1000), (unsigned)h.consecutiveFailures, lastOk);
+    return (n > 0 && (size_t)n < capacity) ? n : 0;
+}
+
+size_t TelemetryEncoder::encode(PayloadFormat format, const String &deviceId, const MeterReading *readings, size_t count,
+                                char *out, size_t capacity, size_t &outLen, const WallClock *clock) {
+    if (format == PAYLOAD_MSGPACK) {
+        return encodeMsgPack(deviceId, readings, count, out, capacity, outLen, clock);
+    }
+    return encodeJson(deviceId, readings, count, out, capacity, outLen, clock);
+}
+
+size_t TelemetryEncoder::encodeJson(const String &deviceId, const MeterReading *readings, size_t count,
+                                    char *out, size_t capacity, size_t &outLen, const WallClock *clock) {
+    outLen = 0;
+
+    JsonDocument doc(&_arena);
+    doc["device_id"] = deviceId;
+
+    JsonObject channels = doc["channels"].to<JsonObject>();
+
+    size_t used = 0;
+    char key[4];
+    for (; used < count; used++) {
+        const MeterReading r = resolved(readings[used], clock);
+
+        // A chave é o ID do canal (ex: "1", "2")
+        snprintf(key, sizeof(key), "%u", r.channelId);
+        if (channels[key].is<JsonObject>()) break;
+
+        JsonObject chData = channels[key].to<JsonObject>();
+        chData["voltage"] = r.voltage;
+        chData["current"] = r.current;
+        chData["power"] = r.power;
+        chData["total_kwh"] = r.totalKwh;
+        if (r.flags & READING_SUMMARY) {
+            chData["samples"] = r.samples;
+            chData["voltage_min"] = r.voltageMin;
+            chData["voltage_max"] = r.voltageMax;
+            chData["current_min"] = r.currentMin;
+            chData["current_max"] = r.currentMax;
+            chData["power_min"] = r.powerMin;
+            chData["power_max"] = r.powerMax;
+            chData["energy_delta_kwh"] = r.energyDelta;
+        }
+        if (r.flags & READING_TIME_UTC) {
+            chData["ts"] = r.timeMs;
+            // Sem "timestamp" o backend usaria a hora de chegada
+            if (used == 0) doc["timestamp"] = r.timeMs;
+        } else {
+            chData["ts_boot_ms"] = r.timeMs;
+            chData["boot_id"] = r.bootId;
+        }
+
+        // Estourou o buffer (ou a arena): este canal fica para a próxima mensagem
+        if (doc.overflowed() || measureJson(doc) >= capacity) {
+            channels.remove(key);
+            break;
+        }
+    }
+
+    if (used == 0) return 0;
+
+    outLen = serializeJson(doc, out, capacity);
+    return used;
+}
+
+size_t TelemetryEncoder::encodeMsgPack(const String &deviceId, const MeterReading *readings, size_t count,
+                                       char *out, size_t capacity, size_t &outLen, const WallClock *clock) {
+    outLen = 0;
+    MsgPackWriter w((uint8_t *)out, capacity);
+
+    w.mapHeader(3);
+    w.integer(TK_VERSION);
+    w.integer(TELEMETRY_SCHEMA_VERSION);
+    w.integer(TK_DEVICE_ID);
+    w.str(deviceId.c_str(), deviceId.length());
+    w.integer(TK_CHANNELS);
+    size_t countPos = w.length() + 1;
+    w.array16Header(0);
+    if (w.overflow()) return 0;
+
+    size_t used = 0;
+    for (; used < count; used++) {
+        const MeterReading r = resolved(readings[used], clock);
+
+        bool repeated = false;
+        for (size_t i = 0; i < used; i++) {
+            if (readings[i].channelId == r.channelId) repeated = true;
+        }
+        if (repeated) break;
+
+        size_t mark = w.length();
+        bool summary = r.flags & READING_SUMMARY;
+        bool utc = r.flags & READING_TIME_UTC;
+        w.mapHeader((summary ? 13 : 5) + (utc ? 1 : 2));
+        w.integer(TK_CH_ID);
+        w.integer(r.channelId);
+        w.integer(TK_CH_VOLTAGE);
+        w.float32(r.voltage);
+        w.integer(TK_CH_CURRENT);
+        w.float32(r.current);
+        w.integer(TK_CH_POWER);
+        w.float32(r.power);
+        w.integer(TK_CH_TOTAL_KWH);
+        w.float32(r.totalKwh);
+        if (summary) {
+            w.integer(TK_CH_SAMPLES);
+            w.integer(r.samples);
+            w.integer(TK_CH_VOLTAGE_MIN);
+            w.float32(r.voltageMin);
+            w.integer(TK_CH_VOLTAGE_MAX);
+            w.float32(r.voltageMax);
+            w.integer(TK_CH_CURRENT_MIN);
+            w.float32(r.currentMin);
+            w.integer(TK_CH_CURRENT_MAX);
+            w.float32(r.currentMax);
+            w.integer(TK_CH_POWER_MIN);
+            w.float32(r.powerMin);
+            w.integer(TK_CH_POWER_MAX);
+            w.float32(r.powerMax);
+            w.integer(TK_CH_ENERGY_DELTA);
+            w.float32(r.energyDelta);
+        }
+        if (utc) {
+            w.integer(TK_CH_TS);
+            w.integer64(r.timeMs);
+        } else {
+            w.integer(TK_CH_TS_BOOT);
+            w.integer64(r.timeMs);
+            w.integer(TK_CH_BOOT_ID);
+            w.integer(r.bootId);
+        }
+
+        // Estourou o buffer: este canal fica para a próxima mensagem
+        if (w.overflow()) {
+            w.rewind(mark);
+            break;
+        }
+    }
+
+    if (used == 0) return 0;
+
+    w.patch16(countPos, used);
+    outLen = w.length();
+    return used;
+}
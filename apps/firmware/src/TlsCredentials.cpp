@@ -0,0 +1,38 @@
+#include "TlsCredentials.h"
+
+std::unique_ptr<char[]> TlsCredentials::readPem(const char *path, size_t &len) {
+    std::unique_ptr<char[]> pem;
+    if (!LittleFS.exists(path)) return pem;
+    File f = LittleFS.open(path, "r");
+    if (!f) return pem;
+
+    size_t size = f.size();
+    if (size > 0 && size <= TLS_PEM_MAX_BYTES) {
+        pem.reset(new char[size + 1]);
+        bool complete = f.read((uint8_t *)pem.get(), size) == size;
+        pem[size] = '\0';
+        if (complete && strncmp(pem.get(), "-----BEGIN ", 11) == 0) {
+            len = size + 1;
+        } else {
+            pem.reset();
+        }
+    }
+    f.close();
+    if (!pem) Serial.printf("⚠️ Credencial inválida: %s\n", path);
+    return pem;
+}
+
+bool TlsCredentials::load() {
+    size_t caLen = 0, certLen = 0, keyLen = 0;
+    std::unique_ptr<char[]> ca = readPem(TLS_CA_PATH, caLen);
+    std::unique_ptr<char[]> cert = readPem(TLS_CERT_PATH, certLen);
+    std::unique_ptr<char[]> key = readPem(TLS_KEY_PATH, keyLen);
+    if (!ca || !cert || !key) return false;
+
+    _ca = std::move(ca);
+    _cert = std::move(cert);
+    _key = std::move(key);
+    _bytes = caLen + certLen + keyLen;
+    _keyType = DeviceKey::typeOfPem(_key.get());
+    return true;
+}
@@ -0,0 +1,54 @@
+#include "UartRtuPort.h"
+#include "driver/uart.h"
+
+static uint32_t serialConfig(SerialParity parity) {
+    switch (parity) {
+        case PARITY_EVEN: return SERIAL_8E1;
+        case PARITY_ODD: return SERIAL_8O1;
+        default: return SERIAL_8N1;
+    }
+}
+
+void UartRtuPort::begin(HardwareSerial &serial, uint8_t uart, const SerialLine &line, int rxPin, int txPin, int dePin) {
+    _serial = &serial;
+    _uart = uart;
+
+    _serial->begin(line.baud, serialConfig(line.parity), rxPin, txPin);
+    _serial->setPins(rxPin, txPin, -1, dePin); // RTS da UART = DE/RE do MAX485
+    _serial->setMode(UART_MODE_RS485_HALF_DUPLEX);
+
+    // Evento de RX após 1 caractere de silêncio: entrega o quadro (ou o pedaço
+    // dele) logo, com carimbo de tempo próximo do último byte
+    _serial->setRxTimeout(1);
+    _serial->onReceive([this]() {
+        TaskHandle_t waiter = _waiter;
+        if (waiter) xTaskNotifyGive(waiter);
+    }, false);
+}
+
+void UartRtuPort::send(const uint8_t *frame, size_t len) {
+    // 8 bytes cabem na FIFO de TX: retorna sem esperar a transmissão
+    _serial->write(frame, len);
+}
+
+size_t UartRtuPort::receive(uint8_t *buf, size_t max) {
+    size_t n = _serial->available();
+    if (n == 0) return 0;
+    return _serial->read(buf, n < max ? n : max);
+}
+
+void UartRtuPort::waitEvent(uint32_t timeoutUs) {
+    _waiter = xTaskGetCurrentTaskHandle();
+    TickType_t ticks = pdMS_TO_TICKS(timeoutUs / 1000 + 1);
+    ulTaskNotifyTake(pdTRUE, ticks ? ticks : 1);
+}
+
+bool UartRtuPort::setLine(const SerialLine &line) {
+    // Direto no driver: um begin() novo refaria pinos, modo RS485 e o callback de RX
+    static const uart_parity_t parities[] = { UART_PARITY_DISABLE, UART_PARITY_EVEN, UART_PARITY_ODD };
+    if (!_serial || line.parity > PARITY_ODD) return false;
+    _serial->updateBaudRate(line.baud);
+    if (uart_set_parity((uart_port_t)_uart, parities[line.parity]) != ESP_OK) return false;
+    _serial->flush(false); // Descarta o que chegou com o formato antigo
+    return true;
+}
@@ -0,0 +1,38 @@
+#include "WallClock.h"
+#include <esp_timer.h>
+
+int64_t WallClock::monoMs() {
+    return esp_timer_get_time() / 1000;
+}
+
+void WallClock::sync(int64_t monoMs, int64_t utcMs) {
+    int64_t offset = utcMs - monoMs;
+    if (_syncs.load() > 0) {
+        int64_t step = offset - _offsetMs.load();
+        _lastStepMs.store(step > INT32_MAX ? INT32_MAX : step < INT32_MIN ? INT32_MIN : (int32_t)step);
+    }
+    _offsetMs.store(offset);
+    _syncs.fetch_add(1);
+}
+
+bool WallClock::toUtc(int64_t monoMs, int64_t &utcMs) const {
+    if (!synced()) return false;
+    utcMs = monoMs + _offsetMs.load();
+    return true;
+}
+
+void WallClock::stamp(MeterReading &reading) const {
+    reading.bootId = _bootId;
+    reading.flags &= ~READING_TIME_UTC;
+    resolve(reading);
+}
+
+void WallClock::resolve(MeterReading &reading) const {
+    if (reading.flags & READING_TIME_UTC) return;
+    if (reading.bootId != _bootId) return; // Outro boot: o mapeamento se perdeu
+
+    int64_t utc;
+    if (!toUtc(reading.timeMs, utc)) return;
+    reading.timeMs = utc;
+    reading.flags |= READING_TIME_UTC;
+}
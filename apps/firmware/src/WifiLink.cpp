@@ -0,0 +1,86 @@
+#include "WifiLink.h"
+
+void WifiLink::begin(bool enabled, uint32_t nowMs) {
+    _state = enabled ? LINK_WAITING : LINK_OFF;
+    _retry.reset();
+    _beginMs = nowMs;
+    _retryAtMs = nowMs; // Primeira tentativa já no próximo poll()
+    _lost = false;
+    _everConnected = false;
+    _fastAttempt = false;
+}
+
+void WifiLink::setHint(const uint8_t *bssid, uint8_t channel) {
+    memcpy(_hintBssid, bssid, sizeof(_hintBssid));
+    _hintChannel = channel;
+}
+
+void WifiLink::connected(uint32_t nowMs, const uint8_t *bssid, uint8_t channel) {
+    if (_state == LINK_OFF || _state == LINK_CONNECTED) return;
+
+    if (_lost) {
+        uint32_t ms = nowMs - _lostMs;
+        _metrics.lastReconnectMs = ms;
+        if (ms > _metrics.maxReconnectMs) _metrics.maxReconnectMs = ms;
+        _metrics.reconnect.record(ms >= 4000000 ? 0xFFFFFFFF : ms * 1000);
+        _lost = false;
+    }
+    _metrics.connects++;
+    _state = LINK_CONNECTED;
+    _everConnected = true;
+    _retry.reset();
+    if (bssid && channel) setHint(bssid, channel);
+}
+
+void WifiLink::disconnected(uint32_t nowMs, uint8_t reason, uint32_t random) {
+    if (_state == LINK_CONNECTED) {
+        _metrics.disconnects++;
+        _lost = true;
+        _lostMs = nowMs;
+        _retry.reset();
+        _state = LINK_WAITING;
+        _retryAtMs = nowMs + _retry.next(random);
+        return;
+    }
+
+    // Eco de um begin()/disconnect() nosso, ou evento repetido do driver
+    if (_state != LINK_CONNECTING || reason == WIFI_REASON_LEFT) return;
+    fail(nowMs, random);
+}
+
+void WifiLink::fail(uint32_t nowMs, uint32_t random) {
+    _metrics.failures++;
+    if (_fastAttempt) _hintChannel = 0; // O AP mudou de canal ou sumiu: volta a varrer
+    _state = LINK_WAITING;
+    _retryAtMs = nowMs + _retry.next(random);
+}
+
+WifiLinkAction WifiLink::poll(uint32_t nowMs, uint32_t random) {
+    if (_state == LINK_OFF) return LINK_NONE;
+
+    if (_state == LINK_CONNECTED) {
+        if (_apActive) return LINK_STOP_AP; // Era AP de emergência: a rede voltou
+        return LINK_NONE;
+    }
+
+    // Sem rede há tempo demais (contado do begin ou da queda): AP para reconfigurar
+    uint32_t downMs = _lost ? nowMs - _lostMs : nowMs - _beginMs;
+    uint32_t limitMs = _everConnected ? WIFI_AP_AFTER_LOSS_MS : WIFI_AP_FALLBACK_MS;
+    if (!_apActive && downMs >= limitMs) {
+        _metrics.apFallbacks++;
+        return LINK_START_AP;
+    }
+
+    if (_state == LINK_CONNECTING) {
+        if (nowMs - _attemptMs < WIFI_CONNECT_TIMEOUT_MS) return LINK_NONE;
+        fail(nowMs, random);
+        return LINK_ABORT;
+    }
+
+    // LINK_WAITING
+    if ((int32_t)(nowMs - _retryAtMs) < 0) return LINK_NONE;
+    _state = LINK_CONNECTING;
+    _attemptMs = nowMs;
+    _fastAttempt = hasHint(); // Some depois de uma tentativa rápida que falhou
+    return _fastAttempt ? LINK_CONNECT_FAST : LINK_CONNECT;
+}
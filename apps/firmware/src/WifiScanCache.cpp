@@ -0,0 +1,62 @@
+#include "WifiScanCache.h"
+
+bool WifiScanCache::shouldStart(uint32_t nowMs) const {
+    if (_scanning) return false;
+    if (_started && nowMs - _startedMs < SCAN_MIN_INTERVAL_MS) return false;
+    return !_hasResult || ageMs(nowMs) >= SCAN_MAX_AGE_MS;
+}
+
+void WifiScanCache::started(uint32_t nowMs) {
+    _scanning = true;
+    _started = true;
+    _startedMs = nowMs;
+}
+
+// Mesmo SSID de vários APs (repetidores, mesh) aparece uma vez, com o sinal
+// mais forte; a lista fica em ordem de sinal e guarda só as mais fortes
+void WifiScanCache::add(const char *ssid, int32_t rssi, bool secure) {
+    if (!ssid || !*ssid) return; // Rede oculta
+
+    int8_t level = rssi < -128 ? -128 : (rssi > 0 ? 0 : (int8_t)rssi);
+    uint8_t pos = _count;
+    for (uint8_t i = 0; i < _count; i++) {
+        if (strncmp(_entries[i].ssid, ssid, sizeof(_entries[i].ssid) - 1) == 0) {
+            if (_entries[i].rssi >= level) return;
+            pos = i; // Sai daqui e entra de novo na posição do sinal novo
+            break;
+        }
+    }
+
+    if (pos == _count) {
+        if (_count < SCAN_MAX_NETWORKS) {
+            _count++;
+        } else if (_entries[_count - 1].rssi >= level) {
+            return; // Mais fraca que todas
+        } else {
+            pos = _count - 1;
+        }
+    }
+
+    // Abre espaço subindo a partir de `pos` até achar alguém mais forte
+    while (pos > 0 && _entries[pos - 1].rssi < level) {
+        _entries[pos] = _entries[pos - 1];
+        pos--;
+    }
+
+    ScanEntry &e = _entries[pos];
+    strncpy(e.ssid, ssid, sizeof(e.ssid) - 1);
+    e.ssid[sizeof(e.ssid) - 1] = '\0';
+    e.rssi = level;
+    e.secure = secure;
+}
+
+void WifiScanCache::finished(uint32_t nowMs) {
+    _scanning = false;
+    _hasResult = true;
+    _updatedMs = nowMs;
+}
+
+void WifiScanCache::failed() {
+    // A lista anterior continua valendo; tenta de novo depois de SCAN_MIN_INTERVAL_MS
+    _scanning = false;
+}
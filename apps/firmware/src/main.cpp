@@ -1,25 +1,50 @@
 #include <Arduino.h>
 #include "AppConfig.h"
 #include "ConfigManager.h"
+#include "ConfigStore.h"
 #include "NetworkManager.h"
-#include "ModbusWorker.h"
+#include "BusPoller.h"
 #include "MqttWorker.h"
 #include "ProvisioningManager.h"
+#include "ReadingOutbox.h"
+#include "PollScheduler.h"
+#include "Metrics.h"
+#include "WallClock.h"
+#include "esp_sntp.h"
 
 // --- Definições de Hardware ---
 #define LED_PIN 2       // LED azul on-board do ESP32 (GPIO 2)
 #define BUTTON_PIN 0    // Botão BOOT do ESP32 (GPIO 0)
 
+// --- Replay do Outbox ---
+#define OUTBOX_REPLAY_BATCH 16        // Leituras reenviadas por rodada
+#define OUTBOX_REPLAY_INTERVAL_MS 200 // Pausa entre rodadas (não satura o broker)
+
+// --- Status dos medidores ---
+#define STATUS_INTERVAL_MS 60000      // Republica o status mesmo sem mudança de estado
+
+// --- Métricas ---
+#define METRICS_INTERVAL_MS 300000    // Publica as métricas do gateway no MQTT
+#define METRICS_GATEWAY_PARTS 9       // Partes do gateway em renderMetrics (o resto é por medidor)
+
 // Globais
-SystemConfig sysConfig;
-QueueHandle_t readingQueue; // Fila para passar dados do Modbus -> MQTT
+ConfigStore configStore; // Config viva: snapshots imutáveis trocados pelo /api/save (ver ConfigStore.h)
+TaskHandle_t netTask = NULL;
+TaskHandle_t pubTask = NULL;  // Acordada pelos barramentos no fim de cada ciclo
+SemaphoreHandle_t outboxLock;  // O outbox é escrito pela PubTask e pelo spill dos barramentos
 
 // Instâncias dos Gerenciadores
 ConfigManager configManager;
 NetworkManager networkManager;
-ModbusWorker modbusWorker;
 ProvisioningManager provManager;
 MqttWorker mqttWorker;
+ReadingOutbox outbox; // Store-and-forward em flash (quedas de WiFi/MQTT)
+WallClock wallClock;  // Monotônico -> UTC (SNTP); carimba as leituras na BusPoller
+BusPoller busPollers[MAX_BUSES]; // Um por barramento RS485, cada um com sua task e sua fila
+
+// Tempo de boot (exportado nas métricas)
+uint32_t bootConfigLoadUs = 0;    // configManager.load()
+uint32_t bootFirstReadingMs = 0;  // millis() da primeira leitura na PubTask (0 = ainda não chegou)
 
 // Variáveis para controle do botão físico
 unsigned long buttonPressTime = 0;
@@ -56,14 +81,28 @@ void checkPhysicalButton() {
     }
 }
 
+// Callback do SNTP (task do lwIP): o relógio do sistema acabou de ser ajustado
+void onTimeSync(struct timeval *tv) {
+    bool first = !wallClock.synced();
+    wallClock.sync(WallClock::monoMs(), (int64_t)tv->tv_sec * 1000 + tv->tv_usec / 1000);
+    if (first) Serial.println("🕒 Relógio sincronizado via SNTP");
+}
+
 // --- Tarefa 1: Rede e WebServer (Core 0) ---
-vvoid taskNetwork(void *parameter) {
-    networkManager.begin(sysConfig);
+void taskNetwork(void *parameter) {
+    networkManager.begin(configStore);
+
+    // O SNTP começa a consultar sozinho quando o WiFi tiver IP
+    sntp_set_time_sync_notification_cb(onTimeSync);
+    sntp_set_sync_interval(SNTP_SYNC_INTERVAL_MS);
+    configTime(0, 0, SNTP_SERVER_1, SNTP_SERVER_2);
     networkManager.setupWebServer(configManager);
 
     // Só tenta provisionar se tiver WiFi e ainda não tiver certificados
+    // (o loop() segue rodando: é ele que religa e sobe o AP de emergência)
     while (!networkManager.isWifiConnected()) {
-        vTaskDelay(pdMS_TO_TICKS(500));
+        networkManager.loop();
+        vTaskDelay(pdMS_TO_TICKS(10));
     }
 
     if (!provManager.isProvisioned()) {
@@ -71,9 +110,10 @@ vvoid taskNetwork(void *parameter) {
         
         // Assume que a API está no mesmo IP do Broker MQTT, porta 3000
         // (Ou adicione um campo 'apiUrl' no AppConfig.h para ser mais correto)
-        String apiUrl = "http://" + sysConfig.mqttServer + ":3000";
+        ConfigRef config = configStore.get();
+        String apiUrl = "http://" + config->mqttServer + ":3000";
         
-        if (provManager.performProvisioning(apiUrl, sysConfig.deviceId)) {
+        if (provManager.performProvisioning(apiUrl, config->deviceId)) {
             Serial.println("🎉 Autorização obtida! Reiniciando para aplicar segurança...");
             vTaskDelay(2000);
             ESP.restart(); // Reinicia para carregar limpo com os novos certs
@@ -93,74 +133,405 @@ vvoid taskNetwork(void *parameter) {
     }
 }
 
-// --- Tarefa 2: Leitura Modbus (Core 1) ---
-void taskModbus(void *parameter) {
-    modbusWorker.begin(); // Configura Serial2 (RS485)
+// --- Config nova publicada (na task de quem publicou: servidor web ou NetTask) ---
+// WiFi e MQTT conferem a versão sozinhos na NetTask; os barramentos dormem
+// até a próxima liberação, então são acordados para aplicar no fim do ciclo atual
+void onConfigChanged(uint8_t changes, void *ctx) {
+    if (!(changes & CONFIG_CHANGED_POLLING)) return;
+    for (uint8_t b = 0; b < MAX_BUSES; b++) busPollers[b].notifyConfigChanged();
+}
 
-    while (true) {
-        unsigned long start = millis();
+// --- Fila de um barramento cheia (política spill): a leitura vai direto para o flash ---
+// Roda na task do barramento; custa uma escrita no LittleFS, mas nada se perde
+void spillToOutbox(const MeterReading &reading, void *ctx) {
+    xSemaphoreTake(outboxLock, portMAX_DELAY);
+    outbox.push(reading);
+    xSemaphoreGive(outboxLock);
+}
 
-        // Itera sobre os medidores configurados
-        for (const auto &meter : sysConfig.meters) {
-            MeterReading reading;
-            
-            // Tenta ler do hardware RS485
-            if (modbusWorker.readMeter(meter.modbusId, reading)) {
-                
-                //  Usa o channelIndex configurado manualmente
-                reading.channelId = meter.channelIndex; 
-                
-                // Envia para a Fila
-                xQueueSend(readingQueue, &reading, pdMS_TO_TICKS(100));
+// --- Publicação de um ciclo lido agora ---
+// O que não couber na janela QoS 1 do MQTT vai para o outbox, e de lá só
+// sai com PUBACK (replayOutbox), como as leituras que o spill já gravou
+void publishCycle(const MeterReading *readings, size_t count) {
+    size_t sent = mqttWorker.isConnected() ? mqttWorker.publishBatch(readings, count) : 0;
+
+    if (sent > 0) {
+        Serial.printf(">> Enviado ciclo com %u canais\n", (unsigned)sent);
+    }
+    if (sent < count) {
+        xSemaphoreTake(outboxLock, portMAX_DELAY);
+        for (size_t i = sent; i < count; i++) outbox.push(readings[i]);
+        xSemaphoreGive(outboxLock);
+    }
+    if (sent < count) {
+        Serial.printf("!! MQTT indisponível ou janela cheia, %u leituras guardadas no outbox (%u pendentes)\n", (unsigned)(count - sent), (unsigned)outbox.size());
+    }
+}
+
+// --- Reenvio do Outbox (chamado pela PubTask) ---
+// Apaga do flash o que já teve PUBACK e entrega o próximo lote à janela QoS 1.
+// Entregue não é confirmado: um reboot antes do PUBACK reenvia do flash.
+void replayOutbox() {
+    uint32_t through;
+    if (mqttWorker.outboxAcked(through)) {
+        xSemaphoreTake(outboxLock, portMAX_DELAY);
+        outbox.ackThrough(through);
+        xSemaphoreGive(outboxLock);
+    }
+
+    if (outbox.unsent() == 0 || !mqttWorker.isConnected()) return;
+
+    MeterReading batch[OUTBOX_REPLAY_BATCH];
+    uint32_t seqs[OUTBOX_REPLAY_BATCH];
+    xSemaphoreTake(outboxLock, portMAX_DELAY);
+    size_t n = outbox.peek(batch, OUTBOX_REPLAY_BATCH, seqs);
+    xSemaphoreGive(outboxLock);
+
+    size_t sent = mqttWorker.publishBatch(batch, n, seqs);
+
+    // Um spill entre o peek e o markSent não atrapalha: só mexe no head (ou descarta do tail)
+    xSemaphoreTake(outboxLock, portMAX_DELAY);
+    outbox.markSent(sent);
+    xSemaphoreGive(outboxLock);
+
+    if (sent > 0) {
+        Serial.printf("↻ Outbox: %u leituras reenviadas (%u pendentes)\n", (unsigned)sent, (unsigned)outbox.size());
+    }
+}
+
+// --- Status (retido) dos medidores e do gateway ---
+// Publica quando algum medidor muda de estado ou a cada STATUS_INTERVAL_MS
+void publishHealth() {
+    static uint32_t lastPublish = 0;
+    static uint32_t lastChanges = 0;
+    static bool published = false;
+
+    uint32_t changes = 0;
+    for (uint8_t b = 0; b < MAX_BUSES; b++) changes += busPollers[b].healthChanges();
+
+    if (published && changes == lastChanges && millis() - lastPublish < STATUS_INTERVAL_MS) return;
+    if (!mqttWorker.isConnected()) return;
+
+    size_t online = 0, offline = 0;
+    for (uint8_t b = 0; b < MAX_BUSES; b++) {
+        MeterStatus st;
+        for (size_t i = 0; busPollers[b].meterStatus(i, st); i++) {
+            if (st.health.state == SLAVE_OFFLINE) offline++;
+            else online++;
+            if (!mqttWorker.publishMeterStatus(st)) return; // Tenta tudo de novo na próxima
+        }
+    }
+    if (!mqttWorker.publishGatewayStatus(online, offline)) return;
+
+    published = true;
+    lastChanges = changes;
+    lastPublish = millis();
+}
+
+// --- Métricas de runtime (/api/metrics e energymeter/{id}/metrics) ---
+// Partes 0..METRICS_GATEWAY_PARTS-1: gateway. Depois, para cada família dos
+// medidores, uma parte por medidor (o formato pede as amostras de uma família
+// juntas). Roda na task do servidor web ou na PubTask; só lê os contadores.
+
+static size_t totalMeters() {
+    size_t n = 0;
+    for (uint8_t b = 0; b < MAX_BUSES; b++) n += busPollers[b].meterCount();
+    return n;
+}
+
+static void renderGatewayPart(size_t part, PromWriter &w) {
+    char labels[24];
+    switch (part) {
+        case 0:
+            w.family("energymeter_uptime_seconds", "gauge", "Tempo desde o boot");
+            w.sample("energymeter_uptime_seconds", NULL, millis() / 1000);
+            w.family("energymeter_heap_free_bytes", "gauge", "Heap livre");
+            w.sample("energymeter_heap_free_bytes", NULL, ESP.getFreeHeap());
+            w.family("energymeter_heap_min_free_bytes", "gauge", "Menor heap livre desde o boot");
+            w.sample("energymeter_heap_min_free_bytes", NULL, ESP.getMinFreeHeap());
+            w.family("energymeter_heap_largest_block_bytes", "gauge", "Maior bloco alocavel");
+            w.sample("energymeter_heap_largest_block_bytes", NULL, ESP.getMaxAllocHeap());
+            w.family("energymeter_boot_config_load_microseconds", "gauge", "Tempo para carregar a configuracao no boot");
+            snprintf(labels, sizeof(labels), "source=\"%s\"", ConfigManager::sourceName(configManager.lastSource()));
+            w.sample("energymeter_boot_config_load_microseconds", labels, bootConfigLoadUs);
+            w.family("energymeter_boot_first_reading_milliseconds", "gauge", "Do boot ate a primeira leitura chegar na PubTask (0 = ainda nao)");
+            w.sample("energymeter_boot_first_reading_milliseconds", NULL, bootFirstReadingMs);
+            w.family("energymeter_task_stack_free_bytes", "gauge", "Menor folga de pilha ja vista por task");
+            if (netTask) w.sample("energymeter_task_stack_free_bytes", "task=\"NetTask\"", uxTaskGetStackHighWaterMark(netTask));
+            if (pubTask) w.sample("energymeter_task_stack_free_bytes", "task=\"PubTask\"", uxTaskGetStackHighWaterMark(pubTask));
+            for (uint8_t b = 0; b < MAX_BUSES; b++) {
+                if (busPollers[b].stackHighWater() == 0) continue;
+                snprintf(labels, sizeof(labels), "task=\"Modbus%u\"", b);
+                w.sample("energymeter_task_stack_free_bytes", labels, busPollers[b].stackHighWater());
+            }
+            break;
+        case 1:
+            // Filas de leituras (uma por barramento)
+            w.family("energymeter_reading_queue_depth", "gauge", "Leituras na fila do barramento");
+            for (uint8_t b = 0; b < MAX_BUSES; b++) {
+                if (busPollers[b].readings().capacity() == 0) continue;
+                snprintf(labels, sizeof(labels), "bus=\"%u\"", b);
+                w.sample("energymeter_reading_queue_depth", labels, busPollers[b].readings().size());
+            }
+            w.family("energymeter_reading_queue_capacity", "gauge", "Capacidade da fila do barramento");
+            for (uint8_t b = 0; b < MAX_BUSES; b++) {
+                if (busPollers[b].readings().capacity() == 0) continue;
+                snprintf(labels, sizeof(labels), "bus=\"%u\"", b);
+                w.sample("energymeter_reading_queue_capacity", labels, busPollers[b].readings().capacity());
+            }
+            w.family("energymeter_reading_queue_high_water", "gauge", "Maior ocupacao ja vista");
+            for (uint8_t b = 0; b < MAX_BUSES; b++) {
+                if (busPollers[b].readings().capacity() == 0) continue;
+                snprintf(labels, sizeof(labels), "bus=\"%u\"", b);
+                w.sample("energymeter_reading_queue_high_water", labels, busPollers[b].readings().highWater());
+            }
+            w.family("energymeter_reading_queue_dropped_total", "counter", "Leituras perdidas com a fila cheia");
+            for (uint8_t b = 0; b < MAX_BUSES; b++) {
+                if (busPollers[b].readings().capacity() == 0) continue;
+                snprintf(labels, sizeof(labels), "bus=\"%u\"", b);
+                w.sample("energymeter_reading_queue_dropped_total", labels, busPollers[b].readings().dropped());
+            }
+            w.family("energymeter_reading_queue_spilled_total", "counter", "Leituras desviadas para o outbox com a fila cheia");
+            for (uint8_t b = 0; b < MAX_BUSES; b++) {
+                if (busPollers[b].readings().capacity() == 0) continue;
+                snprintf(labels, sizeof(labels), "bus=\"%u\"", b);
+                w.sample("energymeter_reading_queue_spilled_total", labels, busPollers[b].readings().spilled());
+            }
+            break;
+        case 2:
+            w.family("energymeter_outbox_pending", "gauge", "Leituras aguardando reenvio no outbox");
+            w.sample("energymeter_outbox_pending", NULL, outbox.size());
+            w.family("energymeter_bus_cycle_overruns_total", "counter", "Ciclos de polling que passaram do periodo");
+            for (uint8_t b = 0; b < MAX_BUSES; b++) {
+                if (busPollers[b].meterCount() == 0) continue;
+                snprintf(labels, sizeof(labels), "bus=\"%u\"", b);
+                w.sample("energymeter_bus_cycle_overruns_total", labels, busPollers[b].stats().overruns);
             }
-            vTaskDelay(pdMS_TO_TICKS(50));
+            w.family("energymeter_readings_suppressed_total", "counter", "Leituras seguradas pela banda morta");
+            for (uint8_t b = 0; b < MAX_BUSES; b++) {
+                if (busPollers[b].meterCount() == 0) continue;
+                snprintf(labels, sizeof(labels), "bus=\"%u\"", b);
+                w.sample("energymeter_readings_suppressed_total", labels, busPollers[b].suppressed());
+            }
+            break;
+        case 3: {
+            const MqttMetrics &m = mqttWorker.metrics();
+            w.family("energymeter_mqtt_connects_total", "counter", "Conexoes MQTT estabelecidas");
+            w.sample("energymeter_mqtt_connects_total", NULL, m.connects);
+            w.family("energymeter_mqtt_connect_failures_total", "counter", "Tentativas de conexao MQTT que falharam");
+            w.sample("energymeter_mqtt_connect_failures_total", NULL, m.connectFailures);
+            w.family("energymeter_mqtt_disconnects_total", "counter", "Quedas de uma conexao MQTT estabelecida");
+            w.sample("energymeter_mqtt_disconnects_total", NULL, m.disconnects);
+            w.family("energymeter_mqtt_publish_failures_total", "counter", "Publishes recusados (fila cheia)");
+            w.sample("energymeter_mqtt_publish_failures_total", NULL, m.publishFailures);
+            w.family("energymeter_mqtt_publish_seconds", "histogram", "Escrita de cada publish no socket");
+            w.histogram("energymeter_mqtt_publish_seconds", NULL, m.publish);
+            break;
+        }
+        case 4: {
+            const WifiMetrics &m = networkManager.wifiMetrics();
+            w.family("energymeter_wifi_connects_total", "counter", "Conexoes WiFi com IP");
+            w.sample("energymeter_wifi_connects_total", NULL, m.connects);
+            w.family("energymeter_wifi_disconnects_total", "counter", "Quedas de uma conexao WiFi estabelecida");
+            w.sample("energymeter_wifi_disconnects_total", NULL, m.disconnects);
+            w.family("energymeter_wifi_connect_failures_total", "counter", "Tentativas de conexao WiFi que falharam");
+            w.sample("energymeter_wifi_connect_failures_total", NULL, m.failures);
+            w.family("energymeter_wifi_ap_fallbacks_total", "counter", "Vezes que o AP de emergencia subiu");
+            w.sample("energymeter_wifi_ap_fallbacks_total", NULL, m.apFallbacks);
+            w.family("energymeter_wifi_reconnect_last_milliseconds", "gauge", "Da ultima queda ate ter IP de novo");
+            w.sample("energymeter_wifi_reconnect_last_milliseconds", NULL, m.lastReconnectMs);
+            w.family("energymeter_wifi_reconnect_max_milliseconds", "gauge", "Maior tempo para religar desde o boot");
+            w.sample("energymeter_wifi_reconnect_max_milliseconds", NULL, m.maxReconnectMs);
+            w.family("energymeter_wifi_reconnect_seconds", "histogram", "Da queda ate ter IP de novo");
+            w.histogram("energymeter_wifi_reconnect_seconds", NULL, m.reconnect);
+            break;
+        }
+        case 5:
+            w.family("energymeter_tls_handshake_seconds", "histogram", "TCP + handshake TLS com o broker");
+            w.histogram("energymeter_tls_handshake_seconds", NULL, mqttWorker.metrics().tlsHandshake);
+            w.family("energymeter_tls_device_key_info", "gauge", "Tipo da chave do dispositivo no mTLS");
+            snprintf(labels, sizeof(labels), "type=\"%s\"", DeviceKey::name(mqttWorker.keyType()));
+            w.sample("energymeter_tls_device_key_info", labels, 1);
+            break;
+        case 6: {
+            const MqttSessionStats &m = mqttWorker.sessionStats();
+            w.family("energymeter_mqtt_acks_total", "counter", "PUBACK recebidos (leituras confirmadas pelo broker)");
+            w.sample("energymeter_mqtt_acks_total", NULL, m.acked);
+            w.family("energymeter_mqtt_retransmits_total", "counter", "PUBLISH QoS 1 reenviados depois de uma queda");
+            w.sample("energymeter_mqtt_retransmits_total", NULL, m.retransmits);
+            w.family("energymeter_mqtt_inflight", "gauge", "PUBLISH QoS 1 sem PUBACK");
+            w.sample("energymeter_mqtt_inflight", NULL, mqttWorker.inflight());
+            w.family("energymeter_mqtt_ack_seconds", "histogram", "Do PUBLISH escrito ate o PUBACK");
+            w.histogram("energymeter_mqtt_ack_seconds", NULL, m.ack);
+            break;
+        }
+        case 7: {
+            int32_t step = wallClock.lastStepMs();
+            w.family("energymeter_clock_synced", "gauge", "1 se o relogio ja sincronizou via SNTP (leituras em UTC)");
+            w.sample("energymeter_clock_synced", NULL, wallClock.synced() ? 1 : 0);
+            w.family("energymeter_clock_syncs_total", "counter", "Sincronizacoes SNTP desde o boot");
+            w.sample("energymeter_clock_syncs_total", NULL, wallClock.syncs());
+            w.family("energymeter_clock_last_step_milliseconds", "gauge", "Correcao do ultimo sync SNTP (em modulo)");
+            w.sample("energymeter_clock_last_step_milliseconds", NULL, step < 0 ? -(int64_t)step : step);
+            break;
         }
+        default:
+            w.family("energymeter_mqtt_reconnect_last_milliseconds", "gauge", "Da ultima queda do MQTT ate conectar de novo");
+            w.sample("energymeter_mqtt_reconnect_last_milliseconds", NULL, mqttWorker.metrics().lastReconnectMs);
+            w.family("energymeter_mqtt_reconnect_seconds", "histogram", "Da queda do MQTT ate conectar de novo");
+            w.histogram("energymeter_mqtt_reconnect_seconds", NULL, mqttWorker.metrics().reconnect);
+            break;
+    }
+}
+
+bool renderMetrics(size_t part, Print &out) {
+    PromWriter w(out);
+    if (part < METRICS_GATEWAY_PARTS) {
+        renderGatewayPart(part, w);
+        return true;
+    }
 
-        // Espera o intervalo configurado (Ex: 5 min)
-        // Nota: Cálculo simplificado. O ideal é usar millis() diff para precisão.
-        vTaskDelay(pdMS_TO_TICKS(sysConfig.interval * 1000));
+    size_t meters = totalMeters();
+    if (meters == 0) return false;
+    size_t family = (part - METRICS_GATEWAY_PARTS) / meters;
+    size_t n = (part - METRICS_GATEWAY_PARTS) % meters;
+    if (family >= 3) return false;
+
+    // n-ésimo medidor somando os barramentos
+    uint8_t b = 0;
+    while (b < MAX_BUSES && n >= busPollers[b].meterCount()) n -= busPollers[b++].meterCount();
+    MeterStatus st;
+    // Lista trocada pelo /api/save no meio da resposta: a parte sai vazia
+    if (b == MAX_BUSES || !busPollers[b].meterStatus(n, st)) return true;
+    bool first = (part - METRICS_GATEWAY_PARTS) % meters == 0;
+
+    char labels[64];
+    char resultLabels[80];
+    snprintf(labels, sizeof(labels), "bus=\"%u\",modbus_id=\"%u\",channel=\"%u\"", st.bus, st.modbusId, st.channelId);
+
+    switch (family) {
+        case 0:
+            if (first) w.family("energymeter_modbus_slave_up", "gauge", "1 se o medidor esta respondendo");
+            w.sample("energymeter_modbus_slave_up", labels, st.health.state == SLAVE_ONLINE ? 1 : 0);
+            break;
+        case 1:
+            if (first) w.family("energymeter_modbus_transactions_total", "counter", "Transacoes ok e leituras com erro (uma por ciclo)");
+            snprintf(resultLabels, sizeof(resultLabels), "%s,result=\"ok\"", labels);
+            w.sample("energymeter_modbus_transactions_total", resultLabels, st.health.okCount);
+            snprintf(resultLabels, sizeof(resultLabels), "%s,result=\"error\"", labels);
+            w.sample("energymeter_modbus_transactions_total", resultLabels, st.health.failCount);
+            break;
+        default:
+            if (first) w.family("energymeter_modbus_response_seconds", "histogram", "Tempo de resposta do escravo");
+            w.histogram("energymeter_modbus_response_seconds", labels, st.health.response);
+            break;
     }
+    return true;
 }
 
-// --- Tarefa 3: Processador de Fila MQTT (Core 1) ---
+// Só o gateway vai para o MQTT: o estado de cada medidor já sai em status/{canal}
+void publishMetrics() {
+    static uint32_t lastPublish = 0;
+    static bool published = false;
+    static char text[METRICS_GATEWAY_PARTS * RESPONSE_PART_SIZE]; // Uma RESPONSE_PART_SIZE por parte do gateway
+
+    if (published && millis() - lastPublish < METRICS_INTERVAL_MS) return;
+    if (!mqttWorker.isConnected()) return;
+    if (mqttWorker.metricsPending()) return; // A NetTask ainda escreve o texto anterior
+
+    BufferPrint out(text, sizeof(text));
+    for (size_t part = 0; part < METRICS_GATEWAY_PARTS; part++) renderMetrics(part, out);
+    if (out.overflow()) Serial.println("⚠️ Métricas truncadas (aumente o buffer)");
+
+    if (!mqttWorker.publishMetrics(text, out.length())) return;
+    published = true;
+    lastPublish = millis();
+}
+
+static bool endsCycle(const MeterReading &reading) {
+    return (reading.flags & READING_CYCLE_END) != 0;
+}
+
+// --- Tarefa 2: Publicação MQTT (Core 1) ---
+// (As tasks de leitura Modbus ficam em BusPoller, uma por barramento)
 void taskMqttPublisher(void *parameter) {
-    MeterReading incomingReading;
+    static MeterReading batch[MAX_CYCLE_READINGS];
 
     while (true) {
-        // Fica bloqueado aqui até chegar algo na fila
-        if (xQueueReceive(readingQueue, &incomingReading, portMAX_DELAY)) {
-            
-            // Chegou dado! Publica no broker
-            if (networkManager.isWifiConnected()) {
-                mqttWorker.publishReading(sysConfig.deviceId, incomingReading);
-                Serial.printf(">> Enviado canal %d: %.2f kWh\n", incomingReading.channelId, incomingReading.totalKwh);
-            } else {
-                Serial.println("!! Sem WiFi, descartando leitura (bufferizar futuramente)");
+        // Esvazia as filas, publicando cada ciclo inteiro (até READING_CYCLE_END).
+        // Acordando no meio de um ciclo (outro barramento, replay, status), o
+        // pedaço já lido fica na fila até o fim dele chegar; só um lote cheio
+        // sem fim (ciclo > MAX_CYCLE_READINGS) sai dividido.
+        for (uint8_t b = 0; b < MAX_BUSES; b++) {
+            size_t n;
+            while ((n = busPollers[b].readings().popThrough(batch, MAX_CYCLE_READINGS, endsCycle)) > 0) {
+                if (!bootFirstReadingMs) {
+                    bootFirstReadingMs = millis();
+                    Serial.printf("⏱️ Primeira leitura %u ms após o boot\n", (unsigned)bootFirstReadingMs);
+                }
+                size_t start = 0;
+                for (size_t i = 0; i < n; i++) {
+                    if (!(batch[i].flags & READING_CYCLE_END) && i + 1 < n) continue;
+                    publishCycle(batch + start, i + 1 - start);
+                    start = i + 1;
+                }
             }
         }
+
+        replayOutbox();
+        publishHealth();
+        publishMetrics();
+
+        // Os barramentos notificam no fim de cada ciclo. Com pendências no
+        // outbox acorda periodicamente para reenviar (throttling); senão
+        // acorda para republicar o status (se todos os medidores caírem,
+        // não chega leitura nenhuma). Esperar só no fim da volta pega os
+        // ciclos que terminaram antes de esta task existir.
+        TickType_t wait = pdMS_TO_TICKS(outbox.size() > 0 ? OUTBOX_REPLAY_INTERVAL_MS : STATUS_INTERVAL_MS);
+        ulTaskNotifyTake(pdTRUE, wait);
     }
 }
 
 void setup() {
     Serial.begin(115200);
     
-    // 1. Carregar Configurações
+    // 1. Carregar Configurações (snapshot binário; o JSON só se ele estiver ausente/desatualizado)
     if (!configManager.begin()) {
         Serial.println("Erro no LittleFS! Formatando...");
     }
-    sysConfig = configManager.load();
+    uint32_t loadStart = micros();
+    SystemConfig config = configManager.load();
+    bootConfigLoadUs = micros() - loadStart;
+    Serial.printf("⏱️ Config (%s) carregada em %u us\n", ConfigManager::sourceName(configManager.lastSource()), (unsigned)bootConfigLoadUs);
+    // O Device ID é sempre o MAC, qualquer que seja o do arquivo
+    config.deviceId = networkManager.getDeviceId();
+    Serial.println("🔒 Device ID (MAC): " + config.deviceId);
+    configStore.publish(config);
+    configStore.setListener(onConfigChanged);
+    networkManager.setMetricsRenderer(renderMetrics);
+    networkManager.setBuses(busPollers, MAX_BUSES);
+    wallClock.begin(esp_random()); // Distingue leituras deste boot no outbox
 
-    // 2. Criar Fila de Dados (Capacidade para 50 leituras)
-    readingQueue = xQueueCreate(50, sizeof(MeterReading));
+    // 2. Filas de leituras: uma por barramento, criadas no start() de cada BusPoller
 
     // 3. Criar Tarefas
+    // Core 1: Coisas de Hardware e Lógica (Modbus, MQTT Publish)
+    // Os barramentos sobem primeiro: a recuperação do outbox (varre o log
+    // inteiro) roda enquanto o primeiro ciclo já está no fio. Um spill nesse
+    // meio-tempo espera o lock, que só é liberado com o outbox pronto.
+    outboxLock = xSemaphoreCreateMutex();
+    xSemaphoreTake(outboxLock, portMAX_DELAY);
+    // Uma task de polling por barramento RS485 (prioridade 2, ver BusPoller)
+    for (uint8_t b = 0; b < config.buses.size() && b < MAX_BUSES; b++) {
+        busPollers[b].start(b, configStore, &pubTask, spillToOutbox);
+    }
+
     // Core 0: Coisas de Rede (WiFi, WebServer)
-    xTaskCreatePinnedToCore(taskNetwork, "NetTask", 4096, NULL, 1, NULL, 0);
+    xTaskCreatePinnedToCore(taskNetwork, "NetTask", 4096, NULL, 1, &netTask, 0);
 
-    // Core 1: Coisas de Hardware e Lógica (Modbus, MQTT Publish)
-    // Prioridade do Modbus é mais alta (2) para garantir precisão no tempo
-    xTaskCreatePinnedToCore(taskModbus, "ModbusTask", 4096, NULL, 2, NULL, 1);
-    xTaskCreatePinnedToCore(taskMqttPublisher, "PubTask", 4096, NULL, 1, NULL, 1);
+    outbox.begin();
+    xSemaphoreGive(outboxLock);
+    xTaskCreatePinnedToCore(taskMqttPublisher, "PubTask", 4096, NULL, 1, &pubTask, 1);
 
     Serial.println("--- EnergyMe Firmware Iniciado ---");
 }
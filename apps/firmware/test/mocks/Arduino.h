@@ -1,5 +1,6 @@
 #pragma once
 #include <iostream>
+#include <cstdio>
 #include <string>
 #include <cstring>
 #include <stdint.h>
@@ -29,6 +30,23 @@ public:
 };
 static SerialMock Serial;
 
-// Simula funções de tempo
-inline unsigned long millis() { return 0; }
-inline void delay(int) {}
\ No newline at end of file
+// Simula funções de tempo com um relógio virtual controlado pelos testes.
+// delay() avança o relógio em vez de dormir.
+static unsigned long mockMillis = 0;
+inline unsigned long millis() { return mockMillis; }
+inline void delay(int ms) { mockMillis += ms; }
+
+// Simula a classe Print (saída de bytes: Serial, resposta HTTP, cliente MQTT)
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t n = 0;
+    while (size--)
+      n += write(*buffer++);
+    return n;
+  }
+};
@@ -0,0 +1,53 @@
+#pragma once
+// SystemConfig de teste, o mesmo para todas as suítes.
+//
+// Uma central "Kitnets" com `meters` medidores espalhados por `buses`
+// barramentos (o segundo em Serial1, 19200 8E1, DE no GPIO 27). Cada
+// medidor i (base 0) tem id e canal i + 1, modbusId 10 + i, nome
+// "Kitnet <101 + i>" e varia de modelo (i % METER_MODEL_COUNT), de
+// período (30 s a cada terceiro), de barramento (i % buses) e de deadband
+// (15 W a cada terceiro), para os testes de ida e volta cobrirem os campos.
+// Quem precisa de outro valor muda o campo depois.
+#include <string>
+
+#include "Arduino.h"
+#include "../../include/AppConfig.h"
+
+inline SystemConfig makeConfig(size_t meters = 1, uint8_t buses = 1)
+{
+  SystemConfig config;
+  config.wifiSsid = "Kitnets";
+  config.wifiPass = "segredo";
+  config.apModeForce = false;
+  config.mqttServer = "broker.local";
+  config.mqttPort = 8883;
+  config.deviceId = "A1B2C3D4E5F6";
+  config.interval = 60;
+
+  config.buses.push_back(BusConfig());
+  if (buses > 1)
+  {
+    BusConfig second;
+    second.uart = 1;
+    second.dePin = 27;
+    second.baud = 19200;
+    second.parity = PARITY_EVEN;
+    config.buses.push_back(second);
+  }
+
+  for (size_t i = 0; i < meters; i++)
+  {
+    MeterConfig m;
+    m.id = i + 1;
+    m.channelIndex = i + 1;
+    m.modbusId = 10 + i % 238; // 10..247
+    m.model = (MeterModel)(i % METER_MODEL_COUNT);
+    m.periodSec = i % 3 ? 0 : 30;
+    m.bus = i % config.buses.size();
+    m.deadband.power = i % 3 ? 0.0f : 15.0f;
+    m.deadband.heartbeatSec = 600;
+    m.name = "Kitnet " + std::to_string(101 + i);
+    config.meters.push_back(m);
+  }
+  return config;
+}
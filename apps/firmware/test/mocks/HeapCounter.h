@@ -0,0 +1,88 @@
+#pragma once
+// Intercepta malloc/free do processo de teste (glibc) para contar alocações
+// e o pico de bytes vivos. Incluir em UM único arquivo de teste por executável.
+#include <stddef.h>
+#include <malloc.h>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+struct HeapStats
+{
+  size_t allocs; // malloc/calloc/realloc
+  size_t frees;
+  size_t peakBytes; // Maior soma de bytes alocados (e ainda não liberados) desde o start
+};
+
+static HeapStats heapStats;
+static bool heapCounting = false;
+static long heapLiveBytes = 0; // Pode ficar negativo: libera o que foi alocado antes do start
+
+inline void heapTrack(long delta)
+{
+  heapLiveBytes += delta;
+  if (heapLiveBytes > (long)heapStats.peakBytes)
+    heapStats.peakBytes = heapLiveBytes;
+}
+
+// Zera os contadores e começa a contar
+inline void heapCountStart()
+{
+  heapStats.allocs = 0;
+  heapStats.frees = 0;
+  heapStats.peakBytes = 0;
+  heapLiveBytes = 0;
+  heapCounting = true;
+}
+
+inline HeapStats heapCountStop()
+{
+  heapCounting = false;
+  return heapStats;
+}
+
+extern "C" void *malloc(size_t size)
+{
+  void *p = __libc_malloc(size);
+  if (heapCounting)
+  {
+    heapStats.allocs++;
+    heapTrack(malloc_usable_size(p));
+  }
+  return p;
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+  void *p = __libc_calloc(n, size);
+  if (heapCounting)
+  {
+    heapStats.allocs++;
+    heapTrack(malloc_usable_size(p));
+  }
+  return p;
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  long before = (heapCounting && ptr) ? (long)malloc_usable_size(ptr) : 0;
+  void *p = __libc_realloc(ptr, size);
+  if (heapCounting)
+  {
+    heapStats.allocs++;
+    heapTrack((long)malloc_usable_size(p) - before);
+  }
+  return p;
+}
+
+extern "C" void free(void *ptr)
+{
+  if (heapCounting && ptr)
+  {
+    heapStats.frees++;
+    heapTrack(-(long)malloc_usable_size(ptr));
+  }
+  __libc_free(ptr);
+}
@@ -1,34 +1,141 @@
 #pragma once
 #include "Arduino.h"
+#include <map>
+#include <memory>
 
-class File
+// Sistema de arquivos em RAM: cada arquivo é um vetor de bytes compartilhado
+// entre todos os handles abertos (como no LittleFS real).
+typedef std::vector<uint8_t> FileData;
+
+class File : public Print
 {
 public:
-  operator bool() const { return true; }
-  void close() {}
+  File() : _pos(0) {}
+  File(std::shared_ptr<FileData> data, size_t pos) : _data(data), _pos(pos) {}
+
+  operator bool() const { return (bool)_data; }
+  void close() { _data.reset(); }
+  void flush() {}
+
+  size_t size() const { return _data ? _data->size() : 0; }
+  size_t position() const { return _pos; }
+  int available() { return _data ? (int)(_data->size() - _pos) : 0; }
+
+  bool seek(uint32_t pos)
+  {
+    if (!_data || pos > _data->size())
+      return false;
+    _pos = pos;
+    return true;
+  }
 
   // Usado por algumas libs
-  size_t readBytes(char *buffer, size_t length) { return 0; }
+  size_t readBytes(char *buffer, size_t length) { return read((uint8_t *)buffer, length); }
+
+  size_t read(uint8_t *buffer, size_t length)
+  {
+    if (!_data)
+      return 0;
+    size_t n = _data->size() - _pos;
+    if (n > length)
+      n = length;
+    if (n)
+      memcpy(buffer, _data->data() + _pos, n);
+    _pos += n;
+    return n;
+  }
+
+  String readString()
+  {
+    String s;
+    int c;
+    while ((c = read()) >= 0)
+      s += (char)c;
+    return s;
+  }
+
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
 
   // --- MÉTODOS PARA ARDUINOJSON v7 ---
 
-  int read() { return -1; }
+  int read()
+  {
+    if (!_data || _pos >= _data->size())
+      return -1;
+    return (*_data)[_pos++];
+  }
+
+  int peek()
+  {
+    if (!_data || _pos >= _data->size())
+      return -1;
+    return (*_data)[_pos];
+  }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t length) override
+  {
+    if (!_data)
+      return 0;
+    if (_pos + length > _data->size())
+      _data->resize(_pos + length);
+    memcpy(_data->data() + _pos, buffer, length);
+    _pos += length;
+    return length;
+  }
 
-  size_t write(uint8_t c) { return 1; }
-  size_t write(const uint8_t *buffer, size_t length) { return length; }
+private:
+  std::shared_ptr<FileData> _data;
+  size_t _pos;
 };
 
 class LittleFSMock
 {
 public:
   bool begin(bool fmt) { return true; }
-  bool exists(const char *path) { return false; }
-  bool remove(const char *path) { return true; }
+  bool exists(const char *path) { return _files.count(path) > 0; }
+  bool remove(const char *path) { return _files.erase(path) > 0; }
+  void format() { _files.clear(); }
 
-  File open(const char *path, const char *mode)
+  bool rename(const char *from, const char *to)
   {
-    return File();
+    std::map<std::string, std::shared_ptr<FileData> >::iterator it = _files.find(from);
+    if (it == _files.end())
+      return false;
+    _files[to] = it->second;
+    _files.erase(from);
+    return true;
   }
+
+  File open(const char *path, const char *mode = "r")
+  {
+    std::map<std::string, std::shared_ptr<FileData> >::iterator it = _files.find(path);
+    bool found = it != _files.end();
+
+    if (mode[0] == 'r')
+    {
+      if (!found)
+        return File();
+      return File(it->second, 0);
+    }
+
+    // "w" e "a" criam o arquivo se não existir
+    if (!found)
+      it = _files.insert(std::make_pair(std::string(path), std::make_shared<FileData>())).first;
+    if (mode[0] == 'w')
+      it->second->clear();
+    return File(it->second, mode[0] == 'a' ? it->second->size() : 0);
+  }
+
+  // Acesso direto aos bytes (usado nos testes para simular corrupção)
+  FileData *raw(const char *path)
+  {
+    std::map<std::string, std::shared_ptr<FileData> >::iterator it = _files.find(path);
+    return it == _files.end() ? NULL : it->second.get();
+  }
+
+private:
+  std::map<std::string, std::shared_ptr<FileData> > _files;
 };
 
-static LittleFSMock LittleFS;
\ No newline at end of file
+static LittleFSMock LittleFS;
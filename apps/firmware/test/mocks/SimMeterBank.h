@@ -0,0 +1,225 @@
+#pragma once
+// Banco de medidores simulados atrás de um RtuPort (teste nativo).
+//
+// Faz o papel do barramento RS485 inteiro: recebe os quadros do mestre,
+// responde como os escravos responderiam e entrega cada byte só quando o
+// relógio virtual chega ao instante em que ele terminaria de chegar no fio.
+// waitEvent() pula o relógio direto para o próximo byte ou prazo, então um
+// ciclo de 247 medidores roda em milissegundos e sempre do mesmo jeito.
+//
+// O relógio em us vira o millis() do mock (mockMillis), que é o que o
+// ModbusWorker usa para a saúde dos medidores.
+#include <map>
+#include <deque>
+#include <vector>
+
+#include "Arduino.h"
+#include "../../include/ModbusRtuMaster.h"
+
+// Comportamento de um escravo
+struct SimMeter {
+    MeterModel model = METER_DDS238;
+    uint32_t latencyUs = 5000;   // Do fim da requisição ao primeiro byte da resposta
+    bool silent = false;         // Não responde nada (desligado, endereço errado)
+    uint8_t dropPct = 0;         // % de requisições ignoradas
+    uint8_t corruptPct = 0;      // % de respostas com um byte trocado (erro de CRC)
+    uint32_t baud = 0;           // Só responde com o banco nesta linha (0 = qualquer uma)
+    SerialParity parity = PARITY_NONE;
+    std::map<uint32_t, uint16_t> regs; // (função << 16) | endereço -> valor
+};
+
+// Contadores do barramento
+struct SimBusStats {
+    uint32_t requests;    // Quadros enviados pelo mestre
+    uint32_t replies;     // Respostas completas (inclui exceções e corrompidas)
+    uint32_t exceptions;
+    uint32_t dropped;     // Ignoradas (silent ou dropPct)
+    uint32_t corrupted;
+    uint32_t busyUs;      // Tempo com o fio ocupado (requisições + respostas)
+};
+
+class SimMeterBank : public RtuPort {
+public:
+    explicit SimMeterBank(uint32_t baud = 9600, uint32_t seed = 1)
+        : _timing(RtuTiming::forBaud(baud)), _seed(seed ? seed : 1) {
+        _line.baud = baud;
+        _line.parity = PARITY_NONE;
+        _clockUs = (uint64_t)mockMillis * 1000;
+        memset(&_stats, 0, sizeof(_stats));
+    }
+
+    // Cria (ou devolve) o escravo com este endereço
+    SimMeter &add(uint8_t slave, MeterModel model = METER_DDS238) {
+        SimMeter &m = _meters[slave];
+        m.model = model;
+        // Os registradores que o modelo tem (zerados): fora deles o escravo responde exceção 02
+        const ReadPlan &plan = MeterProfiles::plan(model);
+        for (uint8_t b = 0; b < plan.blockCount; b++) {
+            for (uint16_t i = 0; i < plan.blocks[b].count; i++) {
+                m.regs[((uint32_t)plan.blocks[b].function << 16) | (uint16_t)(plan.blocks[b].start + i)];
+            }
+        }
+        return m;
+    }
+
+    SimMeter &meter(uint8_t slave) { return _meters[slave]; }
+
+    // Grava uma grandeza no mapa de registradores, na codificação do perfil do modelo
+    void set(uint8_t slave, MeterQuantity q, float value) {
+        SimMeter &m = _meters[slave];
+        const RegisterField &f = METER_PROFILES[m.model].fields[q];
+        uint32_t key = ((uint32_t)f.function << 16) | f.address;
+        float raw = value / f.scale;
+
+        uint32_t bits;
+        switch (f.type) {
+            case REG_U16:
+            case REG_S16:
+                m.regs[key] = (uint16_t)(int32_t)(raw + (raw < 0 ? -0.5f : 0.5f));
+                return;
+            case REG_F32:
+                memcpy(&bits, &raw, sizeof(bits));
+                break;
+            default:
+                bits = (uint32_t)(int32_t)(raw + (raw < 0 ? -0.5f : 0.5f));
+                break;
+        }
+        uint16_t hi = bits >> 16, lo = bits & 0xFFFF;
+        m.regs[key] = f.order == WORDS_ABCD ? hi : lo;
+        m.regs[key + 1] = f.order == WORDS_ABCD ? lo : hi;
+    }
+
+    const SimBusStats &stats() const { return _stats; }
+    const RtuTiming &timing() const { return _timing; }
+    const SerialLine &line() const { return _line; }
+    uint64_t clockUs() const { return _clockUs; }
+
+    // --- RtuPort ---
+
+    void send(const uint8_t *frame, size_t len) override {
+        sync();
+        _stats.requests++;
+        _stats.busyUs += len * _timing.charUs;
+        uint64_t txEnd = _clockUs + len * _timing.charUs;
+
+        if (len != 8) return;
+        uint16_t crc = crc16Modbus(frame, 6);
+        if (frame[6] != (crc & 0xFF) || frame[7] != (crc >> 8)) return;
+
+        std::map<uint8_t, SimMeter>::iterator it = _meters.find(frame[0]);
+        if (it == _meters.end()) return; // Ninguém com esse endereço
+        SimMeter &m = it->second;
+        // Em outra linha o escravo recebe lixo, o CRC não bate e ele fica quieto
+        bool wrongLine = m.baud && (m.baud != _line.baud || m.parity != _line.parity);
+        if (m.silent || wrongLine || chance(m.dropPct)) {
+            _stats.dropped++;
+            return;
+        }
+
+        uint8_t fc = frame[1];
+        uint16_t start = (frame[2] << 8) | frame[3];
+        uint16_t count = (frame[4] << 8) | frame[5];
+
+        std::vector<uint8_t> reply;
+        reply.push_back(frame[0]);
+        uint8_t exception = 0;
+        if (fc != FC_HOLDING && fc != FC_INPUT) exception = 0x01;       // Função ilegal
+        else if (count == 0 || count > MODBUS_MAX_READ_REGS) exception = 0x03;
+        else {
+            for (uint16_t i = 0; i < count && !exception; i++) {
+                if (!m.regs.count(((uint32_t)fc << 16) | (uint16_t)(start + i))) exception = 0x02; // Endereço ilegal
+            }
+        }
+
+        if (exception) {
+            reply.push_back(fc | 0x80);
+            reply.push_back(exception);
+            _stats.exceptions++;
+        } else {
+            reply.push_back(fc);
+            reply.push_back(2 * count);
+            for (uint16_t i = 0; i < count; i++) {
+                uint16_t v = m.regs[((uint32_t)fc << 16) | (uint16_t)(start + i)];
+                reply.push_back(v >> 8);
+                reply.push_back(v & 0xFF);
+            }
+        }
+        crc = crc16Modbus(reply.data(), reply.size());
+        reply.push_back(crc & 0xFF);
+        reply.push_back(crc >> 8);
+
+        if (chance(m.corruptPct)) {
+            reply[reply.size() / 2] ^= 0x5A;
+            _stats.corrupted++;
+        }
+
+        uint64_t t = txEnd + m.latencyUs;
+        for (size_t i = 0; i < reply.size(); i++) {
+            t += _timing.charUs;
+            _rx.push_back(std::make_pair(t, reply[i]));
+        }
+        _stats.replies++;
+        _stats.busyUs += reply.size() * _timing.charUs;
+    }
+
+    size_t receive(uint8_t *buf, size_t max) override {
+        sync();
+        size_t n = 0;
+        while (n < max && !_rx.empty() && _rx.front().first <= _clockUs) {
+            buf[n++] = _rx.front().second;
+            _rx.pop_front();
+        }
+        return n;
+    }
+
+    uint32_t nowUs() override {
+        sync();
+        return (uint32_t)_clockUs;
+    }
+
+    // Acorda no primeiro byte que chegar ou no prazo, o que vier antes
+    void waitEvent(uint32_t timeoutUs) override {
+        sync();
+        uint64_t wake = _clockUs + timeoutUs;
+        if (!_rx.empty() && _rx.front().first < wake) wake = _rx.front().first;
+        advanceTo(wake);
+    }
+
+    // waitEvent() acorda exatamente no byte: o silêncio medido é o do fio
+    bool exactByteTimes() const override { return true; }
+
+    bool setLine(const SerialLine &line) override {
+        sync();
+        _line = line;
+        _timing = RtuTiming::forBaud(line.baud);
+        return true;
+    }
+
+private:
+    RtuTiming _timing;
+    SerialLine _line;
+    uint32_t _seed;
+    uint64_t _clockUs;
+    SimBusStats _stats;
+    std::map<uint8_t, SimMeter> _meters;
+    std::deque<std::pair<uint64_t, uint8_t> > _rx;
+
+    void advanceTo(uint64_t t) {
+        if (t > _clockUs) _clockUs = t;
+        mockMillis = _clockUs / 1000;
+    }
+
+    // O teste pode avançar o millis() entre ciclos (delay): o barramento acompanha
+    void sync() {
+        if ((uint64_t)mockMillis * 1000 > _clockUs) _clockUs = (uint64_t)mockMillis * 1000;
+    }
+
+    // Sorteio determinístico (xorshift32) para as falhas configuradas
+    bool chance(uint8_t pct) {
+        if (pct == 0) return false;
+        _seed ^= _seed << 13;
+        _seed ^= _seed >> 17;
+        _seed ^= _seed << 5;
+        return _seed % 100 < pct;
+    }
+};
@@ -0,0 +1,5 @@
+#pragma once
+#include "Arduino.h"
+
+// Relógio monotônico do ESP-IDF em µs, sobre o relógio virtual dos testes
+inline int64_t esp_timer_get_time() { return (int64_t)mockMillis * 1000; }
@@ -0,0 +1,313 @@
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <chrono>
+#include <cstdlib>
+
+#include "../mocks/Arduino.h"
+#include "../mocks/LittleFS.h"
+#include "../mocks/HeapCounter.h"
+#include "../mocks/ConfigFixture.h"
+
+#define private public
+#include "../../src/ConfigManager.cpp"
+#undef private
+#include "../../src/MeterProfiles.cpp"
+#include "../../src/TelemetryEncoder.cpp"
+#include "../../src/WallClock.cpp"
+#include "../../src/SlaveHealth.cpp"
+#include "../../src/Metrics.cpp"
+#include "../../src/ReadingOutbox.cpp"
+#include "../../src/AtomicFile.cpp"
+#include "../../src/ConfigSnapshot.cpp"
+#include "../../src/JsonInput.cpp"
+
+// Microbenchmarks dos caminhos quentes (env:native_bench).
+//
+// Cada caso mede o tempo por operação (laço calibrado para ~50 ms) e, numa
+// execução separada, as alocações por operação e o pico de bytes vivos.
+// Os números saem em JSON no stdout (linha "BENCH_JSON ...") e, se a variável
+// BENCH_JSON apontar para um arquivo, lá também, para comparar entre builds.
+// As asserções só pegam regressões grosseiras; o acompanhamento fino é pelo JSON.
+
+struct BenchResult
+{
+  const char *name;
+  size_t n;           // Tamanho do caso (medidores, canais, leituras)
+  uint32_t iterations;
+  double nsPerOp;
+  double allocsPerOp;
+  size_t peakBytes;   // Pico de heap de uma operação
+};
+
+static std::vector<BenchResult> results;
+
+static double nowNs()
+{
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename F>
+static const BenchResult &bench(const char *name, size_t n, F op)
+{
+  // Aquece (primeira chamada costuma alocar buffers que depois são reaproveitados)
+  op();
+
+  BenchResult r;
+  r.name = name;
+  r.n = n;
+
+  heapCountStart();
+  op();
+  HeapStats heap = heapCountStop();
+  r.peakBytes = heap.peakBytes;
+
+  uint32_t iterations = 1;
+  double elapsed = 0;
+  while (true)
+  {
+    heapCountStart();
+    double start = nowNs();
+    for (uint32_t i = 0; i < iterations; i++)
+      op();
+    elapsed = nowNs() - start;
+    heap = heapCountStop();
+    if (elapsed > 50e6 || iterations >= (1u << 24))
+      break;
+    iterations *= elapsed < 5e6 ? 8 : 2;
+  }
+  r.iterations = iterations;
+  r.nsPerOp = elapsed / iterations;
+  r.allocsPerOp = (double)heap.allocs / iterations;
+
+  results.push_back(r);
+  return results.back();
+}
+
+// --- Dados de entrada ---
+
+static std::string configJson(size_t meters)
+{
+  ConfigManager manager;
+  JsonDocument doc;
+  manager.serialize(makeConfig(meters), doc);
+  std::string json;
+  serializeJson(doc, json);
+  return json;
+}
+
+static MeterReading readings[64];
+static char payload[8192];
+
+void setUp(void)
+{
+  for (int i = 0; i < 64; i++)
+  {
+    memset(&readings[i], 0, sizeof(MeterReading));
+    readings[i].channelId = i + 1;
+    readings[i].voltage = 220.5f;
+    readings[i].current = 12.34f;
+    readings[i].power = 2721.0f;
+    readings[i].totalKwh = 12345.67f;
+  }
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+static const size_t METER_COUNTS[] = {1, 8, 32, 128};
+static const size_t CHANNEL_COUNTS[] = {1, 8, 32, 64};
+
+void test_bench_config_parse()
+{
+  for (size_t k = 0; k < sizeof(METER_COUNTS) / sizeof(METER_COUNTS[0]); k++)
+  {
+    size_t n = METER_COUNTS[k];
+    std::string json = configJson(n);
+    ConfigManager manager;
+    size_t parsed = 0;
+
+    bench("config_parse", n, [&]() {
+      JsonDocument doc;
+      deserializeJson(doc, json);
+      parsed = manager.deserialize(doc).meters.size();
+    });
+    TEST_ASSERT_EQUAL_INT(n, parsed);
+  }
+}
+
+// Caminho do boot: o mesmo config lido do snapshot binário (compare com config_parse)
+void test_bench_config_snapshot_decode()
+{
+  for (size_t k = 0; k < sizeof(METER_COUNTS) / sizeof(METER_COUNTS[0]); k++)
+  {
+    size_t n = METER_COUNTS[k];
+    std::vector<uint8_t> snapshot;
+    ConfigSnapshot::encode(makeConfig(n), 0, snapshot);
+    size_t parsed = 0;
+
+    bench("config_snapshot_decode", n, [&]() {
+      SystemConfig config;
+      uint32_t sourceCrc;
+      ConfigSnapshot::decode(snapshot.data(), snapshot.size(), config, sourceCrc);
+      parsed = config.meters.size();
+    });
+    TEST_ASSERT_EQUAL_INT(n, parsed);
+  }
+}
+
+void test_bench_config_serialize()
+{
+  for (size_t k = 0; k < sizeof(METER_COUNTS) / sizeof(METER_COUNTS[0]); k++)
+  {
+    size_t n = METER_COUNTS[k];
+    SystemConfig config = makeConfig(n);
+    ConfigManager manager;
+    std::string out;
+
+    bench("config_serialize", n, [&]() {
+      JsonDocument doc;
+      manager.serialize(config, doc);
+      out.clear();
+      serializeJson(doc, out);
+    });
+    TEST_ASSERT_GREATER_THAN(n * 20, out.size());
+  }
+}
+
+// Caminho do /api/save e do load(): cabeçalho filtrado e um medidor por vez
+// (compare o pico com config_parse; o que cresce é só a lista de saída)
+void test_bench_config_stream_parse()
+{
+  for (size_t k = 0; k < sizeof(METER_COUNTS) / sizeof(METER_COUNTS[0]); k++)
+  {
+    size_t n = METER_COUNTS[k];
+    std::string json = configJson(n);
+    size_t parsed = 0;
+
+    bench("config_stream_parse", n, [&]() {
+      BufferJsonInput in(json.data(), json.size());
+      JsonDocument doc;
+      std::vector<MeterConfig> meters;
+      ConfigManager::readHeader(in, doc);
+      in.rewind();
+      ConfigManager::readMeters(in, meters);
+      parsed = meters.size();
+    });
+    TEST_ASSERT_EQUAL_INT(n, parsed);
+  }
+}
+
+// Caminho do save() e do /api/config: uma parte por vez num buffer fixo
+void test_bench_config_write_parts()
+{
+  static char text[1536];
+  size_t firstPeak = 0;
+  for (size_t k = 0; k < sizeof(METER_COUNTS) / sizeof(METER_COUNTS[0]); k++)
+  {
+    size_t n = METER_COUNTS[k];
+    SystemConfig config = makeConfig(n);
+    size_t total = 0;
+
+    const BenchResult &r = bench("config_write_parts", n, [&]() {
+      total = 0;
+      for (size_t part = 0; part < ConfigManager::partCount(config); part++)
+      {
+        BufferPrint out(text, sizeof(text));
+        ConfigManager::writePart(config, part, out, true);
+        total += out.length();
+      }
+    });
+    TEST_ASSERT_GREATER_THAN(n * 20, total);
+
+    // O pico é o de uma parte, não cresce com os medidores
+    if (k == 0)
+      firstPeak = r.peakBytes;
+    TEST_ASSERT_TRUE(r.peakBytes <= 2 * firstPeak);
+  }
+}
+
+void test_bench_payload()
+{
+  TelemetryEncoder encoder;
+  String deviceId("A1B2C3D4E5F6");
+
+  for (size_t k = 0; k < sizeof(CHANNEL_COUNTS) / sizeof(CHANNEL_COUNTS[0]); k++)
+  {
+    size_t n = CHANNEL_COUNTS[k];
+    size_t len;
+
+    const BenchResult &json = bench("payload_json", n, [&]() {
+      encoder.encode(PAYLOAD_JSON, deviceId, readings, n, payload, sizeof(payload), len);
+    });
+    // O publish em regime não pode alocar (ver test_payload)
+    TEST_ASSERT_EQUAL_INT(0, json.allocsPerOp);
+
+    const BenchResult &msgpack = bench("payload_msgpack", n, [&]() {
+      encoder.encode(PAYLOAD_MSGPACK, deviceId, readings, n, payload, sizeof(payload), len);
+    });
+    TEST_ASSERT_EQUAL_INT(0, msgpack.allocsPerOp);
+  }
+}
+
+void test_bench_outbox_push_pop()
+{
+  LittleFS.format();
+  ReadingOutbox outbox;
+  TEST_ASSERT_TRUE(outbox.begin(256));
+  MeterReading batch[OUTBOX_MAX_BATCH];
+
+  // Um ciclo de 64 leituras entrando e saindo em lotes, como no replay
+  bench("outbox_push_pop", 64, [&]() {
+    for (int i = 0; i < 64; i++)
+      outbox.push(readings[i]);
+    while (outbox.size() > 0)
+      outbox.ack(outbox.peek(batch, OUTBOX_MAX_BATCH));
+  });
+  TEST_ASSERT_EQUAL_INT(0, outbox.dropped());
+}
+
+// --- Saída ---
+
+static void writeResults()
+{
+  std::string json = "{\"schema\":1,\"results\":[";
+  char line[256];
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult &r = results[i];
+    snprintf(line, sizeof(line),
+             "%s{\"name\":\"%s\",\"n\":%u,\"iterations\":%u,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"peak_bytes\":%u}",
+             i ? "," : "", r.name, (unsigned)r.n, (unsigned)r.iterations, r.nsPerOp, r.allocsPerOp, (unsigned)r.peakBytes);
+    json += line;
+  }
+  json += "]}";
+
+  printf("BENCH_JSON %s\n", json.c_str());
+
+  const char *path = getenv("BENCH_JSON");
+  if (path && *path)
+  {
+    FILE *f = fopen(path, "w");
+    if (f)
+    {
+      fputs(json.c_str(), f);
+      fclose(f);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_bench_config_parse);
+  RUN_TEST(test_bench_config_snapshot_decode);
+  RUN_TEST(test_bench_config_serialize);
+  RUN_TEST(test_bench_config_stream_parse);
+  RUN_TEST(test_bench_config_write_parts);
+  RUN_TEST(test_bench_payload);
+  RUN_TEST(test_bench_outbox_push_pop);
+  writeResults();
+  UNITY_END();
+  return 0;
+}
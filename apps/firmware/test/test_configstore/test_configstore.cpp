@@ -0,0 +1,193 @@
+#include <unity.h>
+#include <thread>
+
+#include "../mocks/Arduino.h"
+#include "../mocks/ConfigFixture.h"
+
+#include "../../src/ConfigStore.cpp"
+
+static uint32_t notified;
+static uint8_t lastChanges;
+
+static void onChange(uint8_t changes, void *ctx)
+{
+  notified++;
+  lastChanges = changes;
+}
+
+void setUp(void)
+{
+  notified = 0;
+  lastChanges = 0;
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_publish_swaps_snapshot_and_bumps_version()
+{
+  ConfigStore store;
+  TEST_ASSERT_FALSE((bool)store.get());
+  TEST_ASSERT_EQUAL_INT(0, store.version());
+
+  store.publish(makeConfig(4));
+  TEST_ASSERT_EQUAL_INT(1, store.version());
+  TEST_ASSERT_EQUAL_STRING("Kitnets", store.get()->wifiSsid.c_str());
+
+  store.setListener(onChange);
+  SystemConfig next = makeConfig(4);
+  next.interval = 30;
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_POLLING, store.publish(next));
+  TEST_ASSERT_EQUAL_INT(2, store.version());
+  TEST_ASSERT_EQUAL_INT(30, store.get()->interval);
+  TEST_ASSERT_EQUAL_INT(1, notified);
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_POLLING, lastChanges);
+}
+
+void test_diff_names_only_what_changed()
+{
+  SystemConfig a = makeConfig(4);
+  SystemConfig b = makeConfig(4);
+  TEST_ASSERT_EQUAL_INT(0, ConfigStore::diff(a, b));
+
+  // Renomear um medidor não mexe em WiFi nem MQTT
+  b.meters[2].name = "Kitnet 999";
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_POLLING, ConfigStore::diff(a, b));
+
+  b = makeConfig(4);
+  b.meters[0].deadband.power = 25.0f;
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_POLLING, ConfigStore::diff(a, b));
+
+  b = makeConfig(4);
+  b.meters.pop_back();
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_POLLING, ConfigStore::diff(a, b));
+
+  b = makeConfig(4);
+  b.wifiPass = "outra";
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_WIFI, ConfigStore::diff(a, b));
+
+  b = makeConfig(4);
+  b.mqttPort = 1883;
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_MQTT, ConfigStore::diff(a, b));
+
+  b = makeConfig(4);
+  b.payloadFormat = PAYLOAD_MSGPACK;
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_PAYLOAD, ConfigStore::diff(a, b));
+
+  // Só o que é criado no boot exige reinício
+  b = makeConfig(4);
+  b.buses[0].baud = 19200;
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_HARDWARE, ConfigStore::diff(a, b));
+  b = makeConfig(4);
+  b.buses.push_back(BusConfig());
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_HARDWARE, ConfigStore::diff(a, b));
+  b = makeConfig(4);
+  b.queueOverflow = RING_DROP_NEWEST;
+  TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED_HARDWARE, ConfigStore::diff(a, b));
+}
+
+void test_match_follows_meters_by_address_and_model()
+{
+  std::vector<MeterConfig> before = makeConfig(4).meters;
+  std::vector<MeterConfig> after = before;
+
+  // Remove o primeiro, renomeia um, troca o modelo de outro e acrescenta um
+  after.erase(after.begin());
+  after[0].name = "Kitnet 999";
+  after[1].model = (MeterModel)((after[1].model + 1) % METER_MODEL_COUNT);
+  MeterConfig added = before[0];
+  added.modbusId = 99;
+  after.push_back(added);
+
+  std::vector<int> from;
+  ConfigStore::matchMeters(before, after, from);
+  TEST_ASSERT_EQUAL_INT(4, from.size());
+  TEST_ASSERT_EQUAL_INT(1, from[0]);  // renomeado continua
+  TEST_ASSERT_EQUAL_INT(-1, from[1]); // outro modelo recomeça
+  TEST_ASSERT_EQUAL_INT(3, from[2]);
+  TEST_ASSERT_EQUAL_INT(-1, from[3]); // novo
+}
+
+void test_reader_keeps_its_snapshot_until_released()
+{
+  ConfigStore store;
+  store.publish(makeConfig(4));
+
+  ConfigRef held = store.get();
+  std::weak_ptr<const SystemConfig> watch = held;
+
+  SystemConfig next = makeConfig(4);
+  next.meters.clear();
+  store.publish(next);
+
+  // Quem segurava continua vendo a lista antiga inteira
+  TEST_ASSERT_EQUAL_INT(4, held->meters.size());
+  TEST_ASSERT_EQUAL_STRING("Kitnet 101", held->meters[0].name.c_str());
+  TEST_ASSERT_EQUAL_INT(0, store.get()->meters.size());
+
+  // Solta: a versão antiga é liberada
+  TEST_ASSERT_FALSE(watch.expired());
+  held.reset();
+  TEST_ASSERT_TRUE(watch.expired());
+}
+
+void test_concurrent_readers_never_see_a_torn_config()
+{
+  ConfigStore store;
+  store.publish(makeConfig(4));
+
+  const uint32_t VERSIONS = 20000;
+  std::atomic<bool> done(false);
+  uint32_t torn = 0;
+  uint32_t reads = 0;
+
+  // Cada versão é coerente: interval == número de medidores == nome de todos
+  std::thread writer([&]() {
+    for (uint32_t v = 1; v <= VERSIONS; v++)
+    {
+      SystemConfig next = makeConfig(4);
+      size_t count = 1 + v % 12;
+      next.interval = count;
+      next.meters.resize(count);
+      for (size_t i = 0; i < count; i++)
+        next.meters[i].name = std::to_string(count);
+      store.publish(next);
+    }
+    done = true;
+  });
+
+  uint32_t lastVersion = 0;
+  while (!done)
+  {
+    uint32_t version = store.version();
+    ConfigRef config = store.get();
+    reads++;
+    if ((size_t)config->interval != config->meters.size() && config->interval != 60)
+      torn++;
+    for (size_t i = 0; config->interval != 60 && i < config->meters.size(); i++)
+      if (config->meters[i].name != std::to_string(config->interval))
+        torn++;
+    // A versão nunca anda para trás
+    if (version < lastVersion)
+      torn++;
+    lastVersion = version;
+  }
+  writer.join();
+
+  TEST_ASSERT_EQUAL_INT(0, torn);
+  TEST_ASSERT_GREATER_THAN(0, reads);
+  TEST_ASSERT_EQUAL_INT(VERSIONS + 1, store.version());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_publish_swaps_snapshot_and_bumps_version);
+  RUN_TEST(test_diff_names_only_what_changed);
+  RUN_TEST(test_match_follows_meters_by_address_and_model);
+  RUN_TEST(test_reader_keeps_its_snapshot_until_released);
+  RUN_TEST(test_concurrent_readers_never_see_a_torn_config);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,218 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/MeterProfiles.cpp"
+#include "../../src/ModbusRtuMaster.cpp"
+#include "../../src/SlaveHealth.cpp"
+#include "../../src/Metrics.cpp"
+#include "../../src/ModbusWorker.cpp"
+#include "../../src/WallClock.cpp"
+#include "../../src/MeterDiscovery.cpp"
+
+#include "../mocks/SimMeterBank.h"
+
+// Descoberta contra o banco simulado, no relógio virtual: o tempo de uma
+// varredura completa sai igual em toda execução.
+
+static ModbusWorker worker;
+static std::vector<DiscoveredMeter> found;
+static std::atomic<uint16_t> probed;
+
+static void addMeter(SimMeterBank &bank, uint8_t id, MeterModel model)
+{
+  bank.add(id, model);
+  bank.set(id, Q_VOLTAGE, 221.0f);
+  bank.set(id, Q_CURRENT, 2.5f);
+  bank.set(id, Q_POWER, 550.0f);
+  bank.set(id, Q_ENERGY, 1234.0f);
+}
+
+// Varre o banco; retorna o tempo gasto (us)
+static uint64_t scan(SimMeterBank &bank, bool allLines, uint32_t timeoutUs = DISCOVERY_TIMEOUT_US)
+{
+  SerialLine lines[DISCOVERY_MAX_LINES];
+  SerialLine busLine = { 9600, PARITY_NONE };
+  size_t n = MeterDiscovery::lines(busLine, allLines, lines);
+
+  worker.begin(&bank, 9600, 0);
+  uint64_t start = bank.clockUs();
+  worker.discover(lines, n, timeoutUs, found, &probed);
+  return bank.clockUs() - start;
+}
+
+static const DiscoveredMeter *find(uint8_t id)
+{
+  for (size_t i = 0; i < found.size(); i++)
+    if (found[i].modbusId == id)
+      return &found[i];
+  return NULL;
+}
+
+void setUp(void)
+{
+  mockMillis = 0;
+  found.clear();
+  probed = 0;
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_finds_and_identifies_every_model()
+{
+  SimMeterBank bank;
+  addMeter(bank, 1, METER_DDS238);
+  addMeter(bank, 17, METER_SDM120);
+  addMeter(bank, 100, METER_SDM630);
+  addMeter(bank, 247, METER_DDSU666);
+
+  scan(bank, false);
+
+  TEST_ASSERT_EQUAL_INT(4, found.size());
+  TEST_ASSERT_EQUAL_INT(METER_DDS238, find(1)->model);
+  TEST_ASSERT_EQUAL_INT(METER_SDM120, find(17)->model);
+  TEST_ASSERT_EQUAL_INT(METER_SDM630, find(100)->model);
+  TEST_ASSERT_EQUAL_INT(METER_DDSU666, find(247)->model);
+  TEST_ASSERT_EQUAL_INT(9600, find(17)->line.baud);
+  TEST_ASSERT_EQUAL_INT(DISCOVERY_ADDRESSES, probed.load());
+}
+
+void test_full_bus_scan_takes_seconds()
+{
+  SimMeterBank bank;
+  for (uint8_t id = 10; id < 18; id++)
+    addMeter(bank, id, METER_SDM120);
+
+  uint64_t us = scan(bank, false);
+
+  char msg[96];
+  snprintf(msg, sizeof(msg), "1..247 a 9600 baud com %u medidores: %.1f s", 8u, us / 1e6);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_INT(8, found.size());
+  // 247 timeouts de 40 ms + o fio: bem menos que um timeout padrão (2 s) por endereço
+  TEST_ASSERT_LESS_THAN(15000000, (uint32_t)us);
+}
+
+void test_exception_counts_as_present()
+{
+  // Escravo que não tem nenhum registrador dos perfis: responde exceção a tudo
+  SimMeterBank bank;
+  bank.meter(42);
+
+  scan(bank, false);
+
+  TEST_ASSERT_EQUAL_INT(1, found.size());
+  TEST_ASSERT_EQUAL_INT(42, found[0].modbusId);
+  TEST_ASSERT_EQUAL_INT(METER_MODEL_COUNT, found[0].model);
+}
+
+void test_implausible_values_are_not_identified()
+{
+  // Mapa de um DDS238, mas a tensão lida seria 0 V
+  SimMeterBank bank;
+  bank.add(5, METER_DDS238);
+
+  scan(bank, false);
+
+  TEST_ASSERT_EQUAL_INT(1, found.size());
+  TEST_ASSERT_EQUAL_INT(METER_MODEL_COUNT, found[0].model);
+}
+
+void test_auto_mode_finds_other_baud_and_parity()
+{
+  SimMeterBank bank;
+  addMeter(bank, 3, METER_SDM120);
+  addMeter(bank, 8, METER_DDSU666);
+  bank.meter(8).baud = 19200;
+  bank.meter(8).parity = PARITY_EVEN;
+
+  // Só a linha do barramento: o de 19200 8E1 não aparece
+  scan(bank, false);
+  TEST_ASSERT_EQUAL_INT(1, found.size());
+
+  found.clear();
+  probed = 0;
+  scan(bank, true);
+  TEST_ASSERT_EQUAL_INT(2, found.size());
+  TEST_ASSERT_EQUAL_INT(19200, find(8)->line.baud);
+  TEST_ASSERT_EQUAL_INT(PARITY_EVEN, find(8)->line.parity);
+  TEST_ASSERT_EQUAL_INT(METER_DDSU666, find(8)->model);
+  TEST_ASSERT_EQUAL_INT(DISCOVERY_MAX_LINES - 1, probed.load() / DISCOVERY_ADDRESSES);
+}
+
+void test_merge_into_config()
+{
+  SystemConfig config;
+  config.buses.push_back(BusConfig());
+  config.buses.push_back(BusConfig());
+  MeterConfig existing;
+  existing.id = 4;
+  existing.channelIndex = 9;
+  existing.modbusId = 10;
+  existing.model = METER_DDS238;
+  existing.periodSec = 0;
+  existing.bus = 1;
+  existing.name = "Kitnet 101";
+  config.meters.push_back(existing);
+
+  SerialLine line = { 9600, PARITY_NONE };
+  DiscoveredMeter d;
+  d.line = line;
+  d.modbusId = 10; d.model = METER_SDM120; found.push_back(d);       // já configurado, modelo errado
+  d.modbusId = 11; d.model = METER_SDM120; found.push_back(d);
+  d.modbusId = 12; d.model = METER_MODEL_COUNT; found.push_back(d);  // desconhecido
+
+  DiscoveryMerge r = MeterDiscovery::merge(config, 1, found);
+
+  TEST_ASSERT_EQUAL_INT(1, r.added);
+  TEST_ASSERT_EQUAL_INT(1, r.updated);
+  TEST_ASSERT_EQUAL_INT(1, r.skipped);
+  TEST_ASSERT_FALSE(r.lineChanged);
+  TEST_ASSERT_EQUAL_INT(2, config.meters.size());
+  TEST_ASSERT_EQUAL_INT(METER_SDM120, config.meters[0].model);
+  TEST_ASSERT_EQUAL_STRING("Kitnet 101", config.meters[0].name.c_str());
+  TEST_ASSERT_EQUAL_INT(5, config.meters[1].id);
+  TEST_ASSERT_EQUAL_INT(10, config.meters[1].channelIndex);
+  TEST_ASSERT_EQUAL_INT(11, config.meters[1].modbusId);
+  TEST_ASSERT_EQUAL_INT(1, config.meters[1].bus);
+}
+
+void test_merge_adopts_line_with_most_meters()
+{
+  SystemConfig config;
+  config.buses.push_back(BusConfig());
+
+  SerialLine fast = { 19200, PARITY_EVEN };
+  SerialLine slow = { 9600, PARITY_NONE };
+  DiscoveredMeter d;
+  d.model = METER_DDSU666;
+  d.line = fast;
+  d.modbusId = 1; found.push_back(d);
+  d.modbusId = 2; found.push_back(d);
+  d.line = slow;
+  d.modbusId = 3; found.push_back(d);
+
+  DiscoveryMerge r = MeterDiscovery::merge(config, 0, found);
+
+  TEST_ASSERT_TRUE(r.lineChanged);
+  TEST_ASSERT_EQUAL_INT(19200, config.buses[0].baud);
+  TEST_ASSERT_EQUAL_INT(PARITY_EVEN, config.buses[0].parity);
+  TEST_ASSERT_EQUAL_INT(2, r.added);
+  TEST_ASSERT_EQUAL_INT(1, r.skipped); // O de 9600 não conversa com o barramento em 19200
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_finds_and_identifies_every_model);
+  RUN_TEST(test_full_bus_scan_takes_seconds);
+  RUN_TEST(test_exception_counts_as_present);
+  RUN_TEST(test_implausible_values_are_not_identified);
+  RUN_TEST(test_auto_mode_finds_other_baud_and_parity);
+  RUN_TEST(test_merge_into_config);
+  RUN_TEST(test_merge_adopts_line_with_most_meters);
+  UNITY_END();
+  return 0;
+}
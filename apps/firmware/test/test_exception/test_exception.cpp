@@ -0,0 +1,127 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/ExceptionFilter.cpp"
+
+static ExceptionFilter filter;
+static Deadband db;
+
+static MeterReading reading(float v, float i, float p, float kwh)
+{
+  MeterReading r;
+  memset(&r, 0, sizeof(r));
+  r.voltage = v;
+  r.current = i;
+  r.power = p;
+  r.totalKwh = kwh;
+  return r;
+}
+
+void setUp(void)
+{
+  filter.reset(2);
+  db = Deadband();
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_disabled_reports_everything()
+{
+  for (int k = 0; k < 5; k++)
+    TEST_ASSERT_TRUE(filter.shouldReport(0, db, reading(220, 0, 0, 10), k * 1000));
+  TEST_ASSERT_EQUAL_UINT32(0, filter.suppressed());
+}
+
+void test_idle_unit_is_suppressed_until_heartbeat()
+{
+  db.voltage = 2.0f;
+  db.power = 20.0f;
+  db.heartbeatSec = 900;
+
+  TEST_ASSERT_TRUE(filter.shouldReport(0, db, reading(220.0f, 0, 0, 10), 0)); // primeira sempre sai
+
+  // Kitnet vazia: tensão oscilando dentro de ±2 V e 0 W a cada 60 s
+  for (uint32_t t = 60000; t < 900000; t += 60000)
+    TEST_ASSERT_FALSE(filter.shouldReport(0, db, reading(t % 120000 ? 221.5f : 218.5f, 0, 0, 10), t));
+  TEST_ASSERT_EQUAL_UINT32(14, filter.suppressed());
+
+  // Heartbeat: 15 min sem publicar
+  TEST_ASSERT_TRUE(filter.shouldReport(0, db, reading(220.0f, 0, 0, 10), 900000));
+}
+
+void test_change_beyond_deadband_reports()
+{
+  db.power = 20.0f;
+  filter.shouldReport(0, db, reading(220, 0, 0, 10), 0);
+
+  TEST_ASSERT_FALSE(filter.shouldReport(0, db, reading(220, 0, 15, 10), 1000));
+  TEST_ASSERT_TRUE(filter.shouldReport(0, db, reading(220, 5, 1100, 10), 2000)); // chuveiro ligou
+
+  // A referência passa a ser a última publicada, não a última lida
+  TEST_ASSERT_FALSE(filter.shouldReport(0, db, reading(220, 5, 1110, 10), 3000));
+  TEST_ASSERT_FALSE(filter.shouldReport(0, db, reading(220, 5, 1119, 10), 4000));
+  TEST_ASSERT_TRUE(filter.shouldReport(0, db, reading(220, 5, 1121, 10), 5000));
+}
+
+void test_percent_band_scales_with_load()
+{
+  db.power = 10.0f;  // piso para ruído perto de zero
+  db.percent = 5.0f; // 5% do último valor publicado
+
+  filter.shouldReport(0, db, reading(220, 0, 4000, 10), 0);
+  TEST_ASSERT_FALSE(filter.shouldReport(0, db, reading(220, 0, 4150, 10), 1000)); // 150 W < 200 W
+  TEST_ASSERT_TRUE(filter.shouldReport(0, db, reading(220, 0, 4250, 10), 2000));
+
+  filter.shouldReport(1, db, reading(220, 0, 0, 10), 0);
+  TEST_ASSERT_FALSE(filter.shouldReport(1, db, reading(220, 0, 8, 10), 1000)); // 5% de 0 = 0, vale o piso
+  TEST_ASSERT_TRUE(filter.shouldReport(1, db, reading(220, 0, 12, 10), 2000));
+}
+
+void test_energy_deadband()
+{
+  db.energy = 0.1f;
+  filter.shouldReport(0, db, reading(220, 0, 0, 100.0f), 0);
+  TEST_ASSERT_FALSE(filter.shouldReport(0, db, reading(220, 0, 0, 100.05f), 1000));
+  TEST_ASSERT_TRUE(filter.shouldReport(0, db, reading(220, 0, 0, 100.15f), 2000));
+}
+
+void test_channels_are_independent()
+{
+  db.power = 20.0f;
+  filter.shouldReport(0, db, reading(220, 0, 0, 10), 0);
+  TEST_ASSERT_TRUE(filter.shouldReport(1, db, reading(220, 0, 0, 10), 0));
+  TEST_ASSERT_FALSE(filter.shouldReport(1, db, reading(220, 0, 0, 10), 1000));
+}
+
+void test_remap_keeps_reference_of_meters_that_stay()
+{
+  db.power = 20.0f;
+  filter.shouldReport(0, db, reading(220, 0, 100, 10), 0);
+  filter.shouldReport(1, db, reading(220, 0, 500, 10), 0);
+
+  // Config nova: o canal 1 continua (agora na posição 0), entra um novo
+  std::vector<int> from;
+  from.push_back(1);
+  from.push_back(-1);
+  filter.remap(from);
+
+  TEST_ASSERT_FALSE(filter.shouldReport(0, db, reading(220, 0, 510, 10), 1000)); // mesma referência
+  TEST_ASSERT_TRUE(filter.shouldReport(1, db, reading(220, 0, 100, 10), 1000));  // novo: primeira sai
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_disabled_reports_everything);
+  RUN_TEST(test_idle_unit_is_suppressed_until_heartbeat);
+  RUN_TEST(test_change_beyond_deadband_reports);
+  RUN_TEST(test_percent_band_scales_with_load);
+  RUN_TEST(test_energy_deadband);
+  RUN_TEST(test_channels_are_independent);
+  RUN_TEST(test_remap_keeps_reference_of_meters_that_stay);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,142 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/SlaveHealth.cpp"
+#include "../../src/Metrics.cpp"
+
+static SlaveHealthTracker health;
+
+void setUp(void)
+{
+  health.reset(2);
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_backoff_doubles_up_to_cap()
+{
+  Backoff b(1000, 5000);
+  TEST_ASSERT_EQUAL_UINT32(1000, b.next());
+  TEST_ASSERT_EQUAL_UINT32(2000, b.next());
+  TEST_ASSERT_EQUAL_UINT32(4000, b.next());
+  TEST_ASSERT_EQUAL_UINT32(5000, b.next());
+  TEST_ASSERT_EQUAL_UINT32(5000, b.next());
+  TEST_ASSERT_EQUAL_INT(5, b.attempts());
+
+  b.reset();
+  TEST_ASSERT_EQUAL_UINT32(1000, b.next());
+}
+
+void test_backoff_jitter_stays_in_range()
+{
+  Backoff b(10000, 60000, 20);
+  TEST_ASSERT_EQUAL_UINT32(8000, b.next(0));             // -20%
+  TEST_ASSERT_EQUAL_UINT32(24000, b.next(2 * 4000));     // 20000 + 20%
+  TEST_ASSERT_EQUAL_UINT32(40000, b.next(8000));         // 40000 exato
+}
+
+void test_timeout_adapts_to_response_time()
+{
+  TEST_ASSERT_EQUAL_UINT32(HEALTH_INITIAL_TIMEOUT_US, health.timeoutUs(0));
+
+  // Escravo estável em ~30 ms: o timeout converge para perto da média
+  for (int i = 0; i < 50; i++)
+    health.onSuccess(0, 30000 + (i % 2) * 2000, i * 1000);
+
+  uint32_t t = health.timeoutUs(0);
+  TEST_ASSERT_UINT32_WITHIN(2000, 31000, health.get(0).srttUs);
+  TEST_ASSERT_GREATER_OR_EQUAL(HEALTH_MIN_TIMEOUT_US, t);
+  TEST_ASSERT_LESS_THAN(100000, t);
+
+  // Escravo lento/variável: timeout maior, mas nunca acima do teto
+  for (int i = 0; i < 50; i++)
+    health.onSuccess(1, (i % 2) ? 900000 : 100000, i * 1000);
+  TEST_ASSERT_GREATER_THAN(t, health.timeoutUs(1));
+  TEST_ASSERT_LESS_OR_EQUAL(HEALTH_MAX_TIMEOUT_US, health.timeoutUs(1));
+}
+
+void test_dead_slave_goes_offline_and_is_probed_with_backoff()
+{
+  health.onSuccess(0, 30000, 0);
+  TEST_ASSERT_EQUAL_INT(SLAVE_ONLINE, health.get(0).state);
+
+  TEST_ASSERT_TRUE(health.onFailure(0, 1000));
+  TEST_ASSERT_EQUAL_INT(SLAVE_DEGRADED, health.get(0).state);
+  TEST_ASSERT_FALSE(health.onFailure(0, 2000));
+  TEST_ASSERT_TRUE(health.shouldPoll(0, 2000));
+
+  TEST_ASSERT_TRUE(health.onFailure(0, 3000));
+  TEST_ASSERT_EQUAL_INT(SLAVE_OFFLINE, health.get(0).state);
+
+  // Primeira sonda em 10 s; se falhar, a próxima em 20 s
+  TEST_ASSERT_FALSE(health.shouldPoll(0, 3000 + HEALTH_PROBE_BASE_MS - 1));
+  TEST_ASSERT_TRUE(health.shouldPoll(0, 3000 + HEALTH_PROBE_BASE_MS));
+  health.onFailure(0, 13000);
+  TEST_ASSERT_FALSE(health.shouldPoll(0, 13000 + 2 * HEALTH_PROBE_BASE_MS - 1));
+  TEST_ASSERT_TRUE(health.shouldPoll(0, 13000 + 2 * HEALTH_PROBE_BASE_MS));
+
+  // O vizinho saudável não é afetado
+  TEST_ASSERT_TRUE(health.shouldPoll(1, 3001));
+
+  // Voltou: online de novo, backoff zerado
+  TEST_ASSERT_TRUE(health.onSuccess(0, 30000, 40000));
+  TEST_ASSERT_EQUAL_INT(SLAVE_ONLINE, health.get(0).state);
+  TEST_ASSERT_EQUAL_INT(0, health.get(0).consecutiveFailures);
+  TEST_ASSERT_EQUAL_UINT32(0, health.get(0).probe.current());
+}
+
+void test_state_changes_are_counted()
+{
+  uint32_t before = health.changes();
+  health.onSuccess(0, 30000, 0);
+  health.onSuccess(0, 30000, 1000); // mesmo estado
+  TEST_ASSERT_EQUAL_UINT32(before + 1, health.changes());
+}
+
+void test_remap_keeps_health_of_meters_that_stay()
+{
+  // Medidor 0 offline com backoff em andamento, medidor 1 online
+  health.onSuccess(0, 30000, 0);
+  for (uint32_t t = 1000; t <= 3000; t += 1000)
+    health.onFailure(0, t);
+  health.onSuccess(1, 40000, 3000);
+
+  // Config nova: o 1 vai para a frente, o 0 sai e entra um medidor novo
+  std::vector<int> from;
+  from.push_back(1);
+  from.push_back(-1);
+  health.remap(from);
+
+  TEST_ASSERT_EQUAL_INT(2, health.size());
+  TEST_ASSERT_EQUAL_INT(SLAVE_ONLINE, health.get(0).state);
+  TEST_ASSERT_EQUAL_UINT32(40000, health.get(0).srttUs);
+  TEST_ASSERT_EQUAL_UINT32(1, health.get(0).okCount);
+  TEST_ASSERT_EQUAL_INT(SLAVE_UNKNOWN, health.get(1).state);
+  TEST_ASSERT_EQUAL_UINT32(0, health.get(1).failCount);
+  TEST_ASSERT_EQUAL_UINT32(HEALTH_INITIAL_TIMEOUT_US, health.timeoutUs(1));
+
+  // O offline que continua mantém a sonda agendada
+  from.assign(1, 1);
+  health.reset(2);
+  for (uint32_t t = 1000; t <= 3000; t += 1000)
+    health.onFailure(1, t);
+  health.remap(from);
+  TEST_ASSERT_EQUAL_INT(SLAVE_OFFLINE, health.get(0).state);
+  TEST_ASSERT_FALSE(health.shouldPoll(0, 3000 + HEALTH_PROBE_BASE_MS - 1));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_backoff_doubles_up_to_cap);
+  RUN_TEST(test_backoff_jitter_stays_in_range);
+  RUN_TEST(test_timeout_adapts_to_response_time);
+  RUN_TEST(test_dead_slave_goes_offline_and_is_probed_with_backoff);
+  RUN_TEST(test_state_changes_are_counted);
+  RUN_TEST(test_remap_keeps_health_of_meters_that_stay);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+#include "../mocks/LittleFS.h"
+
+#include "../../src/JsonInput.cpp"
+
+static std::string rest(JsonInput &in)
+{
+  std::string s;
+  int c;
+  while ((c = in.read()) >= 0)
+    s += (char)c;
+  return s;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_seek_key_skips_nested_keys_and_strings()
+{
+  // "meters" aparece como valor, dentro de string e num objeto interno antes da chave de fora
+  const char *json = "{\"wifi\":{\"ssid\":\"meters\",\"meters\":1},"
+                     "\"note\":\"a \\\"meters\\\": b\",\"meters\" : [7]}";
+  BufferJsonInput in(json, strlen(json));
+
+  TEST_ASSERT_TRUE(JsonScan::seekKey(in, "meters"));
+  TEST_ASSERT_EQUAL_STRING(" [7]}", rest(in).c_str());
+}
+
+void test_seek_key_missing_stops_at_end_of_object()
+{
+  const char *json = "{\"wifi\":{\"meters\":[]}} {\"meters\":[]}";
+  BufferJsonInput in(json, strlen(json));
+
+  TEST_ASSERT_FALSE(JsonScan::seekKey(in, "meters"));
+  // Não avança para o próximo documento
+  TEST_ASSERT_EQUAL_STRING(" {\"meters\":[]}", rest(in).c_str());
+}
+
+void test_array_walk()
+{
+  const char *json = "[ 1 ,2,\n3 ]";
+  BufferJsonInput in(json, strlen(json));
+  std::string seen;
+
+  int more = JsonScan::enterArray(in);
+  while (more == 1)
+  {
+    seen += (char)in.read(); // Elemento de um caractere
+    more = JsonScan::nextElement(in);
+  }
+  TEST_ASSERT_EQUAL_INT(0, more);
+  TEST_ASSERT_EQUAL_STRING("123", seen.c_str());
+
+  const char *empty = " [ ] ";
+  BufferJsonInput e(empty, strlen(empty));
+  TEST_ASSERT_EQUAL_INT(0, JsonScan::enterArray(e));
+
+  const char *notArray = " {\"id\":1}";
+  BufferJsonInput o(notArray, strlen(notArray));
+  TEST_ASSERT_EQUAL_INT(-1, JsonScan::enterArray(o));
+
+  const char *truncated = "[1";
+  BufferJsonInput t(truncated, strlen(truncated));
+  TEST_ASSERT_EQUAL_INT(1, JsonScan::enterArray(t));
+  t.read();
+  TEST_ASSERT_EQUAL_INT(-1, JsonScan::nextElement(t));
+}
+
+void test_file_input_rewinds()
+{
+  File f = LittleFS.open("/scan.json", "w");
+  f.print(String("{\"a\":1,\"meters\":[]}"));
+  f.close();
+
+  f = LittleFS.open("/scan.json", "r");
+  FileJsonInput in(f);
+  TEST_ASSERT_TRUE(JsonScan::seekKey(in, "meters"));
+  TEST_ASSERT_EQUAL_INT(0, JsonScan::enterArray(in));
+
+  TEST_ASSERT_TRUE(in.rewind());
+  char head[5] = {0};
+  TEST_ASSERT_EQUAL_INT(4, in.readBytes(head, 4));
+  TEST_ASSERT_EQUAL_STRING("{\"a\"", head);
+  f.close();
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_seek_key_skips_nested_keys_and_strings);
+  RUN_TEST(test_seek_key_missing_stops_at_end_of_object);
+  RUN_TEST(test_array_walk);
+  RUN_TEST(test_file_input_rewinds);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/Metrics.cpp"
+
+static char text[2048];
+
+void setUp(void)
+{
+  memset(text, 0, sizeof(text));
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_histogram_buckets_and_sum()
+{
+  LatencyHistogram h;
+  h.record(3000);    // 3 ms -> le 0.010
+  h.record(10000);   // no limite: ainda le 0.010
+  h.record(10001);   // le 0.025
+  h.record(2600000); // acima do último limite: +Inf
+
+  TEST_ASSERT_EQUAL_INT(2, h.buckets[0]);
+  TEST_ASSERT_EQUAL_INT(1, h.buckets[1]);
+  TEST_ASSERT_EQUAL_INT(1, h.buckets[HIST_BUCKETS - 1]);
+  TEST_ASSERT_EQUAL_INT(4, h.count);
+  TEST_ASSERT_EQUAL_INT(3 + 10 + 10 + 2600, h.sumMs);
+}
+
+void test_prometheus_histogram_is_cumulative()
+{
+  LatencyHistogram h;
+  h.record(5000);
+  h.record(40000);
+  h.record(40000);
+  h.record(3000000);
+
+  BufferPrint out(text, sizeof(text));
+  PromWriter w(out);
+  w.family("x_seconds", "histogram", "teste");
+  w.histogram("x_seconds", "bus=\"0\"", h);
+
+  TEST_ASSERT_NOT_NULL(strstr(text, "# HELP x_seconds teste\n# TYPE x_seconds histogram\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "x_seconds_bucket{bus=\"0\",le=\"0.010\"} 1\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "x_seconds_bucket{bus=\"0\",le=\"0.050\"} 3\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "x_seconds_bucket{bus=\"0\",le=\"2.500\"} 3\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "x_seconds_bucket{bus=\"0\",le=\"+Inf\"} 4\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "x_seconds_sum{bus=\"0\"} 3.085\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "x_seconds_count{bus=\"0\"} 4\n"));
+}
+
+void test_prometheus_samples_without_labels()
+{
+  LatencyHistogram h;
+  BufferPrint out(text, sizeof(text));
+  PromWriter w(out);
+  w.sample("heap_free_bytes", NULL, 123456);
+  w.sample("stack_free_bytes", "task=\"PubTask\"", 812);
+  w.histogram("y_seconds", NULL, h);
+
+  TEST_ASSERT_NOT_NULL(strstr(text, "heap_free_bytes 123456\nstack_free_bytes{task=\"PubTask\"} 812\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "y_seconds_bucket{le=\"0.010\"} 0\n"));
+  TEST_ASSERT_NOT_NULL(strstr(text, "y_seconds_sum 0.000\ny_seconds_count 0\n"));
+}
+
+void test_buffer_print_truncates_and_flags()
+{
+  char small[16];
+  BufferPrint out(small, sizeof(small));
+  PromWriter w(out);
+  w.sample("a", NULL, 1);
+  TEST_ASSERT_FALSE(out.overflow());
+  TEST_ASSERT_EQUAL_STRING("a 1\n", small);
+
+  w.sample("um_nome_bem_comprido", NULL, 1);
+  TEST_ASSERT_TRUE(out.overflow());
+  TEST_ASSERT_EQUAL_INT(15, out.length());
+  TEST_ASSERT_EQUAL_INT(15, strlen(small)); // Sempre terminado em '\0'
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_histogram_buckets_and_sum);
+  RUN_TEST(test_prometheus_histogram_is_cumulative);
+  RUN_TEST(test_prometheus_samples_without_labels);
+  RUN_TEST(test_buffer_print_truncates_and_flags);
+  UNITY_END();
+  return 0;
+}
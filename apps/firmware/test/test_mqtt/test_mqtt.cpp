@@ -0,0 +1,366 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/MqttSession.cpp"
+#include "../../src/Metrics.cpp"
+
+// --- Broker falso: decodifica o que o cliente escreve e devolve CONNACK/PUBACK ---
+struct StubPacket
+{
+  uint8_t type;
+  bool dup;
+  uint8_t qos;
+  bool retain;
+  uint16_t id;
+  std::string topic;
+  std::string payload;
+  std::vector<uint8_t> raw;
+  bool framed; // "Remaining length" bate com o tamanho escrito
+};
+
+static StubPacket decode(const uint8_t *data, size_t len)
+{
+  StubPacket p;
+  p.raw.assign(data, data + len);
+  p.type = data[0] >> 4;
+  p.dup = data[0] & 0x08;
+  p.qos = (data[0] >> 1) & 0x03;
+  p.retain = data[0] & 0x01;
+  p.id = 0;
+
+  size_t i = 1;
+  uint32_t remaining = 0;
+  for (int shift = 0;; shift += 7)
+  {
+    uint8_t b = data[i++];
+    remaining |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      break;
+  }
+  p.framed = remaining == len - i;
+
+  if (p.type == MQTT_PUBLISH)
+  {
+    size_t topicLen = (data[i] << 8) | data[i + 1];
+    p.topic.assign((const char *)data + i + 2, topicLen);
+    i += 2 + topicLen;
+    if (p.qos)
+    {
+      p.id = (data[i] << 8) | data[i + 1];
+      i += 2;
+    }
+    p.payload.assign((const char *)data + i, len - i);
+  }
+  return p;
+}
+
+static MqttSession session;
+static uint32_t now;
+
+static void connack(uint8_t code = 0)
+{
+  const uint8_t pkt[] = {MQTT_CONNACK << 4, 2, 0, code};
+  session.receive(pkt, sizeof(pkt), now);
+}
+
+static void puback(uint16_t id)
+{
+  const uint8_t pkt[] = {MQTT_PUBACK << 4, 2, (uint8_t)(id >> 8), (uint8_t)id};
+  TEST_ASSERT_TRUE(session.receive(pkt, sizeof(pkt), now));
+}
+
+// Escreve tudo que está na fila (como o MqttWorker faz na NetTask)
+static std::vector<StubPacket> drain()
+{
+  std::vector<StubPacket> out;
+  const uint8_t *data;
+  size_t len;
+  while ((data = session.nextOutput(len)) != NULL)
+  {
+    out.push_back(decode(data, len));
+    session.written(now);
+  }
+  return out;
+}
+
+static bool publish(const char *payload, uint8_t qos = 1, bool retain = false)
+{
+  return session.publish("energymeter/gw/data", (const uint8_t *)payload, strlen(payload), qos, retain);
+}
+
+void setUp(void)
+{
+  session = MqttSession();
+  now = 1000;
+  session.begin(now);
+  connack();
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_connect_packet()
+{
+  uint8_t buf[128];
+  size_t n = MqttSession::encodeConnect(buf, sizeof(buf), "gw_01", "energymeter/gw_01/status", "{\"online\":false}", true);
+  TEST_ASSERT_TRUE(n > 0);
+
+  StubPacket p = decode(buf, n);
+  TEST_ASSERT_EQUAL_INT(MQTT_CONNECT, p.type);
+  TEST_ASSERT_TRUE(p.framed);
+  const uint8_t header[] = {0, 4, 'M', 'Q', 'T', 'T', 4};
+  TEST_ASSERT_EQUAL_MEMORY(header, buf + 2, sizeof(header));
+  TEST_ASSERT_EQUAL_HEX8(0x2C, buf[9]); // Will + will QoS 1 + will retain, clean session = 0
+  TEST_ASSERT_EQUAL_INT(MQTT_KEEPALIVE_S, (buf[10] << 8) | buf[11]);
+  TEST_ASSERT_EQUAL_INT(5, (buf[12] << 8) | buf[13]);
+  TEST_ASSERT_EQUAL_MEMORY("gw_01", buf + 14, 5);
+
+  TEST_ASSERT_EQUAL_INT(0, MqttSession::encodeConnect(buf, 20, "gw_01", "energymeter/gw_01/status", "{}", true));
+}
+
+void test_streamed_publish_header()
+{
+  // Métricas: header montado aqui, texto escrito direto do buffer do chamador
+  std::string text(3000, 'm');
+  uint8_t buf[3100];
+  size_t n = MqttSession::encodePublishHeader(buf, 80, "energymeter/gw/metrics", text.size(), false);
+  TEST_ASSERT_EQUAL_INT(1 + 2 + 2 + 22, n);
+  memcpy(buf + n, text.data(), text.size());
+
+  StubPacket p = decode(buf, n + text.size());
+  TEST_ASSERT_TRUE(p.framed);
+  TEST_ASSERT_EQUAL_INT(0, p.qos);
+  TEST_ASSERT_EQUAL_STRING("energymeter/gw/metrics", p.topic.c_str());
+  TEST_ASSERT_EQUAL_INT(text.size(), p.payload.size());
+  TEST_ASSERT_EQUAL_INT(0, MqttSession::encodePublishHeader(buf, 10, "energymeter/gw/metrics", 1, false));
+}
+
+void test_window_pipelines_qos1_and_matches_acks_by_id()
+{
+  for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++)
+    TEST_ASSERT_TRUE(publish("{\"v\":1}"));
+  TEST_ASSERT_FALSE(publish("{\"v\":2}")); // Janela cheia: vai para o outbox
+
+  // Todos saem sem esperar nenhum PUBACK
+  std::vector<StubPacket> sent = drain();
+  TEST_ASSERT_EQUAL_INT(MQTT_INFLIGHT_WINDOW, sent.size());
+  for (size_t i = 0; i < sent.size(); i++)
+  {
+    TEST_ASSERT_EQUAL_INT(MQTT_PUBLISH, sent[i].type);
+    TEST_ASSERT_TRUE(sent[i].framed);
+    TEST_ASSERT_EQUAL_INT(1, sent[i].qos);
+    TEST_ASSERT_FALSE(sent[i].dup);
+    TEST_ASSERT_EQUAL_STRING("energymeter/gw/data", sent[i].topic.c_str());
+    TEST_ASSERT_EQUAL_STRING("{\"v\":1}", sent[i].payload.c_str());
+  }
+  TEST_ASSERT_NOT_EQUAL(sent[0].id, sent[1].id);
+
+  // PUBACK fora de ordem libera só o slot daquele id
+  now += 40;
+  puback(sent[2].id);
+  TEST_ASSERT_EQUAL_INT(MQTT_INFLIGHT_WINDOW - 1, session.inflight());
+  puback(sent[2].id); // Repetido: nada muda
+  puback(0xBEEF);     // Desconhecido: ignorado
+  TEST_ASSERT_EQUAL_INT(1, session.stats().acked);
+  TEST_ASSERT_EQUAL_UINT32(1, session.stats().ack.count);
+  TEST_ASSERT_EQUAL_UINT32(40, session.stats().ack.sumMs);
+
+  TEST_ASSERT_TRUE(publish("{\"v\":3}"));
+  for (size_t i = 0; i < sent.size(); i++)
+    puback(sent[i].id);
+  TEST_ASSERT_EQUAL_INT(1, session.inflight());
+}
+
+void test_unacked_are_resent_with_dup_after_reconnect()
+{
+  publish("a");
+  publish("b");
+  publish("c");
+  std::vector<StubPacket> first = drain();
+  puback(first[0].id);
+  publish("d"); // Enfileirado, ainda não escrito
+
+  // Caiu: nada sai até o CONNACK da conexão nova
+  session.end();
+  size_t len;
+  TEST_ASSERT_NULL(session.nextOutput(len));
+  TEST_ASSERT_TRUE(publish("e")); // Offline ainda enfileira: b, c, d, e enchem a janela
+  TEST_ASSERT_FALSE(publish("f"));
+  session.begin(now);
+  TEST_ASSERT_NULL(session.nextOutput(len));
+  connack();
+
+  std::vector<StubPacket> again = drain();
+  TEST_ASSERT_EQUAL_INT(4, again.size());
+  TEST_ASSERT_EQUAL_STRING("b", again[0].payload.c_str());
+  TEST_ASSERT_TRUE(again[0].dup);
+  TEST_ASSERT_EQUAL_INT(first[1].id, again[0].id);
+  TEST_ASSERT_EQUAL_STRING("c", again[1].payload.c_str());
+  TEST_ASSERT_TRUE(again[1].dup);
+  TEST_ASSERT_EQUAL_STRING("d", again[2].payload.c_str());
+  TEST_ASSERT_FALSE(again[2].dup);
+  TEST_ASSERT_EQUAL_STRING("e", again[3].payload.c_str());
+  TEST_ASSERT_EQUAL_INT(2, session.stats().retransmits);
+}
+
+static bool publishOutbox(uint32_t first, uint32_t end)
+{
+  OutboxRange range = {first, end};
+  return session.publish("energymeter/gw/data", (const uint8_t *)"r", 1, 1, false, &range);
+}
+
+void test_outbox_ack_advances_in_order()
+{
+  uint32_t through;
+  TEST_ASSERT_FALSE(session.outboxAcked(through));
+
+  publishOutbox(0, 5);
+  publish("ciclo"); // Leitura ao vivo: não mexe no outbox
+  publishOutbox(5, 9);
+  publishOutbox(9, 12);
+  std::vector<StubPacket> sent = drain();
+
+  // PUBACK fora de ordem: o flash não pode passar do 0..4 ainda sem PUBACK
+  puback(sent[2].id);
+  TEST_ASSERT_TRUE(session.outboxAcked(through));
+  TEST_ASSERT_EQUAL_UINT32(0, through);
+  puback(sent[1].id);
+  session.outboxAcked(through);
+  TEST_ASSERT_EQUAL_UINT32(0, through);
+
+  puback(sent[0].id);
+  TEST_ASSERT_TRUE(session.outboxAcked(through));
+  TEST_ASSERT_EQUAL_UINT32(9, through);
+
+  // Queda com o último no ar: só o PUBACK do reenvio confirma
+  session.end();
+  session.begin(now);
+  connack();
+  std::vector<StubPacket> again = drain();
+  TEST_ASSERT_EQUAL_INT(1, again.size());
+  TEST_ASSERT_TRUE(again[0].dup);
+  session.outboxAcked(through);
+  TEST_ASSERT_EQUAL_UINT32(9, through);
+  puback(again[0].id);
+  session.outboxAcked(through);
+  TEST_ASSERT_EQUAL_UINT32(12, through);
+
+  // Faixa de outbox não vai em QoS 0
+  OutboxRange range = {12, 13};
+  TEST_ASSERT_FALSE(session.publish("t", (const uint8_t *)"r", 1, 0, false, &range));
+}
+
+void test_write_cut_mid_packet_is_resent()
+{
+  publish("a");
+  size_t len;
+  TEST_ASSERT_NOT_NULL(session.nextOutput(len));
+  session.end(); // Socket caiu durante o write (sem written())
+
+  session.begin(now);
+  connack();
+  std::vector<StubPacket> again = drain();
+  TEST_ASSERT_EQUAL_INT(1, again.size());
+  TEST_ASSERT_TRUE(again[0].dup);
+}
+
+void test_qos0_has_its_own_slots()
+{
+  for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++)
+    publish("{}");
+  TEST_ASSERT_TRUE(publish("{\"online\":true}", 0, true));
+  TEST_ASSERT_TRUE(publish("{\"online\":true}", 0, true));
+  TEST_ASSERT_FALSE(publish("{\"online\":true}", 0, true));
+
+  std::vector<StubPacket> sent = drain();
+  TEST_ASSERT_EQUAL_INT(MQTT_SLOTS, sent.size());
+  TEST_ASSERT_EQUAL_INT(0, sent.back().qos);
+  TEST_ASSERT_TRUE(sent.back().retain);
+  TEST_ASSERT_EQUAL_INT(MQTT_INFLIGHT_WINDOW, session.queued()); // QoS 0 sai da fila ao escrever
+}
+
+void test_oversized_payload_is_rejected()
+{
+  // Header (1) + remaining length (2) + tópico (2 + 19) + id (2) enchem o pacote até MQTT_PACKET_MAX
+  size_t topicLen = strlen("energymeter/gw/data");
+  std::string big(MQTT_PACKET_MAX - 7 - topicLen, 'x');
+  TEST_ASSERT_TRUE(mqttPayloadMax(topicLen) <= big.size());
+  TEST_ASSERT_TRUE(publish(big.c_str()));
+  big += "x";
+  TEST_ASSERT_FALSE(publish(big.c_str()));
+
+  std::vector<StubPacket> sent = drain();
+  TEST_ASSERT_TRUE(sent[0].framed);
+  TEST_ASSERT_EQUAL_INT(MQTT_PACKET_MAX, sent[0].raw.size());
+}
+
+void test_parser_handles_fragments_and_skips_foreign_packets()
+{
+  publish("a");
+  publish("b");
+  std::vector<StubPacket> sent = drain();
+
+  // PUBLISH do broker (ignorado) + PINGRESP + dois PUBACK, um byte por vez
+  std::vector<uint8_t> stream = {MQTT_PUBLISH << 4, 5, 0, 1, 't', 'h', 'i',
+                                 MQTT_PINGRESP << 4, 0,
+                                 MQTT_PUBACK << 4, 2, (uint8_t)(sent[0].id >> 8), (uint8_t)sent[0].id,
+                                 MQTT_PUBACK << 4, 2, (uint8_t)(sent[1].id >> 8), (uint8_t)sent[1].id};
+  for (size_t i = 0; i < stream.size(); i++)
+    TEST_ASSERT_TRUE(session.receive(&stream[i], 1, now));
+  TEST_ASSERT_EQUAL_INT(0, session.inflight());
+
+  const uint8_t malformed[] = {MQTT_PUBLISH << 4, 0xFF, 0xFF, 0xFF, 0xFF};
+  TEST_ASSERT_FALSE(session.receive(malformed, sizeof(malformed), now));
+}
+
+void test_refused_connack()
+{
+  session.end();
+  session.begin(now);
+  const uint8_t refused[] = {MQTT_CONNACK << 4, 2, 0, 5}; // Não autorizado
+  TEST_ASSERT_FALSE(session.receive(refused, sizeof(refused), now));
+  TEST_ASSERT_FALSE(session.connected());
+  TEST_ASSERT_EQUAL_INT(5, session.connackCode());
+}
+
+void test_keepalive_pings_and_times_out()
+{
+  uint32_t ka = MQTT_KEEPALIVE_S * 1000;
+  TEST_ASSERT_EQUAL_INT(MQTT_IDLE, session.keepAlive(now + ka - 1));
+  TEST_ASSERT_EQUAL_INT(MQTT_SEND_PING, session.keepAlive(now + ka));
+
+  // Respondeu: volta ao silêncio
+  now += ka;
+  session.pingSent(now);
+  TEST_ASSERT_EQUAL_INT(MQTT_IDLE, session.keepAlive(now + MQTT_PING_TIMEOUT_MS - 1));
+  const uint8_t pingresp[] = {MQTT_PINGRESP << 4, 0};
+  session.receive(pingresp, sizeof(pingresp), now + 100);
+  TEST_ASSERT_EQUAL_INT(MQTT_IDLE, session.keepAlive(now + MQTT_PING_TIMEOUT_MS));
+
+  // Sem resposta: conexão morta
+  now += ka;
+  session.pingSent(now);
+  TEST_ASSERT_EQUAL_INT(MQTT_TIMED_OUT, session.keepAlive(now + MQTT_PING_TIMEOUT_MS));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_packet);
+  RUN_TEST(test_streamed_publish_header);
+  RUN_TEST(test_window_pipelines_qos1_and_matches_acks_by_id);
+  RUN_TEST(test_unacked_are_resent_with_dup_after_reconnect);
+  RUN_TEST(test_outbox_ack_advances_in_order);
+  RUN_TEST(test_write_cut_mid_packet_is_resent);
+  RUN_TEST(test_qos0_has_its_own_slots);
+  RUN_TEST(test_oversized_payload_is_rejected);
+  RUN_TEST(test_parser_handles_fragments_and_skips_foreign_packets);
+  RUN_TEST(test_refused_connack);
+  RUN_TEST(test_keepalive_pings_and_times_out);
+  UNITY_END();
+  return 0;
+}
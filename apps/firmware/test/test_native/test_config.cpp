@@ -4,14 +4,20 @@
 // --- TRUQUES PARA O TESTE ---
 #include "../mocks/Arduino.h"
 #include "../mocks/LittleFS.h"
+#include "../mocks/ConfigFixture.h"
 
 #define private public
 #include "../../src/ConfigManager.cpp"
+#include "../../src/MeterProfiles.cpp"
+#include "../../src/AtomicFile.cpp"
+#include "../../src/ConfigSnapshot.cpp"
+#include "../../src/JsonInput.cpp"
 
 // --- FUNÇÕES OBRIGATÓRIAS DO UNITY (ADICIONE ISTO) ---
 void setUp(void)
 {
   // Roda antes de cada teste. Se precisar limpar algo, coloque aqui.
+  LittleFS.format();
 }
 
 void tearDown(void)
@@ -43,6 +49,99 @@ void test_channel_index_parsing()
   TEST_ASSERT_EQUAL_STRING("Ar Condicionado", result.meters[0].name.c_str());
 }
 
+void test_meter_model_parsing()
+{
+  JsonDocument doc;
+  doc["meters"].add<JsonObject>()["model"] = "sdm120";
+  doc["meters"].add<JsonObject>()["model"] = "modelo_inexistente";
+
+  ConfigManager manager;
+  SystemConfig result = manager.deserialize(doc);
+
+  TEST_ASSERT_EQUAL_INT(METER_SDM120, result.meters[0].model);
+  TEST_ASSERT_EQUAL_INT(METER_DDS238, result.meters[1].model);
+}
+
+void test_bus_parsing()
+{
+  JsonDocument doc;
+  JsonObject b1 = doc["buses"].add<JsonObject>();
+  b1["uart"] = 2;
+  JsonObject b2 = doc["buses"].add<JsonObject>();
+  b2["uart"] = 1;
+  b2["rx"] = 25;
+  b2["tx"] = 26;
+  b2["de"] = 27;
+  b2["baud"] = 19200;
+  b2["parity"] = "even";
+  doc["meters"].add<JsonObject>()["bus"] = 1;
+  doc["meters"].add<JsonObject>()["bus"] = 5; // barramento inexistente
+
+  ConfigManager manager;
+  SystemConfig result = manager.deserialize(doc);
+
+  TEST_ASSERT_EQUAL_INT(2, result.buses.size());
+  TEST_ASSERT_EQUAL_INT(16, result.buses[0].rxPin); // padrão
+  TEST_ASSERT_EQUAL_INT(1, result.buses[1].uart);
+  TEST_ASSERT_EQUAL_INT(27, result.buses[1].dePin);
+  TEST_ASSERT_EQUAL_INT(19200, result.buses[1].baud);
+  TEST_ASSERT_EQUAL_INT(PARITY_EVEN, result.buses[1].parity);
+  TEST_ASSERT_EQUAL_INT(PARITY_NONE, result.buses[0].parity); // padrão 8N1
+  TEST_ASSERT_EQUAL_INT(1, result.meters[0].bus);
+  TEST_ASSERT_EQUAL_INT(0, result.meters[1].bus);
+
+  // Config antiga, sem "buses": um barramento Serial2 16/17/4 a 9600
+  JsonDocument legacy;
+  legacy["meters"].add<JsonObject>()["modbus_id"] = 10;
+  result = manager.deserialize(legacy);
+  TEST_ASSERT_EQUAL_INT(1, result.buses.size());
+  TEST_ASSERT_EQUAL_INT(2, result.buses[0].uart);
+  TEST_ASSERT_EQUAL_INT(4, result.buses[0].dePin);
+  TEST_ASSERT_EQUAL_INT(9600, result.buses[0].baud);
+}
+
+void test_deadband_parsing()
+{
+  JsonDocument doc;
+  JsonObject meter = doc["meters"].add<JsonObject>();
+  meter["deadband"]["power"] = 20;
+  meter["deadband"]["percent"] = 5;
+  meter["deadband"]["heartbeat"] = 600;
+  doc["meters"].add<JsonObject>()["modbus_id"] = 2;
+
+  ConfigManager manager;
+  SystemConfig result = manager.deserialize(doc);
+
+  TEST_ASSERT_TRUE(result.meters[0].deadband.enabled());
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, result.meters[0].deadband.power);
+  TEST_ASSERT_EQUAL_FLOAT(5.0f, result.meters[0].deadband.percent);
+  TEST_ASSERT_EQUAL_INT(600, result.meters[0].deadband.heartbeatSec);
+  TEST_ASSERT_FALSE(result.meters[1].deadband.enabled()); // sem bloco: publica tudo
+
+  // Ida e volta pelo JSON
+  JsonDocument out;
+  manager.serialize(result, out);
+  TEST_ASSERT_EQUAL_INT(600, out["meters"][0]["deadband"]["heartbeat"].as<int>());
+  TEST_ASSERT_FALSE(out["meters"][1]["deadband"].is<JsonObject>());
+}
+
+void test_queue_overflow_policy()
+{
+  JsonDocument doc;
+  ConfigManager manager;
+
+  // Sem o campo: spill (nada se perde)
+  TEST_ASSERT_EQUAL_INT(RING_SPILL, manager.deserialize(doc).queueOverflow);
+
+  doc["mqtt"]["overflow"] = "drop_oldest";
+  SystemConfig result = manager.deserialize(doc);
+  TEST_ASSERT_EQUAL_INT(RING_DROP_OLDEST, result.queueOverflow);
+
+  JsonDocument out;
+  manager.serialize(result, out);
+  TEST_ASSERT_EQUAL_STRING("drop_oldest", out["mqtt"]["overflow"].as<const char *>());
+}
+
 void test_legacy_compatibility()
 {
   JsonDocument doc;
@@ -56,11 +155,181 @@ void test_legacy_compatibility()
   TEST_ASSERT_EQUAL_INT(5, result.meters[0].channelIndex);
 }
 
+void test_boot_prefers_snapshot_and_falls_back_to_json()
+{
+  ConfigManager manager;
+  TEST_ASSERT_TRUE(manager.save(makeConfig()));
+  TEST_ASSERT_TRUE(LittleFS.exists("/config.bin"));
+
+  SystemConfig loaded = manager.load();
+  TEST_ASSERT_EQUAL_INT(CONFIG_FROM_SNAPSHOT, manager.lastSource());
+  TEST_ASSERT_EQUAL_STRING("Kitnet 101", loaded.meters[0].name.c_str());
+
+  // JSON trocado por fora: o snapshot não bate mais e o JSON vence
+  File f = LittleFS.open("/config.json", "w");
+  f.print(String("{\"mqtt\":{\"device_id\":\"editado\"},\"meters\":[]}"));
+  f.close();
+  loaded = manager.load();
+  TEST_ASSERT_EQUAL_INT(CONFIG_FROM_JSON, manager.lastSource());
+  TEST_ASSERT_EQUAL_STRING("editado", loaded.deviceId.c_str());
+
+  // ...e o snapshot é refeito para o próximo boot
+  manager.load();
+  TEST_ASSERT_EQUAL_INT(CONFIG_FROM_SNAPSHOT, manager.lastSource());
+}
+
+void test_corrupted_config_restores_last_known_good()
+{
+  ConfigManager manager;
+  SystemConfig config = makeConfig();
+  manager.save(config);
+  config.meters[0].name = "Kitnet 102";
+  manager.save(config);
+
+  // Os dois arquivos atuais estragados (ex.: flash com bit trocado)
+  (*LittleFS.raw("/config.json"))[0] = '#';
+  (*LittleFS.raw("/config.bin"))[20] ^= 0xFF;
+
+  SystemConfig loaded = manager.load();
+  TEST_ASSERT_EQUAL_INT(CONFIG_FROM_BACKUP, manager.lastSource());
+  TEST_ASSERT_EQUAL_STRING("Kitnet 101", loaded.meters[0].name.c_str());
+  TEST_ASSERT_EQUAL_INT(8883, loaded.mqttPort);
+}
+
+void test_interrupted_save_keeps_previous_config()
+{
+  ConfigManager manager;
+  manager.save(makeConfig());
+
+  // Queda de energia no meio do save: só o temporário ficou pela metade
+  File tmp = AtomicFile::begin("/config.json");
+  tmp.print(String("{\"wifi\":{\"ss"));
+  tmp.close();
+
+  SystemConfig loaded = manager.load();
+  TEST_ASSERT_EQUAL_INT(CONFIG_FROM_SNAPSHOT, manager.lastSource());
+  TEST_ASSERT_EQUAL_STRING("Kitnets", loaded.wifiSsid.c_str());
+}
+
+void test_reset_removes_backups()
+{
+  ConfigManager manager;
+  manager.save(makeConfig());
+  manager.save(makeConfig());
+  manager.reset();
+
+  SystemConfig loaded = manager.load();
+  TEST_ASSERT_EQUAL_INT(CONFIG_FROM_DEFAULTS, manager.lastSource());
+  TEST_ASSERT_TRUE(loaded.apModeForce);
+  TEST_ASSERT_EQUAL_INT(0, loaded.meters.size());
+}
+
+// Saída em memória para as partes do JSON
+class StringPrint : public Print
+{
+public:
+  std::string text;
+  size_t write(uint8_t c) override
+  {
+    text += (char)c;
+    return 1;
+  }
+};
+
+void test_save_writes_parts_that_form_the_whole_document()
+{
+  ConfigManager manager;
+  SystemConfig config = makeConfig(130, 2);
+  TEST_ASSERT_TRUE(manager.save(config));
+
+  // Partes concatenadas == documento inteiro montado de uma vez
+  JsonDocument doc;
+  manager.serialize(config, doc);
+  std::string whole;
+  serializeJson(doc, whole);
+  FileData *raw = LittleFS.raw("/config.json");
+  TEST_ASSERT_EQUAL_STRING(whole.c_str(), std::string(raw->begin(), raw->end()).c_str());
+
+  // E o JSON é lido de volta em duas passadas
+  SystemConfig loaded;
+  TEST_ASSERT_TRUE(manager.parseFile("/config.json", loaded));
+  TEST_ASSERT_EQUAL_INT(130, loaded.meters.size());
+  TEST_ASSERT_EQUAL_INT(2, loaded.buses.size());
+  TEST_ASSERT_EQUAL_STRING("Kitnet 230", loaded.meters[129].name.c_str());
+  TEST_ASSERT_EQUAL_INT(1, loaded.meters[129].bus);
+  TEST_ASSERT_EQUAL_FLOAT(15.0f, loaded.meters[129].deadband.power);
+  TEST_ASSERT_EQUAL_INT(8883, loaded.mqttPort);
+}
+
+void test_api_parts_hide_password()
+{
+  SystemConfig config = makeConfig(2, 2);
+  config.wifiPass = "segredo";
+  config.deviceId = "A1B2C3D4E5F6";
+
+  StringPrint out;
+  for (size_t part = 0; part < ConfigManager::partCount(config); part++)
+    TEST_ASSERT_GREATER_THAN(0, ConfigManager::writePart(config, part, out, true));
+  TEST_ASSERT_EQUAL_INT(0, ConfigManager::writePart(config, ConfigManager::partCount(config), out, true));
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, out.text));
+  TEST_ASSERT_FALSE(doc["wifi"]["pass"].is<const char *>());
+  TEST_ASSERT_EQUAL_STRING("A1B2C3D4E5F6", doc["system"]["serial_id"].as<const char *>());
+  TEST_ASSERT_EQUAL_INT(2, doc["meters"].size());
+}
+
+void test_read_meters_from_body_in_any_order()
+{
+  // "meters" antes do cabeçalho e um "meters" falso dentro do mqtt
+  const char *body = "{ \"meters\" : [ {\"id\":1,\"modbus_id\":11,\"name\":\"A\"} ,\n"
+                     "{\"id\":2,\"modbus_id\":12,\"bus\":1,\"name\":\"B\"} ],"
+                     "\"mqtt\":{\"server\":\"meters\",\"meters\":[]},\"wifi\":{\"ssid\":\"Kitnets\"}}";
+  BufferJsonInput in(body, strlen(body));
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(ConfigManager::readHeader(in, doc));
+  TEST_ASSERT_EQUAL_STRING("Kitnets", doc["wifi"]["ssid"].as<const char *>());
+  TEST_ASSERT_FALSE(doc["meters"].is<JsonArray>()); // Filtrado: fica para a segunda passada
+
+  std::vector<MeterConfig> meters;
+  TEST_ASSERT_TRUE(in.rewind());
+  TEST_ASSERT_EQUAL_INT(1, ConfigManager::readMeters(in, meters));
+  TEST_ASSERT_EQUAL_INT(2, meters.size());
+  TEST_ASSERT_EQUAL_INT(12, meters[1].modbusId);
+  TEST_ASSERT_EQUAL_INT(1, meters[1].bus);
+  TEST_ASSERT_EQUAL_STRING("B", meters[1].name.c_str());
+
+  // Sem a chave: mantém a lista atual
+  const char *noMeters = "{\"wifi\":{\"ssid\":\"x\"}}";
+  BufferJsonInput partial(noMeters, strlen(noMeters));
+  TEST_ASSERT_EQUAL_INT(0, ConfigManager::readMeters(partial, meters));
+
+  // Vírgula sobrando ou corpo cortado no meio: inválido
+  const char *trailing = "{\"meters\":[{\"id\":1},]}";
+  BufferJsonInput bad(trailing, strlen(trailing));
+  TEST_ASSERT_EQUAL_INT(-1, ConfigManager::readMeters(bad, meters));
+  const char *cut = "{\"meters\":[{\"id\":1},{\"id\"";
+  BufferJsonInput truncated(cut, strlen(cut));
+  TEST_ASSERT_EQUAL_INT(-1, ConfigManager::readMeters(truncated, meters));
+}
+
 int main(int argc, char **argv)
 {
   UNITY_BEGIN();
   RUN_TEST(test_channel_index_parsing);
   RUN_TEST(test_legacy_compatibility);
+  RUN_TEST(test_meter_model_parsing);
+  RUN_TEST(test_bus_parsing);
+  RUN_TEST(test_deadband_parsing);
+  RUN_TEST(test_queue_overflow_policy);
+  RUN_TEST(test_boot_prefers_snapshot_and_falls_back_to_json);
+  RUN_TEST(test_corrupted_config_restores_last_known_good);
+  RUN_TEST(test_interrupted_save_keeps_previous_config);
+  RUN_TEST(test_reset_removes_backups);
+  RUN_TEST(test_save_writes_parts_that_form_the_whole_document);
+  RUN_TEST(test_api_parts_hide_password);
+  RUN_TEST(test_read_meters_from_body_in_any_order);
   UNITY_END();
   return 0;
 }
\ No newline at end of file
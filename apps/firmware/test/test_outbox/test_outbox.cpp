@@ -0,0 +1,214 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+#include "../mocks/LittleFS.h"
+
+#include "../../src/ReadingOutbox.cpp"
+
+static MeterReading makeReading(uint8_t channel, float kwh)
+{
+  MeterReading r;
+  memset(&r, 0, sizeof(r));
+  r.channelId = channel;
+  r.voltage = 220.0f;
+  r.totalKwh = kwh;
+  return r;
+}
+
+void setUp(void)
+{
+  // Cada teste começa com o "flash" vazio
+  LittleFS.format();
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_push_peek_ack_in_order()
+{
+  ReadingOutbox outbox;
+  TEST_ASSERT_TRUE(outbox.begin(16));
+
+  for (int i = 0; i < 5; i++)
+    outbox.push(makeReading(i, i * 10.0f));
+  TEST_ASSERT_EQUAL_INT(5, outbox.size());
+
+  MeterReading batch[OUTBOX_MAX_BATCH];
+  size_t n = outbox.peek(batch, 3);
+  TEST_ASSERT_EQUAL_INT(3, n);
+  TEST_ASSERT_EQUAL_INT(0, batch[0].channelId);
+  TEST_ASSERT_EQUAL_INT(2, batch[2].channelId);
+
+  // Só o primeiro foi publicado
+  outbox.ack(1);
+  TEST_ASSERT_EQUAL_INT(4, outbox.size());
+
+  n = outbox.peek(batch, OUTBOX_MAX_BATCH);
+  TEST_ASSERT_EQUAL_INT(4, n);
+  TEST_ASSERT_EQUAL_INT(1, batch[0].channelId);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 40.0f, batch[3].totalKwh);
+}
+
+void test_survives_reboot()
+{
+  {
+    ReadingOutbox outbox;
+    outbox.begin(16);
+    for (int i = 0; i < 6; i++)
+      outbox.push(makeReading(i, 0));
+
+    MeterReading batch[OUTBOX_MAX_BATCH];
+    outbox.peek(batch, 2);
+    outbox.ack(2);
+  }
+
+  // "Reboot": nova instância lendo o mesmo arquivo
+  ReadingOutbox outbox;
+  outbox.begin(16);
+  TEST_ASSERT_EQUAL_INT(4, outbox.size());
+
+  MeterReading batch[OUTBOX_MAX_BATCH];
+  TEST_ASSERT_EQUAL_INT(4, outbox.peek(batch, OUTBOX_MAX_BATCH));
+  TEST_ASSERT_EQUAL_INT(2, batch[0].channelId);
+
+  // Novas leituras continuam a sequência após as recuperadas
+  outbox.push(makeReading(42, 0));
+  TEST_ASSERT_EQUAL_INT(5, outbox.peek(batch, OUTBOX_MAX_BATCH));
+  TEST_ASSERT_EQUAL_INT(42, batch[4].channelId);
+}
+
+void test_full_evicts_oldest_first()
+{
+  ReadingOutbox outbox;
+  outbox.begin(8);
+
+  for (int i = 0; i < 20; i++)
+    outbox.push(makeReading(i, 0));
+
+  TEST_ASSERT_EQUAL_INT(8, outbox.size());
+  TEST_ASSERT_EQUAL_INT(12, outbox.dropped());
+
+  MeterReading batch[OUTBOX_MAX_BATCH];
+  TEST_ASSERT_EQUAL_INT(8, outbox.peek(batch, OUTBOX_MAX_BATCH));
+  TEST_ASSERT_EQUAL_INT(12, batch[0].channelId);
+  TEST_ASSERT_EQUAL_INT(19, batch[7].channelId);
+
+  // Após wrap-around, o reboot encontra a mesma janela
+  ReadingOutbox rebooted;
+  rebooted.begin(8);
+  TEST_ASSERT_EQUAL_INT(8, rebooted.size());
+  rebooted.peek(batch, 1);
+  TEST_ASSERT_EQUAL_INT(12, batch[0].channelId);
+}
+
+void test_sent_records_stay_until_acked()
+{
+  {
+    ReadingOutbox outbox;
+    outbox.begin(16);
+    for (int i = 0; i < 6; i++)
+      outbox.push(makeReading(i, 0));
+
+    // Entregues ao MQTT: o próximo peek começa depois, mas nada sai do flash
+    MeterReading batch[OUTBOX_MAX_BATCH];
+    uint32_t seqs[OUTBOX_MAX_BATCH];
+    TEST_ASSERT_EQUAL_INT(4, outbox.peek(batch, 4, seqs));
+    TEST_ASSERT_EQUAL_UINT32(0, seqs[0]);
+    TEST_ASSERT_EQUAL_UINT32(3, seqs[3]);
+    outbox.markSent(4);
+    TEST_ASSERT_EQUAL_INT(6, outbox.size());
+    TEST_ASSERT_EQUAL_INT(2, outbox.unsent());
+    TEST_ASSERT_EQUAL_INT(2, outbox.peek(batch, OUTBOX_MAX_BATCH));
+    TEST_ASSERT_EQUAL_INT(4, batch[0].channelId);
+
+    // PUBACK dos dois primeiros
+    outbox.ackThrough(2);
+    TEST_ASSERT_EQUAL_INT(4, outbox.size());
+    outbox.ackThrough(1); // Atrasado: não volta
+    TEST_ASSERT_EQUAL_INT(4, outbox.size());
+  }
+
+  // Reboot com 2 e 3 ainda sem PUBACK: saem de novo
+  ReadingOutbox outbox;
+  outbox.begin(16);
+  TEST_ASSERT_EQUAL_INT(4, outbox.size());
+  TEST_ASSERT_EQUAL_INT(4, outbox.unsent());
+  MeterReading batch[OUTBOX_MAX_BATCH];
+  TEST_ASSERT_EQUAL_INT(4, outbox.peek(batch, OUTBOX_MAX_BATCH));
+  TEST_ASSERT_EQUAL_INT(2, batch[0].channelId);
+}
+
+void test_overflow_moves_cursor_past_dropped()
+{
+  ReadingOutbox outbox;
+  outbox.begin(4);
+  for (int i = 0; i < 4; i++)
+    outbox.push(makeReading(i, 0));
+
+  MeterReading batch[OUTBOX_MAX_BATCH];
+  outbox.peek(batch, 2);
+  outbox.markSent(2);
+
+  // Cheio: os entregues sem PUBACK são os primeiros a sair
+  for (int i = 4; i < 7; i++)
+    outbox.push(makeReading(i, 0));
+  TEST_ASSERT_EQUAL_INT(3, outbox.dropped());
+  TEST_ASSERT_EQUAL_INT(4, outbox.unsent());
+  TEST_ASSERT_EQUAL_INT(4, outbox.peek(batch, OUTBOX_MAX_BATCH));
+  TEST_ASSERT_EQUAL_INT(3, batch[0].channelId);
+
+  // PUBACK de um registro já descartado não mexe em nada
+  outbox.ackThrough(2);
+  TEST_ASSERT_EQUAL_INT(4, outbox.size());
+}
+
+void test_corrupted_record_is_skipped()
+{
+  ReadingOutbox outbox;
+  outbox.begin(16);
+  for (int i = 0; i < 3; i++)
+    outbox.push(makeReading(i, 0));
+
+  // Simula escrita interrompida no registro do meio
+  FileData *raw = LittleFS.raw("/outbox.bin");
+  TEST_ASSERT_NOT_NULL(raw);
+  (*raw)[raw->size() - 2 * sizeof(OutboxRecord) + 6] ^= 0xFF;
+
+  ReadingOutbox rebooted;
+  rebooted.begin(16);
+
+  MeterReading batch[OUTBOX_MAX_BATCH];
+  TEST_ASSERT_EQUAL_INT(2, rebooted.peek(batch, OUTBOX_MAX_BATCH));
+  TEST_ASSERT_EQUAL_INT(0, batch[0].channelId);
+  TEST_ASSERT_EQUAL_INT(2, batch[1].channelId);
+
+  rebooted.ack(2);
+  TEST_ASSERT_EQUAL_INT(0, rebooted.size());
+}
+
+void test_capacity_change_recreates_log()
+{
+  ReadingOutbox outbox;
+  outbox.begin(16);
+  outbox.push(makeReading(1, 0));
+
+  ReadingOutbox resized;
+  resized.begin(32);
+  TEST_ASSERT_EQUAL_INT(0, resized.size());
+  TEST_ASSERT_EQUAL_INT(32, resized.capacity());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_push_peek_ack_in_order);
+  RUN_TEST(test_survives_reboot);
+  RUN_TEST(test_full_evicts_oldest_first);
+  RUN_TEST(test_sent_records_stay_until_acked);
+  RUN_TEST(test_overflow_moves_cursor_past_dropped);
+  RUN_TEST(test_corrupted_record_is_skipped);
+  RUN_TEST(test_capacity_change_recreates_log);
+  UNITY_END();
+  return 0;
+}
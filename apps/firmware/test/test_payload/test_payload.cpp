@@ -0,0 +1,312 @@
+#include <unity.h>
+#include <ArduinoJson.h>
+
+#include "../mocks/Arduino.h"
+#include "../mocks/HeapCounter.h"
+
+#include "../../src/TelemetryEncoder.cpp"
+#include "../../src/WallClock.cpp"
+#include "../../src/SlaveHealth.cpp"
+#include "../../src/Metrics.cpp"
+
+static MeterReading readings[64];
+static char buffer[4096];
+
+void setUp(void)
+{
+  for (int i = 0; i < 64; i++)
+  {
+    memset(&readings[i], 0, sizeof(MeterReading));
+    readings[i].channelId = i + 1;
+    readings[i].voltage = 220.5f;
+    readings[i].current = 12.34f;
+    readings[i].power = 2721.0f;
+    readings[i].totalKwh = 12345.67f;
+  }
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_cycle_in_single_message()
+{
+  TelemetryEncoder encoder;
+  size_t len;
+  size_t used = encoder.encodeJson("GW01", readings, 4, buffer, sizeof(buffer), len);
+
+  TEST_ASSERT_EQUAL_INT(4, used);
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, buffer, len));
+  TEST_ASSERT_EQUAL_STRING("GW01", doc["device_id"].as<const char *>());
+  TEST_ASSERT_EQUAL_INT(4, doc["channels"].size());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 220.5f, doc["channels"]["3"]["voltage"].as<float>());
+}
+
+void test_splits_when_buffer_is_full()
+{
+  TelemetryEncoder encoder;
+  size_t len;
+  size_t total = 0;
+  int messages = 0;
+
+  while (total < 64)
+  {
+    size_t used = encoder.encodeJson("GW01", readings + total, 64 - total, buffer, 512, len);
+    TEST_ASSERT_GREATER_THAN(0, used);
+    TEST_ASSERT_LESS_THAN(512, len);
+    total += used;
+    messages++;
+  }
+
+  TEST_ASSERT_EQUAL_INT(64, total);
+  TEST_ASSERT_GREATER_THAN(1, messages);
+  TEST_ASSERT_LESS_THAN(64, messages);
+}
+
+void test_repeated_channel_starts_new_message()
+{
+  // Replay do outbox: o canal 1 aparece em dois ciclos seguidos
+  readings[2].channelId = 1;
+
+  TelemetryEncoder encoder;
+  size_t len;
+  TEST_ASSERT_EQUAL_INT(2, encoder.encodeJson("GW01", readings, 4, buffer, sizeof(buffer), len));
+}
+
+// Payload que cabe num slot da MqttSession (pacote de 1 KB menos tópico e header)
+const size_t SLOT_PAYLOAD = 960;
+
+// Bytes para publicar as `channels` primeiras leituras no formato, em
+// mensagens de até `capacity` (como o MqttWorker::publishBatch divide)
+static size_t batchBytes(PayloadFormat format, size_t channels, size_t capacity, size_t &messages)
+{
+  TelemetryEncoder encoder;
+  String deviceId("A1B2C3D4E5F6");
+  size_t total = 0, sent = 0, len;
+  messages = 0;
+  while (sent < channels)
+  {
+    size_t n = encoder.encode(format, deviceId, readings + sent, channels - sent, buffer, capacity, len);
+    if (n == 0)
+      break;
+    sent += n;
+    total += len;
+    messages++;
+  }
+  return sent == channels ? total : 0;
+}
+
+static void assertMsgPackSmaller(size_t channels)
+{
+  // Ganho da codificação: o mesmo lote em JSON e em MessagePack
+  size_t jsonMessages, packMessages;
+  size_t json = batchBytes(PAYLOAD_JSON, channels, sizeof(buffer), jsonMessages);
+  size_t pack = batchBytes(PAYLOAD_MSGPACK, channels, sizeof(buffer), packMessages);
+  TEST_ASSERT_GREATER_THAN(0, json);
+  TEST_ASSERT_GREATER_THAN(0, pack);
+
+  // À parte: PUBLISH por ciclo com o payload limitado a um slot MQTT
+  size_t jsonSlots, packSlots;
+  batchBytes(PAYLOAD_JSON, channels, SLOT_PAYLOAD, jsonSlots);
+  batchBytes(PAYLOAD_MSGPACK, channels, SLOT_PAYLOAD, packSlots);
+
+  char msg[160];
+  snprintf(msg, sizeof(msg), "%u canais: JSON %u bytes, MessagePack %u bytes (%.0f%%); mensagens de 1 KB: JSON %u, MessagePack %u",
+           (unsigned)channels, (unsigned)json, (unsigned)pack, 100.0 * pack / json, (unsigned)jsonSlots, (unsigned)packSlots);
+  TEST_MESSAGE(msg);
+
+  // Só a codificação já corta mais da metade, com 1 canal ou com 32
+  TEST_ASSERT_LESS_THAN(json / 2, pack);
+  TEST_ASSERT_LESS_OR_EQUAL(jsonSlots, packSlots);
+}
+
+void test_msgpack_size_1_channel() { assertMsgPackSmaller(1); }
+void test_msgpack_size_8_channels() { assertMsgPackSmaller(8); }
+void test_msgpack_size_32_channels() { assertMsgPackSmaller(32); }
+
+void test_msgpack_header_has_schema_version()
+{
+  TelemetryEncoder encoder;
+  size_t len;
+  encoder.encodeMsgPack("GW01", readings, 2, buffer, sizeof(buffer), len);
+
+  const uint8_t *p = (const uint8_t *)buffer;
+  TEST_ASSERT_EQUAL_HEX8(0x83, p[0]);                     // fixmap(3)
+  TEST_ASSERT_EQUAL_HEX8(TK_VERSION, p[1]);
+  TEST_ASSERT_EQUAL_HEX8(TELEMETRY_SCHEMA_VERSION, p[2]);
+  TEST_ASSERT_EQUAL_HEX8(TK_DEVICE_ID, p[3]);
+  TEST_ASSERT_EQUAL_HEX8(0xa4, p[4]);                     // fixstr(4) "GW01"
+  TEST_ASSERT_EQUAL_HEX8(TK_CHANNELS, p[9]);
+  TEST_ASSERT_EQUAL_HEX8(0xdc, p[10]);                    // array16
+  TEST_ASSERT_EQUAL_HEX8(2, p[12]);
+}
+
+void test_steady_state_publish_does_not_allocate()
+{
+  TelemetryEncoder encoder;
+  String deviceId("A1B2C3D4E5F6");
+  size_t len;
+
+  // Primeira mensagem "aquece" (igual ao primeiro publish após o boot)
+  encoder.encode(PAYLOAD_JSON, deviceId, readings, 8, buffer, 1000, len);
+
+  heapCountStart();
+  for (int i = 0; i < 100; i++)
+  {
+    encoder.encode(PAYLOAD_JSON, deviceId, readings, 8, buffer, 1000, len);
+    encoder.encode(PAYLOAD_MSGPACK, deviceId, readings, 8, buffer, 1000, len);
+  }
+  HeapStats stats = heapCountStop();
+
+  TEST_ASSERT_EQUAL_INT(0, stats.allocs);
+  TEST_ASSERT_EQUAL_INT(0, stats.frees);
+}
+
+void test_summary_fields()
+{
+  readings[0].flags = READING_SUMMARY;
+  readings[0].samples = 150;
+  readings[0].powerMax = 4200.0f;
+  readings[0].energyDelta = 0.35f;
+
+  TelemetryEncoder encoder;
+  size_t len;
+  TEST_ASSERT_EQUAL_INT(2, encoder.encodeJson("GW01", readings, 2, buffer, sizeof(buffer), len));
+
+  JsonDocument doc;
+  deserializeJson(doc, buffer);
+  TEST_ASSERT_EQUAL_INT(150, doc["channels"]["1"]["samples"].as<int>());
+  TEST_ASSERT_EQUAL_FLOAT(4200.0f, doc["channels"]["1"]["power_max"].as<float>());
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.35f, doc["channels"]["1"]["energy_delta_kwh"].as<float>());
+  // Leitura instantânea continua sem os campos de resumo
+  TEST_ASSERT_FALSE(doc["channels"]["2"]["samples"].is<int>());
+
+  // MsgPack: canal de resumo com 13 chaves + tempo relativo ao boot (2)
+  encoder.encodeMsgPack("GW01", readings, 1, buffer, sizeof(buffer), len);
+  TEST_ASSERT_EQUAL_HEX8(0x8f, (uint8_t)buffer[13]); // fixmap(15)
+}
+
+void test_boot_relative_time_until_sntp_sync()
+{
+  WallClock clock;
+  clock.begin(0x2a);
+  readings[0].timeMs = 7500;
+  clock.stamp(readings[0]);
+
+  TelemetryEncoder encoder;
+  size_t len;
+  encoder.encodeJson("GW01", readings, 1, buffer, sizeof(buffer), len, &clock);
+
+  JsonDocument doc;
+  deserializeJson(doc, buffer);
+  TEST_ASSERT_EQUAL_INT(7500, doc["channels"]["1"]["ts_boot_ms"].as<int>());
+  TEST_ASSERT_EQUAL_INT(0x2a, doc["channels"]["1"]["boot_id"].as<int>());
+  TEST_ASSERT_FALSE(doc["channels"]["1"]["ts"].is<int64_t>());
+  TEST_ASSERT_FALSE(doc["timestamp"].is<int64_t>());
+}
+
+void test_queued_reading_gets_utc_after_sync()
+{
+  // Leitura carimbada antes do sync, ainda na fila quando o SNTP responde
+  WallClock clock;
+  clock.begin(0x2a);
+  readings[0].timeMs = 7500;
+  clock.stamp(readings[0]);
+  readings[1].timeMs = 7600;
+  clock.stamp(readings[1]);
+
+  const int64_t utcAt10s = 1760000000000LL;
+  clock.sync(10000, utcAt10s);
+
+  TelemetryEncoder encoder;
+  size_t len;
+  encoder.encodeJson("GW01", readings, 2, buffer, sizeof(buffer), len, &clock);
+
+  JsonDocument doc;
+  deserializeJson(doc, buffer);
+  TEST_ASSERT_TRUE(doc["channels"]["1"]["ts"].as<int64_t>() == utcAt10s - 2500);
+  TEST_ASSERT_TRUE(doc["channels"]["2"]["ts"].as<int64_t>() == utcAt10s - 2400);
+  TEST_ASSERT_TRUE(doc["timestamp"].as<int64_t>() == utcAt10s - 2500);
+  TEST_ASSERT_FALSE(doc["channels"]["1"]["boot_id"].is<int>());
+
+  // MsgPack: { 13: uint64 } no fim do canal
+  encoder.encodeMsgPack("GW01", readings, 1, buffer, sizeof(buffer), len, &clock);
+  const uint8_t *p = (const uint8_t *)buffer;
+  TEST_ASSERT_EQUAL_HEX8(0x86, p[13]); // fixmap(5 + 1)
+  TEST_ASSERT_EQUAL_HEX8(TK_CH_TS, p[len - 10]);
+  TEST_ASSERT_EQUAL_HEX8(0xcf, p[len - 9]);
+  uint64_t ts = 0;
+  for (int i = 0; i < 8; i++) ts = (ts << 8) | p[len - 8 + i];
+  TEST_ASSERT_TRUE(ts == (uint64_t)(utcAt10s - 2500));
+}
+
+void test_reading_from_previous_boot_stays_relative()
+{
+  // Replay do outbox: o boot anterior não tem como virar UTC
+  WallClock clock;
+  clock.begin(0x2a);
+  clock.sync(10000, 1760000000000LL);
+  readings[0].bootId = 0x11;
+  readings[0].timeMs = 3000;
+
+  TelemetryEncoder encoder;
+  size_t len;
+  encoder.encodeJson("GW01", readings, 1, buffer, sizeof(buffer), len, &clock);
+
+  JsonDocument doc;
+  deserializeJson(doc, buffer);
+  TEST_ASSERT_EQUAL_INT(3000, doc["channels"]["1"]["ts_boot_ms"].as<int>());
+  TEST_ASSERT_EQUAL_INT(0x11, doc["channels"]["1"]["boot_id"].as<int>());
+}
+
+void test_meter_status_payload()
+{
+  MeterStatus st;
+  st.channelId = 3;
+  st.bus = 1;
+  st.modbusId = 12;
+  st.timeoutUs = 120000;
+  st.health.state = SLAVE_OFFLINE;
+  st.health.srttUs = 23400;
+  st.health.consecutiveFailures = 5;
+
+  // Nunca respondeu: last_ok_s = null
+  size_t len = TelemetryEncoder::encodeMeterStatus(st, 60000, buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL_STRING("{\"bus\":1,\"modbus_id\":12,\"state\":\"offline\",\"response_ms\":23,"
+                           "\"timeout_ms\":120,\"failures\":5,\"last_ok_s\":null}",
+                           buffer);
+  TEST_ASSERT_EQUAL_INT(strlen(buffer), len);
+
+  st.health.okCount = 1;
+  st.health.lastOkMs = 18000;
+  TelemetryEncoder::encodeMeterStatus(st, 60000, buffer, sizeof(buffer));
+  TEST_ASSERT_NOT_NULL(strstr(buffer, "\"last_ok_s\":42}"));
+
+  // Não cabe: 0, sem JSON cortado
+  TEST_ASSERT_EQUAL_INT(0, TelemetryEncoder::encodeMeterStatus(st, 60000, buffer, 32));
+  TEST_ASSERT_EQUAL_INT(0, TelemetryEncoder::encodeGatewayStatus(100, 7, 1, buffer, 16));
+  TEST_ASSERT_GREATER_THAN(0, TelemetryEncoder::encodeGatewayStatus(100, 7, 1, buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL_STRING("{\"online\":true,\"uptime_s\":100,\"meters_online\":7,\"meters_offline\":1}", buffer);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_cycle_in_single_message);
+  RUN_TEST(test_splits_when_buffer_is_full);
+  RUN_TEST(test_repeated_channel_starts_new_message);
+  RUN_TEST(test_msgpack_size_1_channel);
+  RUN_TEST(test_msgpack_size_8_channels);
+  RUN_TEST(test_msgpack_size_32_channels);
+  RUN_TEST(test_msgpack_header_has_schema_version);
+  RUN_TEST(test_steady_state_publish_does_not_allocate);
+  RUN_TEST(test_summary_fields);
+  RUN_TEST(test_boot_relative_time_until_sntp_sync);
+  RUN_TEST(test_queued_reading_gets_utc_after_sync);
+  RUN_TEST(test_reading_from_previous_boot_stays_relative);
+  RUN_TEST(test_meter_status_payload);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,277 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/MeterProfiles.cpp"
+#include "../../src/ModbusRtuMaster.cpp"
+#include "../../src/SlaveHealth.cpp"
+#include "../../src/Metrics.cpp"
+#include "../../src/ModbusWorker.cpp"
+#include "../../src/WallClock.cpp"
+#include "../../src/MeterDiscovery.cpp"
+
+#include "../mocks/SimMeterBank.h"
+
+// Ciclos completos de leitura (ModbusWorker + mestre RTU) contra o banco
+// simulado, no relógio virtual: tempo de ciclo, falhas e ordem de entrega
+// saem iguais em toda execução.
+
+static std::vector<MeterConfig> meters;
+static ModbusWorker worker;
+
+struct Tally
+{
+  uint32_t ok;
+  uint32_t failed;
+  uint32_t failedById[248];
+  std::vector<uint8_t> order; // modbusId na ordem em que o callback recebeu
+  MeterReading last[248];     // Última leitura ok por modbusId
+};
+static Tally tally;
+
+static void onRead(const MeterConfig &meter, bool ok, const MeterReading &reading, void *ctx)
+{
+  Tally *t = (Tally *)ctx;
+  t->order.push_back(meter.modbusId);
+  if (ok)
+  {
+    t->ok++;
+    t->last[meter.modbusId] = reading;
+  }
+  else
+  {
+    t->failed++;
+    t->failedById[meter.modbusId]++;
+  }
+}
+
+static void addMeter(SimMeterBank &bank, uint8_t id, MeterModel model = METER_DDS238)
+{
+  MeterConfig m;
+  m.id = id;
+  m.channelIndex = id;
+  m.modbusId = id;
+  m.model = model;
+  meters.push_back(m);
+
+  bank.add(id, model);
+  bank.set(id, Q_VOLTAGE, 220.0f + id % 10);
+  bank.set(id, Q_CURRENT, 1.5f);
+  bank.set(id, Q_POWER, 300.0f + id);
+  bank.set(id, Q_ENERGY, 1000.0f + id);
+}
+
+// Um ciclo de todos os medidores, em lotes de MAX_CYCLE_READINGS como na
+// BusPoller. Retorna o tempo de barramento gasto (us).
+static uint32_t pollCycle(SimMeterBank &bank)
+{
+  uint8_t due[MAX_CYCLE_READINGS];
+  uint64_t start = bank.clockUs();
+  for (size_t first = 0; first < meters.size(); first += MAX_CYCLE_READINGS)
+  {
+    size_t n = 0;
+    for (size_t i = first; i < meters.size() && n < MAX_CYCLE_READINGS; i++)
+      due[n++] = i;
+    worker.readMeters(meters.data(), due, n, onRead, &tally);
+  }
+  return bank.clockUs() - start;
+}
+
+// Tempo mínimo de uma transação DDS238 no fio: requisição + resposta de 16 registradores
+static uint32_t dds238WireUs(const SimMeterBank &bank)
+{
+  return (8 + 5 + 2 * 16) * bank.timing().charUs;
+}
+
+void setUp(void)
+{
+  mockMillis = 0;
+  meters.clear();
+  tally.ok = 0;
+  tally.failed = 0;
+  memset(tally.failedById, 0, sizeof(tally.failedById));
+  tally.order.clear();
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_every_model_decodes_end_to_end()
+{
+  SimMeterBank bank;
+  addMeter(bank, 1, METER_DDS238);
+  addMeter(bank, 2, METER_SDM120);
+  addMeter(bank, 3, METER_SDM630);
+  addMeter(bank, 4, METER_DDSU666);
+  worker.begin(&bank, 9600, meters.size());
+
+  pollCycle(bank);
+
+  TEST_ASSERT_EQUAL_INT(4, tally.ok);
+  for (uint8_t id = 1; id <= 4; id++)
+  {
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 220.0f + id, tally.last[id].voltage);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 1.5f, tally.last[id].current);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 300.0f + id, tally.last[id].power);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 1000.0f + id, tally.last[id].totalKwh);
+  }
+  // Todo quadro enviado teve resposta (nenhum timeout no caminho feliz)
+  TEST_ASSERT_EQUAL_INT(bank.stats().replies, bank.stats().requests);
+}
+
+static void assertCycleTime(size_t count)
+{
+  setUp();
+  SimMeterBank bank;
+  for (size_t i = 1; i <= count; i++)
+    addMeter(bank, i);
+  worker.begin(&bank, 9600, meters.size());
+
+  uint32_t cycleUs = pollCycle(bank);
+
+  TEST_ASSERT_EQUAL_INT(count, tally.ok);
+  TEST_ASSERT_EQUAL_INT(count, bank.stats().requests);
+
+  // Limite: fio + latência do escravo + t3.5 antes de cada requisição, mais 1 ms de folga por medidor
+  uint32_t perMeter = dds238WireUs(bank) + bank.meter(1).latencyUs + bank.timing().t35Us;
+  TEST_ASSERT_GREATER_OR_EQUAL(count * dds238WireUs(bank), cycleUs);
+  TEST_ASSERT_LESS_OR_EQUAL(count * (perMeter + 1000), cycleUs);
+
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%u medidores: ciclo %u ms (%.1f ms/medidor, fio %u%%)", (unsigned)count,
+           (unsigned)(cycleUs / 1000), cycleUs / 1000.0 / count, (unsigned)(100ULL * bank.stats().busyUs / cycleUs));
+  TEST_MESSAGE(msg);
+}
+
+void test_cycle_time_1_meter() { assertCycleTime(1); }
+void test_cycle_time_16_meters() { assertCycleTime(16); }
+void test_cycle_time_247_meters() { assertCycleTime(247); }
+
+void test_readings_delivered_in_order()
+{
+  SimMeterBank bank;
+  for (uint8_t id = 1; id <= 8; id++)
+    addMeter(bank, id, id % 2 ? METER_DDS238 : METER_SDM120);
+  // Latências bem diferentes não mudam a ordem de entrega
+  bank.meter(3).latencyUs = 40000;
+  bank.meter(4).latencyUs = 1000;
+  worker.begin(&bank, 9600, meters.size());
+
+  pollCycle(bank);
+
+  TEST_ASSERT_EQUAL_INT(8, tally.order.size());
+  for (uint8_t i = 0; i < 8; i++)
+    TEST_ASSERT_EQUAL_INT(i + 1, tally.order[i]);
+}
+
+void test_sample_time_is_response_arrival()
+{
+  SimMeterBank bank;
+  addMeter(bank, 1);
+  addMeter(bank, 2);
+  bank.meter(1).latencyUs = 40000;
+  mockMillis = 5000;
+  worker.begin(&bank, 9600, meters.size());
+
+  pollCycle(bank);
+
+  // Monotônico (ms desde o boot), no instante em que a resposta chegou
+  int64_t first = tally.last[1].timeMs;
+  int64_t second = tally.last[2].timeMs;
+  TEST_ASSERT_TRUE(first >= 5000 + 40);
+  TEST_ASSERT_TRUE(second >= first + dds238WireUs(bank) / 1000);
+  TEST_ASSERT_TRUE(second <= (int64_t)mockMillis);
+}
+
+void test_silent_slave_stops_costing_bus_time()
+{
+  SimMeterBank bank;
+  for (uint8_t id = 1; id <= 8; id++)
+    addMeter(bank, id);
+  bank.meter(5).silent = true;
+  worker.begin(&bank, 9600, meters.size());
+
+  uint32_t first = pollCycle(bank);
+  // O timeout inicial (1 s) domina o ciclo
+  TEST_ASSERT_GREATER_THAN(HEALTH_INITIAL_TIMEOUT_US, first);
+
+  for (int i = 0; i < HEALTH_OFFLINE_AFTER - 1; i++)
+    pollCycle(bank);
+  TEST_ASSERT_EQUAL_INT(SLAVE_OFFLINE, worker.health().get(4).state);
+
+  // Offline: fora da sonda não é consultado, o ciclo volta ao tempo dos outros 7
+  uint32_t requests = bank.stats().requests;
+  tally.failed = 0;
+  uint32_t cycle = pollCycle(bank);
+  TEST_ASSERT_EQUAL_INT(7, bank.stats().requests - requests);
+  TEST_ASSERT_EQUAL_INT(0, tally.failed);
+  TEST_ASSERT_LESS_THAN(8 * (dds238WireUs(bank) + 10000), cycle);
+
+  // Volta a responder: na sonda seguinte fica online de novo
+  bank.meter(5).silent = false;
+  delay(HEALTH_PROBE_MAX_MS);
+  pollCycle(bank);
+  TEST_ASSERT_EQUAL_INT(SLAVE_ONLINE, worker.health().get(4).state);
+}
+
+void test_dropped_and_corrupted_frames_only_hit_that_meter()
+{
+  SimMeterBank bank(9600, 42);
+  for (uint8_t id = 1; id <= 4; id++)
+    addMeter(bank, id);
+  bank.meter(2).dropPct = 20;
+  bank.meter(2).corruptPct = 10;
+  worker.begin(&bank, 9600, meters.size());
+
+  for (int cycle = 0; cycle < 200; cycle++)
+  {
+    delay(1000);
+    pollCycle(bank);
+    // Falhando 3 vezes seguidas ele sairia da rodada até a sonda: mantém sempre consultado
+    if (worker.health().get(1).state == SLAVE_OFFLINE)
+      delay(HEALTH_PROBE_MAX_MS);
+  }
+
+  const SimBusStats &st = bank.stats();
+  TEST_ASSERT_GREATER_THAN(0, st.dropped);
+  TEST_ASSERT_GREATER_THAN(0, st.corrupted);
+  // Cada quadro perdido ou corrompido é exatamente uma falha do medidor 2
+  TEST_ASSERT_EQUAL_INT(st.dropped + st.corrupted, tally.failedById[2]);
+  TEST_ASSERT_EQUAL_INT(tally.failedById[2], tally.failed);
+  TEST_ASSERT_EQUAL_INT(4 * 200 - tally.failed, tally.ok);
+}
+
+void test_wrong_model_fails_fast_with_exception()
+{
+  SimMeterBank bank;
+  addMeter(bank, 1);
+  addMeter(bank, 2);
+  // Configurado como SDM120, mas quem está no endereço 2 é um DDS238
+  meters[1].model = METER_SDM120;
+  worker.begin(&bank, 9600, meters.size());
+
+  uint32_t cycleUs = pollCycle(bank);
+
+  TEST_ASSERT_EQUAL_INT(1, tally.ok);
+  TEST_ASSERT_EQUAL_INT(1, tally.failed);
+  TEST_ASSERT_GREATER_THAN(0, bank.stats().exceptions);
+  // Exceção responde na hora: nada de esperar o timeout
+  TEST_ASSERT_LESS_THAN(HEALTH_INITIAL_TIMEOUT_US / 4, cycleUs);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_every_model_decodes_end_to_end);
+  RUN_TEST(test_cycle_time_1_meter);
+  RUN_TEST(test_cycle_time_16_meters);
+  RUN_TEST(test_cycle_time_247_meters);
+  RUN_TEST(test_readings_delivered_in_order);
+  RUN_TEST(test_sample_time_is_response_arrival);
+  RUN_TEST(test_silent_slave_stops_costing_bus_time);
+  RUN_TEST(test_dropped_and_corrupted_frames_only_hit_that_meter);
+  RUN_TEST(test_wrong_model_fails_fast_with_exception);
+  UNITY_END();
+  return 0;
+}
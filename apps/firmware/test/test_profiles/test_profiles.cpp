@@ -0,0 +1,131 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/MeterProfiles.cpp"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_dds238_merged_into_single_read()
+{
+  // Antes: 0x000C x10 + 0x0000 x2 (duas transações)
+  ReadPlan plan = MeterProfiles::buildPlan(METER_PROFILES[METER_DDS238]);
+
+  TEST_ASSERT_EQUAL_INT(1, plan.blockCount);
+  TEST_ASSERT_EQUAL_INT(FC_HOLDING, plan.blocks[0].function);
+  TEST_ASSERT_EQUAL_HEX16(0x0000, plan.blocks[0].start);
+  TEST_ASSERT_EQUAL_INT(16, plan.blocks[0].count);
+}
+
+void test_distant_registers_split_blocks()
+{
+  // SDM120: 0x0000..0x000D perto, energia em 0x0156 (fora dos 125)
+  ReadPlan plan = MeterProfiles::buildPlan(METER_PROFILES[METER_SDM120]);
+
+  TEST_ASSERT_EQUAL_INT(2, plan.blockCount);
+  TEST_ASSERT_EQUAL_INT(FC_INPUT, plan.blocks[0].function);
+  TEST_ASSERT_EQUAL_INT(14, plan.blocks[0].count);
+  TEST_ASSERT_EQUAL_HEX16(0x0156, plan.blocks[1].start);
+  TEST_ASSERT_EQUAL_INT(2, plan.blocks[1].count);
+  TEST_ASSERT_EQUAL_INT(0, plan.fieldBlock[Q_POWER]);
+  TEST_ASSERT_EQUAL_INT(1, plan.fieldBlock[Q_ENERGY]);
+}
+
+void test_block_limit_is_respected()
+{
+  // SDM630 cabe num bloco de 54 regs, mas não num limite de 32
+  TEST_ASSERT_EQUAL_INT(2, MeterProfiles::buildPlan(METER_PROFILES[METER_SDM630]).blockCount);
+
+  ReadPlan plan = MeterProfiles::buildPlan(METER_PROFILES[METER_SDM630], 32);
+  TEST_ASSERT_EQUAL_INT(3, plan.blockCount);
+  for (uint8_t b = 0; b < plan.blockCount; b++)
+    TEST_ASSERT_LESS_OR_EQUAL(32, plan.blocks[b].count);
+}
+
+void test_different_functions_never_merge()
+{
+  MeterProfile mixed = {"mixed", {
+                                     {FC_HOLDING, 0x0000, REG_U16, WORDS_ABCD, 1.0f},
+                                     {FC_INPUT, 0x0001, REG_U16, WORDS_ABCD, 1.0f},
+                                     {FC_HOLDING, 0x0002, REG_U16, WORDS_ABCD, 1.0f},
+                                     {FC_INPUT, 0x0003, REG_U16, WORDS_ABCD, 1.0f},
+                                 }};
+  ReadPlan plan = MeterProfiles::buildPlan(mixed);
+
+  TEST_ASSERT_EQUAL_INT(2, plan.blockCount);
+  TEST_ASSERT_EQUAL_INT(plan.fieldBlock[0], plan.fieldBlock[2]);
+  TEST_ASSERT_EQUAL_INT(plan.fieldBlock[1], plan.fieldBlock[3]);
+}
+
+void test_float32_word_orders()
+{
+  // 230.5f = 0x43668000
+  const uint16_t abcd[] = {0x4366, 0x8000};
+  const uint16_t cdab[] = {0x8000, 0x4366};
+
+  RegisterField f = {FC_INPUT, 0, REG_F32, WORDS_ABCD, 1.0f};
+  TEST_ASSERT_EQUAL_FLOAT(230.5f, MeterProfiles::decode(f, abcd));
+
+  f.order = WORDS_CDAB;
+  TEST_ASSERT_EQUAL_FLOAT(230.5f, MeterProfiles::decode(f, cdab));
+}
+
+void test_integer_decoders_and_scale()
+{
+  const uint16_t energy[] = {0x0001, 0xE240}; // 123456
+  RegisterField kwh = {FC_HOLDING, 0, REG_U32, WORDS_ABCD, 0.01f};
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1234.56f, MeterProfiles::decode(kwh, energy));
+
+  const uint16_t swapped[] = {0xE240, 0x0001};
+  kwh.order = WORDS_CDAB;
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1234.56f, MeterProfiles::decode(kwh, swapped));
+
+  const uint16_t negative[] = {0xFF38}; // -200 W (exportando)
+  RegisterField power = {FC_HOLDING, 0, REG_S16, WORDS_ABCD, 1.0f};
+  TEST_ASSERT_EQUAL_FLOAT(-200.0f, MeterProfiles::decode(power, negative));
+}
+
+void test_model_names_round_trip()
+{
+  for (uint8_t m = 0; m < METER_MODEL_COUNT; m++)
+    TEST_ASSERT_EQUAL_INT(m, MeterProfiles::fromName(MeterProfiles::name((MeterModel)m)));
+
+  TEST_ASSERT_EQUAL_INT(METER_DDS238, MeterProfiles::fromName(""));
+  TEST_ASSERT_EQUAL_INT(METER_DDS238, MeterProfiles::fromName(NULL));
+}
+
+void test_plan_table_matches_planner()
+{
+  // A tabela já vem pronta da inicialização estática, sem depender de quem chama primeiro
+  for (uint8_t m = 0; m < METER_MODEL_COUNT; m++) {
+    ReadPlan expected = MeterProfiles::buildPlan(METER_PROFILES[m], PLAN_MAX_READ_REGS);
+    const ReadPlan &plan = MeterProfiles::plan((MeterModel)m);
+    TEST_ASSERT_EQUAL_INT(expected.blockCount, plan.blockCount);
+    for (uint8_t b = 0; b < plan.blockCount; b++) {
+      TEST_ASSERT_EQUAL_INT(expected.blocks[b].function, plan.blocks[b].function);
+      TEST_ASSERT_EQUAL_INT(expected.blocks[b].start, plan.blocks[b].start);
+      TEST_ASSERT_EQUAL_INT(expected.blocks[b].count, plan.blocks[b].count);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(expected.fieldBlock, plan.fieldBlock, sizeof(plan.fieldBlock));
+  }
+  // Modelo fora da faixa cai no padrão
+  TEST_ASSERT_TRUE(&MeterProfiles::plan(METER_DDS238) == &MeterProfiles::plan(METER_MODEL_COUNT));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_dds238_merged_into_single_read);
+  RUN_TEST(test_distant_registers_split_blocks);
+  RUN_TEST(test_block_limit_is_respected);
+  RUN_TEST(test_different_functions_never_merge);
+  RUN_TEST(test_float32_word_orders);
+  RUN_TEST(test_integer_decoders_and_scale);
+  RUN_TEST(test_model_names_round_trip);
+  RUN_TEST(test_plan_table_matches_planner);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,258 @@
+#include <unity.h>
+#include <thread>
+
+#include "../mocks/Arduino.h"
+
+#include "../../include/SpscRing.h"
+
+// Item grande o bastante para uma cópia "rasgada" aparecer (seq repetido em todos os campos)
+struct Item
+{
+  uint32_t seq;
+  uint32_t copy[11];
+};
+
+static Item makeItem(uint32_t seq)
+{
+  Item it;
+  it.seq = seq;
+  for (int i = 0; i < 11; i++)
+    it.copy[i] = seq * 2654435761u + i;
+  return it;
+}
+
+static bool intact(const Item &it)
+{
+  for (int i = 0; i < 11; i++)
+    if (it.copy[i] != it.seq * 2654435761u + i)
+      return false;
+  return true;
+}
+
+static std::vector<uint32_t> spilledSeqs;
+static void spillTo(const Item &item, void *ctx)
+{
+  ((std::vector<uint32_t> *)ctx)->push_back(item.seq);
+}
+
+const uint32_t STRESS_ITEMS = 2000000;
+
+// Produtor e consumidor em threads separadas; o consumidor confere ordem e integridade
+struct StressResult
+{
+  std::vector<uint32_t> received;
+  bool inOrder;
+  bool allIntact;
+};
+
+static StressResult stress(SpscRing<Item> &ring)
+{
+  StressResult r;
+  r.inOrder = true;
+  r.allIntact = true;
+  std::atomic<bool> done(false);
+
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < STRESS_ITEMS; i++)
+      ring.push(makeItem(i));
+    done.store(true);
+  });
+
+  Item batch[16];
+  uint32_t last = 0;
+  bool first = true;
+  while (true)
+  {
+    bool finished = done.load();
+    size_t n = ring.popBatch(batch, 16);
+    for (size_t i = 0; i < n; i++)
+    {
+      if (!intact(batch[i]))
+        r.allIntact = false;
+      if (!first && batch[i].seq <= last)
+        r.inOrder = false;
+      last = batch[i].seq;
+      first = false;
+      r.received.push_back(batch[i].seq);
+    }
+    if (n == 0 && finished)
+      break;
+  }
+  producer.join();
+  return r;
+}
+
+void setUp(void)
+{
+  spilledSeqs.clear();
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_capacity_rounds_to_power_of_two()
+{
+  SpscRing<Item> ring;
+  ring.begin(100, RING_DROP_NEWEST);
+  TEST_ASSERT_EQUAL_INT(128, ring.capacity());
+  TEST_ASSERT_EQUAL_INT(0, ring.size());
+}
+
+void test_batch_pop_in_order()
+{
+  SpscRing<Item> ring;
+  ring.begin(8, RING_DROP_NEWEST);
+  for (uint32_t i = 0; i < 5; i++)
+    TEST_ASSERT_TRUE(ring.push(makeItem(i)));
+
+  Item out[8];
+  TEST_ASSERT_EQUAL_INT(3, ring.popBatch(out, 3));
+  TEST_ASSERT_EQUAL_INT(0, out[0].seq);
+  TEST_ASSERT_EQUAL_INT(2, out[2].seq);
+  TEST_ASSERT_EQUAL_INT(2, ring.popBatch(out, 8));
+  TEST_ASSERT_EQUAL_INT(4, out[1].seq);
+  TEST_ASSERT_EQUAL_INT(0, ring.popBatch(out, 8));
+  TEST_ASSERT_EQUAL_INT(5, ring.highWater());
+}
+
+// Fim de grupo: seq múltiplo de 4 fecha o "ciclo" (0..3 abre, 3 fecha)
+static bool endsGroup(const Item &item) { return item.seq % 4 == 3; }
+
+void test_pop_through_leaves_open_cycle()
+{
+  SpscRing<Item> ring;
+  ring.begin(16, RING_DROP_NEWEST);
+  Item out[16];
+
+  // Ciclo ainda aberto: nada sai
+  ring.push(makeItem(0));
+  ring.push(makeItem(1));
+  TEST_ASSERT_EQUAL_INT(0, ring.popThrough(out, 16, endsGroup));
+  TEST_ASSERT_EQUAL_INT(2, ring.size());
+
+  // Fechou um e abriu o próximo: sai só o fechado
+  ring.push(makeItem(2));
+  ring.push(makeItem(3));
+  ring.push(makeItem(4));
+  TEST_ASSERT_EQUAL_INT(4, ring.popThrough(out, 16, endsGroup));
+  TEST_ASSERT_EQUAL_UINT32(3, out[3].seq);
+  TEST_ASSERT_EQUAL_INT(1, ring.size());
+
+  // Lote cheio sem fim de ciclo: divide (o chamador não tem onde guardar mais)
+  for (uint32_t i = 5; i < 7; i++)
+    ring.push(makeItem(i));
+  TEST_ASSERT_EQUAL_INT(2, ring.popThrough(out, 2, endsGroup));
+  TEST_ASSERT_EQUAL_UINT32(4, out[0].seq);
+  TEST_ASSERT_EQUAL_UINT32(5, out[1].seq);
+
+  ring.push(makeItem(7));
+  TEST_ASSERT_EQUAL_INT(2, ring.popThrough(out, 16, endsGroup));
+  TEST_ASSERT_EQUAL_UINT32(7, out[1].seq);
+  TEST_ASSERT_EQUAL_INT(0, ring.size());
+}
+
+void test_pop_through_full_ring_without_end()
+{
+  // Ciclo maior que a fila (config nova antes do reboot): a fila cheia sai assim mesmo
+  SpscRing<Item> ring;
+  ring.begin(4, RING_DROP_NEWEST);
+  Item out[16];
+  for (uint32_t i = 0; i < 4; i++)
+    ring.push(makeItem(i * 4));
+  TEST_ASSERT_EQUAL_INT(4, ring.popThrough(out, 16, endsGroup));
+}
+
+void test_overflow_policies_single_thread()
+{
+  Item out[8];
+  SpscRing<Item> newest, oldest, spill;
+  newest.begin(4, RING_DROP_NEWEST);
+  oldest.begin(4, RING_DROP_OLDEST);
+  spill.begin(4, RING_SPILL, spillTo, &spilledSeqs);
+
+  for (uint32_t i = 0; i < 6; i++)
+  {
+    newest.push(makeItem(i));
+    oldest.push(makeItem(i));
+    spill.push(makeItem(i));
+  }
+
+  // Descarta os que chegaram: fica 0..3
+  TEST_ASSERT_EQUAL_INT(2, newest.dropped());
+  TEST_ASSERT_EQUAL_INT(4, newest.popBatch(out, 8));
+  TEST_ASSERT_EQUAL_INT(0, out[0].seq);
+
+  // Descarta os mais antigos: fica 2..5
+  TEST_ASSERT_EQUAL_INT(2, oldest.dropped());
+  TEST_ASSERT_EQUAL_INT(4, oldest.popBatch(out, 8));
+  TEST_ASSERT_EQUAL_INT(2, out[0].seq);
+  TEST_ASSERT_EQUAL_INT(5, out[3].seq);
+
+  // Spill: 4 e 5 foram para o callback, nada perdido
+  TEST_ASSERT_EQUAL_INT(2, spill.spilled());
+  TEST_ASSERT_EQUAL_INT(0, spill.dropped());
+  TEST_ASSERT_EQUAL_INT(2, spilledSeqs.size());
+  TEST_ASSERT_EQUAL_INT(4, spilledSeqs[0]);
+  TEST_ASSERT_EQUAL_INT(4, spill.highWater());
+}
+
+void test_stress_drop_newest()
+{
+  SpscRing<Item> ring;
+  ring.begin(64, RING_DROP_NEWEST);
+  StressResult r = stress(ring);
+
+  TEST_ASSERT_TRUE(r.inOrder);
+  TEST_ASSERT_TRUE(r.allIntact);
+  TEST_ASSERT_EQUAL_INT(STRESS_ITEMS, r.received.size() + ring.dropped());
+}
+
+void test_stress_drop_oldest()
+{
+  SpscRing<Item> ring;
+  ring.begin(64, RING_DROP_OLDEST);
+  StressResult r = stress(ring);
+
+  TEST_ASSERT_TRUE(r.inOrder);
+  TEST_ASSERT_TRUE(r.allIntact);
+  TEST_ASSERT_EQUAL_INT(STRESS_ITEMS, r.received.size() + ring.dropped());
+  // O mais recente nunca é descartado
+  TEST_ASSERT_EQUAL_INT(STRESS_ITEMS - 1, r.received.back());
+}
+
+void test_stress_spill_loses_nothing()
+{
+  SpscRing<Item> ring;
+  ring.begin(64, RING_SPILL, spillTo, &spilledSeqs);
+  StressResult r = stress(ring);
+
+  TEST_ASSERT_TRUE(r.inOrder);
+  TEST_ASSERT_TRUE(r.allIntact);
+  TEST_ASSERT_EQUAL_INT(0, ring.dropped());
+  TEST_ASSERT_EQUAL_INT(STRESS_ITEMS, r.received.size() + spilledSeqs.size());
+
+  std::vector<bool> seen(STRESS_ITEMS, false);
+  for (size_t i = 0; i < r.received.size(); i++)
+    seen[r.received[i]] = true;
+  for (size_t i = 0; i < spilledSeqs.size(); i++)
+    seen[spilledSeqs[i]] = true;
+  for (uint32_t i = 0; i < STRESS_ITEMS; i++)
+    if (!seen[i])
+      TEST_FAIL_MESSAGE("item perdido");
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_capacity_rounds_to_power_of_two);
+  RUN_TEST(test_batch_pop_in_order);
+  RUN_TEST(test_pop_through_leaves_open_cycle);
+  RUN_TEST(test_pop_through_full_ring_without_end);
+  RUN_TEST(test_overflow_policies_single_thread);
+  RUN_TEST(test_stress_drop_newest);
+  RUN_TEST(test_stress_drop_oldest);
+  RUN_TEST(test_stress_spill_loses_nothing);
+  UNITY_END();
+  return 0;
+}
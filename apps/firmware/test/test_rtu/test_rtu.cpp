@@ -0,0 +1,314 @@
+#include <unity.h>
+#include <deque>
+#include <vector>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/MeterProfiles.cpp"
+#include "../../src/ModbusRtuMaster.cpp"
+
+// Porta roteirizada: guarda os quadros enviados e entrega cada byte de
+// resposta só quando o relógio alcança o instante em que ele terminaria de chegar
+class ScriptedPort : public RtuPort {
+public:
+  uint32_t now = 0;
+  std::vector<std::vector<uint8_t> > sent;
+  std::vector<uint32_t> sentAt;
+  std::deque<std::pair<uint32_t, uint8_t> > rx;
+  bool exact = true; // false = porta como a UART (sem carimbo por byte)
+
+  void send(const uint8_t *frame, size_t len) override
+  {
+    sent.push_back(std::vector<uint8_t>(frame, frame + len));
+    sentAt.push_back(now);
+  }
+
+  size_t receive(uint8_t *buf, size_t max) override
+  {
+    size_t n = 0;
+    while (n < max && !rx.empty() && rx.front().first <= now)
+    {
+      buf[n++] = rx.front().second;
+      rx.pop_front();
+    }
+    return n;
+  }
+
+  uint32_t nowUs() override { return now; }
+  void waitEvent(uint32_t timeoutUs) override { now += timeoutUs; }
+  bool exactByteTimes() const override { return exact; }
+
+  // Agenda a resposta começando em startUs; opcionalmente com silêncio extra depois do byte gapAfter
+  uint32_t reply(uint32_t startUs, const std::vector<uint8_t> &bytes, uint32_t charUs, int gapAfter = -1, uint32_t gapUs = 0)
+  {
+    uint32_t t = startUs;
+    for (size_t i = 0; i < bytes.size(); i++)
+    {
+      t += charUs;
+      rx.push_back(std::make_pair(t, bytes[i]));
+      if ((int)i == gapAfter)
+        t += gapUs;
+    }
+    return t; // Fim do último byte
+  }
+};
+
+static ScriptedPort port;
+static ModbusRtuMaster master;
+static RtuResult result;
+
+static std::vector<uint8_t> withCrc(std::vector<uint8_t> frame)
+{
+  uint16_t crc = crc16Modbus(frame.data(), frame.size());
+  frame.push_back(crc & 0xFF);
+  frame.push_back(crc >> 8);
+  return frame;
+}
+
+static RtuRequest request(uint8_t slave, uint16_t start, uint16_t count, uint32_t timeoutUs = 0)
+{
+  RtuRequest r;
+  r.slave = slave;
+  r.function = FC_HOLDING;
+  r.start = start;
+  r.count = count;
+  r.timeoutUs = timeoutUs;
+  r.tag = slave;
+  return r;
+}
+
+// Avança o relógio em passos de 100 us chamando poll(); para na primeira resposta
+static bool runUntil(uint32_t untilUs)
+{
+  while (port.now < untilUs)
+  {
+    master.poll(port.now);
+    if (master.nextResult(result))
+      return true;
+    port.now = (untilUs - port.now > 100) ? port.now + 100 : untilUs;
+  }
+  master.poll(port.now);
+  return master.nextResult(result);
+}
+
+static uint32_t charUs() { return master.timing().charUs; }
+
+void setUp(void)
+{
+  port = ScriptedPort();
+  port.now = 1000000;
+  master = ModbusRtuMaster();
+  master.begin(&port, 9600);
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_timing_from_baud()
+{
+  RtuTiming t = RtuTiming::forBaud(9600);
+  TEST_ASSERT_EQUAL_UINT32(1146, t.charUs);
+  TEST_ASSERT_EQUAL_UINT32(1719, t.t15Us);
+  TEST_ASSERT_EQUAL_UINT32(4011, t.t35Us);
+
+  t = RtuTiming::forBaud(19200);
+  TEST_ASSERT_EQUAL_UINT32(573, t.charUs);
+  TEST_ASSERT_EQUAL_UINT32(2005, t.t35Us);
+
+  // Acima de 19200 os silêncios são fixos
+  t = RtuTiming::forBaud(115200);
+  TEST_ASSERT_EQUAL_UINT32(750, t.t15Us);
+  TEST_ASSERT_EQUAL_UINT32(1750, t.t35Us);
+}
+
+void test_request_frame_and_crc()
+{
+  // Vetor clássico: 01 03 00 00 00 0A C5 CD
+  uint8_t frame[8];
+  TEST_ASSERT_EQUAL_INT(8, ModbusRtuMaster::buildRequest(request(1, 0x0000, 10), frame));
+  const uint8_t expected[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A, 0xC5, 0xCD};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame, 8);
+}
+
+void test_reads_registers()
+{
+  TEST_ASSERT_TRUE(master.submit(request(1, 0x000C, 2)));
+  master.poll(port.now);
+  TEST_ASSERT_EQUAL_INT(1, port.sent.size());
+
+  uint32_t txEnd = port.now + 8 * charUs();
+  uint32_t last = port.reply(txEnd + 5000, withCrc({0x01, 0x03, 0x04, 0x08, 0x9D, 0x02, 0x0B}), charUs());
+
+  // Entrega assim que o último byte esperado chega, sem esperar o t3.5
+  TEST_ASSERT_TRUE(runUntil(last + 200));
+  TEST_ASSERT_LESS_OR_EQUAL(last + 100, port.now);
+  TEST_ASSERT_EQUAL_INT(RTU_OK, result.status);
+  TEST_ASSERT_EQUAL_HEX16(0x089D, result.regs[0]);
+  TEST_ASSERT_EQUAL_HEX16(0x020B, result.regs[1]);
+  TEST_ASSERT_EQUAL_INT(1, result.request.tag);
+  TEST_ASSERT_UINT32_WITHIN(100, last - txEnd, result.latencyUs);
+  TEST_ASSERT_UINT32_WITHIN(100, 5000, result.responseUs);
+}
+
+void test_crc_error()
+{
+  master.submit(request(1, 0, 1));
+  master.poll(port.now);
+
+  std::vector<uint8_t> frame = withCrc({0x01, 0x03, 0x02, 0x12, 0x34});
+  frame.back() ^= 0xFF;
+  port.reply(port.now + 20000, frame, charUs());
+
+  TEST_ASSERT_TRUE(runUntil(port.now + 100000));
+  TEST_ASSERT_EQUAL_INT(RTU_CRC_ERROR, result.status);
+}
+
+void test_exception_response()
+{
+  master.submit(request(1, 0, 10));
+  master.poll(port.now);
+  uint32_t last = port.reply(port.now + 20000, withCrc({0x01, 0x83, 0x02}), charUs());
+
+  // 5 bytes bastam para uma exceção
+  TEST_ASSERT_TRUE(runUntil(last + 200));
+  TEST_ASSERT_EQUAL_INT(RTU_EXCEPTION, result.status);
+  TEST_ASSERT_EQUAL_HEX8(0x02, result.exceptionCode);
+}
+
+void test_silent_slave_times_out()
+{
+  master.submit(request(7, 0, 2, 100000));
+  master.poll(port.now);
+  uint32_t txEnd = port.now + 8 * charUs();
+
+  TEST_ASSERT_FALSE(runUntil(txEnd + 99900));
+  TEST_ASSERT_EQUAL_UINT32(100, master.nextEventUs(port.now));
+  TEST_ASSERT_TRUE(runUntil(txEnd + 100000));
+  TEST_ASSERT_EQUAL_INT(RTU_TIMEOUT, result.status);
+  TEST_ASSERT_EQUAL_INT(7, result.request.slave);
+}
+
+void test_inter_char_gap_over_t15_breaks_frame()
+{
+  std::vector<uint8_t> frame = withCrc({0x01, 0x03, 0x02, 0x12, 0x34});
+
+  // 1 caractere de silêncio (< t1.5): válido
+  master.submit(request(1, 0, 1));
+  master.poll(port.now);
+  port.reply(port.now + 20000, frame, charUs(), 2, charUs());
+  TEST_ASSERT_TRUE(runUntil(port.now + 100000));
+  TEST_ASSERT_EQUAL_INT(RTU_OK, result.status);
+
+  // 2 caracteres de silêncio (> t1.5, < t3.5): quadro descartado
+  master.submit(request(1, 0, 1));
+  port.now += 10000;
+  master.poll(port.now);
+  port.reply(port.now + 20000, frame, charUs(), 2, 2 * charUs());
+  TEST_ASSERT_TRUE(runUntil(port.now + 100000));
+  TEST_ASSERT_EQUAL_INT(RTU_FRAME_ERROR, result.status);
+}
+
+void test_gap_not_checked_without_byte_times()
+{
+  // UART: o poll() pode rodar atrasado, então o intervalo medido não vale
+  port.exact = false;
+  master.begin(&port, 9600);
+  std::vector<uint8_t> frame = withCrc({0x01, 0x03, 0x02, 0x12, 0x34});
+
+  master.submit(request(1, 0, 1));
+  master.poll(port.now);
+  port.reply(port.now + 20000, frame, charUs(), 2, 2 * charUs());
+  TEST_ASSERT_TRUE(runUntil(port.now + 100000));
+  TEST_ASSERT_EQUAL_INT(RTU_OK, result.status);
+
+  // O quadro ainda termina pelo t3.5 e o CRC continua valendo
+  master.submit(request(1, 0, 1));
+  port.now += 10000;
+  master.poll(port.now);
+  port.reply(port.now + 20000, frame, charUs(), 2, 4 * charUs());
+  TEST_ASSERT_TRUE(runUntil(port.now + 100000));
+  TEST_ASSERT_EQUAL_INT(RTU_FRAME_ERROR, result.status);
+}
+
+void test_truncated_frame_ends_after_t35()
+{
+  master.submit(request(1, 0, 2));
+  master.poll(port.now);
+
+  std::vector<uint8_t> frame = withCrc({0x01, 0x03, 0x04, 0x08, 0x9D, 0x02, 0x0B});
+  frame.resize(6);
+  uint32_t last = port.reply(port.now + 20000, frame, charUs());
+
+  // Menor que o esperado: só termina com o silêncio de t3.5
+  TEST_ASSERT_FALSE(runUntil(last + master.timing().t35Us - 100));
+  TEST_ASSERT_TRUE(runUntil(last + master.timing().t35Us + 100));
+  TEST_ASSERT_EQUAL_INT(RTU_FRAME_ERROR, result.status);
+}
+
+void test_reply_from_wrong_slave_is_rejected()
+{
+  master.submit(request(1, 0, 1));
+  master.poll(port.now);
+  port.reply(port.now + 20000, withCrc({0x02, 0x03, 0x02, 0x12, 0x34}), charUs());
+
+  TEST_ASSERT_TRUE(runUntil(port.now + 100000));
+  TEST_ASSERT_EQUAL_INT(RTU_FRAME_ERROR, result.status);
+}
+
+void test_next_frame_waits_t35_after_reply()
+{
+  // Duas requisições na fila: a segunda sai t3.5 depois do fim da primeira
+  // resposta, que já está disponível para decodificar nesse meio tempo
+  master.submit(request(1, 0, 1));
+  master.submit(request(2, 0, 1));
+  master.poll(port.now);
+  TEST_ASSERT_EQUAL_INT(1, port.sent.size());
+
+  uint32_t last = port.reply(port.now + 20000, withCrc({0x01, 0x03, 0x02, 0x12, 0x34}), charUs());
+  TEST_ASSERT_TRUE(runUntil(last + 200));
+  TEST_ASSERT_EQUAL_INT(1, port.sent.size());
+
+  while (port.sent.size() < 2 && port.now < last + 20000)
+  {
+    port.now += 100;
+    master.poll(port.now);
+  }
+  TEST_ASSERT_EQUAL_INT(2, port.sent.size());
+  TEST_ASSERT_GREATER_OR_EQUAL(master.timing().t35Us, port.sentAt[1] - last);
+  // Folga de dois passos: o byte é lido até 100 us depois de chegar
+  TEST_ASSERT_LESS_THAN(master.timing().t35Us + 200, port.sentAt[1] - last);
+  TEST_ASSERT_EQUAL_HEX8(0x02, port.sent[1][0]);
+}
+
+void test_cancel_and_limits()
+{
+  TEST_ASSERT_FALSE(master.submit(request(0, 0, 1)));    // broadcast não tem resposta
+  TEST_ASSERT_FALSE(master.submit(request(1, 0, 126)));  // acima do limite do protocolo
+
+  for (uint8_t i = 0; i < RTU_MAX_QUEUE; i++)
+    TEST_ASSERT_TRUE(master.submit(request(i < 2 ? 1 : 2, 0, 1)));
+  TEST_ASSERT_FALSE(master.submit(request(3, 0, 1)));
+
+  TEST_ASSERT_EQUAL_INT(2, master.cancel(2));
+  TEST_ASSERT_TRUE(master.submit(request(3, 0, 1)));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_timing_from_baud);
+  RUN_TEST(test_request_frame_and_crc);
+  RUN_TEST(test_reads_registers);
+  RUN_TEST(test_crc_error);
+  RUN_TEST(test_exception_response);
+  RUN_TEST(test_silent_slave_times_out);
+  RUN_TEST(test_inter_char_gap_over_t15_breaks_frame);
+  RUN_TEST(test_gap_not_checked_without_byte_times);
+  RUN_TEST(test_truncated_frame_ends_after_t35);
+  RUN_TEST(test_reply_from_wrong_slave_is_rejected);
+  RUN_TEST(test_next_frame_waits_t35_after_reply);
+  RUN_TEST(test_cancel_and_limits);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/PollScheduler.cpp"
+
+static std::vector<MeterConfig> meters;
+static uint32_t polls[16];
+
+static void addMeter(uint16_t periodSec)
+{
+  MeterConfig m;
+  m.id = meters.size() + 1;
+  m.channelIndex = m.id;
+  m.modbusId = m.id;
+  m.model = METER_DDS238;
+  m.periodSec = periodSec;
+  meters.push_back(m);
+}
+
+// Reproduz o laço da taskModbus sobre o relógio virtual: dorme até a
+// liberação, "lê" cada medidor vencido gastando pollMs e fecha o ciclo.
+static void run(PollScheduler &sched, uint32_t untilMs, uint32_t pollMs, uint32_t lateStartMs = 0)
+{
+  uint8_t due[16];
+  while (true)
+  {
+    uint32_t release = sched.nextRelease();
+    if (release >= untilMs)
+      break;
+    if ((int32_t)(release - millis()) > 0)
+      mockMillis = release;
+    delay(lateStartMs);
+
+    uint32_t start = millis();
+    size_t n = sched.collectDue(start, due, 16);
+    for (size_t i = 0; i < n; i++)
+    {
+      polls[due[i]]++;
+      delay(pollMs);
+    }
+    sched.endCycle(release, start, millis());
+  }
+}
+
+void setUp(void)
+{
+  mockMillis = 0;
+  meters.clear();
+  memset(polls, 0, sizeof(polls));
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_period_does_not_drift()
+{
+  addMeter(0);
+  addMeter(0);
+
+  PollScheduler sched;
+  sched.configure(meters, 5000, millis());
+
+  // 1000 ciclos gastando 730 ms de barramento cada: com "poll + delay(intervalo)"
+  // isso atrasaria 730 s; com deadline absoluto as liberações ficam na grade.
+  run(sched, 1000 * 5000, 365);
+
+  TEST_ASSERT_EQUAL_INT(1000, polls[0]);
+  TEST_ASSERT_EQUAL_INT(1000, polls[1]);
+  TEST_ASSERT_EQUAL_INT(1000 * 5000, sched.nextRelease());
+  TEST_ASSERT_EQUAL_INT(0, sched.stats().overruns);
+  TEST_ASSERT_EQUAL_INT(0, sched.stats().maxJitterMs);
+}
+
+void test_multi_rate_with_staggered_groups()
+{
+  addMeter(5);  // alimentador
+  addMeter(60); // sub-medidor
+  addMeter(60); // sub-medidor
+
+  PollScheduler sched;
+  sched.configure(meters, 300000, millis());
+
+  uint8_t due[16];
+  // t=0: só o grupo de 5 s; os de 60 s entram defasados em 2,5 s
+  TEST_ASSERT_EQUAL_INT(1, sched.collectDue(0, due, 16));
+  TEST_ASSERT_EQUAL_INT(2500, sched.nextRelease());
+  TEST_ASSERT_EQUAL_INT(2, sched.collectDue(2500, due, 16));
+  TEST_ASSERT_EQUAL_INT(5000, sched.nextRelease());
+
+  setUp();
+  addMeter(5);
+  addMeter(60);
+  addMeter(60);
+  sched.configure(meters, 300000, millis());
+  run(sched, 120000, 50);
+
+  TEST_ASSERT_EQUAL_INT(24, polls[0]);
+  TEST_ASSERT_EQUAL_INT(2, polls[1]);
+  TEST_ASSERT_EQUAL_INT(2, polls[2]);
+}
+
+void test_overrun_is_reported_and_grid_kept()
+{
+  addMeter(0);
+  addMeter(0);
+
+  PollScheduler sched;
+  sched.configure(meters, 1000, millis());
+
+  // Cada ciclo leva 1,6 s para um período de 1 s
+  run(sched, 10000, 800);
+
+  const SchedulerStats &st = sched.stats();
+  TEST_ASSERT_GREATER_THAN(0, st.overruns);
+  TEST_ASSERT_GREATER_THAN(0, st.skipped);
+  TEST_ASSERT_EQUAL_INT(1600, st.lastCycleMs);
+  // As liberações continuam múltiplas do período
+  TEST_ASSERT_EQUAL_INT(0, sched.nextRelease() % 1000);
+}
+
+void test_jitter_is_measured()
+{
+  addMeter(0);
+
+  PollScheduler sched;
+  sched.configure(meters, 1000, millis());
+  run(sched, 5000, 10, 20);
+
+  TEST_ASSERT_EQUAL_INT(20, sched.stats().lastJitterMs);
+  TEST_ASSERT_EQUAL_INT(20, sched.stats().maxJitterMs);
+  TEST_ASSERT_EQUAL_INT(5, sched.stats().cycles);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_period_does_not_drift);
+  RUN_TEST(test_multi_rate_with_staggered_groups);
+  RUN_TEST(test_overrun_is_reported_and_grid_kept);
+  RUN_TEST(test_jitter_is_measured);
+  UNITY_END();
+  return 0;
+}
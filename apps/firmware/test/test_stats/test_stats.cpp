@@ -0,0 +1,134 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/ChannelStats.cpp"
+
+static ChannelStats stats;
+static MeterReading summary;
+
+static void sample(float v, float i, float p, float kwh)
+{
+  MeterReading r;
+  memset(&r, 0, sizeof(r));
+  r.voltage = v;
+  r.current = i;
+  r.power = p;
+  r.totalKwh = kwh;
+  stats.add(r);
+}
+
+void setUp(void)
+{
+  stats = ChannelStats();
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_min_max_mean()
+{
+  sample(220.0f, 1.0f, 200.0f, 100.0f);
+  sample(230.0f, 3.0f, 2500.0f, 100.5f); // pico entre dois relatórios
+  sample(225.0f, 2.0f, 300.0f, 101.0f);
+
+  stats.summarize(summary);
+  TEST_ASSERT_TRUE(summary.flags & READING_SUMMARY);
+  TEST_ASSERT_EQUAL_INT(3, summary.samples);
+  TEST_ASSERT_EQUAL_FLOAT(225.0f, summary.voltage);
+  TEST_ASSERT_EQUAL_FLOAT(220.0f, summary.voltageMin);
+  TEST_ASSERT_EQUAL_FLOAT(230.0f, summary.voltageMax);
+  TEST_ASSERT_EQUAL_FLOAT(2.0f, summary.current);
+  TEST_ASSERT_EQUAL_FLOAT(1000.0f, summary.power);
+  TEST_ASSERT_EQUAL_FLOAT(2500.0f, summary.powerMax);
+  TEST_ASSERT_EQUAL_FLOAT(101.0f, summary.totalKwh);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 1.0f, summary.energyDelta);
+
+  // A janela seguinte começa vazia
+  TEST_ASSERT_EQUAL_INT(0, stats.count());
+}
+
+void test_energy_carries_over_between_windows()
+{
+  sample(220, 1, 100, 10.0f);
+  sample(220, 1, 100, 10.2f);
+  stats.summarize(summary);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.2f, summary.energyDelta);
+
+  // O consumo entre a última amostra da janela anterior e a primeira desta conta aqui
+  sample(220, 1, 100, 10.5f);
+  stats.summarize(summary);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 0.3f, summary.energyDelta);
+}
+
+void test_counter_reset_is_ignored()
+{
+  sample(220, 1, 100, 500.0f);
+  sample(220, 1, 100, 500.4f);
+  sample(220, 1, 100, 0.1f); // medidor trocado/zerado
+  sample(220, 1, 100, 0.3f);
+
+  stats.summarize(summary);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 0.6f, summary.energyDelta);
+}
+
+void test_mean_is_stable_over_long_windows()
+{
+  // Um dia de amostras a cada 1 s oscilando em torno de 220,1 V.
+  // Somando em float, a partir de ~2^24 / 220 amostras cada parcela perde bits.
+  const uint32_t n = 86400 * 4;
+  float naive = 0;
+  for (uint32_t k = 0; k < n; k++)
+  {
+    float v = (k & 1) ? 220.05f : 220.15f;
+    naive += v;
+    sample(v, 0.5f, 110.0f, 0);
+  }
+
+  stats.summarize(summary);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, 220.1f, summary.voltage);
+  TEST_ASSERT_EQUAL_FLOAT(220.05f, summary.voltageMin);
+  TEST_ASSERT_EQUAL_FLOAT(220.15f, summary.voltageMax);
+  TEST_ASSERT_EQUAL_INT(0xFFFF, summary.samples); // satura, não dá a volta
+
+  // Referência: a soma ingênua em float erraria bem mais
+  TEST_ASSERT_TRUE(fabs(naive / n - 220.1f) > 0.01f);
+}
+
+void test_empty_window()
+{
+  stats.summarize(summary);
+  TEST_ASSERT_EQUAL_INT(0, summary.samples);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, summary.energyDelta);
+}
+
+void test_summary_carries_last_sample_time()
+{
+  MeterReading r;
+  memset(&r, 0, sizeof(r));
+  r.bootId = 7;
+  r.timeMs = 5000;
+  stats.add(r);
+  r.timeMs = 1700000000000LL;
+  r.flags = READING_TIME_UTC; // o SNTP sincronizou no meio da janela
+  stats.add(r);
+
+  stats.summarize(summary);
+  TEST_ASSERT_EQUAL_INT(READING_SUMMARY | READING_TIME_UTC, summary.flags);
+  TEST_ASSERT_TRUE(summary.timeMs == 1700000000000LL);
+  TEST_ASSERT_EQUAL_INT(7, summary.bootId);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_min_max_mean);
+  RUN_TEST(test_energy_carries_over_between_windows);
+  RUN_TEST(test_counter_reset_is_ignored);
+  RUN_TEST(test_mean_is_stable_over_long_windows);
+  RUN_TEST(test_empty_window);
+  RUN_TEST(test_summary_carries_last_sample_time);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,171 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/WifiLink.cpp"
+#include "../../src/Metrics.cpp"
+
+static const uint8_t BSSID[6] = {0xAA, 0xBB, 0xCC, 0x01, 0x02, 0x03};
+static WifiLink link;
+
+// Menor atraso sorteado (random = 0 pega o começo da faixa do jitter)
+static uint32_t minDelay(uint32_t ms)
+{
+  return ms - ms * WIFI_RETRY_JITTER_PCT / 100;
+}
+
+void setUp(void)
+{
+  link = WifiLink();
+  link.begin(true, 0);
+}
+
+void tearDown(void) {}
+
+// Conecta na primeira tentativa (t = 0)
+static void connectNow(uint32_t now)
+{
+  TEST_ASSERT_NOT_EQUAL(LINK_NONE, link.poll(now));
+  link.connected(now + 800, BSSID, 6);
+}
+
+// --- CASOS DE TESTE ---
+
+void test_begin_connects_immediately()
+{
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECT, link.poll(0));
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECTING, link.state());
+  TEST_ASSERT_EQUAL_INT(LINK_NONE, link.poll(100)); // Esperando o evento
+
+  link.connected(900, BSSID, 6);
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECTED, link.state());
+  TEST_ASSERT_EQUAL_INT(1, link.metrics().connects);
+  TEST_ASSERT_EQUAL_INT(6, link.hintChannel());
+}
+
+void test_blip_reconnects_sub_second_on_cached_bssid()
+{
+  connectNow(0);
+
+  // AP pisca: a primeira tentativa sai em ~250 ms, direto no BSSID/canal
+  link.disconnected(10000, 200);
+  TEST_ASSERT_EQUAL_INT(LINK_NONE, link.poll(10000 + minDelay(WIFI_RETRY_BASE_MS) - 1));
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECT_FAST, link.poll(10000 + minDelay(WIFI_RETRY_BASE_MS)));
+
+  link.connected(10900, BSSID, 6);
+  TEST_ASSERT_EQUAL_INT(1, link.metrics().disconnects);
+  TEST_ASSERT_EQUAL_UINT32(900, link.metrics().lastReconnectMs);
+  TEST_ASSERT_EQUAL_UINT32(900, link.metrics().maxReconnectMs);
+  TEST_ASSERT_EQUAL_UINT32(1, link.metrics().reconnect.count);
+}
+
+void test_failed_fast_attempt_falls_back_to_full_scan_with_backoff()
+{
+  connectNow(0);
+  link.disconnected(10000, 200);
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECT_FAST, link.poll(10250));
+
+  // AP trocou de canal: o rápido falha e as próximas varrem, dobrando o intervalo
+  link.disconnected(10400, 201);
+  TEST_ASSERT_FALSE(link.hasHint());
+  TEST_ASSERT_EQUAL_INT(LINK_NONE, link.poll(10400 + minDelay(500) - 1));
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECT, link.poll(10400 + minDelay(500)));
+  link.disconnected(11000, 201);
+  TEST_ASSERT_EQUAL_INT(LINK_NONE, link.poll(11000 + minDelay(1000) - 1));
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECT, link.poll(11000 + minDelay(1000)));
+  TEST_ASSERT_EQUAL_INT(2, link.metrics().failures);
+
+  link.connected(12500, BSSID, 11);
+  TEST_ASSERT_EQUAL_UINT32(2500, link.metrics().lastReconnectMs);
+  TEST_ASSERT_EQUAL_INT(11, link.hintChannel());
+}
+
+void test_own_disconnect_echo_is_not_a_failure()
+{
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECT, link.poll(0));
+  link.disconnected(50, WIFI_REASON_LEFT); // Eco do begin() trocando de config
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECTING, link.state());
+  TEST_ASSERT_EQUAL_INT(0, link.metrics().failures);
+
+  // Eventos repetidos do driver com a conexão já fora não contam de novo
+  link.disconnected(100, 201);
+  link.disconnected(101, 201);
+  TEST_ASSERT_EQUAL_INT(1, link.metrics().failures);
+}
+
+void test_stuck_attempt_times_out()
+{
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECT, link.poll(0));
+  TEST_ASSERT_EQUAL_INT(LINK_NONE, link.poll(WIFI_CONNECT_TIMEOUT_MS - 1));
+  TEST_ASSERT_EQUAL_INT(LINK_ABORT, link.poll(WIFI_CONNECT_TIMEOUT_MS));
+  TEST_ASSERT_EQUAL_INT(LINK_WAITING, link.state());
+  TEST_ASSERT_EQUAL_INT(1, link.metrics().failures);
+}
+
+void test_ap_fallback_by_time_and_stop_when_back()
+{
+  // Credenciais que nunca conectaram: AP em WIFI_AP_FALLBACK_MS, STA segue tentando
+  uint32_t t = 0;
+  bool apStarted = false;
+  while (t <= WIFI_AP_FALLBACK_MS && !apStarted)
+  {
+    WifiLinkAction a = link.poll(t);
+    if (a == LINK_CONNECT)
+      link.disconnected(t + 100, 15); // Senha errada
+    if (a == LINK_START_AP)
+      apStarted = true;
+    t += 10;
+  }
+  TEST_ASSERT_TRUE(apStarted);
+  TEST_ASSERT_TRUE(t - 10 >= WIFI_AP_FALLBACK_MS);
+  link.setApActive(true);
+  TEST_ASSERT_EQUAL_INT(1, link.metrics().apFallbacks);
+
+  // Rede volta: conecta e o AP de emergência sai
+  uint32_t retry = t + WIFI_RETRY_MAX_MS;
+  TEST_ASSERT_EQUAL_INT(LINK_CONNECT, link.poll(retry));
+  link.connected(retry + 500, BSSID, 1);
+  TEST_ASSERT_EQUAL_INT(LINK_STOP_AP, link.poll(retry + 510));
+  link.setApActive(false);
+  TEST_ASSERT_EQUAL_INT(LINK_NONE, link.poll(retry + 520));
+}
+
+void test_proven_network_gets_longer_before_ap()
+{
+  connectNow(0);
+  link.disconnected(1000, 200);
+
+  uint32_t t = 1000;
+  for (; t < 1000 + WIFI_AP_AFTER_LOSS_MS; t += 100)
+  {
+    WifiLinkAction a = link.poll(t);
+    TEST_ASSERT_NOT_EQUAL(LINK_START_AP, a);
+    if (a == LINK_CONNECT || a == LINK_CONNECT_FAST)
+      link.disconnected(t + 50, 201);
+  }
+  TEST_ASSERT_EQUAL_INT(LINK_START_AP, link.poll(t));
+}
+
+void test_disabled_link_stays_quiet()
+{
+  link.begin(false, 0);
+  TEST_ASSERT_EQUAL_INT(LINK_NONE, link.poll(0));
+  TEST_ASSERT_EQUAL_INT(LINK_NONE, link.poll(WIFI_AP_AFTER_LOSS_MS * 2));
+  link.connected(10, BSSID, 1);
+  TEST_ASSERT_EQUAL_INT(LINK_OFF, link.state());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_begin_connects_immediately);
+  RUN_TEST(test_blip_reconnects_sub_second_on_cached_bssid);
+  RUN_TEST(test_failed_fast_attempt_falls_back_to_full_scan_with_backoff);
+  RUN_TEST(test_own_disconnect_echo_is_not_a_failure);
+  RUN_TEST(test_stuck_attempt_times_out);
+  RUN_TEST(test_ap_fallback_by_time_and_stop_when_back);
+  RUN_TEST(test_proven_network_gets_longer_before_ap);
+  RUN_TEST(test_disabled_link_stays_quiet);
+  UNITY_END();
+  return 0;
+}
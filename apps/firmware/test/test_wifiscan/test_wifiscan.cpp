@@ -0,0 +1,103 @@
+#include <unity.h>
+
+#include "../mocks/Arduino.h"
+
+#include "../../src/WifiScanCache.cpp"
+
+static WifiScanCache cache;
+
+void setUp(void)
+{
+  cache = WifiScanCache();
+}
+
+void tearDown(void) {}
+
+// --- CASOS DE TESTE ---
+
+void test_first_request_starts_a_scan_and_later_ones_use_the_cache()
+{
+  TEST_ASSERT_TRUE(cache.shouldStart(1000));
+  cache.started(1000);
+  TEST_ASSERT_TRUE(cache.scanning());
+  TEST_ASSERT_FALSE(cache.shouldStart(1500)); // Já rodando
+
+  cache.add("Kitnets", -60, true);
+  cache.finished(4000);
+  TEST_ASSERT_FALSE(cache.scanning());
+  TEST_ASSERT_TRUE(cache.hasResult());
+  TEST_ASSERT_EQUAL_UINT32(2000, cache.ageMs(6000));
+
+  // Atualizar a página não refaz o scan enquanto a lista é recente
+  TEST_ASSERT_FALSE(cache.shouldStart(10000));
+  TEST_ASSERT_FALSE(cache.shouldStart(4000 + SCAN_MAX_AGE_MS - 1));
+  TEST_ASSERT_TRUE(cache.shouldStart(4000 + SCAN_MAX_AGE_MS));
+}
+
+void test_failure_keeps_list_and_retries_after_min_interval()
+{
+  cache.started(0);
+  cache.add("Kitnets", -60, true);
+  cache.finished(3000);
+
+  cache.started(40000);
+  TEST_ASSERT_FALSE(cache.timedOut(40000 + SCAN_TIMEOUT_MS - 1));
+  TEST_ASSERT_TRUE(cache.timedOut(40000 + SCAN_TIMEOUT_MS));
+  cache.failed();
+
+  TEST_ASSERT_EQUAL_INT(1, cache.count());
+  TEST_ASSERT_FALSE(cache.shouldStart(40000 + SCAN_MIN_INTERVAL_MS - 1));
+  TEST_ASSERT_TRUE(cache.shouldStart(40000 + SCAN_MIN_INTERVAL_MS));
+}
+
+void test_entries_sorted_by_signal_without_duplicates()
+{
+  cache.add("B", -70, true);
+  cache.add("A", -50, false);
+  cache.add("", -10, false); // Oculta
+  cache.add("C", -80, true);
+  cache.add("C", -40, true); // Repetidor mais perto
+  cache.add("A", -90, false);
+
+  TEST_ASSERT_EQUAL_INT(3, cache.count());
+  TEST_ASSERT_EQUAL_STRING("C", cache.entry(0).ssid);
+  TEST_ASSERT_EQUAL_INT(-40, cache.entry(0).rssi);
+  TEST_ASSERT_EQUAL_STRING("A", cache.entry(1).ssid);
+  TEST_ASSERT_EQUAL_INT(-50, cache.entry(1).rssi);
+  TEST_ASSERT_FALSE(cache.entry(1).secure);
+  TEST_ASSERT_EQUAL_STRING("B", cache.entry(2).ssid);
+}
+
+void test_full_list_keeps_the_strongest()
+{
+  char ssid[8];
+  for (int i = 0; i < SCAN_MAX_NETWORKS; i++)
+  {
+    snprintf(ssid, sizeof(ssid), "N%d", i);
+    cache.add(ssid, -60 - i, true);
+  }
+  cache.add("Fraca", -99, true);
+  TEST_ASSERT_EQUAL_INT(SCAN_MAX_NETWORKS, cache.count());
+  TEST_ASSERT_EQUAL_STRING("N19", cache.entry(SCAN_MAX_NETWORKS - 1).ssid);
+
+  cache.add("Forte", -30, true);
+  TEST_ASSERT_EQUAL_INT(SCAN_MAX_NETWORKS, cache.count());
+  TEST_ASSERT_EQUAL_STRING("Forte", cache.entry(0).ssid);
+  TEST_ASSERT_EQUAL_STRING("N18", cache.entry(SCAN_MAX_NETWORKS - 1).ssid);
+
+  // SSID de 32 bytes (máximo do 802.11) cabe inteiro
+  cache.clear();
+  cache.add("0123456789abcdef0123456789abcdef", -40, true);
+  TEST_ASSERT_EQUAL_STRING("0123456789abcdef0123456789abcdef", cache.entry(0).ssid);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_first_request_starts_a_scan_and_later_ones_use_the_cache);
+  RUN_TEST(test_failure_keeps_list_and_retries_after_min_interval);
+  RUN_TEST(test_entries_sorted_by_signal_without_duplicates);
+  RUN_TEST(test_full_list_keeps_the_strongest);
+  UNITY_END();
+  return 0;
+}